@@ -2,6 +2,7 @@
 
 #include "Behaviour.hpp"
 #include "Animation/WrapMode.hpp"
+#include "Animation/AnimationCullingMode.hpp"
 
 namespace FishEngine
 {
@@ -15,6 +16,20 @@ namespace FishEngine
 		virtual void Start() override;
 		virtual void Update() override;
 
+		// What to do while none of the SkinnedMeshRenderers below is visible.
+		AnimationCullingMode cullingMode() const
+		{
+			return m_cullingMode;
+		}
+
+		void setCullingMode(AnimationCullingMode cullingMode)
+		{
+			m_cullingMode = cullingMode;
+		}
+
+		// One of the SkinnedMeshRenderers below was visible in the last frame, or there are none.
+		bool IsVisible() const;
+
 		// the default animation
 		//Meta(NonSerializable)
 		AnimationClipPtr m_clip;
@@ -25,11 +40,24 @@ namespace FishEngine
 
 		WrapMode m_wrapMode;
 
+		AnimationCullingMode m_cullingMode = AnimationCullingMode::AlwaysAnimate;
+
 		// temp
 		Meta(NonSerializable)
 		float m_localTimer = 0.0f;
 
 		Meta(NonSerializable)
 		std::map<std::string, TransformPtr> m_skeleton;
+
+		// the renderers of this game object and its children, collected again when the scene structure changes
+		Meta(NonSerializable)
+		mutable std::vector<std::weak_ptr<SkinnedMeshRenderer>> m_renderers;
+
+		// RendererRegistry::structureVersion() when m_renderers was collected, 0: never
+		Meta(NonSerializable)
+		mutable uint32_t m_renderersVersion = 0;
+
+	private:
+		void CollectRenderers() const;
 	};
 }
@@ -0,0 +1,13 @@
+#pragma once
+
+namespace FishEngine
+{
+	// What Animation and SkinnedMeshRenderer do while their renderers are neither seen by the camera nor cast
+	// shadows into the visible part of the shadow map.
+	enum class AnimationCullingMode
+	{
+		AlwaysAnimate,          // Animate and skin even when off-screen.
+		CullUpdateTransforms,   // Time keeps running, but the bones are not written and the mesh is not skinned while off-screen.
+		CullCompletely,         // Time stops too: the animation resumes where it was when it becomes visible again.
+	};
+}
@@ -5,6 +5,7 @@
 #include "Matrix4x4.hpp"
 #include "Ray.hpp"
 #include "Frustum.hpp"
+#include "CommandBuffer.hpp"
 
 namespace FishEngine 
 {
@@ -107,6 +108,30 @@ namespace FishEngine
 		// Returns a ray going from camera through a screen point.
 		Ray ScreenPointToRay(const Vector3& position);
 
+		// Add a command buffer to be executed at a specified place.
+		void AddCommandBuffer(Rendering::CameraEvent evt, Rendering::CommandBufferPtr const & buffer);
+
+		// Remove command buffer from execution at a specified place.
+		void RemoveCommandBuffer(Rendering::CameraEvent evt, Rendering::CommandBufferPtr const & buffer);
+
+		// Remove command buffers from execution at a specified place.
+		void RemoveCommandBuffers(Rendering::CameraEvent evt);
+
+		// Remove all command buffers set on this camera.
+		void RemoveAllCommandBuffers();
+
+		// Get command buffers to be executed at a specified place.
+		std::vector<Rendering::CommandBufferPtr> const & GetCommandBuffers(Rendering::CameraEvent evt) const
+		{
+			return m_commandBuffers[static_cast<int>(evt)];
+		}
+
+		// Number of command buffers set up on this camera.
+		int commandBufferCount() const;
+
+		// called by RenderSystem
+		void ExecuteCommandBuffers(Rendering::CameraEvent evt) const;
+
 		void virtual OnDrawGizmos() override;
 		void virtual OnDrawGizmosSelected() override;
 
@@ -158,6 +183,9 @@ namespace FishEngine
 		Meta(NonSerializable)
 		mutable Matrix4x4 m_projectMatrix;
 
+		Meta(NonSerializable)
+		std::vector<Rendering::CommandBufferPtr> m_commandBuffers[static_cast<int>(Rendering::CameraEvent::Count)];
+
 		static CameraPtr m_mainCamera;
 		static std::vector<CameraPtr> m_allCameras;
 	};
@@ -1,11 +1,121 @@
 #pragma once
 
-namespace FishEngine::Rendering
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "FishEngine.hpp"
+#include "ReflectClass.hpp"
+#include "Color.hpp"
+
+namespace FishEngine
 {
-	class CommandBuffer
+namespace Rendering
+{
+	// Defines a place in camera's rendering to attach CommandBuffer objects to.
+	enum class CameraEvent
+	{
+		BeforeGBuffer,			// before the deferred G-buffer is rendered, the G-buffer is the active target
+		AfterGBuffer,
+		BeforeForwardOpaque,	// before the opaque forward objects, the main target is active
+		AfterForwardOpaque,
+		BeforeSkybox,
+		AfterSkybox,
+		BeforeForwardAlpha,		// before the transparent objects
+		AfterForwardAlpha,
+		AfterEverything,
+
+		Count,
+	};
+
+	class CommandBuffer;
+	typedef std::shared_ptr<CommandBuffer> CommandBufferPtr;
+
+	// A list of graphics commands to execute.
+	// Recording only appends to a compact byte stream and never touches GL, so a buffer can be recorded on any thread
+	// (one thread per buffer at a time) and kept across frames. Execute() replays it on the GL thread.
+	class FE_EXPORT Meta(NonSerializable) CommandBuffer
 	{
 	public:
-		CommandBuffer();
+		CommandBuffer() = default;
+		explicit CommandBuffer(std::string const & name) : m_name(name) { }
+
+		// Name of this command buffer.
+		std::string const & name() const
+		{
+			return m_name;
+		}
+
+		void setName(std::string const & name)
+		{
+			m_name = name;
+		}
+
+		// Number of recorded commands.
+		uint32_t commandCount() const
+		{
+			return m_commandCount;
+		}
+
+		// Size in bytes of the recorded command stream.
+		std::size_t sizeInBytes() const
+		{
+			return m_stream.size();
+		}
+
+		// Clear all commands in the buffer.
+		void Clear();
+
+		// Add a "draw mesh" command. subMeshIndex -1 draws all submeshes.
+		void DrawMesh(MeshPtr const & mesh, Matrix4x4 const & matrix, MaterialPtr const & material, int subMeshIndex = -1);
+
+		// Add a "draw mesh with instancing" command, the matrices are copied into the buffer.
+		void DrawMeshInstanced(MeshPtr const & mesh, int subMeshIndex, MaterialPtr const & material, std::vector<Matrix4x4> const & matrices);
+
+		// Add a "set active render target" command. nullptr restores the target that was active before Execute().
+		void SetRenderTarget(RenderTargetPtr const & renderTarget);
+
+		// Adds a "clear render target" command.
+		void ClearRenderTarget(bool clearDepth, bool clearColor, Color const & backgroundColor, float depth = 1.0f);
+
+		// Add "set material property" commands, applied to the material when the buffer is executed.
+		// Names are turned into ids (Shader::PropertyToID) while recording.
+		void SetMaterialFloat(MaterialPtr const & material, std::string const & name, float value);
+		void SetMaterialVector(MaterialPtr const & material, std::string const & name, Vector4 const & value);
+		void SetMaterialMatrix(MaterialPtr const & material, std::string const & name, Matrix4x4 const & value);
+		void SetMaterialTexture(MaterialPtr const & material, std::string const & name, TexturePtr const & texture);
+		void SetMaterialFloat(MaterialPtr const & material, int nameID, float value);
+		void SetMaterialVector(MaterialPtr const & material, int nameID, Vector4 const & value);
+		void SetMaterialMatrix(MaterialPtr const & material, int nameID, Matrix4x4 const & value);
+		void SetMaterialTexture(MaterialPtr const & material, int nameID, TexturePtr const & texture);
+
+		// Add a "blit into a render target" command. dest nullptr: the active target;
+		// material nullptr: copy with the builtin DrawQuad material. source is set as _MainTex.
+		void Blit(TexturePtr const & source, RenderTargetPtr const & dest, MaterialPtr const & material = nullptr);
+
+		// Replay the commands, GL thread only.
+		void Execute() const;
+
+	private:
+		enum class CommandType : uint16_t;
+
+		void Append(CommandType type, const void* payload, uint32_t size, const void* extra = nullptr, uint32_t extraSize = 0);
+
+		uint32_t Reference(MeshPtr const & mesh);
+		uint32_t Reference(MaterialPtr const & material);
+		uint32_t Reference(TexturePtr const & texture);
+		uint32_t Reference(RenderTargetPtr const & renderTarget);
+
+		std::string					m_name;
+		uint32_t					m_commandCount = 0;
+
+		// commands: header + POD payload, objects are referenced by index into the tables below
+		std::vector<uint8_t>		m_stream;
 
+		std::vector<MeshPtr>			m_meshes;
+		std::vector<MaterialPtr>		m_materials;
+		std::vector<TexturePtr>			m_textures;
+		std::vector<RenderTargetPtr>	m_renderTargets;
 	};
-}
\ No newline at end of file
+}
+}
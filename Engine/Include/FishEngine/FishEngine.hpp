@@ -39,6 +39,8 @@ namespace FishEngine
 	class Camera;
 	class Renderer;
 	class MeshFilter;
+	class LODGroup;
+	struct LOD;
 	class MeshRenderer;
 	class SkinnedMeshRenderer;
 	class Script;
@@ -97,6 +99,7 @@ namespace FishEngine
 	typedef std::shared_ptr<Camera> CameraPtr;
 	typedef std::shared_ptr<Renderer> RendererPtr;
 	typedef std::shared_ptr<MeshFilter> MeshFilterPtr;
+	typedef std::shared_ptr<LODGroup> LODGroupPtr;
 	typedef std::shared_ptr<MeshRenderer> MeshRendererPtr;
 	typedef std::shared_ptr<SkinnedMeshRenderer> SkinnedMeshRendererPtr;
 	typedef std::shared_ptr<Script> ScriptPtr;
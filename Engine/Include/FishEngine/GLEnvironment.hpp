@@ -35,4 +35,7 @@
 
 FE_EXPORT void _checkOpenGLError(const char *file, int line);
 
+// routes the gl* calls through the active graphics device
+#include "Render/GraphicsDevice.hpp"
+
 #endif // GLEnvironment_hpp
@@ -9,6 +9,7 @@
 #include "PrimitiveType.hpp"
 #include "Generated/Class_ComponentInfo.hpp"
 #include "Component_gen.hpp"
+#include "Render/RendererRegistry.hpp"
 
 template< class T >
 using PtrVector = std::vector< std::shared_ptr<T> >;
@@ -101,12 +102,17 @@ namespace FishEngine
 		void RemoveComponent(ComponentPtr component)
 		{
 			m_components.remove(component);
+			RendererRegistry::OnComponentRemoved(component);
 		}
 
 		// Activates/Deactivates the GameObject (activeSelf).
 		void SetActive(bool value)
 		{
-			m_activeSelf = value;
+			if (m_activeSelf != value)
+			{
+				m_activeSelf = value;
+				RendererRegistry::SetStateDirty(*this);
+			}
 		}
 
 		/************************************************************************/
@@ -272,6 +278,7 @@ inline bool FishEngine::GameObject::AddComponent(ComponentPtr component)
 	component->m_gameObject = m_transform->gameObject();
 	m_components.push_back(component);
 	component->Reset();
+	RendererRegistry::OnComponentAdded(component);
 	return true;
 }
 
@@ -287,6 +294,7 @@ std::shared_ptr<T> FishEngine::GameObject::AddComponent()
 	auto component = MakeShared<T>();
 	component->m_gameObject = m_transform->gameObject();
 	m_components.push_back(component);
+	RendererRegistry::OnComponentAdded(component);
 	return component;
 }
 
@@ -25,6 +25,7 @@ namespace FishEngine
 	//	{"Light", "Behaviour"},
 	//	{"Animator", "Component"},
 	//	{"MeshFilter", "Component"},
+	//	{"LODGroup", "Component"},
 	//	{"CameraController", "Script"},
 	//	{"BoxCollider", "Collider"},
 	//	{"Renderer", "Component"},
@@ -53,6 +54,7 @@ namespace FishEngine
 		{ ClassID<FishEngine::Component>(), ClassID<FishEngine::Object>() },
 		{ ClassID<FishEngine::Cubemap>(), ClassID<FishEngine::Texture>() },
 		{ ClassID<FishEngine::GameObject>(), ClassID<FishEngine::Object>() },
+		{ ClassID<FishEngine::LODGroup>(), ClassID<FishEngine::Component>() },
 		{ ClassID<FishEngine::Light>(), ClassID<FishEngine::Behaviour>() },
 		{ ClassID<FishEngine::Material>(), ClassID<FishEngine::Object>() },
 		{ ClassID<FishEngine::Mesh>(), ClassID<FishEngine::Object>() },
@@ -55,6 +55,7 @@
 #include "../Color.hpp"
 #include "../MeshRenderer.hpp"
 #include "../Skybox.hpp"
+#include "../ShaderVariantCollection.hpp"
 #include "../GameApp.hpp"
 #include "../Ray.hpp"
 
@@ -123,9 +124,9 @@ namespace FishEngine
 	{
 		archive << BaseClassWrapper<Object>(value);
 		archive << make_nvp("m_shader", value.m_shader); // ShaderPtr
-		archive << make_nvp("m_textures", value.m_textures); // std::map<std::string, TexturePtr>
-		archive << make_nvp("m_uniforms", value.m_uniforms); // FishEngine::ShaderUniforms
 		archive << make_nvp("m_properties", value.m_properties); // std::vector<MaterialProperty>
+		archive << make_nvp("m_values", value.m_values); // std::vector<float>
+		archive << make_nvp("m_textureValues", value.m_textureValues); // std::vector<TexturePtr>
 	}
 
 	template<typename Archive>
@@ -133,9 +134,9 @@ namespace FishEngine
 	{
 		archive >> BaseClassWrapper<Object>(value);
 		archive >> make_nvp("m_shader", value.m_shader); // ShaderPtr
-		archive >> make_nvp("m_textures", value.m_textures); // std::map<std::string, TexturePtr>
-		archive >> make_nvp("m_uniforms", value.m_uniforms); // FishEngine::ShaderUniforms
 		archive >> make_nvp("m_properties", value.m_properties); // std::vector<MaterialProperty>
+		archive >> make_nvp("m_values", value.m_values); // std::vector<float>
+		archive >> make_nvp("m_textureValues", value.m_textureValues); // std::vector<TexturePtr>
 	}
 
 
@@ -179,6 +180,7 @@ namespace FishEngine
 	{
 		archive << make_nvp("name", value.name); // std::string
 		archive << make_nvp("type", value.type); // FishEngine::MaterialPropertyType
+		archive << make_nvp("offset", value.offset); // uint32_t
 	}
 
 	template<typename Archive>
@@ -186,6 +188,7 @@ namespace FishEngine
 	{
 		archive >> make_nvp("name", value.name); // std::string
 		archive >> make_nvp("type", value.type); // FishEngine::MaterialPropertyType
+		archive >> make_nvp("offset", value.offset); // uint32_t
 	}
 
 
@@ -487,6 +490,7 @@ namespace FishEngine
 		archive << make_nvp("m_ZWrite", value.m_ZWrite); // bool
 		archive << make_nvp("m_blend", value.m_blend); // bool
 		archive << make_nvp("m_deferred", value.m_deferred); // bool
+		archive << make_nvp("m_instancing", value.m_instancing); // bool
 		archive << make_nvp("m_keywords", value.m_keywords); // ShaderKeywords
 	}
 
@@ -499,6 +503,7 @@ namespace FishEngine
 		archive >> make_nvp("m_ZWrite", value.m_ZWrite); // bool
 		archive >> make_nvp("m_blend", value.m_blend); // bool
 		archive >> make_nvp("m_deferred", value.m_deferred); // bool
+		archive >> make_nvp("m_instancing", value.m_instancing); // bool
 		archive >> make_nvp("m_keywords", value.m_keywords); // ShaderKeywords
 	}
 
@@ -1116,6 +1121,38 @@ namespace FishEngine
 	}
 
 
+	// ShaderVariant
+	template<typename Archive>
+	void Save ( Archive& archive, ShaderVariant const & value )
+	{
+		archive << make_nvp("shader", value.shader); // ShaderPtr
+		archive << make_nvp("keywords", value.keywords); // ShaderKeywords
+	}
+
+	template<typename Archive>
+	void Load ( Archive& archive, ShaderVariant & value )
+	{
+		archive >> make_nvp("shader", value.shader); // ShaderPtr
+		archive >> make_nvp("keywords", value.keywords); // ShaderKeywords
+	}
+
+
+	// ShaderVariantCollection
+	template<typename Archive>
+	void Save ( Archive& archive, ShaderVariantCollection const & value )
+	{
+		archive << BaseClassWrapper<Object>(value);
+		archive << make_nvp("m_variants", value.m_variants); // std::vector<ShaderVariant>
+	}
+
+	template<typename Archive>
+	void Load ( Archive& archive, ShaderVariantCollection & value )
+	{
+		archive >> BaseClassWrapper<Object>(value);
+		archive >> make_nvp("m_variants", value.m_variants); // std::vector<ShaderVariant>
+	}
+
+
 	// GameApp
 	template<typename Archive>
 	void Save ( Archive& archive, GameApp const & value )
@@ -1233,6 +1270,9 @@ namespace FishEngine
             break;
         case ClassID<Skybox>():
             archive << *std::dynamic_pointer_cast<Skybox>(obj);
+            break;
+        case ClassID<ShaderVariantCollection>():
+            archive << *std::dynamic_pointer_cast<ShaderVariantCollection>(obj);
             break;;
         default:
             abort();
@@ -13,7 +13,7 @@ namespace FishEngine
 
 // enum count
 template<>
-constexpr int EnumCount<FishEngine::MaterialPropertyType>() { return 11; }
+constexpr int EnumCount<FishEngine::MaterialPropertyType>() { return 10; }
 
 // string array
 static const char* MaterialPropertyTypeStrings[] =
@@ -22,7 +22,6 @@ static const char* MaterialPropertyTypeStrings[] =
 	"Float2",
 	"Float3",
 	"Float4",
-	"Mat3",
 	"Mat4",
 	"Texture2D",
 	"Texture2DArray",
@@ -47,13 +46,12 @@ inline FishEngine::MaterialPropertyType ToEnum<FishEngine::MaterialPropertyType>
 	case 1: return FishEngine::MaterialPropertyType::Float2; break;
 	case 2: return FishEngine::MaterialPropertyType::Float3; break;
 	case 3: return FishEngine::MaterialPropertyType::Float4; break;
-	case 4: return FishEngine::MaterialPropertyType::Mat3; break;
-	case 5: return FishEngine::MaterialPropertyType::Mat4; break;
-	case 6: return FishEngine::MaterialPropertyType::Texture2D; break;
-	case 7: return FishEngine::MaterialPropertyType::Texture2DArray; break;
-	case 8: return FishEngine::MaterialPropertyType::Texture2DArrayShadow; break;
-	case 9: return FishEngine::MaterialPropertyType::Texture3D; break;
-	case 10: return FishEngine::MaterialPropertyType::TextureCube; break;
+	case 4: return FishEngine::MaterialPropertyType::Mat4; break;
+	case 5: return FishEngine::MaterialPropertyType::Texture2D; break;
+	case 6: return FishEngine::MaterialPropertyType::Texture2DArray; break;
+	case 7: return FishEngine::MaterialPropertyType::Texture2DArrayShadow; break;
+	case 8: return FishEngine::MaterialPropertyType::Texture3D; break;
+	case 9: return FishEngine::MaterialPropertyType::TextureCube; break;
 	
     default: abort(); break;
     }
@@ -68,13 +66,12 @@ inline int EnumToIndex<FishEngine::MaterialPropertyType>(FishEngine::MaterialPro
 	case FishEngine::MaterialPropertyType::Float2: return 1; break;
 	case FishEngine::MaterialPropertyType::Float3: return 2; break;
 	case FishEngine::MaterialPropertyType::Float4: return 3; break;
-	case FishEngine::MaterialPropertyType::Mat3: return 4; break;
-	case FishEngine::MaterialPropertyType::Mat4: return 5; break;
-	case FishEngine::MaterialPropertyType::Texture2D: return 6; break;
-	case FishEngine::MaterialPropertyType::Texture2DArray: return 7; break;
-	case FishEngine::MaterialPropertyType::Texture2DArrayShadow: return 8; break;
-	case FishEngine::MaterialPropertyType::Texture3D: return 9; break;
-	case FishEngine::MaterialPropertyType::TextureCube: return 10; break;
+	case FishEngine::MaterialPropertyType::Mat4: return 4; break;
+	case FishEngine::MaterialPropertyType::Texture2D: return 5; break;
+	case FishEngine::MaterialPropertyType::Texture2DArray: return 6; break;
+	case FishEngine::MaterialPropertyType::Texture2DArrayShadow: return 7; break;
+	case FishEngine::MaterialPropertyType::Texture3D: return 8; break;
+	case FishEngine::MaterialPropertyType::TextureCube: return 9; break;
 	
     default: abort(); break;
     }
@@ -88,7 +85,6 @@ inline FishEngine::MaterialPropertyType ToEnum<FishEngine::MaterialPropertyType>
 	if (s == "Float2") return FishEngine::MaterialPropertyType::Float2;
 	if (s == "Float3") return FishEngine::MaterialPropertyType::Float3;
 	if (s == "Float4") return FishEngine::MaterialPropertyType::Float4;
-	if (s == "Mat3") return FishEngine::MaterialPropertyType::Mat3;
 	if (s == "Mat4") return FishEngine::MaterialPropertyType::Mat4;
 	if (s == "Texture2D") return FishEngine::MaterialPropertyType::Texture2D;
 	if (s == "Texture2DArray") return FishEngine::MaterialPropertyType::Texture2DArray;
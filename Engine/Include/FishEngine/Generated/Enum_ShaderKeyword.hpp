@@ -13,13 +13,14 @@ namespace FishEngine
 
 // enum count
 template<>
-constexpr int EnumCount<FishEngine::ShaderKeyword>() { return 3; }
+constexpr int EnumCount<FishEngine::ShaderKeyword>() { return 4; }
 
 // string array
 static const char* ShaderKeywordStrings[] =
 {
     "None",
 	"AmbientIBL",
+	"Instancing",
 	"All"
 };
 
@@ -37,7 +38,8 @@ inline FishEngine::ShaderKeyword ToEnum<FishEngine::ShaderKeyword>(const int ind
     switch (index) {
     case 0: return FishEngine::ShaderKeyword::None; break;
 	case 1: return FishEngine::ShaderKeyword::AmbientIBL; break;
-	case 2: return FishEngine::ShaderKeyword::All; break;
+	case 2: return FishEngine::ShaderKeyword::Instancing; break;
+	case 3: return FishEngine::ShaderKeyword::All; break;
 	
     default: abort(); break;
     }
@@ -50,7 +52,8 @@ inline int EnumToIndex<FishEngine::ShaderKeyword>(FishEngine::ShaderKeyword e)
     switch (e) {
     case FishEngine::ShaderKeyword::None: return 0; break;
 	case FishEngine::ShaderKeyword::AmbientIBL: return 1; break;
-	case FishEngine::ShaderKeyword::All: return 2; break;
+	case FishEngine::ShaderKeyword::Instancing: return 2; break;
+	case FishEngine::ShaderKeyword::All: return 3; break;
 	
     default: abort(); break;
     }
@@ -62,6 +65,7 @@ inline FishEngine::ShaderKeyword ToEnum<FishEngine::ShaderKeyword>(const std::st
 {
     if (s == "None") return FishEngine::ShaderKeyword::None;
 	if (s == "AmbientIBL") return FishEngine::ShaderKeyword::AmbientIBL;
+	if (s == "Instancing") return FishEngine::ShaderKeyword::Instancing;
 	if (s == "All") return FishEngine::ShaderKeyword::All;
 	
     abort();
@@ -17,6 +17,15 @@ namespace FishEngine
 		static void DrawMesh(const MeshPtr& mesh, const Matrix4x4& matrix, const MaterialPtr& material);
 		static void DrawMesh(const MeshPtr& mesh, const MaterialPtr& material);
 		static void DrawMesh(const MeshPtr& mesh, const MaterialPtr& material, int subMeshIndex);
+
+		// Draw the same mesh with one object matrix per instance in as few draw calls as possible.
+		// Falls back to one DrawMesh per matrix if the shader does not support instancing.
+		static void DrawMeshInstanced(const MeshPtr& mesh, int subMeshIndex, const MaterialPtr& material, const std::vector<Matrix4x4>& matrices);
+		static void DrawMeshInstanced(const MeshPtr& mesh, int subMeshIndex, const MaterialPtr& material, const Matrix4x4* matrices, int count);
+
+		// Draw different meshes with the same material, one object matrix each, as one multi-draw when they are all
+		// in the same GeometryArena pool. Falls back to one DrawMeshInstanced per run of the same mesh otherwise.
+		static void DrawMeshesInstanced(const MeshPtr* meshes, const int* subMeshIndices, const MaterialPtr& material, const Matrix4x4* matrices, int count);
 		static void DrawTexture();
 
 		static void SetRenderTarget(RenderTexturePtr rt);
@@ -36,6 +36,12 @@ namespace FishEngine
 			m_data.emplace_back(data);
 		}
 
+		// every message logged so far
+		std::deque<LogData> const & data() const
+		{
+			return m_data;
+		}
+
 	private:
 		friend class ::LogViewModel;
 
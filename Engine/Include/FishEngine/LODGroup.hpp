@@ -0,0 +1,138 @@
+#ifndef LODGroup_hpp
+#define LODGroup_hpp
+
+#include "Component.hpp"
+#include "Vector3.hpp"
+#include "Macro.hpp"
+
+namespace FishEngine
+{
+	// The LOD fade modes.
+	enum class LODFadeMode
+	{
+		None,		// Indicates the LOD fading is turned off.
+		CrossFade,	// Perform cross-fade style blending between the current LOD and the next LOD if the distance to camera falls in the range specified by the LOD.fadeTransitionWidth of each LOD.
+	};
+
+	// Structure for building a LOD for passing to the LODGroup::SetLODs function.
+	// see: https://docs.unity3d.com/ScriptReference/LOD.html
+	struct FE_EXPORT LOD
+	{
+		InjectSerializationFunctionsNonPolymorphic(LOD)
+
+		LOD() = default;
+
+		LOD(float screenRelativeTransitionHeight, std::vector<std::weak_ptr<GameObject>> gameObjects)
+			: screenRelativeTransitionHeight(screenRelativeTransitionHeight), gameObjects(std::move(gameObjects))
+		{
+		}
+
+		// The screen relative height to use for the transition [0-1].
+		// The LOD is used while the object is at least this high on screen.
+		float screenRelativeTransitionHeight = 0;
+
+		// Width of the cross-fade transition zone (proportion to the current LOD's whole length) [0-1].
+		// Only used if it's not animated.
+		float fadeTransitionWidth = 0;
+
+		// The renderers of these game objects (not of their children) are drawn at this LOD.
+		std::vector<std::weak_ptr<GameObject>> gameObjects;
+	};
+
+
+	// LODGroup lets you group multiple Renderers into LOD levels.
+	// The LOD is picked once per frame from the height of the group on the screen of the main camera,
+	// scaled by QualitySettings::lodBias().
+	// see: https://docs.unity3d.com/ScriptReference/LODGroup.html
+	class FE_EXPORT LODGroup : public Component
+	{
+	public:
+		DefineComponent(LODGroup)
+
+		// the LOD of a renderer is a bit in a byte
+		static constexpr int kMaxLODs = 8;
+
+		LODGroup() = default;
+
+		// The local reference point against which the LOD distance is calculated.
+		Vector3 localReferencePoint() const
+		{
+			return m_localReferencePoint;
+		}
+
+		void setLocalReferencePoint(const Vector3 & localReferencePoint)
+		{
+			m_localReferencePoint = localReferencePoint;
+		}
+
+		// The size of the LOD object in local space.
+		float size() const
+		{
+			return m_size;
+		}
+
+		void setSize(float size)
+		{
+			m_size = size;
+		}
+
+		// The LOD fade mode used.
+		LODFadeMode fadeMode() const
+		{
+			return m_fadeMode;
+		}
+
+		void setFadeMode(LODFadeMode fadeMode)
+		{
+			m_fadeMode = fadeMode;
+		}
+
+		// The number of LOD levels.
+		int lodCount() const
+		{
+			return static_cast<int>(m_lods.size());
+		}
+
+		// Returns the array of LODs.
+		std::vector<LOD> const & GetLODs() const
+		{
+			return m_lods;
+		}
+
+		// Set the LODs for the LOD group. This will remove any existing LODs configured on the LODGroup.
+		// The LODs are sorted from the most detailed (highest screenRelativeTransitionHeight) to the least detailed.
+		void SetLODs(std::vector<LOD> const & lods);
+
+		// Recalculate the bounding region for the LODGroup (Relatively slow, do not call often).
+		void RecalculateBounds();
+
+		// Force a LOD level, -1 to return to the automatic selection.
+		void ForceLOD(int index)
+		{
+			m_forcedLOD = index;
+		}
+
+		// Height of the group relative to the screen height of camera, before the LOD bias.
+		float ScreenRelativeHeight(const Camera & camera) const;
+
+		// The LOD to draw for camera, lodCount() if the group is culled.
+		// fade is the visibility of that LOD in [0, 1]: 1 unless it is cross-fading to the next LOD.
+		int SelectLOD(const Camera & camera, float & fade) const;
+
+	private:
+		friend class FishEditor::Inspector;
+
+		Vector3 m_localReferencePoint = Vector3::zero;
+
+		float m_size = 1.0f;
+
+		LODFadeMode m_fadeMode = LODFadeMode::None;
+
+		std::vector<LOD> m_lods;
+
+		Meta(NonSerializable)
+		int m_forcedLOD = -1;
+	};
+}
+
+#endif // LODGroup_hpp
@@ -15,7 +15,6 @@ namespace FishEngine
 		Float2,
 		Float3,
 		Float4,
-		Mat3,
 		Mat4,
 		Texture2D,
 		Texture2DArray,
@@ -28,6 +27,10 @@ namespace FishEngine
 	{
 		std::string             name;
 		MaterialPropertyType    type;
+		uint32_t                offset;		// first float in Material::m_values, index in Material::m_textureValues for textures
+
+		Meta(NonSerializable)
+		int                     nameID = -1;	// Shader::PropertyToID(name), resolved on first use
 	};
 
 
@@ -43,6 +46,8 @@ namespace FishEngine
 			setShader(shader);
 		}
 
+		~Material();
+
 		/**
 		 * The main material's color.
 		 *
@@ -111,28 +116,37 @@ namespace FishEngine
 		bool IsKeywordEnabled(ShaderKeyword keyword);
 
 		bool HasProperty(const std::string& propertyName);
+		bool HasProperty(int nameID);
+
+		// The Set* overloads taking a name id (see Shader::PropertyToID) do no string work.
 
 		// Set a named float value.
 		void SetFloat(const std::string& name, const float value);
+		void SetFloat(int nameID, const float value);
 
 		void SetVector2(const std::string& name, const Vector2& value);
+		void SetVector2(int nameID, const Vector2& value);
 
 		// Set a named Vector3 value.
 		void SetVector3(const std::string& name, const Vector3& value);
+		void SetVector3(int nameID, const Vector3& value);
 
 		void SetVector4(const std::string& name, const Vector4& value);
+		void SetVector4(int nameID, const Vector4& value);
 
 		// Set a named matrix for the shader.
-		void SetMatrix(const std::string& name, const Matrix4x4& value)
-		{
-			m_uniforms.mat4s[name] = value;
-		}
+		void SetMatrix(const std::string& name, const Matrix4x4& value);
+		void SetMatrix(int nameID, const Matrix4x4& value);
 
 		// Set a named texture
 		void SetTexture(const std::string& name, TexturePtr texture);
+		void SetTexture(int nameID, TexturePtr texture);
 
 		void BindTextures(const std::map<std::string, TexturePtr>& textures);
 
+		// Bind the textures and upload the uniforms of the material to the current shader variant.
+		// Values in the shader's "MaterialUniforms" block are kept in a uniform buffer owned by the material,
+		// it is only re-uploaded after a Set*; binding it is a single glBindBufferRange.
 		void BindProperties();
 
 		/************************************************************************/
@@ -155,11 +169,66 @@ namespace FishEngine
 	private:
 		friend class FishEditor::Inspector;
 
+		// index in m_properties, -1 if the material has no such property
+		int FindProperty(int nameID);
+
+		// the property, added (or re-typed) if the material has no property of that type yet
+		MaterialProperty & GetOrAddProperty(int nameID, MaterialPropertyType type);
+
+		// the floats of a number property, marks the uniform buffer dirty
+		float* PropertyValues(int nameID, MaterialPropertyType type);
+
+		TexturePtr & PropertyTexture(int nameID);
+
+		// materials saved before m_properties held the values have m_textures and m_uniforms instead;
+		// reads those into the properties, false if the archive is in the current format
+		bool DeserializeLegacy(InputArchive & archive);
+
+		struct UniformBindingCache;
+
+		// uniform index -> property index for the program that is in use, built on first use
+		const UniformBindingCache& UniformBinding(GLuint program, const std::vector<UniformInfo>& uniforms);
+
+		// write the MaterialUniforms block in std140 layout and upload it
+		void UpdateUniformBuffer(const std::vector<UniformInfo>& uniforms, const UniformBindingCache& binding);
+
 		Meta(NonSerializable)
 		ShaderPtr                           m_shader = nullptr;
-		std::map<std::string, TexturePtr>   m_textures;
-		ShaderUniforms                      m_uniforms;
+
+		// one entry per property, the first ones in the order of the uniforms of the shader (see setShader)
 		std::vector<MaterialProperty>       m_properties;
+		std::vector<float>                  m_values;
+		std::vector<TexturePtr>             m_textureValues;
+
+		struct UniformBindingCache
+		{
+			GLuint              program;
+			uint64_t            blockLayout;	// size and member offsets of the MaterialUniforms block of program
+			std::vector<int>    properties;		// -1: not set by the material
+		};
+
+		Meta(NonSerializable)
+		std::vector<UniformBindingCache>    m_uniformBindings;
+
+		// GL buffer of the MaterialUniforms block, a copy of the material creates its own
+		struct UniformBuffer
+		{
+			GLuint      buffer = 0;
+			uint64_t    layout = 0;		// the block was written for this layout, shared by the variants of a shader
+			int         size = 0;
+			bool        dirty = true;
+
+			UniformBuffer() = default;
+			UniformBuffer(UniformBuffer const &) { }
+			UniformBuffer & operator=(UniformBuffer const &)
+			{
+				dirty = true;
+				return *this;
+			}
+		};
+
+		Meta(NonSerializable)
+		UniformBuffer                       m_uniformBuffer;
 
 		Meta(NonSerializable)
 		ShaderLabProperties m_savedProperties;
@@ -473,8 +473,75 @@ namespace FishEngine
 			return length - Mathf::Abs(t - length);
 		}
 
-		// ushort FloatToHalf(float val);
-		// float HalfToFloat(ushort val);
+		// Encode a floating point value into a 16-bit representation (IEEE half, round to nearest even).
+		static uint16_t FloatToHalf(float val)
+		{
+			union {
+				float f;
+				uint32_t u;
+			} fu;
+			fu.f = val;
+			const uint32_t sign = (fu.u >> 16) & 0x8000u;
+			const uint32_t absBits = fu.u & 0x7FFFFFFFu;
+			if (absBits >= 0x7F800000u)		// Inf, NaN
+				return static_cast<uint16_t>(sign | 0x7C00u | (absBits > 0x7F800000u ? 0x200u : 0u));
+			if (absBits >= 0x477FF000u)		// rounds to a value beyond 65504
+				return static_cast<uint16_t>(sign | 0x7C00u);
+			if (absBits < 0x38800000u)		// denormal or zero in half
+			{
+				if (absBits < 0x33000000u)
+					return static_cast<uint16_t>(sign);
+				const uint32_t shift = 126u - (absBits >> 23);
+				const uint32_t mantissa = (absBits & 0x7FFFFFu) | 0x800000u;
+				uint32_t half = mantissa >> shift;
+				const uint32_t rest = mantissa & ((1u << shift) - 1u);
+				const uint32_t halfway = 1u << (shift - 1u);
+				if (rest > halfway || (rest == halfway && (half & 1u)))
+					half++;
+				return static_cast<uint16_t>(sign | half);
+			}
+			uint32_t half = ((absBits - 0x38000000u) >> 13);
+			const uint32_t rest = absBits & 0x1FFFu;
+			if (rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+				half++;
+			return static_cast<uint16_t>(sign | half);
+		}
+
+		// Convert a half precision float to a 32-bit floating point value.
+		static float HalfToFloat(uint16_t val)
+		{
+			const uint32_t sign = static_cast<uint32_t>(val & 0x8000u) << 16;
+			const uint32_t exponent = (val >> 10) & 0x1Fu;
+			uint32_t mantissa = val & 0x3FFu;
+			union {
+				float f;
+				uint32_t u;
+			} fu;
+			if (exponent == 0x1Fu)
+			{
+				fu.u = sign | 0x7F800000u | (mantissa << 13);
+			}
+			else if (exponent != 0)
+			{
+				fu.u = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+			}
+			else if (mantissa == 0)
+			{
+				fu.u = sign;
+			}
+			else
+			{
+				// denormal, normalize it
+				uint32_t e = 113u;
+				while ((mantissa & 0x400u) == 0)
+				{
+					mantissa <<= 1;
+					e--;
+				}
+				fu.u = sign | (e << 23) | ((mantissa & 0x3FFu) << 13);
+			}
+			return fu.f;
+		}
 
 		// Calculates the shortest difference between two given angles given in degrees.
 		static float DeltaAngle(float current, float target)
@@ -1,11 +1,15 @@
 #pragma once
 
+#include <cstddef>
+
 #include "Vector3.hpp"
 #include "Vector4.hpp"
 #include "Quaternion.hpp"
+#include "SIMD.hpp"
 
 namespace FishEngine
 {
+	class Bounds;
 
 	// Matrices are row major.
 	class FE_EXPORT Matrix4x4
@@ -54,6 +58,9 @@ namespace FishEngine
 		// Returns the Inverse of mat.
 		static Matrix4x4 Inverse(const Matrix4x4& mat);
 
+		// Returns the Inverse of an affine mat (the last row is (0, 0, 0, 1)), cheaper than Inverse.
+		static Matrix4x4 InverseAffine(const Matrix4x4& mat);
+
 		// The determinant of mat.
 		static float Determinant(const Matrix4x4& mat);
 
@@ -133,6 +140,27 @@ namespace FishEngine
 		// Transforms a direction by this matrix.
 		Vector3 MultiplyVector(const Vector3& v) const;
 
+		// MultiplyPoint on count points, result may be points.
+		void MultiplyPoints(const Vector3* points, Vector3* result, std::size_t count) const;
+
+		// MultiplyPoint3x4 on count points, result may be points.
+		void MultiplyPoints3x4(const Vector3* points, Vector3* result, std::size_t count) const;
+
+		// MultiplyVector on count directions, result may be vectors.
+		void MultiplyVectors(const Vector3* vectors, Vector3* result, std::size_t count) const;
+
+		// The AABB of bounds transformed by this affine matrix; invalid bounds are returned as is.
+		Bounds TransformBounds(const Bounds& bounds) const;
+
+		// TransformBounds on count boxes, result may be bounds.
+		void TransformBounds(const Bounds* bounds, Bounds* result, std::size_t count) const;
+
+		// result[i] = lhs * rhs[i], result may be rhs.
+		static void Multiply(const Matrix4x4& lhs, const Matrix4x4* rhs, Matrix4x4* result, std::size_t count);
+
+		// result[i] = lhs[i] * rhs[i], result may be lhs or rhs.
+		static void Multiply(const Matrix4x4* lhs, const Matrix4x4* rhs, Matrix4x4* result, std::size_t count);
+
 
 		// Creates a scaling matrix.
 		static Matrix4x4 Scale(float scale);
@@ -45,14 +45,16 @@ namespace FishEngine
 
 	inline Matrix4x4 Matrix4x4::Transpose(const Matrix4x4& mat)
 	{
+		SIMD::float4 r0 = SIMD::Load(mat.m[0]);
+		SIMD::float4 r1 = SIMD::Load(mat.m[1]);
+		SIMD::float4 r2 = SIMD::Load(mat.m[2]);
+		SIMD::float4 r3 = SIMD::Load(mat.m[3]);
+		SIMD::Transpose(r0, r1, r2, r3);
 		Matrix4x4 result;
-		for (int i = 0; i < 4; ++i)
-		{
-			for (int j = 0; j < 4; ++j)
-			{
-				result.m[i][j] = mat.m[j][i];
-			}
-		}
+		SIMD::Store(result.m[0], r0);
+		SIMD::Store(result.m[1], r1);
+		SIMD::Store(result.m[2], r2);
+		SIMD::Store(result.m[3], r3);
 		return result;
 	}
 
@@ -154,32 +156,34 @@ namespace FishEngine
 	}
 
 
-	inline void Matrix4x4::operator*=(const Matrix4x4& rhs)
+	// row i of lhs * rhs is the combination of the rows of rhs weighted by row i of lhs
+	// result may alias lhs or rhs, the rows of rhs are loaded first and a row of lhs before its result is stored
+	inline void MultiplyMatrix4x4(const float lhs[4][4], const float rhs[4][4], float result[4][4])
 	{
+		const SIMD::float4 b0 = SIMD::Load(rhs[0]);
+		const SIMD::float4 b1 = SIMD::Load(rhs[1]);
+		const SIMD::float4 b2 = SIMD::Load(rhs[2]);
+		const SIMD::float4 b3 = SIMD::Load(rhs[3]);
 		for (int i = 0; i < 4; i++)
 		{
-			float f[4];
-			for (int j = 0; j < 4; j++)
-			{
-				f[j] = m[i][0] * rhs.m[0][j] + m[i][1] * rhs.m[1][j] +
-					m[i][2] * rhs.m[2][j] + m[i][3] * rhs.m[3][j];
-			}
-			for (int j = 0; j < 4; j++) {
-				m[i][j] = f[j];
-			}
+			const SIMD::float4 a = SIMD::Load(lhs[i]);
+			SIMD::float4 r = SIMD::Mul(SIMD::Broadcast<0>(a), b0);
+			r = SIMD::MulAdd(SIMD::Broadcast<1>(a), b1, r);
+			r = SIMD::MulAdd(SIMD::Broadcast<2>(a), b2, r);
+			r = SIMD::MulAdd(SIMD::Broadcast<3>(a), b3, r);
+			SIMD::Store(result[i], r);
 		}
 	}
 
+	inline void Matrix4x4::operator*=(const Matrix4x4& rhs)
+	{
+		MultiplyMatrix4x4(m, rhs.m, m);
+	}
+
 	inline Matrix4x4 operator*(const Matrix4x4& lhs, const Matrix4x4& rhs)
 	{
 		Matrix4x4 result;
-		for (int i = 0; i < 4; i++)
-		{
-			for (int j = 0; j < 4; j++)
-			{
-				result.m[i][j] = lhs.m[i][0] * rhs.m[0][j] + lhs.m[i][1] * rhs.m[1][j] + lhs.m[i][2] * rhs.m[2][j] + lhs.m[i][3] * rhs.m[3][j];
-			}
-		}
+		MultiplyMatrix4x4(lhs.m, rhs.m, result.m);
 		return result;
 	}
 
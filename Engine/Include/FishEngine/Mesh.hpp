@@ -11,6 +11,9 @@
 #include "BoneWeight.hpp"
 #include "Vector3.hpp"
 #include "Vector2.hpp"
+#include "Render/VertexLayout.hpp"
+#include "Render/GeometryArena.hpp"
+#include "Render/BonePalette.hpp"
 
 namespace FishEditor
 {
@@ -19,6 +22,9 @@ namespace FishEditor
 
 namespace FishEngine
 {
+	struct MeshBufferData;
+	struct SkinningSource;
+
 	class FE_EXPORT Mesh : public Object
 	{
 	public:
@@ -62,6 +68,34 @@ namespace FishEngine
 			return m_bounds;
 		}
 
+		// The attributes of the vertex buffer, valid once the mesh is uploaded.
+		VertexLayout const & vertexLayout() const
+		{
+			return m_vertexLayout;
+		}
+
+		// GL_UNSIGNED_SHORT when every index fits in 16 bits, GL_UNSIGNED_INT otherwise; valid once the mesh is uploaded.
+		GLenum indexType() const
+		{
+			return m_indexType;
+		}
+
+		// The GeometryArena pool holding the vertices and indices, -1 if the mesh has its own buffers
+		// (skinned, or uploaded while the arena was disabled); valid once the mesh is uploaded.
+		int arenaPool() const
+		{
+			return m_arenaAllocation.pool;
+		}
+
+		// The indices of a submesh (-1: all of them) as they are drawn, the GeometryArena offsets included.
+		struct DrawRange
+		{
+			GLsizei		indexCount;
+			uint32_t	firstIndex;
+			GLint		baseVertex;
+		};
+		DrawRange GetDrawRange(int subMeshIndex) const;
+
 		// Returns the number of vertices in the Mesh (Read Only).
 		uint32_t vertexCount() const
 		{
@@ -175,8 +209,16 @@ namespace FishEngine
 		
 		// -1: reander all submeshes
 		void Render(int subMeshIndex = -1);
+
+		// instanceBuffer holds instanceCount pairs of column-major (MATRIX_M, MATRIX_IT_M), starting at instanceOffset
+		void RenderInstanced(int subMeshIndex, int instanceCount, GLuint instanceBuffer, GLintptr instanceOffset = 0);
 		
 		void RenderSkinned();
+
+		// Point the skinned position, normal and tangent attributes at the float3 streams of buffer
+		// (positions, then normals, then tangents, vertexCount each), as written by CPUSkinning.
+		// 0: back to the transform feedback output of RenderSkinned.
+		void BindSkinnedVertices(GLuint buffer);
 		
 		//void renderPatch(const Shader& shader);
 		// Returns the number of vertices in the Mesh
@@ -191,10 +233,7 @@ namespace FishEngine
 			return static_cast<int>(m_boneNames.size());
 		}
 		
-		// temp
-		void ToBinaryFile(std::ostream & os);
-		static MeshPtr FromBinaryFile(std::istream & is);
-		
+		// legacy text format of the builtin meshes, see MeshFile for the binary one
 		static MeshPtr FromTextFile(std::istream & is);
 		
 		static void Init(std::string const & rootDir);
@@ -236,6 +275,7 @@ namespace FishEngine
 		friend class FishEditor::FBXImporter;
 		friend class MeshRenderer;
 		friend class SkinnedMeshRenderer;
+		friend class MeshFile;
 		//friend class Model;
 
 		static std::map<PrimitiveType, MeshPtr> s_builtinMeshes;
@@ -248,31 +288,26 @@ namespace FishEngine
 		Bounds m_bounds;
 
 		Meta(NonSerializable)
-		GLuint m_VAO = 0;
+		GLuint m_VAO = 0;				// 0 when the mesh is in the GeometryArena, see m_arenaAllocation
 		
 		Meta(NonSerializable)
-		GLuint m_VBO = 0;
+		GLuint m_VBO = 0;				// all attributes, interleaved as described by m_vertexLayout
 
 		Meta(NonSerializable)
 		GLuint m_indexVBO = 0;
 
 		Meta(NonSerializable)
-		GLuint m_positionVBO = 0;
-
-		Meta(NonSerializable)
-		GLuint m_normalVBO = 0;
-
-		Meta(NonSerializable)
-		GLuint m_uvVBO = 0;
+		VertexLayout m_vertexLayout;
 
 		Meta(NonSerializable)
-		GLuint m_tangentVBO = 0;
+		GLenum m_indexType = GL_UNSIGNED_INT;
 
 		Meta(NonSerializable)
-		GLuint m_boneIndexVBO = 0;
+		GeometryArena::Allocation m_arenaAllocation;
 
+		// set by MeshFile::Load, uploaded as is and released by UploadMeshData
 		Meta(NonSerializable)
-		GLuint m_boneWeightVBO = 0;
+		std::shared_ptr<MeshBufferData> m_bufferData;
 
 		Meta(NonSerializable)
 		GLuint m_TFBO = 0;				// transform feedback buffer object, for Animation
@@ -289,8 +324,50 @@ namespace FishEngine
 		Meta(NonSerializable)
 		GLuint m_animationOutputTangentVBO = 0;
 
+		// the buffer the skinned attributes of m_VAO read from, 0: the transform feedback output
+		Meta(NonSerializable)
+		GLuint m_skinnedVertexBuffer = 0;
+
+		// the bind pose kept for CPUSkinning, set by UploadMeshData for skinned meshes
+		Meta(NonSerializable)
+		std::shared_ptr<SkinningSource> m_skinningSource;
+
+		// m_bindposes as 3x4 rows for BonePalette, set by UploadMeshData for skinned meshes
+		Meta(NonSerializable)
+		std::vector<AffineMatrix> m_affineBindposes;
+
+		// for each bone, the bone origin in the bind pose (xyz) and the largest distance of a vertex weighted to it (w),
+		// w is -1 for bones without vertices; empty if the vertices were not available at upload
+		Meta(NonSerializable)
+		std::vector<Vector4> m_boneBounds;
+
+		// the SkinnedMeshRenderer whose vertices are in the transform feedback output
+		Meta(NonSerializable)
+		const SkinnedMeshRenderer* m_transformFeedbackOwner = nullptr;
+
+		// float positions, 10-bit normals and tangents, half uvs when they are small enough, 8-bit bone weights
+		VertexLayout ChooseVertexLayout() const;
+
+		GLenum ChooseIndexType() const
+		{
+			return m_vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		}
+
+		// the vertex and index buffers as they are uploaded
+		void EncodeVertexBuffer(VertexLayout const & layout, std::vector<uint8_t> & vertices) const;
+		void EncodeIndexBuffer(GLenum indexType, std::vector<uint8_t> & indices) const;
+
+		GLuint vertexArray() const
+		{
+			return m_arenaAllocation.pool >= 0 ? GeometryArena::vertexArray(m_arenaAllocation.pool) : m_VAO;
+		}
+
+		// m_boneBounds, from m_vertices and m_boneWeights
+		void CalculateBoneBounds();
+
 		void GenerateBuffer();
 		void BindBuffer();
+		void DrawElements(int subMeshIndex, int instanceCount);
 	};
 
 
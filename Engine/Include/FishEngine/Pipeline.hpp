@@ -3,12 +3,15 @@
 
 #include "FishEngine.hpp"
 #include "Matrix4x4.hpp"
+#include "Render/BonePalette.hpp"
 #include "ShaderVariables_gen.hpp"
 #include "ReflectClass.hpp"
 #include <stack>
 
 namespace FishEngine
 {
+	class UniformRingBuffer;
+
 	class FE_EXPORT Meta(NonSerializable) Pipeline
 	{
 	public:
@@ -16,12 +19,18 @@ namespace FishEngine
 
 		static void Init();
 
+		static void Clean();
+
+		// retire this frame's uniform data, the fence keeps it alive until the GPU is done with it
+		static void EndFrame();
+
 		static void BindCamera(const CameraPtr& camera);
 		static void BindLight(const LightPtr& light);
 
-		static void UpdatePerDrawUniforms(const Matrix4x4& modelMatrix);
+		// lodFade: visibility of the draw while its LODGroup cross-fades, see RendererRegistry::s_lodFade
+		static void UpdatePerDrawUniforms(const Matrix4x4& modelMatrix, float lodFade = 1.0f);
 
-		static void UpdateBonesUniforms(const std::vector<Matrix4x4>& bones);
+		static void UpdateBonesUniforms(const std::vector<AffineMatrix>& bones);
 
 		static RenderTargetPtr CurrentRenderTarget()
 		{
@@ -55,16 +64,20 @@ namespace FishEngine
 		static constexpr unsigned int PerDrawUBOBindingPoint = 1;
 		static constexpr unsigned int LightingUBOBindingPoint = 2;
 		static constexpr unsigned int BonesUBOBindingPoint = 3;
+		static constexpr unsigned int MaterialUBOBindingPoint = 4;	// "MaterialUniforms", owned by Material
 
 	private:
-		static unsigned int         s_perCameraUBO;
-		static unsigned int         s_perDrawUBO;
-		static unsigned int         s_lightingUBO;
-		static unsigned int         s_bonesUBO;
+		// write a block into the ring buffer, re-uploads the other blocks when the ring moved to a new segment
+		static void UploadUniformBlock(unsigned int bindingPoint);
+
+		static UniformRingBuffer    s_uniformRing;
+		static uint32_t             s_uniformGeneration;
+		static uint32_t             s_uploadedBlocks;	// bit i: block of binding point i has been uploaded once
 		static PerCameraUniforms    s_perCameraUniforms;
 		static PerDrawUniforms      s_perDrawUniforms;
 		static LightingUniforms     s_lightingUniforms;
-		//static Bones        s_bonesUniformData;
+		static Bones                s_bonesUniforms;
+		static uint32_t             s_boneCount;
 
 		static RenderTargetPtr      s_currentRenderTarget;
 
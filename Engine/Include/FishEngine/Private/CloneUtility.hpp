@@ -47,6 +47,8 @@ namespace FishEngine
 		void Clone(FishEngine::GameObjectPtr const & source, FishEngine::GameObjectPtr & dest);
 		
 		void Clone(FishEngine::PrefabPtr const & source, FishEngine::PrefabPtr & dest);
+
+		void Clone(FishEngine::LOD const & source, FishEngine::LOD & dest);
 		
 //		void Clone(FishEngine::MaterialPtr const & source, FishEngine::MaterialPtr & dest);
 //		
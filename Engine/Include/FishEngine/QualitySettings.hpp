@@ -29,6 +29,29 @@ namespace FishEngine
 			return s_shadowDistance;
 		}
 
+		// Global multiplier for the LOD's switching distance.
+		// A larger value leads to a longer view distance before a lower resolution LOD is picked.
+		FE_EXPORT static void setLodBias(float lodBias)
+		{
+			s_lodBias = lodBias;
+		}
+
+		FE_EXPORT static float lodBias()
+		{
+			return s_lodBias;
+		}
+
+		// A maximum LOD level. All LOD groups will not use LODs below it.
+		FE_EXPORT static void setMaximumLODLevel(int maximumLODLevel)
+		{
+			s_maximumLODLevel = maximumLODLevel;
+		}
+
+		FE_EXPORT static int maximumLODLevel()
+		{
+			return s_maximumLODLevel;
+		}
+
 		static uint32_t CalculateShadowMapSize();
 
 	private:
@@ -48,5 +71,11 @@ namespace FishEngine
 
 		// Shadow Near Plane Offset	Offset shadow near plane to account for large triangles being distorted by shadow pancaking.
 		static float m_shadowNearPlaneOffset;
+
+		// LOD Bias	LOD levels are chosen based on the onscreen size of an object. The LOD bias scales that size, values greater than 1 favour the more detailed levels.
+		static float s_lodBias;
+
+		// Maximum LOD Level	The highest LOD (most detailed is 0) that the game will use.
+		static int s_maximumLODLevel;
 	};
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Vector3.hpp"
+#include "SIMD.hpp"
 
 namespace FishEngine
 {
@@ -61,11 +61,20 @@ namespace FishEngine
 	inline Quaternion Quaternion::operator*(const Quaternion & rhs) const
 	{
 		// [p.w*q.v + q.w*p.v + corss(p.v, q.v), p.w*q.w-dot(p.v, q.v)]
-		return Quaternion(
-			w * rhs.x + x * rhs.w + y * rhs.z - z * rhs.y,
-			w * rhs.y + y * rhs.w + z * rhs.x - x * rhs.z,
-			w * rhs.z + z * rhs.w + x * rhs.y - y * rhs.x,
-			w * rhs.w - x * rhs.x - y * rhs.y - z * rhs.z);
+		// x: w*qx + x*qw + y*qz - z*qy
+		// y: w*qy + y*qw + z*qx - x*qz
+		// z: w*qz + z*qw + x*qy - y*qx
+		// w: w*qw - x*qx - y*qy - z*qz
+		using SIMD::float4;
+		const float4 p = SIMD::Load(m);
+		const float4 q = SIMD::Load(rhs.m);
+		const float4 t1 = SIMD::Mul(SIMD::Swizzle<0, 1, 2, 0>(p), SIMD::Swizzle<3, 3, 3, 0>(q));
+		const float4 t2 = SIMD::MulAdd(SIMD::Swizzle<1, 2, 0, 1>(p), SIMD::Swizzle<2, 0, 1, 1>(q), t1);
+		float4 r = SIMD::MulAdd(SIMD::Broadcast<3>(p), q, SIMD::Mul(t2, SIMD::Set(1, 1, 1, -1)));
+		r = SIMD::NegMulAdd(SIMD::Swizzle<2, 0, 1, 2>(p), SIMD::Swizzle<1, 2, 0, 2>(q), r);
+		float result[4];
+		SIMD::Store(result, r);
+		return Quaternion(result[0], result[1], result[2], result[3]);
 	}
 
 	inline Vector3 Quaternion::operator*(const Vector3 & point) const
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+
+#include "../FishEngine.hpp"
+#include "../ReflectClass.hpp"
+#include "../Vector3.hpp"
+#include "../Vector4.hpp"
+#include "../Matrix4x4.hpp"
+
+namespace FishEngine
+{
+	// The top three rows of an affine transform, the last row is (0, 0, 0, 1).
+	// Same layout as a mat3x4 of the Bones uniform block: 48 bytes instead of the 64 of a mat4.
+	struct FE_EXPORT Meta(NonSerializable) AffineMatrix
+	{
+		Vector4 rows[3];
+
+		AffineMatrix() = default;
+
+		explicit AffineMatrix(const Matrix4x4 & m)
+			: rows{ m.rows[0], m.rows[1], m.rows[2] }
+		{
+		}
+
+		Vector3 MultiplyPoint(const Vector3 & p) const
+		{
+			return Vector3(
+				rows[0].x * p.x + rows[0].y * p.y + rows[0].z * p.z + rows[0].w,
+				rows[1].x * p.x + rows[1].y * p.y + rows[1].z * p.z + rows[1].w,
+				rows[2].x * p.x + rows[2].y * p.y + rows[2].z * p.z + rows[2].w);
+		}
+
+		// the largest length of the images of the unit axes
+		float maxScale() const;
+	};
+
+	static_assert(sizeof(AffineMatrix) == 48, "AffineMatrix must match a std140 mat3x4");
+
+
+	// Skinning matrices of a SkinnedMeshRenderer, with affine-only (3x4) products.
+	// The row of a product is a linear combination of the rows of the right hand side, so the bind poses are kept
+	// as rows too and no transpose is needed anywhere.
+	class FE_EXPORT Meta(NonSerializable) BonePalette
+	{
+	public:
+		BonePalette() = delete;
+
+		// result = a * b, result may alias a or b
+		static void Multiply(const AffineMatrix & a, const AffineMatrix & b, AffineMatrix & result);
+
+		// palette[i] = worldToLocal * bones[i]->localToWorldMatrix() * bindposes[i]
+		// A missing bone (nullptr) counts as the identity.
+		static void Build(const AffineMatrix & worldToLocal, Transform* const * bones, const AffineMatrix * bindposes,
+			std::size_t count, AffineMatrix * palette);
+	};
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "../FishEngine.hpp"
+#include "../ReflectClass.hpp"
+#include "../Vector3.hpp"
+#include "../Matrix4x4.hpp"
+#include "BonePalette.hpp"
+#include "../BoneWeight.hpp"
+
+namespace FishEngine
+{
+	// The bind pose vertices of a skinned mesh, kept on the CPU after the upload for CPUSkinning.
+	// normals and tangents are either empty or vertexCount long.
+	struct FE_EXPORT Meta(NonSerializable) SkinningSource
+	{
+		std::vector<Vector3>	positions;
+		std::vector<Vector3>	normals;
+		std::vector<Vector3>	tangents;
+		std::vector<BoneWeight>	boneWeights;
+
+		uint32_t vertexCount() const
+		{
+			return static_cast<uint32_t>(positions.size());
+		}
+	};
+
+	// One skinned mesh instance. The outputs are tightly packed float3 streams of source->vertexCount() vertices,
+	// an empty input stream is written as zeros.
+	struct FE_EXPORT Meta(NonSerializable) SkinningJob
+	{
+		const SkinningSource*	source = nullptr;
+		const AffineMatrix*		palette = nullptr;	// as in the Bones uniform block
+		uint32_t				boneCount = 0;
+		float*					positions = nullptr;
+		float*					normals = nullptr;
+		float*					tangents = nullptr;
+	};
+
+	// 4-bone linear blend skinning on the CPU, the same math as Internal-GPUSkinning.
+	// The jobs of a frame are cut into chunks of kVerticesPerTask vertices, which are run on a pool of worker
+	// threads and on the calling thread.
+	class FE_EXPORT Meta(NonSerializable) CPUSkinning
+	{
+	public:
+		CPUSkinning() = delete;
+
+		static constexpr uint32_t kVerticesPerTask = 1024;
+
+		// skin the vertices [first, last) of job on the calling thread
+		static void Skin(SkinningJob const & job, uint32_t first, uint32_t last);
+
+		// skin all vertices of all jobs, returns when they are done
+		static void Run(const SkinningJob* jobs, int jobCount);
+
+		// the number of worker threads besides the calling one, hardware_concurrency() - 1 by default
+		static int workerCount();
+
+		// 0: skin on the calling thread only
+		static void setWorkerCount(int count);
+
+		// SSE or NEON is available in this build
+		static bool simdEnabled();
+	};
+}
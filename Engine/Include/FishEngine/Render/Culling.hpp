@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "../FishEngine.hpp"
+#include "../ReflectClass.hpp"
+#include "../Vector4.hpp"
+#include "../Matrix4x4.hpp"
+#include "../Bounds.hpp"
+
+namespace FishEngine
+{
+	// Six world space clip planes, (a, b, c, d) with a*x + b*y + c*z + d >= 0 inside.
+	// Order: left, right, bottom, top, near, far.
+	struct FE_EXPORT Meta(NonSerializable) FrustumPlanes
+	{
+		Vector4 planes[6];
+
+		// Gribb-Hartmann extraction from a (projection * view) matrix.
+		static FrustumPlanes FromMatrix(const Matrix4x4 & viewProjection);
+
+		// planes of Camera::frustum() in world space.
+		static FrustumPlanes FromCamera(const Camera & camera);
+	};
+
+
+	// Structure-of-arrays AABB list. The arrays are padded to a multiple of 4,
+	// so the culling loop can always load 4 boxes at a time.
+	class FE_EXPORT Meta(NonSerializable) BoundsArray
+	{
+	public:
+		void Clear();
+		void Reserve(std::size_t count);
+
+		// returns the index of the new box.
+		// Invalid bounds are stored as an infinite box so that they are never culled.
+		uint32_t Add(const Bounds & bounds);
+		void Set(uint32_t index, const Bounds & bounds);
+
+		// move the last box to index and drop it
+		void RemoveSwapBack(uint32_t index);
+
+		std::size_t size() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+
+		std::vector<float> m_centerX;
+		std::vector<float> m_centerY;
+		std::vector<float> m_centerZ;
+		std::vector<float> m_extentX;
+		std::vector<float> m_extentY;
+		std::vector<float> m_extentZ;
+
+	private:
+		std::size_t m_size = 0;
+	};
+
+
+	class FE_EXPORT Meta(NonSerializable) Culling
+	{
+	public:
+		Culling() = delete;
+
+		// visible[i] is set to 1 if box i intersects (or is inside) the frustum, 0 otherwise.
+		// returns the number of visible boxes.
+		static std::size_t CullBounds(const FrustumPlanes & frustum, const BoundsArray & bounds, std::vector<uint8_t> & visible);
+
+		static bool IsVisible(const FrustumPlanes & frustum, const Bounds & bounds);
+	};
+}
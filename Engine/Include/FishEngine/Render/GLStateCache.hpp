@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+
+#include "../FishEngine.hpp"
+#include "../ReflectClass.hpp"
+#include "../GLEnvironment.hpp"
+
+namespace FishEngine
+{
+	enum class GLStateType
+	{
+		Program,
+		VertexArray,
+		Texture,
+		Sampler,
+		Cull,
+		Blend,
+		Depth,
+		Framebuffer,
+		Count,
+	};
+
+	struct Meta(NonSerializable) GLStateCounters
+	{
+		// GL calls that reached the driver
+		uint32_t issued[static_cast<int>(GLStateType::Count)] = {};
+
+		// calls that were dropped because the state was already set
+		uint32_t skipped[static_cast<int>(GLStateType::Count)] = {};
+
+		uint32_t totalIssued() const;
+		uint32_t totalSkipped() const;
+	};
+
+	// Shadow copy of the GL state, skips the binds/enables that would not change anything.
+	// All engine code that touches the tracked state must go through here;
+	// call Invalidate() after any GL code that does not (e.g. a third-party library or a new context).
+	class FE_EXPORT Meta(NonSerializable) GLStateCache
+	{
+	public:
+		GLStateCache() = delete;
+
+		// forget everything, the next call of each kind will be issued.
+		static void Invalidate();
+
+		static void UseProgram(GLuint program);
+		static void BindVertexArray(GLuint vao);
+
+		// bind on the current texture unit (used by texture uploads)
+		static void BindTexture(GLenum target, GLuint texture);
+		static void BindTexture(GLuint unit, GLenum target, GLuint texture);
+		static void BindSampler(GLuint unit, GLuint sampler);
+
+		// face is GL_BACK/GL_FRONT/GL_FRONT_AND_BACK, ignored when disabled
+		static void SetCullFace(bool enabled, GLenum face = GL_BACK);
+		static void SetBlend(bool enabled);
+		static void SetBlendFunc(GLenum src, GLenum dst);
+		static void SetBlendFuncSeparate(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha);
+		static void SetDepthTest(bool enabled);
+		static void SetDepthMask(bool write);
+		static void SetDepthFunc(GLenum func);
+
+		// target is GL_FRAMEBUFFER, GL_DRAW_FRAMEBUFFER or GL_READ_FRAMEBUFFER
+		static void BindFramebuffer(GLenum target, GLuint fbo);
+
+		// deleting a bound object resets the binding to 0 in GL, the cache has to follow
+		// (except the program in use, which GL keeps installed: the cached one becomes unknown)
+		static void DeleteProgram(GLuint program);
+		static void DeleteVertexArray(GLuint vao);
+		static void DeleteTexture(GLuint texture);
+		static void DeleteSampler(GLuint sampler);
+		static void DeleteFramebuffer(GLuint fbo);
+
+		static const GLStateCounters & counters();
+		static void ResetCounters();
+	};
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "../FishEngine.hpp"
+#include "../ReflectClass.hpp"
+#include "../GLEnvironment.hpp"
+#include "VertexLayout.hpp"
+
+namespace FishEngine
+{
+	// Best-fit free-list over [0, capacity) in abstract units (vertices, indices).
+	// Freed ranges are merged with their free neighbours.
+	class FE_EXPORT Meta(NonSerializable) FreeListAllocator
+	{
+	public:
+		static constexpr uint32_t kInvalidOffset = 0xFFFFFFFFu;
+
+		explicit FreeListAllocator(uint32_t capacity = 0);
+
+		// offset of size units, kInvalidOffset if no free range is large enough
+		uint32_t Allocate(uint32_t size);
+
+		void Free(uint32_t offset, uint32_t size);
+
+		// append newCapacity - capacity() free units
+		void Grow(uint32_t newCapacity);
+
+		uint32_t capacity() const
+		{
+			return m_capacity;
+		}
+
+		uint32_t used() const
+		{
+			return m_used;
+		}
+
+		std::size_t freeRangeCount() const
+		{
+			return m_freeByOffset.size();
+		}
+
+	private:
+		void InsertFree(uint32_t offset, uint32_t size);
+		void EraseFree(std::map<uint32_t, uint32_t>::iterator it);
+
+		uint32_t									m_capacity = 0;
+		uint32_t									m_used = 0;
+		std::map<uint32_t, uint32_t>				m_freeByOffset;		// offset -> size
+		std::set<std::pair<uint32_t, uint32_t>>		m_freeBySize;		// (size, offset)
+	};
+
+	// Indirect draw command, the layout is fixed by GL (DrawElementsIndirectCommand).
+	struct DrawElementsIndirectCommand
+	{
+		GLuint	count;
+		GLuint	instanceCount;
+		GLuint	firstIndex;
+		GLint	baseVertex;
+		GLuint	baseInstance;
+	};
+
+	struct Meta(NonSerializable) GeometryArenaStats
+	{
+		uint32_t	pools = 0;
+		uint64_t	vertexBytes = 0;
+		uint64_t	vertexCapacityBytes = 0;
+		uint64_t	indexBytes = 0;
+		uint64_t	indexCapacityBytes = 0;
+	};
+
+	// Static meshes share large vertex and index buffers, one pool per (VertexLayout, index type).
+	// A mesh only holds a range of a pool and is drawn with its base vertex and first index, so draws of different
+	// meshes of the same pool do not switch the VAO, and a run of them can be submitted as one multi-draw.
+	// Pools grow by doubling (the old content is copied on the GPU) up to kMaxPoolBytes, then a new pool is started.
+	class FE_EXPORT Meta(NonSerializable) GeometryArena
+	{
+	public:
+		GeometryArena() = delete;
+
+		static constexpr uint32_t kMaxPoolBytes = 128 * 1024 * 1024;
+
+		struct Allocation
+		{
+			int			pool = -1;		// -1: not in the arena
+			uint32_t	baseVertex = 0;
+			uint32_t	firstIndex = 0;
+			uint32_t	vertexCount = 0;
+			uint32_t	indexCount = 0;
+		};
+
+		// meshes uploaded while disabled keep their own buffers
+		static bool enabled()
+		{
+			return s_enabled;
+		}
+
+		static void setEnabled(bool enabled)
+		{
+			s_enabled = enabled;
+		}
+
+		// Copy the encoded vertices and indices (indexType: GL_UNSIGNED_SHORT or GL_UNSIGNED_INT) into a pool.
+		// Returns an allocation with pool == -1 if the mesh does not fit in a pool.
+		static Allocation Allocate(VertexLayout const & layout, GLenum indexType, const void* vertices, uint32_t vertexCount, const void* indices, uint32_t indexCount);
+
+		static void Free(Allocation & allocation);
+
+		// The VAO of the pool: the vertex layout and the index buffer are bound, and the instance matrices when
+		// MultiDrawInstanced was used.
+		static GLuint vertexArray(int pool);
+		static GLenum indexType(int pool);
+
+		// Draw commands of pool with the pairs of instance matrices in instanceBuffer, indexed by baseInstance.
+		// One glMultiDrawElementsIndirect with GL 4.3, one instanced draw per command otherwise.
+		static void MultiDrawInstanced(int pool, const DrawElementsIndirectCommand* commands, int commandCount, GLuint instanceBuffer);
+
+		static bool multiDrawIndirectSupported();
+
+		static GeometryArenaStats stats();
+
+	private:
+		static bool s_enabled;
+	};
+}
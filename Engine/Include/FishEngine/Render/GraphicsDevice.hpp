@@ -0,0 +1,436 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#include "../FishEngine.hpp"
+#include "../ReflectClass.hpp"
+#include "../GLEnvironment.hpp"
+
+// Every GL entry point the engine calls. The gl* names are redirected to GraphicsDevice::s_gl below
+// (the same trick GLEW uses), so a call site does not know which backend it talks to.
+// A GL function that is not listed here bypasses the device: add it before using it in the engine.
+#define FISHENGINE_GL_FUNCTIONS(X) \
+	X(ActiveTexture) \
+	X(AttachShader) \
+	X(BeginTransformFeedback) \
+	X(BindBuffer) \
+	X(BindBufferBase) \
+	X(BindBufferRange) \
+	X(BindFramebuffer) \
+	X(BindSampler) \
+	X(BindTexture) \
+	X(BindTransformFeedback) \
+	X(BindVertexArray) \
+	X(BlendFuncSeparate) \
+	X(BlitFramebuffer) \
+	X(BufferData) \
+	X(BufferSubData) \
+	X(CheckFramebufferStatus) \
+	X(Clear) \
+	X(ClearBufferfv) \
+	X(ClearColor) \
+	X(ClientWaitSync) \
+	X(CompileShader) \
+	X(CompressedTexSubImage1D) \
+	X(CompressedTexSubImage2D) \
+	X(CompressedTexSubImage3D) \
+	X(CopyBufferSubData) \
+	X(CreateProgram) \
+	X(CreateShader) \
+	X(CullFace) \
+	X(DeleteBuffers) \
+	X(DeleteFramebuffers) \
+	X(DeleteProgram) \
+	X(DeleteSamplers) \
+	X(DeleteShader) \
+	X(DeleteSync) \
+	X(DeleteTextures) \
+	X(DeleteVertexArrays) \
+	X(DepthFunc) \
+	X(DepthMask) \
+	X(DetachShader) \
+	X(Disable) \
+	X(DisableVertexAttribArray) \
+	X(DrawArrays) \
+	X(DrawBuffers) \
+	X(DrawElements) \
+	X(DrawElementsBaseVertex) \
+	X(DrawElementsInstanced) \
+	X(DrawElementsInstancedBaseVertex) \
+	X(Enable) \
+	X(EnableVertexAttribArray) \
+	X(EndTransformFeedback) \
+	X(FenceSync) \
+	X(Flush) \
+	X(FramebufferTexture) \
+	X(FramebufferTexture2D) \
+	X(FrontFace) \
+	X(GenBuffers) \
+	X(GenFramebuffers) \
+	X(GenSamplers) \
+	X(GenTextures) \
+	X(GenTransformFeedbacks) \
+	X(GenVertexArrays) \
+	X(GenerateMipmap) \
+	X(GetActiveUniform) \
+	X(GetActiveUniformBlockiv) \
+	X(GetActiveUniformsiv) \
+	X(GetError) \
+	X(GetIntegerv) \
+	X(GetProgramBinary) \
+	X(GetProgramInfoLog) \
+	X(GetProgramiv) \
+	X(GetShaderInfoLog) \
+	X(GetShaderiv) \
+	X(GetString) \
+	X(GetUniformBlockIndex) \
+	X(GetUniformLocation) \
+	X(LinkProgram) \
+	X(MapBufferRange) \
+	X(PixelStorei) \
+	X(PolygonMode) \
+	X(ProgramBinary) \
+	X(ProgramParameteri) \
+	X(ProgramUniform1f) \
+	X(ProgramUniform1i) \
+	X(ProgramUniform2fv) \
+	X(ProgramUniform3fv) \
+	X(ProgramUniform4fv) \
+	X(ProgramUniformMatrix4fv) \
+	X(SamplerParameteri) \
+	X(ShaderSource) \
+	X(TexImage2D) \
+	X(TexImage3D) \
+	X(TexParameteri) \
+	X(TexStorage1D) \
+	X(TexStorage2D) \
+	X(TexStorage3D) \
+	X(TexSubImage1D) \
+	X(TexSubImage2D) \
+	X(TexSubImage3D) \
+	X(TransformFeedbackVaryings) \
+	X(UniformBlockBinding) \
+	X(UnmapBuffer) \
+	X(UseProgram) \
+	X(VertexAttribDivisor) \
+	X(VertexAttribIPointer) \
+	X(VertexAttribPointer) \
+	X(Viewport) \
+	FISHENGINE_GL_FUNCTIONS_BUFFER_STORAGE(X) \
+	FISHENGINE_GL_FUNCTIONS_MULTI_DRAW_INDIRECT(X)
+
+#if defined(GL_MAP_PERSISTENT_BIT)
+	#define FISHENGINE_GL_FUNCTIONS_BUFFER_STORAGE(X) X(BufferStorage)
+#else
+	#define FISHENGINE_GL_FUNCTIONS_BUFFER_STORAGE(X)	// GL 4.4, missing from the macOS headers
+#endif
+
+#if defined(GL_VERSION_4_3)
+	#define FISHENGINE_GL_FUNCTIONS_MULTI_DRAW_INDIRECT(X) X(MultiDrawElementsIndirect)
+#else
+	#define FISHENGINE_GL_FUNCTIONS_MULTI_DRAW_INDIRECT(X)	// GL 4.3, missing from the macOS headers
+#endif
+
+namespace FishEngine
+{
+	enum class GraphicsDeviceType
+	{
+		OpenGLCore,
+		Null,		// accepts every call and does nothing, for running the render loop without a GPU
+	};
+
+	enum class GraphicsResourceType
+	{
+		Buffer,
+		Texture,
+		Sampler,
+		VertexArray,
+		Framebuffer,
+		TransformFeedback,
+		Program,
+		Shader,
+		Count,
+	};
+
+	struct Meta(NonSerializable) GraphicsDeviceCounters
+	{
+		// per frame, see GraphicsDevice::ResetFrameCounters()
+		uint32_t	drawCalls = 0;
+		uint32_t	instances = 0;
+		uint64_t	vertices = 0;			// vertices (or indices) submitted, times instance count
+		uint32_t	bufferUploads = 0;
+		uint64_t	bufferUploadBytes = 0;
+		uint32_t	textureUploads = 0;
+
+		// objects alive right now
+		uint32_t	liveResources[static_cast<int>(GraphicsResourceType::Count)] = {};
+	};
+
+	// one pointer per GL entry point, typed after the declaration in the GL headers
+	struct Meta(NonSerializable) GLFunctionTable
+	{
+#define FISHENGINE_GL_DECLARE(name) std::add_pointer_t<std::remove_pointer_t<decltype(gl##name)>> name = nullptr;
+		FISHENGINE_GL_FUNCTIONS(FISHENGINE_GL_DECLARE)
+#undef FISHENGINE_GL_DECLARE
+	};
+
+	// Thin graphics device: picks the backend behind the gl* entry points.
+	// OpenGLCore forwards to the driver. Null hands out fake object names, reports every shader as compiled and
+	// every framebuffer as complete, and only counts draws, uploads and live objects. Its cost is one indirect call,
+	// so a headless run measures the CPU side of the render loop (culling, sorting, uniform setup).
+	// The counters are only maintained by the Null backend.
+	class FE_EXPORT Meta(NonSerializable) GraphicsDevice
+	{
+	public:
+		GraphicsDevice() = delete;
+
+		// OpenGLCore needs a current context (and glewInit() on Windows). Must be called before any other GL call.
+		static void Init(GraphicsDeviceType type);
+
+		static GraphicsDeviceType type()
+		{
+			return s_type;
+		}
+
+		static bool isNull()
+		{
+			return s_type == GraphicsDeviceType::Null;
+		}
+
+		static const GraphicsDeviceCounters & counters();
+
+		// reset the per frame counters, the live object counts are kept
+		static void ResetFrameCounters();
+
+		// the table behind the gl* macros
+		static GLFunctionTable s_gl;
+
+	private:
+		static GraphicsDeviceType s_type;
+	};
+}
+
+#if !defined(FISHENGINE_NO_GL_DISPATCH)
+#define FISHENGINE_GL_DISPATCH(name) (::FishEngine::GraphicsDevice::s_gl.name)
+#undef glActiveTexture
+#define glActiveTexture FISHENGINE_GL_DISPATCH(ActiveTexture)
+#undef glAttachShader
+#define glAttachShader FISHENGINE_GL_DISPATCH(AttachShader)
+#undef glBeginTransformFeedback
+#define glBeginTransformFeedback FISHENGINE_GL_DISPATCH(BeginTransformFeedback)
+#undef glBindBuffer
+#define glBindBuffer FISHENGINE_GL_DISPATCH(BindBuffer)
+#undef glBindBufferBase
+#define glBindBufferBase FISHENGINE_GL_DISPATCH(BindBufferBase)
+#undef glBindBufferRange
+#define glBindBufferRange FISHENGINE_GL_DISPATCH(BindBufferRange)
+#undef glBindFramebuffer
+#define glBindFramebuffer FISHENGINE_GL_DISPATCH(BindFramebuffer)
+#undef glBindSampler
+#define glBindSampler FISHENGINE_GL_DISPATCH(BindSampler)
+#undef glBindTexture
+#define glBindTexture FISHENGINE_GL_DISPATCH(BindTexture)
+#undef glBindTransformFeedback
+#define glBindTransformFeedback FISHENGINE_GL_DISPATCH(BindTransformFeedback)
+#undef glBindVertexArray
+#define glBindVertexArray FISHENGINE_GL_DISPATCH(BindVertexArray)
+#undef glBlendFuncSeparate
+#define glBlendFuncSeparate FISHENGINE_GL_DISPATCH(BlendFuncSeparate)
+#undef glBlitFramebuffer
+#define glBlitFramebuffer FISHENGINE_GL_DISPATCH(BlitFramebuffer)
+#undef glBufferData
+#define glBufferData FISHENGINE_GL_DISPATCH(BufferData)
+#undef glBufferSubData
+#define glBufferSubData FISHENGINE_GL_DISPATCH(BufferSubData)
+#undef glCheckFramebufferStatus
+#define glCheckFramebufferStatus FISHENGINE_GL_DISPATCH(CheckFramebufferStatus)
+#undef glClear
+#define glClear FISHENGINE_GL_DISPATCH(Clear)
+#undef glClearBufferfv
+#define glClearBufferfv FISHENGINE_GL_DISPATCH(ClearBufferfv)
+#undef glClearColor
+#define glClearColor FISHENGINE_GL_DISPATCH(ClearColor)
+#undef glClientWaitSync
+#define glClientWaitSync FISHENGINE_GL_DISPATCH(ClientWaitSync)
+#undef glCompileShader
+#define glCompileShader FISHENGINE_GL_DISPATCH(CompileShader)
+#undef glCompressedTexSubImage1D
+#define glCompressedTexSubImage1D FISHENGINE_GL_DISPATCH(CompressedTexSubImage1D)
+#undef glCompressedTexSubImage2D
+#define glCompressedTexSubImage2D FISHENGINE_GL_DISPATCH(CompressedTexSubImage2D)
+#undef glCompressedTexSubImage3D
+#define glCompressedTexSubImage3D FISHENGINE_GL_DISPATCH(CompressedTexSubImage3D)
+#undef glCopyBufferSubData
+#define glCopyBufferSubData FISHENGINE_GL_DISPATCH(CopyBufferSubData)
+#undef glCreateProgram
+#define glCreateProgram FISHENGINE_GL_DISPATCH(CreateProgram)
+#undef glCreateShader
+#define glCreateShader FISHENGINE_GL_DISPATCH(CreateShader)
+#undef glCullFace
+#define glCullFace FISHENGINE_GL_DISPATCH(CullFace)
+#undef glDeleteBuffers
+#define glDeleteBuffers FISHENGINE_GL_DISPATCH(DeleteBuffers)
+#undef glDeleteFramebuffers
+#define glDeleteFramebuffers FISHENGINE_GL_DISPATCH(DeleteFramebuffers)
+#undef glDeleteProgram
+#define glDeleteProgram FISHENGINE_GL_DISPATCH(DeleteProgram)
+#undef glDeleteSamplers
+#define glDeleteSamplers FISHENGINE_GL_DISPATCH(DeleteSamplers)
+#undef glDeleteShader
+#define glDeleteShader FISHENGINE_GL_DISPATCH(DeleteShader)
+#undef glDeleteSync
+#define glDeleteSync FISHENGINE_GL_DISPATCH(DeleteSync)
+#undef glDeleteTextures
+#define glDeleteTextures FISHENGINE_GL_DISPATCH(DeleteTextures)
+#undef glDeleteVertexArrays
+#define glDeleteVertexArrays FISHENGINE_GL_DISPATCH(DeleteVertexArrays)
+#undef glDepthFunc
+#define glDepthFunc FISHENGINE_GL_DISPATCH(DepthFunc)
+#undef glDepthMask
+#define glDepthMask FISHENGINE_GL_DISPATCH(DepthMask)
+#undef glDetachShader
+#define glDetachShader FISHENGINE_GL_DISPATCH(DetachShader)
+#undef glDisable
+#define glDisable FISHENGINE_GL_DISPATCH(Disable)
+#undef glDisableVertexAttribArray
+#define glDisableVertexAttribArray FISHENGINE_GL_DISPATCH(DisableVertexAttribArray)
+#undef glDrawArrays
+#define glDrawArrays FISHENGINE_GL_DISPATCH(DrawArrays)
+#undef glDrawBuffers
+#define glDrawBuffers FISHENGINE_GL_DISPATCH(DrawBuffers)
+#undef glDrawElements
+#define glDrawElements FISHENGINE_GL_DISPATCH(DrawElements)
+#undef glDrawElementsBaseVertex
+#define glDrawElementsBaseVertex FISHENGINE_GL_DISPATCH(DrawElementsBaseVertex)
+#undef glDrawElementsInstanced
+#define glDrawElementsInstanced FISHENGINE_GL_DISPATCH(DrawElementsInstanced)
+#undef glDrawElementsInstancedBaseVertex
+#define glDrawElementsInstancedBaseVertex FISHENGINE_GL_DISPATCH(DrawElementsInstancedBaseVertex)
+#undef glEnable
+#define glEnable FISHENGINE_GL_DISPATCH(Enable)
+#undef glEnableVertexAttribArray
+#define glEnableVertexAttribArray FISHENGINE_GL_DISPATCH(EnableVertexAttribArray)
+#undef glEndTransformFeedback
+#define glEndTransformFeedback FISHENGINE_GL_DISPATCH(EndTransformFeedback)
+#undef glFenceSync
+#define glFenceSync FISHENGINE_GL_DISPATCH(FenceSync)
+#undef glFlush
+#define glFlush FISHENGINE_GL_DISPATCH(Flush)
+#undef glFramebufferTexture
+#define glFramebufferTexture FISHENGINE_GL_DISPATCH(FramebufferTexture)
+#undef glFramebufferTexture2D
+#define glFramebufferTexture2D FISHENGINE_GL_DISPATCH(FramebufferTexture2D)
+#undef glFrontFace
+#define glFrontFace FISHENGINE_GL_DISPATCH(FrontFace)
+#undef glGenBuffers
+#define glGenBuffers FISHENGINE_GL_DISPATCH(GenBuffers)
+#undef glGenFramebuffers
+#define glGenFramebuffers FISHENGINE_GL_DISPATCH(GenFramebuffers)
+#undef glGenSamplers
+#define glGenSamplers FISHENGINE_GL_DISPATCH(GenSamplers)
+#undef glGenTextures
+#define glGenTextures FISHENGINE_GL_DISPATCH(GenTextures)
+#undef glGenTransformFeedbacks
+#define glGenTransformFeedbacks FISHENGINE_GL_DISPATCH(GenTransformFeedbacks)
+#undef glGenVertexArrays
+#define glGenVertexArrays FISHENGINE_GL_DISPATCH(GenVertexArrays)
+#undef glGenerateMipmap
+#define glGenerateMipmap FISHENGINE_GL_DISPATCH(GenerateMipmap)
+#undef glGetActiveUniform
+#define glGetActiveUniform FISHENGINE_GL_DISPATCH(GetActiveUniform)
+#undef glGetActiveUniformBlockiv
+#define glGetActiveUniformBlockiv FISHENGINE_GL_DISPATCH(GetActiveUniformBlockiv)
+#undef glGetActiveUniformsiv
+#define glGetActiveUniformsiv FISHENGINE_GL_DISPATCH(GetActiveUniformsiv)
+#undef glGetError
+#define glGetError FISHENGINE_GL_DISPATCH(GetError)
+#undef glGetIntegerv
+#define glGetIntegerv FISHENGINE_GL_DISPATCH(GetIntegerv)
+#undef glGetProgramBinary
+#define glGetProgramBinary FISHENGINE_GL_DISPATCH(GetProgramBinary)
+#undef glGetProgramInfoLog
+#define glGetProgramInfoLog FISHENGINE_GL_DISPATCH(GetProgramInfoLog)
+#undef glGetProgramiv
+#define glGetProgramiv FISHENGINE_GL_DISPATCH(GetProgramiv)
+#undef glGetShaderInfoLog
+#define glGetShaderInfoLog FISHENGINE_GL_DISPATCH(GetShaderInfoLog)
+#undef glGetShaderiv
+#define glGetShaderiv FISHENGINE_GL_DISPATCH(GetShaderiv)
+#undef glGetString
+#define glGetString FISHENGINE_GL_DISPATCH(GetString)
+#undef glGetUniformBlockIndex
+#define glGetUniformBlockIndex FISHENGINE_GL_DISPATCH(GetUniformBlockIndex)
+#undef glGetUniformLocation
+#define glGetUniformLocation FISHENGINE_GL_DISPATCH(GetUniformLocation)
+#undef glLinkProgram
+#define glLinkProgram FISHENGINE_GL_DISPATCH(LinkProgram)
+#undef glMapBufferRange
+#define glMapBufferRange FISHENGINE_GL_DISPATCH(MapBufferRange)
+#undef glPixelStorei
+#define glPixelStorei FISHENGINE_GL_DISPATCH(PixelStorei)
+#undef glPolygonMode
+#define glPolygonMode FISHENGINE_GL_DISPATCH(PolygonMode)
+#undef glProgramBinary
+#define glProgramBinary FISHENGINE_GL_DISPATCH(ProgramBinary)
+#undef glProgramParameteri
+#define glProgramParameteri FISHENGINE_GL_DISPATCH(ProgramParameteri)
+#undef glProgramUniform1f
+#define glProgramUniform1f FISHENGINE_GL_DISPATCH(ProgramUniform1f)
+#undef glProgramUniform1i
+#define glProgramUniform1i FISHENGINE_GL_DISPATCH(ProgramUniform1i)
+#undef glProgramUniform2fv
+#define glProgramUniform2fv FISHENGINE_GL_DISPATCH(ProgramUniform2fv)
+#undef glProgramUniform3fv
+#define glProgramUniform3fv FISHENGINE_GL_DISPATCH(ProgramUniform3fv)
+#undef glProgramUniform4fv
+#define glProgramUniform4fv FISHENGINE_GL_DISPATCH(ProgramUniform4fv)
+#undef glProgramUniformMatrix4fv
+#define glProgramUniformMatrix4fv FISHENGINE_GL_DISPATCH(ProgramUniformMatrix4fv)
+#undef glSamplerParameteri
+#define glSamplerParameteri FISHENGINE_GL_DISPATCH(SamplerParameteri)
+#undef glShaderSource
+#define glShaderSource FISHENGINE_GL_DISPATCH(ShaderSource)
+#undef glTexImage2D
+#define glTexImage2D FISHENGINE_GL_DISPATCH(TexImage2D)
+#undef glTexImage3D
+#define glTexImage3D FISHENGINE_GL_DISPATCH(TexImage3D)
+#undef glTexParameteri
+#define glTexParameteri FISHENGINE_GL_DISPATCH(TexParameteri)
+#undef glTexStorage1D
+#define glTexStorage1D FISHENGINE_GL_DISPATCH(TexStorage1D)
+#undef glTexStorage2D
+#define glTexStorage2D FISHENGINE_GL_DISPATCH(TexStorage2D)
+#undef glTexStorage3D
+#define glTexStorage3D FISHENGINE_GL_DISPATCH(TexStorage3D)
+#undef glTexSubImage1D
+#define glTexSubImage1D FISHENGINE_GL_DISPATCH(TexSubImage1D)
+#undef glTexSubImage2D
+#define glTexSubImage2D FISHENGINE_GL_DISPATCH(TexSubImage2D)
+#undef glTexSubImage3D
+#define glTexSubImage3D FISHENGINE_GL_DISPATCH(TexSubImage3D)
+#undef glTransformFeedbackVaryings
+#define glTransformFeedbackVaryings FISHENGINE_GL_DISPATCH(TransformFeedbackVaryings)
+#undef glUniformBlockBinding
+#define glUniformBlockBinding FISHENGINE_GL_DISPATCH(UniformBlockBinding)
+#undef glUnmapBuffer
+#define glUnmapBuffer FISHENGINE_GL_DISPATCH(UnmapBuffer)
+#undef glUseProgram
+#define glUseProgram FISHENGINE_GL_DISPATCH(UseProgram)
+#undef glVertexAttribDivisor
+#define glVertexAttribDivisor FISHENGINE_GL_DISPATCH(VertexAttribDivisor)
+#undef glVertexAttribIPointer
+#define glVertexAttribIPointer FISHENGINE_GL_DISPATCH(VertexAttribIPointer)
+#undef glVertexAttribPointer
+#define glVertexAttribPointer FISHENGINE_GL_DISPATCH(VertexAttribPointer)
+#undef glViewport
+#define glViewport FISHENGINE_GL_DISPATCH(Viewport)
+#if defined(GL_MAP_PERSISTENT_BIT)
+#undef glBufferStorage
+#define glBufferStorage FISHENGINE_GL_DISPATCH(BufferStorage)
+#endif
+#if defined(GL_VERSION_4_3)
+#undef glMultiDrawElementsIndirect
+#define glMultiDrawElementsIndirect FISHENGINE_GL_DISPATCH(MultiDrawElementsIndirect)
+#endif
+#endif // FISHENGINE_NO_GL_DISPATCH
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "../FishEngine.hpp"
+
+namespace FishEngine
+{
+namespace Rendering
+{
+	/// <summary>
+	///   <para>64-bit draw sort keys. Smaller keys are drawn first.</para>
+	/// </summary>
+	/// opaque:      | queue 13 | program 12 | material 12 | mesh 11 | depth 16 |    (state first, then front-to-back)
+	/// transparent: | queue 13 | inverted depth 24 | program 9 | material 9 | mesh 9 |    (back-to-front)
+	/// program, material and mesh are ids (e.g. Object::GetInstanceID()), only the low bits are used;
+	/// a collision only makes the state grouping worse, never the result wrong.
+	/// depth01 is the normalized view depth in [0, 1].
+	FE_EXPORT uint64_t MakeOpaqueSortKey(int renderQueue, uint32_t program, uint32_t material, uint32_t mesh, float depth01);
+	FE_EXPORT uint64_t MakeTransparentSortKey(int renderQueue, uint32_t program, uint32_t material, uint32_t mesh, float depth01);
+
+	/// <summary>
+	///   <para>LSD radix sort (8 bits per pass), returns the permutation that sorts keys in ascending order.</para>
+	/// </summary>
+	/// Passes in which every key has the same byte are skipped. The sort is stable.
+	FE_EXPORT void RadixSort(std::vector<uint64_t> const & keys, std::vector<uint32_t> & outOrder);
+}
+}
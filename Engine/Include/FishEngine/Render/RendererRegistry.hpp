@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "../FishEngine.hpp"
+#include "../ReflectClass.hpp"
+#include "Culling.hpp"
+
+namespace FishEngine
+{
+	// Retained list of the renderers in the scene, stored in flat arrays.
+	// The arrays are patched in place: an added renderer is appended, a removed one is swapped with the last one,
+	// SetActive, enable/disable, shadow and material changes refresh only the entries of the renderers they touch.
+	// The arrays are built from a walk over the scene only the first time, or after SetStructureDirty().
+	// World bounds are recomputed only for renderers whose Transform (or mesh) changed, and for skinned ones.
+	class FE_EXPORT Meta(NonSerializable) RendererRegistry
+	{
+	public:
+		RendererRegistry() = delete;
+
+		enum Flags : uint8_t
+		{
+			Active			= 1 << 0,	// gameObject is active in hierarchy && renderer is enabled
+			CastShadows		= 1 << 1,
+			Skinned			= 1 << 2,
+		};
+
+		// drop the arrays and walk the whole scene again in the next Update
+		static void SetStructureDirty() { s_structureDirty = true; ++s_structureVersion; }
+
+		// incremented by every structure change (game objects destroyed/re-parented, renderers or mesh filters
+		// added/removed), caches of raw object pointers compare it
+		static uint32_t structureVersion() { return s_structureVersion; }
+
+		// Renderer::setEnabled, shadow settings, materials: refresh the entries of renderer
+		static void SetStateDirty(Renderer const & renderer);
+
+		// GameObject::SetActive: refresh the renderers of go and its children
+		static void SetStateDirty(GameObject const & go);
+
+		static void OnComponentAdded(ComponentPtr const & component);
+		static void OnComponentRemoved(ComponentPtr const & component);
+
+		// go was re-parented or added to the scene, its renderers join or leave the registry in the next Update
+		static void OnHierarchyChanged(GameObjectPtr const & go);
+
+		// called by Scene::DestroyImmediate, for go only (its children are destroyed one by one)
+		static void OnGameObjectDestroyed(GameObject const & go);
+
+		// the LODs of a LODGroup changed
+		static void SetLODDirty() { s_lodDirty = true; }
+
+		// bring the arrays up to date, call before using them.
+		static void Update();
+
+		// select the LOD of every LODGroup for camera and update s_lodFade, call after Update().
+		static void UpdateLOD(Camera const & camera);
+
+		static std::size_t size() { return s_renderers.size(); }
+
+		static std::vector<RendererPtr>		s_renderers;
+		static std::vector<MeshFilterPtr>	s_meshFilters;		// nullptr for SkinnedMeshRenderer
+		static std::vector<MeshPtr>			s_meshes;
+		static std::vector<uint8_t>			s_flags;
+		static BoundsArray					s_worldBounds;
+
+		// the materials of renderer i are s_materials[s_materialOffsets[i]] to s_materials[s_materialOffsets[i] + s_materialCounts[i] - 1]
+		static std::vector<MaterialPtr>		s_materials;
+		static std::vector<uint32_t>		s_materialOffsets;
+		static std::vector<uint32_t>		s_materialCounts;
+
+		// visibility of the renderer at the current LOD: 1 drawn, 0 skipped, (0, 1) fading out to the next LOD,
+		// (-1, 0) fading in with the complementary dither pattern. Always 1 for renderers not in a LODGroup.
+		static std::vector<float>			s_lodFade;
+
+	private:
+		static void Rebuild();
+		static void ApplyPendingChanges();
+		static void Add(RendererPtr const & renderer);
+		static void Remove(uint32_t index);
+		static void Refresh(uint32_t index);
+		static void RemoveLODGroup(LODGroup const * lodGroup);
+		static void MapLODs();
+		static void CompactMaterials();
+
+		static std::vector<uint32_t>		s_transformVersions;
+		static std::vector<uint8_t>			s_stateDirty;		// 1: in s_dirtyIndices
+		static std::vector<uint32_t>		s_dirtyIndices;
+		static std::vector<LODGroupPtr>		s_lodGroups;
+		static std::vector<int32_t>			s_lodGroupIndex;	// index in s_lodGroups, -1 if not in a LODGroup
+		static std::vector<uint8_t>			s_lodMask;			// bit i: renderer is in LOD i of its group
+		static std::size_t					s_unusedMaterials;	// entries of s_materials no renderer points to
+
+		// added components and re-parented game objects, checked against the scene in Update
+		static std::vector<std::weak_ptr<Component>>	s_addedComponents;
+		static std::vector<std::weak_ptr<GameObject>>	s_movedGameObjects;
+
+		static bool							s_structureDirty;
+		static uint32_t						s_structureVersion;
+		static bool							s_lodDirty;
+	};
+}
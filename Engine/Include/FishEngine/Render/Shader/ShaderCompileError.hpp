@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <exception>
+#include <stdexcept>
+#include <string>
 
 namespace FishEngine
 {
@@ -27,15 +30,57 @@ namespace FishEngine
 		ShaderCompileError(ShaderCompileStage stage,  int lineNumber, ShaderCompileErrorType errorType)
 			: m_stage(stage), m_lineNumber(lineNumber), m_errorType(errorType)
 		{
-			
+
 		}
 
+		virtual const char* what() const noexcept override
+		{
+			switch (m_errorType)
+			{
+			case ShaderCompileErrorType::InvalidSyntax:			return "invalid syntax";
+			case ShaderCompileErrorType::UnmatchedBrace:		return "unmatched brace";
+			case ShaderCompileErrorType::UnMatchedParenthese:	return "unmatched parenthese";
+			case ShaderCompileErrorType::UnknownType:			return "unknown type";
+			case ShaderCompileErrorType::EarlyEndOfFile:		return "early end of file";
+			case ShaderCompileErrorType::FileNotFound:			return "file not found";
+			}
+			return "shader compile error";
+		}
+
+		ShaderCompileStage stage() const { return m_stage; }
+		int lineNumber() const { return m_lineNumber; }
+		ShaderCompileErrorType errorType() const { return m_errorType; }
+
 	protected:
 		ShaderCompileStage 		m_stage 		= ShaderCompileStage::Preprocessor;
 		int 					m_lineNumber 	= 0;
 		ShaderCompileErrorType 	m_errorType 	= ShaderCompileErrorType::InvalidSyntax;
 	};
 
+	// the info log of a shader that failed to compile or a program that failed to link
+	class ShaderInfoLogError : public std::runtime_error
+	{
+	public:
+		ShaderInfoLogError(ShaderCompileStage stage, std::string const & infoLog)
+			: std::runtime_error(infoLog), m_stage(stage)
+		{
+		}
+
+		ShaderCompileStage stage() const { return m_stage; }
+
+	protected:
+		ShaderCompileStage		m_stage;
+	};
+
+	// an error of a shader: of its settings, or one error line of the info log of a variant
+	struct ShaderDiagnostic
+	{
+		ShaderCompileStage		stage = ShaderCompileStage::Compile;
+		uint32_t				keywords = 0;		// ShaderKeywords of the variant
+		int						lineNumber = 0;		// as reported by the driver, 0 if unknown
+		std::string				message;
+	};
+
 	// class ShaderPrepropressError : public ShaderError
 	// {
 
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "../FishEngine.hpp"
+#include "../ReflectClass.hpp"
+#include "../GLEnvironment.hpp"
+#include "../Path.hpp"
+
+namespace FishEngine
+{
+	struct ShaderCacheCounters
+	{
+		uint32_t	hits = 0;
+		uint32_t	misses = 0;
+		uint32_t	rejected = 0;	// binaries the driver did not accept (driver update, truncated file)
+		uint32_t	stored = 0;
+	};
+
+	// On-disk cache of linked GL programs, see glGetProgramBinary / glProgramBinary.
+	// An entry is keyed by the preprocessed shader source, the variant and the GL vendor/renderer/version,
+	// so editing a shader or updating the driver only causes a miss. A binary the driver rejects is deleted
+	// and the caller compiles from source as if there was no entry.
+	class FE_EXPORT Meta(NonSerializable) ShaderCache
+	{
+	public:
+		ShaderCache() = delete;
+
+		// Store entries in directory (created if needed). The cache is disabled until Init is called,
+		// and always with the Null graphics device.
+		static void Init(Path const & directory);
+
+		// <temp>/FishEngine/ShaderCache
+		static Path DefaultDirectory();
+
+		static bool enabled();
+
+		// key of a program variant
+		static uint64_t Key(std::string const & source, uint32_t keywords, bool transformFeedback);
+
+		// a linked program created from the cached binary, 0 if there is none or the driver rejects it
+		static GLuint Load(uint64_t key);
+
+		// save the binary of a linked program, link it with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+		static void Store(uint64_t key, GLuint program);
+
+		static const ShaderCacheCounters & counters();
+
+	private:
+		static Path					s_directory;
+		static bool					s_enabled;
+		static ShaderCacheCounters	s_counters;
+	};
+}
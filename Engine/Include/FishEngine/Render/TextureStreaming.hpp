@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+#include "../FishEngine.hpp"
+#include "../ReflectClass.hpp"
+#include "../TextureProperty.hpp"
+
+namespace FishEngine
+{
+	// The pixels of a Texture2D, tightly packed. After the mip chain is built, data holds every level,
+	// level 0 first, and mipOffsets the offset of each level in data.
+	struct FE_EXPORT Meta(NonSerializable) TextureStreamingImage
+	{
+		uint32_t				width = 0;
+		uint32_t				height = 0;
+		TextureFormat			format = TextureFormat::RGBA32;
+		std::vector<uint8_t>	data;
+		std::vector<uint32_t>	mipOffsets;
+	};
+
+	// Loads Texture2D pixels into GL without stalling the render loop.
+	// Decoding and the mip chain (a box filter, the same result as glGenerateMipmap) run on a pool of worker threads.
+	// Update() then uploads the levels through a ring of pixel buffer objects, at most uploadBudget() bytes
+	// per frame, from the smallest level to level 0. A level is visible as soon as it and the ones below it are
+	// uploaded (GL_TEXTURE_BASE_LEVEL), until the first one is, the texture is bound as its streaming placeholder.
+	// Everything but the decoding and the mip chain runs on the render thread.
+	class FE_EXPORT Meta(NonSerializable) TextureStreaming
+	{
+	public:
+		TextureStreaming() = delete;
+
+		// runs on a worker thread: fill width, height, format and level 0 of data, return false on failure
+		typedef std::function<bool(TextureStreamingImage & image)> Decoder;
+
+		// runs on the render thread once the image is decoded, before the first upload
+		typedef std::function<void(Texture2D & texture)> LoadedCallback;
+
+		// Textures with fewer bytes are uploaded by Texture2D right away.
+		static constexpr uint32_t kMinStreamingBytes = 64 * 64 * 4;
+
+		static constexpr int kPixelBufferCount = 4;
+		static constexpr uint32_t kPixelBufferSize = 4 * 1024 * 1024;
+
+		// Decode texture with decoder (or take the pixels already in it when decoder is null), then stream it in.
+		// A texture that is already resident keeps its contents until the new ones replace them,
+		// a Load of a texture that is still loading supersedes the previous one.
+		static void Load(Texture2D* texture, Decoder decoder = nullptr, LoadedCallback onLoaded = nullptr);
+
+		// drop the pending work of texture, called by ~Texture2D
+		static void Cancel(Texture2D* texture);
+
+		// collect decoded images and upload within the budget, once per frame with the GL context current
+		static void Update();
+
+		// block until texture (every texture when nullptr) is resident, ignoring the budget
+		static void Finish(Texture2D* texture = nullptr);
+
+		static bool IsPending(Texture2D const * texture);
+
+		// textures waiting for a worker, being decoded or being uploaded
+		static std::size_t pendingCount();
+
+		// release the pixel buffers and stop the workers, the pending work is dropped
+		static void Clean();
+
+		// false: Texture2D uploads synchronously on first use
+		static bool enabled()
+		{
+			return s_enabled;
+		}
+
+		static void setEnabled(bool enabled)
+		{
+			s_enabled = enabled;
+		}
+
+		// bytes uploaded per Update, 16MB by default. At least one row is uploaded every frame.
+		static uint64_t uploadBudget()
+		{
+			return s_uploadBudget;
+		}
+
+		static void setUploadBudget(uint64_t bytesPerFrame)
+		{
+			s_uploadBudget = bytesPerFrame;
+		}
+
+		// bytes uploaded by the last Update
+		static uint64_t frameUploadBytes()
+		{
+			return s_frameUploadBytes;
+		}
+
+		// hardware_concurrency() - 1, at most 4, by default. 0: decode on the render thread in Update
+		static int workerCount();
+
+		static void setWorkerCount(int count);
+
+	private:
+		// hand the decoded images to the upload queue
+		static void Collect(bool wait);
+
+		// upload at most budget bytes (0: no limit), returns the bytes uploaded
+		static uint64_t Upload(uint64_t budget, bool wait);
+
+		static bool		s_enabled;
+		static uint64_t	s_uploadBudget;
+		static uint64_t	s_frameUploadBytes;
+	};
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+
+#include "../FishEngine.hpp"
+#include "../ReflectClass.hpp"
+#include "../GLEnvironment.hpp"
+
+namespace FishEngine
+{
+	// One GL uniform buffer split into kSegmentCount segments. The uniform blocks of a frame are written
+	// linearly into the current segment and bound with glBindBufferRange, so there is no per-draw orphaning.
+	// A fence is inserted when a segment is retired and waited on before that segment is written again.
+	// The buffer is persistently mapped when GL 4.4 / ARB_buffer_storage is available, glBufferSubData is used otherwise.
+	class FE_EXPORT Meta(NonSerializable) UniformRingBuffer
+	{
+	public:
+		static constexpr int kSegmentCount = 3;
+
+		UniformRingBuffer() = default;
+		UniformRingBuffer(UniformRingBuffer const &) = delete;
+		UniformRingBuffer & operator=(UniformRingBuffer const &) = delete;
+
+		void Init(uint32_t segmentSize);
+		void Destroy();
+
+		// Copy size bytes into the current segment and bind bindSize bytes (bindSize >= size) of it to bindingPoint.
+		// Moves to the next segment first if the current one is full, see generation().
+		void Upload(GLuint bindingPoint, const void* data, uint32_t size, uint32_t bindSize);
+
+		void Upload(GLuint bindingPoint, const void* data, uint32_t size)
+		{
+			Upload(bindingPoint, data, size, size);
+		}
+
+		// retire the current segment, call once at the end of a frame
+		void NextFrame();
+
+		// incremented every time the current segment changes;
+		// ranges bound before that point into an older segment must be uploaded again before the next draw.
+		uint32_t generation() const
+		{
+			return m_generation;
+		}
+
+		bool persistentlyMapped() const
+		{
+			return m_mapped != nullptr;
+		}
+
+	private:
+		void AdvanceSegment();
+
+		GLuint		m_buffer = 0;
+		uint8_t*	m_mapped = nullptr;
+		uint32_t	m_segmentSize = 0;
+		uint32_t	m_alignment = 256;
+		int			m_segment = 0;
+		uint32_t	m_head = 0;			// offset in the current segment
+		uint32_t	m_generation = 0;
+		GLsync		m_fences[kSegmentCount] = {};
+	};
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "../FishEngine.hpp"
+#include "../ReflectClass.hpp"
+#include "../GLEnvironment.hpp"
+
+namespace FishEngine
+{
+	// How a vertex attribute is stored in the vertex buffer.
+	enum class VertexAttributeFormat : uint8_t
+	{
+		Float32,			// GL_FLOAT
+		Float16,			// GL_HALF_FLOAT
+		SNorm2_10_10_10,	// GL_INT_2_10_10_10_REV, normalized to [-1, 1], 4 components in 4 bytes
+		UNorm8,				// GL_UNSIGNED_BYTE, normalized to [0, 1]
+		UInt8,				// GL_UNSIGNED_BYTE, integer attribute (glVertexAttribIPointer)
+		UInt16,				// GL_UNSIGNED_SHORT, integer attribute
+	};
+
+	struct VertexAttributeDescriptor
+	{
+		GLuint                  location;		// PositionIndex, NormalIndex...
+		VertexAttributeFormat   format;
+		int                     dimension;
+		uint32_t                offset;			// from the start of the vertex
+	};
+
+	// The attributes of one interleaved vertex buffer.
+	class FE_EXPORT Meta(NonSerializable) VertexLayout
+	{
+	public:
+		VertexLayout() = default;
+
+		// Append an attribute, the offset is kept 4-byte aligned.
+		void Add(GLuint location, VertexAttributeFormat format, int dimension);
+
+		// size of one vertex in bytes
+		uint32_t stride() const
+		{
+			return m_stride;
+		}
+
+		std::vector<VertexAttributeDescriptor> const & attributes() const
+		{
+			return m_attributes;
+		}
+
+		// nullptr if there is no attribute at location
+		VertexAttributeDescriptor const * Find(GLuint location) const;
+
+		// Point and enable every attribute at the buffer bound to GL_ARRAY_BUFFER, the vertices start at baseOffset.
+		void Apply(GLintptr baseOffset = 0) const;
+
+		// Point the per-instance MATRIX_M and MATRIX_IT_M attributes at the buffer bound to GL_ARRAY_BUFFER,
+		// column-major pairs of matrices starting at offset.
+		static void ApplyInstanceMatrices(GLintptr offset);
+
+		// Disable the instance attributes and reset their divisors, after the instanced draws: the vertex array
+		// is shared by every mesh of its layout and must not keep pointing at the instance buffer.
+		static void ResetInstanceMatrices();
+
+		// Encode count values of srcDimension floats (srcStride bytes apart) into the attribute at location of
+		// count vertices. Missing components are 0; Float16/UNorm8/SNorm2_10_10_10 are rounded to the nearest value.
+		void Write(void* vertices, GLuint location, const float* src, int srcDimension, std::size_t srcStride, uint32_t count) const;
+
+		// Copy count integers per vertex into an integer attribute.
+		void WriteInt(void* vertices, GLuint location, const int* src, std::size_t srcStride, uint32_t count) const;
+
+		static uint32_t SizeOf(VertexAttributeFormat format, int dimension);
+
+		bool operator==(VertexLayout const & rhs) const;
+
+		bool operator!=(VertexLayout const & rhs) const
+		{
+			return !(*this == rhs);
+		}
+
+	private:
+		std::vector<VertexAttributeDescriptor>  m_attributes;
+		uint32_t                                m_stride = 0;
+	};
+}
@@ -16,6 +16,12 @@ namespace FishEngine
 
 		static void Render();
 
+		// The number of Render calls so far, the current one included.
+		static uint32_t frameCount()
+		{
+			return s_frameCount;
+		}
+
 		static void Clean();
 
 		static void ResizeBufferSize(const int width, const int height);
@@ -35,6 +41,9 @@ namespace FishEngine
 		//static ColorBufferPtr   m_blurredScreenShadowMap;
 		//static RenderTargetPtr  m_blurScreenShadowMapRenderTarget1;
 		//static RenderTargetPtr  m_blurScreenShadowMapRenderTarget2;
+
+	private:
+		static uint32_t			s_frameCount;
 	};
 }
 
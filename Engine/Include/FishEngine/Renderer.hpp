@@ -4,6 +4,7 @@
 #include "Component.hpp"
 #include "Material.hpp"
 #include "Bounds.hpp"
+#include "Render/RendererRegistry.hpp"
 
 namespace FishEngine
 {
@@ -33,6 +34,7 @@ namespace FishEngine
 		void AddMaterial(MaterialPtr material)
 		{
 			m_materials.push_back(material);
+			RendererRegistry::SetStateDirty(*this);
 		}
 
 		MaterialPtr material() const
@@ -40,11 +42,17 @@ namespace FishEngine
 			return m_materials.size() > 0 ? m_materials[0] : nullptr;
 		}
 
-		std::vector<MaterialPtr>& materials()
+		std::vector<MaterialPtr> const & materials() const
 		{
 			return m_materials;
 		}
 
+		void SetMaterials(std::vector<MaterialPtr> const & materials)
+		{
+			m_materials = materials;
+			RendererRegistry::SetStateDirty(*this);
+		}
+
 		void SetMaterial(MaterialPtr material)
 		{
 			//m_materials.clear();
@@ -52,6 +60,7 @@ namespace FishEngine
 				m_materials.push_back(material);
 			else
 				m_materials[0] = material;
+			RendererRegistry::SetStateDirty(*this);
 		}
 
 		virtual Bounds localBounds() const = 0;
@@ -67,6 +76,7 @@ namespace FishEngine
 		void setEnabled(bool enabled)
 		{
 			m_enabled = enabled;
+			RendererRegistry::SetStateDirty(*this);
 		}
 
 		//virtual void OnInspectorGUI() override;
@@ -80,6 +90,7 @@ namespace FishEngine
 		void setShadowCastingMode(ShadowCastingMode shadowCastingMode)
 		{
 			m_shadowCastingMode = shadowCastingMode;
+			RendererRegistry::SetStateDirty(*this);
 		}
 		
 		void setReceiveShadows(bool value)
@@ -90,11 +101,16 @@ namespace FishEngine
 	protected:
 		friend class FishEditor::Inspector;
 		friend class FishEditor::EditorGUI;
+		friend class RendererRegistry;
 		bool m_enabled = true;	// Makes the rendered 3D object visible if enabled.
 		std::vector<MaterialPtr> m_materials;
 
 		ShadowCastingMode	m_shadowCastingMode = ShadowCastingMode::On;
 		bool				m_receiveShadows = true;
+
+		// index in RendererRegistry::s_renderers, -1 if not in the registry
+		Meta(NonSerializable)
+		int32_t				m_registryIndex = -1;
 	};
 }
 
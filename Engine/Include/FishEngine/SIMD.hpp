@@ -0,0 +1,389 @@
+#pragma once
+
+// 4-wide float vectors for the math core (Matrix4x4, Quaternion) and the batch loops built on it
+// (culling, skinning, bone palettes).
+// Backends: SSE (x86/x64, FMA when the compiler targets FMA; on MSVC, /arch:AVX2), NEON (AArch64), or plain floats.
+// Define FISHENGINE_SIMD_DISABLE to force the plain float backend.
+//
+// FISHENGINE_SIMD is 1 with a vector backend; code that has a better scalar formulation (early-outs, no lane
+// shuffles) uses it to choose, everything else just uses float4.
+
+#if !defined(FISHENGINE_SIMD_DISABLE) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#	define FISHENGINE_SIMD_SSE 1
+#	include <xmmintrin.h>
+#	if defined(__FMA__) || (defined(_MSC_VER) && defined(__AVX2__))	// GCC/Clang: -mavx2 does not imply -mfma
+#		define FISHENGINE_SIMD_FMA 1
+#		include <immintrin.h>
+#	endif
+#elif !defined(FISHENGINE_SIMD_DISABLE) && (defined(__aarch64__) || defined(_M_ARM64))
+#	define FISHENGINE_SIMD_NEON 1
+#	include <arm_neon.h>
+#endif
+
+#ifndef FISHENGINE_SIMD_SSE
+#	define FISHENGINE_SIMD_SSE 0
+#endif
+#ifndef FISHENGINE_SIMD_FMA
+#	define FISHENGINE_SIMD_FMA 0
+#endif
+#ifndef FISHENGINE_SIMD_NEON
+#	define FISHENGINE_SIMD_NEON 0
+#endif
+#define FISHENGINE_SIMD (FISHENGINE_SIMD_SSE || FISHENGINE_SIMD_NEON)
+
+#include <cmath>
+
+namespace FishEngine
+{
+	namespace SIMD
+	{
+#if FISHENGINE_SIMD_SSE
+		typedef __m128 float4;
+#elif FISHENGINE_SIMD_NEON
+		typedef float32x4_t float4;
+#else
+		struct float4
+		{
+			float v[4];
+		};
+#endif
+
+		// unaligned
+		inline float4 Load(const float* p)
+		{
+#if FISHENGINE_SIMD_SSE
+			return _mm_loadu_ps(p);
+#elif FISHENGINE_SIMD_NEON
+			return vld1q_f32(p);
+#else
+			return { { p[0], p[1], p[2], p[3] } };
+#endif
+		}
+
+		// (p[0], p[1], p[2], 0), reads 3 floats only
+		inline float4 Load3(const float* p)
+		{
+#if FISHENGINE_SIMD_SSE
+			const __m128 xy = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(p));
+			return _mm_movelh_ps(xy, _mm_load_ss(p + 2));
+#elif FISHENGINE_SIMD_NEON
+			return vcombine_f32(vld1_f32(p), vset_lane_f32(p[2], vdup_n_f32(0), 0));
+#else
+			return { { p[0], p[1], p[2], 0 } };
+#endif
+		}
+
+		inline void Store(float* p, float4 v)
+		{
+#if FISHENGINE_SIMD_SSE
+			_mm_storeu_ps(p, v);
+#elif FISHENGINE_SIMD_NEON
+			vst1q_f32(p, v);
+#else
+			for (int i = 0; i < 4; ++i)
+				p[i] = v.v[i];
+#endif
+		}
+
+		// writes 3 floats only
+		inline void Store3(float* p, float4 v)
+		{
+#if FISHENGINE_SIMD_SSE
+			_mm_storel_pi(reinterpret_cast<__m64*>(p), v);
+			_mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+#elif FISHENGINE_SIMD_NEON
+			vst1_f32(p, vget_low_f32(v));
+			vst1q_lane_f32(p + 2, v, 2);
+#else
+			for (int i = 0; i < 3; ++i)
+				p[i] = v.v[i];
+#endif
+		}
+
+		inline float4 Set(float x, float y, float z, float w)
+		{
+#if FISHENGINE_SIMD_SSE
+			return _mm_setr_ps(x, y, z, w);
+#elif FISHENGINE_SIMD_NEON
+			const float v[4] = { x, y, z, w };
+			return vld1q_f32(v);
+#else
+			return { { x, y, z, w } };
+#endif
+		}
+
+		inline float4 Splat(float f)
+		{
+#if FISHENGINE_SIMD_SSE
+			return _mm_set1_ps(f);
+#elif FISHENGINE_SIMD_NEON
+			return vdupq_n_f32(f);
+#else
+			return { { f, f, f, f } };
+#endif
+		}
+
+		inline float4 Zero()
+		{
+#if FISHENGINE_SIMD_SSE
+			return _mm_setzero_ps();
+#else
+			return Splat(0.0f);
+#endif
+		}
+
+		inline float GetX(float4 v)
+		{
+#if FISHENGINE_SIMD_SSE
+			return _mm_cvtss_f32(v);
+#elif FISHENGINE_SIMD_NEON
+			return vgetq_lane_f32(v, 0);
+#else
+			return v.v[0];
+#endif
+		}
+
+		inline float4 Add(float4 a, float4 b)
+		{
+#if FISHENGINE_SIMD_SSE
+			return _mm_add_ps(a, b);
+#elif FISHENGINE_SIMD_NEON
+			return vaddq_f32(a, b);
+#else
+			float4 r;
+			for (int i = 0; i < 4; ++i)
+				r.v[i] = a.v[i] + b.v[i];
+			return r;
+#endif
+		}
+
+		inline float4 Sub(float4 a, float4 b)
+		{
+#if FISHENGINE_SIMD_SSE
+			return _mm_sub_ps(a, b);
+#elif FISHENGINE_SIMD_NEON
+			return vsubq_f32(a, b);
+#else
+			float4 r;
+			for (int i = 0; i < 4; ++i)
+				r.v[i] = a.v[i] - b.v[i];
+			return r;
+#endif
+		}
+
+		inline float4 Mul(float4 a, float4 b)
+		{
+#if FISHENGINE_SIMD_SSE
+			return _mm_mul_ps(a, b);
+#elif FISHENGINE_SIMD_NEON
+			return vmulq_f32(a, b);
+#else
+			float4 r;
+			for (int i = 0; i < 4; ++i)
+				r.v[i] = a.v[i] * b.v[i];
+			return r;
+#endif
+		}
+
+		inline float4 Div(float4 a, float4 b)
+		{
+#if FISHENGINE_SIMD_SSE
+			return _mm_div_ps(a, b);
+#elif FISHENGINE_SIMD_NEON
+			return vdivq_f32(a, b);
+#else
+			float4 r;
+			for (int i = 0; i < 4; ++i)
+				r.v[i] = a.v[i] / b.v[i];
+			return r;
+#endif
+		}
+
+		inline float4 Min(float4 a, float4 b)
+		{
+#if FISHENGINE_SIMD_SSE
+			return _mm_min_ps(a, b);
+#elif FISHENGINE_SIMD_NEON
+			return vminq_f32(a, b);
+#else
+			float4 r;
+			for (int i = 0; i < 4; ++i)
+				r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+			return r;
+#endif
+		}
+
+		inline float4 Max(float4 a, float4 b)
+		{
+#if FISHENGINE_SIMD_SSE
+			return _mm_max_ps(a, b);
+#elif FISHENGINE_SIMD_NEON
+			return vmaxq_f32(a, b);
+#else
+			float4 r;
+			for (int i = 0; i < 4; ++i)
+				r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+			return r;
+#endif
+		}
+
+		// a * b + c
+		inline float4 MulAdd(float4 a, float4 b, float4 c)
+		{
+#if FISHENGINE_SIMD_FMA
+			return _mm_fmadd_ps(a, b, c);
+#elif FISHENGINE_SIMD_NEON
+			return vfmaq_f32(c, a, b);
+#else
+			return Add(Mul(a, b), c);
+#endif
+		}
+
+		// c - a * b
+		inline float4 NegMulAdd(float4 a, float4 b, float4 c)
+		{
+#if FISHENGINE_SIMD_FMA
+			return _mm_fnmadd_ps(a, b, c);
+#elif FISHENGINE_SIMD_NEON
+			return vfmsq_f32(c, a, b);
+#else
+			return Sub(c, Mul(a, b));
+#endif
+		}
+
+		inline float4 Abs(float4 v)
+		{
+#if FISHENGINE_SIMD_SSE
+			return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+#elif FISHENGINE_SIMD_NEON
+			return vabsq_f32(v);
+#else
+			return { { std::fabs(v.v[0]), std::fabs(v.v[1]), std::fabs(v.v[2]), std::fabs(v.v[3]) } };
+#endif
+		}
+
+		inline float4 Sqrt(float4 v)
+		{
+#if FISHENGINE_SIMD_SSE
+			return _mm_sqrt_ps(v);
+#elif FISHENGINE_SIMD_NEON
+			return vsqrtq_f32(v);
+#else
+			return { { std::sqrt(v.v[0]), std::sqrt(v.v[1]), std::sqrt(v.v[2]), std::sqrt(v.v[3]) } };
+#endif
+		}
+
+		// all bits set in the lanes where a < b; only the sign bit is meaningful with the plain float backend
+		inline float4 CmpLt(float4 a, float4 b)
+		{
+#if FISHENGINE_SIMD_SSE
+			return _mm_cmplt_ps(a, b);
+#elif FISHENGINE_SIMD_NEON
+			return vreinterpretq_f32_u32(vcltq_f32(a, b));
+#else
+			float4 r;
+			for (int i = 0; i < 4; ++i)
+				r.v[i] = a.v[i] < b.v[i] ? -1.0f : 0.0f;
+			return r;
+#endif
+		}
+
+		inline float4 Or(float4 a, float4 b)
+		{
+#if FISHENGINE_SIMD_SSE
+			return _mm_or_ps(a, b);
+#elif FISHENGINE_SIMD_NEON
+			return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+#else
+			float4 r;
+			for (int i = 0; i < 4; ++i)
+				r.v[i] = std::signbit(a.v[i]) || std::signbit(b.v[i]) ? -1.0f : 0.0f;
+			return r;
+#endif
+		}
+
+		// bit i is the sign bit of lane i
+		inline int MoveMask(float4 v)
+		{
+#if FISHENGINE_SIMD_SSE
+			return _mm_movemask_ps(v);
+#elif FISHENGINE_SIMD_NEON
+			const uint32x4_t sign = vshrq_n_u32(vreinterpretq_u32_f32(v), 31);
+			return static_cast<int>(vgetq_lane_u32(sign, 0) | (vgetq_lane_u32(sign, 1) << 1) |
+				(vgetq_lane_u32(sign, 2) << 2) | (vgetq_lane_u32(sign, 3) << 3));
+#else
+			int mask = 0;
+			for (int i = 0; i < 4; ++i)
+				mask |= std::signbit(v.v[i]) ? (1 << i) : 0;
+			return mask;
+#endif
+		}
+
+		// (a[a0], a[a1], b[b0], b[b1]), the lane order of _mm_shuffle_ps
+		template<int a0, int a1, int b0, int b1>
+		inline float4 Shuffle(float4 a, float4 b)
+		{
+#if FISHENGINE_SIMD_SSE
+			return _mm_shuffle_ps(a, b, _MM_SHUFFLE(b1, b0, a1, a0));
+#elif FISHENGINE_SIMD_NEON
+			float32x4_t r = vdupq_n_f32(vgetq_lane_f32(a, a0));
+			r = vsetq_lane_f32(vgetq_lane_f32(a, a1), r, 1);
+			r = vsetq_lane_f32(vgetq_lane_f32(b, b0), r, 2);
+			return vsetq_lane_f32(vgetq_lane_f32(b, b1), r, 3);
+#else
+			return { { a.v[a0], a.v[a1], b.v[b0], b.v[b1] } };
+#endif
+		}
+
+		// (v[i0], v[i1], v[i2], v[i3])
+		template<int i0, int i1, int i2, int i3>
+		inline float4 Swizzle(float4 v)
+		{
+			return Shuffle<i0, i1, i2, i3>(v, v);
+		}
+
+		// v[i] in all lanes
+		template<int i>
+		inline float4 Broadcast(float4 v)
+		{
+#if FISHENGINE_SIMD_NEON
+			return vdupq_laneq_f32(v, i);
+#else
+			return Swizzle<i, i, i, i>(v);
+#endif
+		}
+
+		// dot(a, b) in all lanes
+		inline float4 Dot4(float4 a, float4 b)
+		{
+#if FISHENGINE_SIMD_NEON
+			return vdupq_n_f32(vaddvq_f32(vmulq_f32(a, b)));
+#else
+			float4 m = Mul(a, b);
+			m = Add(m, Swizzle<1, 0, 3, 2>(m));
+			return Add(m, Swizzle<2, 3, 0, 1>(m));
+#endif
+		}
+
+		// the rows become the columns
+		inline void Transpose(float4 & r0, float4 & r1, float4 & r2, float4 & r3)
+		{
+#if FISHENGINE_SIMD_SSE
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+#elif FISHENGINE_SIMD_NEON
+			const float32x4x2_t t01 = vtrnq_f32(r0, r1);
+			const float32x4x2_t t23 = vtrnq_f32(r2, r3);
+			r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+			r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+			r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+			r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+#else
+			const float4 t0 = r0, t1 = r1, t2 = r2, t3 = r3;
+			r0 = { { t0.v[0], t1.v[0], t2.v[0], t3.v[0] } };
+			r1 = { { t0.v[1], t1.v[1], t2.v[1], t3.v[1] } };
+			r2 = { { t0.v[2], t1.v[2], t2.v[2], t3.v[2] } };
+			r3 = { { t0.v[3], t1.v[3], t2.v[3], t3.v[3] } };
+#endif
+		}
+	}
+}
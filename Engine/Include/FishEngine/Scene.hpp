@@ -3,6 +3,7 @@
 
 #include "FishEngine.hpp"
 #include "Bounds.hpp"
+#include "Render/RendererRegistry.hpp"
 #include <utility>
 
 namespace FishEngine
@@ -160,6 +161,7 @@ namespace FishEngine
 		static void AddGameObject(GameObjectPtr const & go)
 		{
 			m_gameObjects.push_back(go);
+			RendererRegistry::OnHierarchyChanged(go);
 		}
 
 	private:
@@ -249,6 +249,10 @@ namespace FishEngine
 		virtual void EndNVP() = 0;
 		virtual void NameOfNVP(const char* name) = 0;
 		virtual void MiddleOfNVP() = 0;
+
+	public:
+		// the current class has a value with this name
+		virtual bool HasNVP(const char* name) = 0;
 	};
 
 	
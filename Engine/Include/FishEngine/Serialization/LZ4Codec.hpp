@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "../FishEngine.hpp"
+#include "../ReflectClass.hpp"
+
+namespace FishEngine
+{
+	// LZ4 block format (no frame header), cheap to decode.
+	// see: https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+	class FE_EXPORT Meta(NonSerializable) LZ4Codec
+	{
+	public:
+		LZ4Codec() = delete;
+
+		// worst case size of the compressed data
+		static std::size_t CompressBound(std::size_t size)
+		{
+			return size + size / 255 + 16;
+		}
+
+		// Compress size bytes of src into dst, which holds at least CompressBound(size) bytes.
+		// Returns the compressed size.
+		static std::size_t Compress(const uint8_t* src, std::size_t size, uint8_t* dst);
+
+		// Returns false if src is corrupted or does not decode to exactly dstSize bytes.
+		static bool Decompress(const uint8_t* src, std::size_t srcSize, uint8_t* dst, std::size_t dstSize);
+	};
+}
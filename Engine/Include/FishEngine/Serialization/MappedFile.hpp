@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "../FishEngine.hpp"
+#include "../ReflectClass.hpp"
+#include "../Path.hpp"
+
+namespace FishEngine
+{
+	// A whole file mapped read-only into memory, pages are read by the OS on first access.
+	class FE_EXPORT Meta(NonSerializable) MappedFile
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		// noncopyable
+		MappedFile(const MappedFile&) = delete;
+		void operator=(const MappedFile&) = delete;
+
+		// false if the file can not be opened or is empty
+		bool Open(Path const & path);
+
+		void Close();
+
+		bool isOpen() const
+		{
+			return m_data != nullptr;
+		}
+
+		const uint8_t* data() const
+		{
+			return m_data;
+		}
+
+		std::size_t size() const
+		{
+			return m_size;
+		}
+
+	private:
+		const uint8_t*	m_data = nullptr;
+		std::size_t		m_size = 0;
+#if FISHENGINE_PLATFORM_WINDOWS
+		void*			m_mapping = nullptr;	// HANDLE
+#endif
+	};
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "../FishEngine.hpp"
+#include "../ReflectClass.hpp"
+#include "../Path.hpp"
+
+namespace FishEngine
+{
+	enum class MeshFileCompression : uint32_t
+	{
+		None,		// sections are used in place from the mapped file
+		LZ4,		// byte-shuffled and LZ4 compressed, smaller on disk but decoded on load
+	};
+
+	struct MeshFileOptions
+	{
+		MeshFileCompression compression = MeshFileCompression::None;
+
+		// also store the float vertex attributes and bone weights, so the loaded mesh can be read on the CPU
+		// (Mesh::vertices(), colliders, reimport). Only the GPU buffers are stored otherwise.
+		bool readable = false;
+	};
+
+	// Vertex and index buffers already encoded as Mesh::UploadMeshData uploads them.
+	// storage owns the memory, e.g. the mapped mesh file.
+	struct MeshBufferData
+	{
+		std::shared_ptr<const void>	storage;
+		const void*					vertices = nullptr;
+		std::size_t					verticesSize = 0;
+		const void*					indices = nullptr;
+		std::size_t					indicesSize = 0;
+	};
+
+	// Versioned binary mesh container (.mesh), little-endian:
+	//   header | section table | sections, each aligned to 16 bytes
+	// The header holds the counts and the bounds. The sections hold the interleaved vertex buffer and its
+	// VertexLayout, the index buffer (16-bit when it fits), submesh offsets, skinning data and, optionally, the
+	// float attribute streams. Uncompressed files are memory mapped and the buffers are handed to glBufferData
+	// without being copied; sections of other versions are rejected.
+	class FE_EXPORT Meta(NonSerializable) MeshFile
+	{
+	public:
+		MeshFile() = delete;
+
+		static constexpr uint32_t kVersion = 1;
+
+		// false if the mesh is not readable (already uploaded) or the file can not be written.
+		static bool Save(Mesh const & mesh, Path const & path, MeshFileOptions const & options = MeshFileOptions());
+
+		// nullptr if the file is missing, truncated or of another version.
+		static MeshPtr Load(Path const & path);
+	};
+}
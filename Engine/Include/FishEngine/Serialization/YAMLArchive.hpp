@@ -158,6 +158,13 @@ namespace FishEngine
 
 		}
 
+	public:
+		virtual bool HasNVP(const char* name) override
+		{
+			auto const & current = CurrentNode();
+			return current.IsMap() && current[name];
+		}
+
 	protected:
 
 		static void Convert(YAML::Node const & node, std::string & t)
@@ -11,10 +11,12 @@
 #include "Resources.hpp"
 #include "Render/Shader/ShaderBlendFactor.hpp"
 #include "Render/Shader/ShaderLabProperties.hpp"
+#include "Render/Shader/ShaderCompileError.hpp"
 
 namespace FishEngine
 {
 	class ShaderImpl;
+	class ShaderCompiler;
 
 	class FE_EXPORT Shader : public Object
 	{
@@ -33,9 +35,41 @@ namespace FishEngine
 
 		static ShaderPtr CreateFromFile(const Path& path);
 
+		// Create a shader from the output of compiler.Preprocess(), nullptr on errors.
+		// Preprocessing can run on any thread, the shader is created on the GL thread.
+		// The errors are appended to diagnostics when it is not null.
+		static ShaderPtr CreateFromPreprocessed(ShaderCompiler const & compiler, std::string const & parsedShaderText,
+			std::vector<ShaderDiagnostic>* diagnostics = nullptr);
+
 		void Use() noexcept;
 
+		// Compile and link a variant now instead of at its first Use(), false if it exists already.
+		bool Warmup(ShaderKeywords keywords);
+
+		// The errors of the variants compiled so far.
+		std::vector<ShaderDiagnostic> const & diagnostics() const
+		{
+			return m_diagnostics;
+		}
+
+		// The keywords the source tests with #if/#ifdef (outside comments and "#if 0" blocks),
+		// every subset of them is a distinct variant.
+		ShaderKeywords variantKeywords() const;
+
+		// Compile every variant of every loaded shader (builtin, imported or created from preprocessed text),
+		// e.g. behind a loading screen.
+		static void WarmupAllShaders();
+
+		// Unique id of a property name, the same for every shader and material during the lifetime of the program.
+		// The overloads taking an id do no string work, cache the id of names that are used every frame.
+		static int PropertyToID(const std::string& name);
+		static const std::string& PropertyIDToName(int nameID);
+
 		bool HasUniform(const std::string& name);
+		bool HasUniform(int nameID);
+
+		// index of the uniform in uniforms(), -1 if the current variant does not use it
+		int FindUniform(int nameID) const;
 
 		//GLuint getAttribLocation(const char* name) const;
 
@@ -44,10 +78,13 @@ namespace FishEngine
 		//void BindUniformMat3(const char* name, const glm::mat3& value) const;
 		void BindUniformVec4(const char* name, const Vector4& value);
 		void BindUniformMat4(const char* name, const Matrix4x4& value);
+		void BindUniformVec4(int nameID, const Vector4& value);
+		void BindUniformMat4(int nameID, const Matrix4x4& value);
 
 		//void BindUniformTexture(const char* name, const GLuint texture, const GLuint id, GLenum textureType = GL_TEXTURE_2D) const;
 
 		void BindMatrixArray(const std::string& name, const std::vector<Matrix4x4>& matrixArray);
+		void BindMatrixArray(int nameID, const std::vector<Matrix4x4>& matrixArray);
 		void BindUniforms(const ShaderUniforms& uniforms);
 
 		void BindTexture(const std::string& name, TexturePtr texture);
@@ -68,6 +105,12 @@ namespace FishEngine
 			return m_uniforms;
 		}
 
+		// size in bytes of the "MaterialUniforms" block of the current variant, 0 if it has none
+		int materialBlockSize() const
+		{
+			return m_materialBlockSize;
+		}
+
 
 		static const std::map<std::string, ShaderPtr>& allShaders()
 		{
@@ -85,6 +128,19 @@ namespace FishEngine
 			return m_deferred;
 		}
 
+		// "@instancing on", surface shaders support it by default
+		bool SupportsInstancing() const
+		{
+			return m_instancing;
+		}
+
+		// "@lodfade on", set by including LODFade.inc: the fragment shader calls LODFadeClip(), surface shaders do.
+		// The others switch LODs without cross-fading.
+		bool SupportsLODFade() const
+		{
+			return m_lodFade;
+		}
+
 		bool IsKeywordEnabled(ShaderKeyword keyword)
 		{
 			return (m_keywords & static_cast<ShaderKeywords>(keyword)) != 0;
@@ -106,6 +162,18 @@ namespace FishEngine
 	private:
 		friend class Material;
 		friend class RenderSystem;
+		friend class ShaderVariantCollection;
+
+		// Start compiling a variant without waiting for the driver, see ShaderVariantCollection::WarmupProgressive.
+		// false if the variant exists already or is being compiled.
+		bool BeginWarmup(ShaderKeywords keywords);
+
+		// Finish the started variants that the driver is done with (all of them if wait is true).
+		// true if none is left.
+		bool EndWarmup(bool wait);
+
+		// the variant is compiled and linked
+		bool HasVariant(ShaderKeywords keywords) const;
 
 		Meta(NonSerializable)
 		std::unique_ptr<ShaderImpl> m_impl;
@@ -113,17 +181,30 @@ namespace FishEngine
 		//void GetAllUniforms();
 		bool FromFile(const Path& path);
 
+		// throws on invalid settings
+		void FromPreprocessed(ShaderCompiler const & compiler, std::string const & parsedShaderText);
+
 		void PrintErrorMessage(std::string const & errorMessage) noexcept;
 
+		Meta(NonSerializable)
+		std::vector<ShaderDiagnostic> m_diagnostics;
+
 		// cache
 		Meta(NonSerializable)
 		unsigned int m_GLNativeProgram = 0;
 		std::vector<UniformInfo> m_uniforms;
+		Meta(NonSerializable)
+		int m_materialBlockSize = 0;
 
 		Cullface    m_cullface = Cullface::Back;
 		bool        m_ZWrite = true;
 		bool        m_blend = false;
 		bool        m_deferred = false;
+		bool        m_instancing = false;
+		Meta(NonSerializable)
+		bool        m_lodFade = false;
+		Meta(NonSerializable)
+		ShaderKeywords m_variantKeywords = 0;
 		int					m_blendFactorCount = 0;
 
 		Meta(NonSerializable)
@@ -135,6 +216,9 @@ namespace FishEngine
 		ShaderKeywords m_keywords = static_cast<ShaderKeywords>(ShaderKeyword::None);
 
 		static std::map<std::string, ShaderPtr> m_builtinShaders;
+
+		// every shader created successfully, for WarmupAllShaders. Released shaders expire.
+		static std::vector<std::weak_ptr<Shader>> s_loadedShaders;
 	};
 }
 
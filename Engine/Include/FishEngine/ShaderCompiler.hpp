@@ -1,5 +1,11 @@
 #pragma once
 
+#include <ctime>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <boost/utility/string_view.hpp>
+
 #include "FishEngine.hpp"
 #include "Resources.hpp"
 #include "Macro.hpp"
@@ -47,8 +53,12 @@ namespace FishEngine
 	public:
 		Path m_path;
 		uint32_t m_includeDepth = 0;
-		// absolute path to preprocessed text
-		static std::map<std::string, std::string> s_cachedHeaders;
+
+		// absolute path and last write time of every header the shader includes, directly or not
+		std::vector<std::pair<std::string, std::time_t>> m_dependencies;
+
+		// the macros tested by #if, #ifdef, #ifndef and #elif, except in comments and in "#if 0" blocks
+		std::set<std::string> m_testedMacros;
 
 		ShaderCompiler(const Path& shaderFilePath)
 			: m_path(shaderFilePath)
@@ -65,21 +75,40 @@ namespace FishEngine
 			s_shaderIncludeDir = path;
 		}
 
+		// Headers are preprocessed once per process and shared by all ShaderCompilers (on any thread);
+		// an entry is used again as long as the header and the headers it includes have the same last write time.
+		// Clear it to measure a cold start.
+		static void ClearIncludeCache();
+
 	private:
 
 		std::string PreprocessShaderFile(const Path& path);
 
+		// append the preprocessed header, from the include cache if possible
+		void AppendHeader(const Path& path, std::string& parsed);
+
 		std::string PreprocessImpl(
-			const std::string&  shaderText,
+			boost::string_view  shaderText,
 			const Path&         localDir);
 
+		// record the macros of a conditional directive, line is the directive up to the end of the line
+		void ParseConditional(boost::string_view line);
+
 		std::string parseSubShader(
-			const std::string&  shaderText,
+			boost::string_view  shaderText,
 			size_t&             cursor,
 			const std::string&  str,
 			const Path&         localDir);
 
 		friend class FishEditor::EditorResources;
 		static Path s_shaderIncludeDir;
+
+		// one entry per open conditional: 0 active, 1 "#if 0" until its #else, 2 inside an inactive one
+		std::vector<uint8_t> m_conditionals;
+
+		bool InActiveCode() const
+		{
+			return std::count(m_conditionals.begin(), m_conditionals.end(), 0) == static_cast<std::ptrdiff_t>(m_conditionals.size());
+		}
 	};
 }
@@ -6,6 +6,7 @@
 #include "Vector4.hpp"
 #include "GLEnvironment.hpp"
 #include "Common.hpp"
+#include "ReflectClass.hpp"
 
 namespace FishEngine
 {
@@ -22,9 +23,19 @@ namespace FishEngine
 	{
 		GLenum      type; // type of the variable (float, vec3 or mat4, etc)
 		std::string name;  // variable name in GLSL
-		GLuint      location;
+		Meta(NonSerializable)
+		int         nameID;	// Shader::PropertyToID(name), "[0]" of arrays stripped
+		GLuint      location;	// GL_INVALID_INDEX for members of the MaterialUniforms block
 		int         textureBindPoint;
 		bool        binded;
+
+		// MaterialUniforms block members: byte offset in the block, -1 otherwise
+		Meta(NonSerializable)
+		int         blockOffset = -1;
+		Meta(NonSerializable)
+		int         matrixStride = 0;
+		Meta(NonSerializable)
+		bool        rowMajor = false;
 	};
 
 	//struct UniformTextureInfo
@@ -41,7 +52,8 @@ namespace FishEngine
 		None = 0,
 		//SkinnedAnimation = 1,
 		AmbientIBL = 2,
-		All = AmbientIBL // | SkinnedAnimation,
+		Instancing = 4,		// per-instance MATRIX_M / MATRIX_IT_M from vertex attributes, see Graphics::DrawMeshInstanced
+		All = AmbientIBL | Instancing // | SkinnedAnimation,
 	};
 
 	typedef std::uint32_t ShaderKeywords;
@@ -2,6 +2,7 @@
 #define mat4 FishEngine::Matrix4x4
 #define vec3 FishEngine::Vector3
 #define vec4 FishEngine::Vector4
+#define mat3x4 FishEngine::AffineMatrix
 
 constexpr int PositionIndex = 0;
 constexpr int NormalIndex = 1;
@@ -9,6 +10,8 @@ constexpr int TangentIndex = 2;
 constexpr int UVIndex = 3;
 constexpr int BoneIndexIndex = 4;
 constexpr int BoneWeightIndex = 5;
+constexpr int InstanceMatrixIndex = 6;		// 6-9, columns of the per-instance MATRIX_M
+constexpr int InstanceMatrixITIndex = 10;	// 10-13, columns of the per-instance MATRIX_IT_M
 
 struct PerCameraUniforms
 {
@@ -60,6 +63,7 @@ struct PerDrawUniforms
 	mat4 MATRIX_IT_MV;
 	mat4 MATRIX_M;		// ObjectToWorld
 	mat4 MATRIX_IT_M;   // WorldToObject
+	vec4 LODFade;		// x: visibility of the draw while cross-fading LODs, < 0 for the complementary pattern, 1 when not fading
 };
 
 // layout(std140, row_major) uniform PerFrameUniforms
@@ -85,9 +89,10 @@ struct LightingUniforms
 #define MAX_BONE_SIZE 128
 struct Bones
 {
-	mat4 BoneTransformations[MAX_BONE_SIZE];
+	mat3x4 BoneTransformations[MAX_BONE_SIZE];
 };
 
 #undef mat4
+#undef mat3x4
 #undef vec3
 #undef vec4
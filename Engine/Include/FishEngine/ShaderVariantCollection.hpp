@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Object.hpp"
+#include "ShaderProperty.hpp"
+
+namespace FishEngine
+{
+	// Identifies a specific variant of a shader.
+	struct ShaderVariant
+	{
+		ShaderPtr       shader;
+		ShaderKeywords  keywords = 0;
+
+		bool operator==(ShaderVariant const & rhs) const
+		{
+			return shader == rhs.shader && keywords == rhs.keywords;
+		}
+	};
+
+	// A list of shader variants to compile ahead of their first use, e.g. while a level loads,
+	// so that showing a new material or keyword combination does not stall a frame.
+	class FE_EXPORT ShaderVariantCollection : public Object
+	{
+	public:
+		InjectClassName(ShaderVariantCollection);
+
+		ShaderVariantCollection() = default;
+
+		// Adds a new variant to the collection, false if it is already there.
+		bool Add(ShaderVariant const & variant);
+
+		// Removes a variant from the collection, false if it was not there.
+		bool Remove(ShaderVariant const & variant);
+
+		bool Contains(ShaderVariant const & variant) const;
+
+		void Clear();
+
+		// Number of shaders in this collection.
+		int shaderCount() const;
+
+		// Number of total variants in this collection.
+		int variantCount() const
+		{
+			return static_cast<int>(m_variants.size());
+		}
+
+		// Are all variants in this collection compiled?
+		bool isWarmedUp() const;
+
+		// Compile all variants of this collection now.
+		void Warmup();
+
+		// Compile variants for about timeBudget milliseconds, call it once per frame until it returns true.
+		// With GL_ARB_parallel_shader_compile the driver keeps compiling between the calls.
+		bool WarmupProgressive(float timeBudget);
+
+	private:
+		std::vector<ShaderVariant>  m_variants;
+
+		Meta(NonSerializable)
+		int                         m_warmupCursor = 0;		// the variants before it have been started
+	};
+}
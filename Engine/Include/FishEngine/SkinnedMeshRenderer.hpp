@@ -3,9 +3,19 @@
 
 #include "Renderer.hpp"
 #include "Animator.hpp"
+#include "Animation/AnimationCullingMode.hpp"
+#include "Render/BonePalette.hpp"
 
 namespace FishEngine
 {
+	// Where the vertices of a SkinnedMeshRenderer are skinned.
+	enum class SkinningBackend
+	{
+		Default,	// SkinnedMeshRenderer::defaultSkinningBackend()
+		GPU,		// transform feedback pass of Internal-GPUSkinning, one per renderer
+		CPU,		// CPUSkinning on the worker threads, streamed into a dynamic vertex buffer of the renderer
+	};
+
 	class FE_EXPORT SkinnedMeshRenderer : public Renderer
 	{
 	public:
@@ -15,13 +25,64 @@ namespace FishEngine
 
 		SkinnedMeshRenderer(MaterialPtr material);
 
-		virtual void Update() override;
+		~SkinnedMeshRenderer();
 
 		//virtual void PreRender() const override;
 		//virtual void Render() const override;
 
 		void UpdataAnimation();
 
+		// Skin all renderers for this frame: the GPU ones are submitted first, then the CPU ones are skinned
+		// together on the worker threads while the GPU runs.
+		static void UpdateAnimations(SkinnedMeshRenderer* const * renderers, std::size_t count);
+
+		// Build the palette and the bounds of this frame, called by RendererRegistry::Update.
+		// Skipped for an off-screen renderer with AnimationCullingMode::CullCompletely.
+		void UpdateBounds() const;
+
+		// Point the vertex attributes of the shared mesh at the vertices skinned for this renderer,
+		// call it before drawing the mesh of this renderer.
+		void BindSkinnedVertices() const;
+
+		SkinningBackend skinningBackend() const
+		{
+			return m_skinningBackend;
+		}
+
+		void setSkinningBackend(SkinningBackend backend)
+		{
+			m_skinningBackend = backend;
+		}
+
+		// The backend of the renderers whose skinningBackend is Default (GPU or CPU).
+		static SkinningBackend defaultSkinningBackend()
+		{
+			return s_defaultSkinningBackend;
+		}
+
+		static void setDefaultSkinningBackend(SkinningBackend backend);
+
+		// What to do while the renderer is off-screen.
+		AnimationCullingMode cullingMode() const
+		{
+			return m_cullingMode;
+		}
+
+		void setCullingMode(AnimationCullingMode cullingMode)
+		{
+			m_cullingMode = cullingMode;
+		}
+
+		// Drawn by the camera or into the shadow map in the last rendered frame.
+		bool isVisible() const;
+
+		// Called by the render passes that draw this renderer in the current frame.
+		void MarkVisible();
+
+		// Skin the mesh if it has not been skinned in the current frame, e.g. when it was culled by the camera
+		// but is drawn into the shadow map.
+		void UpdateAnimationIfCulled();
+
 		void setAvatar(AvatarPtr avatar)
 		{
 			m_avatar = avatar;
@@ -33,6 +94,8 @@ namespace FishEngine
 		}
 
 		// AABB of this Skinned Mesh in its local space.
+		// It encloses the spheres around the current bone positions that hold the vertices of each bone
+		// (see Mesh::m_boneBounds), so it follows the animation; the bounds of the mesh if the radii are unknown.
 		virtual Bounds localBounds() const override;
 
 		// The mesh used for skinning.
@@ -44,6 +107,7 @@ namespace FishEngine
 		// The bones used to skin the mesh.
 		std::vector<std::weak_ptr<Transform>> & bones()
 		{
+			m_boneTable.clear();
 			return m_bones;
 		}
 
@@ -75,9 +139,64 @@ namespace FishEngine
 		// same size with sharedMesh.bindposes
 		std::vector<std::weak_ptr<Transform>> m_bones;
 
+		SkinningBackend m_skinningBackend = SkinningBackend::Default;
+
+		AnimationCullingMode m_cullingMode = AnimationCullingMode::AlwaysAnimate;
+
+		// bone * bindpose in the local space of the renderer, built at most once per frame
 		Meta(NonSerializable)
-		mutable std::vector<Matrix4x4> m_matrixPalette;
+		mutable std::vector<AffineMatrix> m_matrixPalette;
 		void UpdateMatrixPalette() const;
+
+		Meta(NonSerializable)
+		mutable uint32_t m_paletteFrame = 0;
+
+		// m_bones resolved to raw pointers (nullptr: expired), valid while the scene structure does not change
+		Meta(NonSerializable)
+		mutable std::vector<Transform*> m_boneTable;
+
+		Meta(NonSerializable)
+		mutable uint32_t m_boneTableVersion = 0;
+
+		void ResolveBones() const;
+
+		// GPU or CPU for this frame; CPU needs the bind pose of the mesh (see Mesh::m_skinningSource)
+		bool UseCPUSkinning() const;
+
+		// the CPU skinned positions, normals and tangents, vertexCount float3 each
+		Meta(NonSerializable)
+		GLuint m_skinnedVertexBuffer = 0;
+
+		Meta(NonSerializable)
+		GLsizeiptr m_skinnedVertexBufferSize = 0;
+
+		// written instead of the mapped buffer when glMapBufferRange fails
+		Meta(NonSerializable)
+		std::vector<float> m_skinnedVertices;
+
+		// skinned by CPUSkinning this frame
+		Meta(NonSerializable)
+		bool m_skinnedOnCPU = false;
+
+		// the local bounds of the palette, set by UpdateMatrixPalette
+		Meta(NonSerializable)
+		mutable Bounds m_skinnedBounds;
+
+		// hash of the palette the skinned vertices were made with, valid if m_skinnedFrame != 0
+		Meta(NonSerializable)
+		uint64_t m_skinnedPaletteHash = 0;
+
+		// RenderSystem::frameCount() of the last skinning and of the last frame it was drawn in
+		Meta(NonSerializable)
+		uint32_t m_skinnedFrame = 0;
+
+		Meta(NonSerializable)
+		uint32_t m_visibleFrame = 0;
+
+		// the skinned vertices of the last skinning are still valid for the current palette
+		bool IsSkinningUpToDate(uint64_t paletteHash) const;
+
+		static SkinningBackend s_defaultSkinningBackend;
 	};
 }
 
@@ -36,7 +36,8 @@ namespace FishEngine
 		{
 			if (!m_uploaded)
 				UploadToGPU();
-			if (m_GLNativeTexture == 0) abort();
+			if (m_GLNativeTexture == 0)
+				return PlaceholderNativeTexture();
 			return m_GLNativeTexture;
 		}
 
@@ -112,6 +113,12 @@ namespace FishEngine
 
 		virtual void UploadToGPU() { m_uploaded = true; };
 
+		// bound instead while there is no GL texture yet, e.g. while it is streamed in
+		virtual unsigned int PlaceholderNativeTexture()
+		{
+			abort();
+		}
+
 		Meta(NonSerializable)
 		mutable bool m_uploaded = false;
 
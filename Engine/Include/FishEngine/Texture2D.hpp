@@ -14,6 +14,8 @@ namespace FishEngine
 
 		Texture2D(int width, int height, TextureFormat format, const uint8_t* data, int byteCount = -1);
 
+		virtual ~Texture2D();
+
 		// The format of the pixel data in the texture (Read Only).
 		TextureFormat format() const
 		{
@@ -30,16 +32,30 @@ namespace FishEngine
 		static Texture2DPtr whiteTexture();
 
 		static Texture2DPtr blackTexture();
-		
+
+		// Bound while the texture is streamed in by TextureStreaming, whiteTexture() when null.
+		Texture2DPtr streamingPlaceholder() const
+		{
+			return m_streamingPlaceholder;
+		}
+
+		void setStreamingPlaceholder(Texture2DPtr const & placeholder)
+		{
+			m_streamingPlaceholder = placeholder;
+		}
 
 	protected:
 
+		// textures of kMinStreamingBytes or more are handed to TextureStreaming when enabled
 		virtual void UploadToGPU() override;
 
+		virtual unsigned int PlaceholderNativeTexture() override;
+
 	protected:
 
 		friend class FishEditor::TextureImporter;
 		friend class FishEditor::DDSImporter;
+		friend class TextureStreaming;
 
 		Meta(NonSerializable)
 		std::vector<std::uint8_t> m_data;
@@ -50,6 +66,11 @@ namespace FishEngine
 		// How many mipmap levels are in this texture (Read Only).
 		uint32_t m_mipmapCount;
 
-		
+		Meta(NonSerializable)
+		Texture2DPtr m_streamingPlaceholder;
+
+		// queued in TextureStreaming, m_GLNativeTexture may hold the previous contents or some of the levels
+		Meta(NonSerializable)
+		bool m_streaming = false;
 	};
 }
@@ -224,6 +224,12 @@ namespace FishEngine
 		}
 
 
+		// changes whenever localToWorldMatrix may have changed.
+		uint32_t version() const
+		{
+			return m_version;
+		}
+
 		uint32_t childCount() const
 		{
 			return (uint32_t)m_children.size();
@@ -370,6 +376,10 @@ namespace FishEngine
 		Meta(NonSerializable)
 		mutable bool				m_isDirty = true;
 
+		// increased every time the world matrix is invalidated, see RendererRegistry
+		Meta(NonSerializable)
+		mutable uint32_t			m_version = 0;
+
 		Meta(NonSerializable)
 		mutable Matrix4x4			m_localToWorldMatrix; // localToWorld
 
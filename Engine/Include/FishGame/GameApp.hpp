@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <FishEngine/ReflectClass.hpp>
 
 struct GLFWwindow;
@@ -11,6 +12,18 @@ namespace FishEngine
 
 	public:
 		FE_EXPORT int Run();
+
+		// Run frameCount frames of the scene without a window on the Null graphics device,
+		// then log the average CPU time of update and render per frame.
+		FE_EXPORT int RunHeadless(int frameCount, int width = 1280, int height = 720);
+
+		// The directory with Engine/Shaders and assets/Models.
+		// Empty by default: the FISHENGINE_ROOT environment variable is used.
+		FE_EXPORT static void setEngineRoot(std::string const & root)
+		{
+			m_engineRoot = root;
+		}
+
 		FE_EXPORT virtual void Init() = 0;
 		FE_EXPORT virtual void Update() = 0;
 		//virtual void Render() = 0;
@@ -25,8 +38,12 @@ namespace FishEngine
 		//static void CharacterCallback(GLFWwindow* window, unsigned int codepoint);
 
 	private:
+		// false if the engine root is not set or misses the shaders or the models
+		bool InitEngine();
+
 		static GLFWwindow*     m_window;
 		static int      m_windowWidth;
 		static int      m_windowHeight;
+		static std::string m_engineRoot;
 	};
 }
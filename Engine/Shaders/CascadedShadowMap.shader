@@ -32,6 +32,9 @@ struct VS_OUT {
 	layout(triangle_strip, max_vertices = 3) out;
 
 	in VS_OUT vs_out[];
+
+	// bit i set: the object overlaps cascade i
+	uniform float CascadeMask = 15;
 	
 	float4 ClipSpaceShadowCasterPos(float4 vertex, float3 normal, float biasScale)
 	{
@@ -78,6 +81,9 @@ struct VS_OUT {
 
 	void main()
 	{
+		if ((int(CascadeMask) & (1 << gl_InvocationID)) == 0)
+			return;
+
 		for (int i = 0; i < gl_in.length(); ++i)
 		{
 		#ifdef SHOWMAP_NO_BIAS
@@ -12,7 +12,7 @@
 	// // column_major: macOS bug
 	// layout(std140, column_major) uniform Bones
 	// {
-	// 	mat4 BoneTransformations[MAX_BONE_SIZE];
+	// 	mat3x4 BoneTransformations[MAX_BONE_SIZE];
 	// };
 
 	out vec3 OutputPosition;
@@ -21,13 +21,13 @@
 
 	void main()
 	{
-		mat4 boneTransformation = BoneTransformations[boneIndex[0]] * boneWeight[0];
+		mat3x4 boneTransformation = BoneTransformations[boneIndex[0]] * boneWeight[0];
 		boneTransformation += BoneTransformations[boneIndex[1]] * boneWeight[1];
 		boneTransformation += BoneTransformations[boneIndex[2]] * boneWeight[2];
 		boneTransformation += BoneTransformations[boneIndex[3]] * boneWeight[3];
-		OutputPosition = (boneTransformation * vec4(InputPositon, 1)).xyz;
-		OutputNormal = mat3(boneTransformation) * InputNormal;
-		OutputTangent = mat3(boneTransformation) * InputTangent;
+		OutputPosition = vec4(InputPositon, 1) * boneTransformation;
+		OutputNormal = vec4(InputNormal, 0) * boneTransformation;
+		OutputTangent = vec4(InputTangent, 0) * boneTransformation;
 	}
 }
 
@@ -21,6 +21,8 @@ struct VS_OUT
 
 @fragment
 {
+	#include <LODFade.inc>
+
 	const vec3 lightDir = normalize(vec3(1, 1, 1));
 	const float bumpiness = 0.2;
 	uniform sampler2D diffuseMap;
@@ -29,6 +31,7 @@ struct VS_OUT
 	out vec4 color;
 	void main()
 	{
+		LODFadeClip();
 		vec3 N = normalize(vs_out.normal);
 		vec3 T = normalize(vs_out.tangent);
 		vec3 B = normalize(cross(T, N));
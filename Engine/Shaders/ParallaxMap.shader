@@ -39,6 +39,8 @@ struct VS_OUT
 
 @fragment
 {
+	#include <LODFade.inc>
+
 	in  VS_OUT vs_out;
 	out vec4 fragColor;
 
@@ -97,6 +99,7 @@ struct VS_OUT
 
 	void main()
 	{
+		LODFadeClip();
 		vec3 viewDir = normalize(vs_out.viewDirInTangent);
 		vec2 uv = ParallaxMapping(vs_out.uv, viewDir);
 		if (uv.x > 1.0 || uv.y > 1.0 || uv.x < 0.0 || uv.y < 0.0)
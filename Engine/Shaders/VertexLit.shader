@@ -26,12 +26,15 @@ struct VS_OUT
 
 @fragment
 {
+	#include <LODFade.inc>
+
 	in VS_OUT vs_out;
 
 	out vec4 color;
 
 	void main()
 	{
+		LODFadeClip();
 		color = vec4(vs_out.color, 1);
 	}
 }
\ No newline at end of file
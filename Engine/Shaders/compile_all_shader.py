@@ -3,20 +3,17 @@ import sys
 
 compiler = r'../Binary/RelWithDebInfo/ShaderCompiler'
 #compiler = r'../Binary/Debug/ShaderCompiler'
-shader_dirs = ['.', './Editor']
-count = 0
 
-for d in shader_dirs:
-	for fn in os.listdir(d):
-		print(fn)
-		ext = fn.split('.')[-1]
+# one batch over this directory (Editor/ included): only the shaders whose source or includes changed since the last run are compiled
+# add --force to compile all of them
+here = os.path.dirname(os.path.abspath(__file__))
+cmd = [compiler, '-I', os.path.join(here, 'include'), '--errors', os.path.join(here, 'shader_errors.json')]
+cmd += sys.argv[1:]
+cmd.append(here)
+cmd = ' '.join('"{}"'.format(c) for c in cmd)
+print(cmd)
+if os.system(cmd) != 0:
+	print("Compile ERROR, see shader_errors.json")
+	sys.exit(1)
 
-		if ext in ['surf', 'shader']:
-			cmd = compiler + ' ' + os.path.abspath(os.path.join(d, fn))
-			print(cmd)
-			if os.system(cmd) != 0:
-				print("Compile ERROR: ", fn)
-				sys.exit()
-			count += 1
-
-print("Done. {} shaders compiled.".format(count))
\ No newline at end of file
+print("Done.")
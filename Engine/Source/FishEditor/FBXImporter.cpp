@@ -11,12 +11,14 @@
 #include <FishEngine/MeshFilter.hpp>
 #include <FishEngine/MeshRenderer.hpp>
 #include <FishEngine/SkinnedMeshRenderer.hpp>
+#include <FishEngine/LODGroup.hpp>
 #include <FishEngine/Texture.hpp>
 #include <FishEngine/Texture2D.hpp>
 #include <FishEngine/Application.hpp>
 
 #include "AssetDataBase.hpp"
 #include "FBXImporter/RawMesh.hpp"
+#include "FBXImporter/MeshSimplifier.hpp"
 
 //#include <Animation/AnimationUtility.hpp>
 //#include <Animation/AnimationClip.hpp>
@@ -604,6 +606,13 @@ MeshPtr FishEditor::FBXImporter::ParseMesh(FbxMesh* fbxMesh)
 
 	auto mesh = rawMesh.ToMesh();
 	GetLinkData(fbxMesh, mesh, rawMesh.m_vertexIndexRemapping);
+
+	// after GetLinkData: the bone weights are linked by the vertex ids of RawMesh and are reordered with the vertices
+	if (m_optimizeMesh)
+	{
+		auto stats = MeshOptimizer::Optimize(*mesh, m_optimizeMeshForOverdraw);
+		m_meshOptimizationStatistics.Merge(stats);
+	}
 	
 	m_model.m_fbxMeshLookup[fbxMesh] = m_model.m_meshes.size();
 	m_model.m_meshes.push_back(mesh);
@@ -818,6 +827,11 @@ GameObjectPtr FishEditor::FBXImporter::ParseNodeRecursively(FbxNode* pNode)
 				material = ParseMaterial(lMaterial);
 				renderer->AddMaterial(material);
 			}
+
+			if (m_generateLODs && go->GetComponent<LODGroup>() == nullptr)
+			{
+				GenerateLODs(go, mesh, renderer);
+			}
 		}
 	}
 
@@ -839,6 +853,84 @@ GameObjectPtr FishEditor::FBXImporter::ParseNodeRecursively(FbxNode* pNode)
 }
 
 
+void FishEditor::FBXImporter::GenerateLODs(GameObjectPtr const & go, MeshPtr const & mesh, RendererPtr const & renderer)
+{
+	const int lodCount = Mathf::Clamp(m_lodCount, 1, LODGroup::kMaxLODs);
+	if (lodCount < 2 || mesh->m_triangleCount == 0)
+		return;
+
+	std::vector<LOD> lods;
+	lods.emplace_back(0.5f, std::vector<std::weak_ptr<GameObject>>{ go });
+
+	uint32_t lastTriangleCount = mesh->m_triangleCount;
+	for (int level = 1; level < lodCount; ++level)
+	{
+		auto lodMesh = MeshSimplifier::Simplify(*mesh, std::pow(m_lodReductionRatio, static_cast<float>(level)));
+		// locked seams and borders, the mesh can not get any simpler
+		if (lodMesh->m_triangleCount == 0 || lodMesh->m_triangleCount >= lastTriangleCount * 0.95f)
+			break;
+		lastTriangleCount = lodMesh->m_triangleCount;
+
+		if (m_optimizeMesh)
+		{
+			MeshOptimizer::Optimize(*lodMesh, m_optimizeMeshForOverdraw);
+		}
+
+		auto lodName = Format("%1%_LOD%2%", mesh->name(), level);
+		lodMesh->setName(lodName);
+		m_model.m_meshes.push_back(lodMesh);
+		if (IsNewlyCreated())
+		{
+			m_recycleNameToFileID[lodName] = m_nextMeshFileID;
+			m_fileIDToRecycleName[m_nextMeshFileID] = lodName;
+			m_nextMeshFileID += 2;
+		}
+
+		auto lodGo = GameObject::Create();
+		lodGo->setName(Format("%1%_LOD%2%", go->name(), level));
+		lodGo->setPrefabInternal(m_model.m_modelPrefab);
+		lodGo->transform()->setPrefabInternal(m_model.m_modelPrefab);
+		FishEditor::AssetDatabase::s_allAssetObjects.insert(lodGo);
+
+		RendererPtr lodRenderer;
+		if (lodMesh->m_skinned)
+		{
+			auto srenderer = lodGo->AddComponent<SkinnedMeshRenderer>();
+			m_model.m_skinnedMeshRenderers.push_back(srenderer);
+			srenderer->setSharedMesh(lodMesh);
+			srenderer->setAvatar(m_model.m_avatar);
+			srenderer->setRootBone(m_model.m_rootNode->transform());
+			lodRenderer = srenderer;
+		}
+		else
+		{
+			lodGo->AddComponent<MeshFilter>()->SetMesh(lodMesh);
+			lodRenderer = lodGo->AddComponent<MeshRenderer>();
+		}
+		lodRenderer->SetMaterials(renderer->materials());
+		lodGo->transform()->SetParent(go->transform(), false);
+
+		lods.emplace_back(0.0f, std::vector<std::weak_ptr<GameObject>>{ lodGo });
+	}
+
+	if (lods.size() < 2)
+		return;
+
+	// halve the screen height for each LOD, the last one is culled below 1% of the screen
+	for (size_t i = 0; i < lods.size(); ++i)
+	{
+		lods[i].screenRelativeTransitionHeight = i + 1 == lods.size() ? 0.01f : std::pow(0.5f, static_cast<float>(i + 1));
+		lods[i].fadeTransitionWidth = 0.1f;
+	}
+
+	auto lodGroup = go->AddComponent<LODGroup>();
+	lodGroup->SetLODs(lods);
+	auto bounds = mesh->bounds();
+	auto size = bounds.size();
+	lodGroup->setLocalReferencePoint(bounds.center());
+	lodGroup->setSize(std::max({ size.x, size.y, size.z }));
+}
+
 void FishEditor::FBXImporter::ImportTo(FishEngine::GameObjectPtr & model)
 {
 	abort();
@@ -852,6 +944,8 @@ void FishEditor::FBXImporter::Reimport()
 
 PrefabPtr FishEditor::FBXImporter::Load(FishEngine::Path const & path)
 {
+	m_meshOptimizationStatistics = MeshOptimizationStatistics();
+
 	if (m_model.m_modelPrefab == nullptr)
 	{
 		m_model.m_modelPrefab = MakeShared<Prefab>();
@@ -1058,6 +1152,13 @@ PrefabPtr FishEditor::FBXImporter::Load(FishEngine::Path const & path)
 		m_asset->Add(clip);
 	m_asset->Add(m_model.m_avatar);
 
+	if (m_optimizeMesh)
+	{
+		auto const & stats = m_meshOptimizationStatistics;
+		LogInfo(Format("%1%: ACMR %2% -> %3%, ATVR %4% -> %5%", path.filename().string(),
+			stats.before.acmr(), stats.after.acmr(), stats.before.atvr(), stats.after.atvr()));
+	}
+
 	return m_model.m_modelPrefab;
 }
 
@@ -116,6 +116,9 @@ namespace FishEditor
 
 		FishEngine::MeshPtr ParseMesh(fbxsdk::FbxMesh* fbxMesh);
 
+		// simplified copies of the renderer of go as its children, grouped in a LODGroup on go
+		void GenerateLODs(FishEngine::GameObjectPtr const & go, FishEngine::MeshPtr const & mesh, FishEngine::RendererPtr const & renderer);
+
 		FishEngine::MaterialPtr ParseMaterial(fbxsdk::FbxSurfaceMaterial * pMaterial);
 
 		void GetLinkData(fbxsdk::FbxMesh* pGeometry, FishEngine::MeshPtr mesh, std::map<uint32_t, uint32_t> const & vertexIndexRemapping);
@@ -0,0 +1,332 @@
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace FishEngine;
+
+namespace
+{
+	// Forsyth's tuned constants, the LRU cache is larger than the FIFO of the hardware on purpose
+	constexpr int   kCacheSize          = 32;
+	constexpr float kCacheDecayPower    = 1.5f;
+	constexpr float kLastTriangleScore  = 0.75f;
+	constexpr float kValenceBoostScale  = 2.0f;
+	constexpr float kValenceBoostPower  = 0.5f;
+
+	float VertexScore(int cachePosition, uint32_t remainingValence)
+	{
+		// no triangle left, never pick it again
+		if (remainingValence == 0)
+			return -1.0f;
+
+		float score = 0;
+		if (cachePosition >= 0)
+		{
+			// the vertices of the last triangle get a fixed score, whichever order they are emitted in
+			if (cachePosition < 3)
+				score = kLastTriangleScore;
+			else
+				score = std::pow(1.0f - (cachePosition - 3) * (1.0f / (kCacheSize - 3)), kCacheDecayPower);
+		}
+		// favour vertices with few triangles left, to clear them out rather than leave lone triangles behind
+		score += kValenceBoostScale * std::pow(static_cast<float>(remainingValence), -kValenceBoostPower);
+		return score;
+	}
+
+	template<typename T>
+	void Permute(std::vector<T> & data, std::vector<uint32_t> const & remap)
+	{
+		if (data.size() != remap.size())
+			return;
+		std::vector<T> result(data.size());
+		for (size_t i = 0; i < data.size(); ++i)
+			result[remap[i]] = data[i];
+		data.swap(result);
+	}
+}
+
+namespace FishEditor
+{
+	VertexCacheStatistics MeshOptimizer::AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, int cacheSize)
+	{
+		VertexCacheStatistics stats;
+		stats.triangleCount = static_cast<uint32_t>(indexCount / 3);
+
+		// a vertex is in the FIFO if fewer than cacheSize vertices were pushed after it
+		std::vector<uint32_t> timestamps(vertexCount, 0);
+		std::vector<bool> referenced(vertexCount, false);
+		uint32_t time = cacheSize + 1;
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			const uint32_t v = indices[i];
+			if (time - timestamps[v] > static_cast<uint32_t>(cacheSize))
+			{
+				timestamps[v] = time++;
+				stats.transformedCount++;
+			}
+			if (!referenced[v])
+			{
+				referenced[v] = true;
+				stats.vertexCount++;
+			}
+		}
+		return stats;
+	}
+
+	void MeshOptimizer::OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+	{
+		const size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0)
+			return;
+
+		// triangles of each vertex
+		std::vector<uint32_t> remainingValence(vertexCount, 0);
+		for (size_t i = 0; i < triangleCount * 3; ++i)
+			remainingValence[indices[i]]++;
+		std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; ++v)
+			adjacencyOffset[v + 1] = adjacencyOffset[v] + remainingValence[v];
+		std::vector<uint32_t> adjacency(triangleCount * 3);
+		{
+			std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+			for (size_t i = 0; i < triangleCount * 3; ++i)
+				adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		std::vector<int> cachePosition(vertexCount, -1);
+		std::vector<float> vertexScore(vertexCount);
+		for (size_t v = 0; v < vertexCount; ++v)
+			vertexScore[v] = VertexScore(-1, remainingValence[v]);
+
+		std::vector<float> triangleScore(triangleCount);
+		size_t bestTriangle = 0;
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			triangleScore[t] = vertexScore[indices[t*3]] + vertexScore[indices[t*3+1]] + vertexScore[indices[t*3+2]];
+			if (triangleScore[t] > triangleScore[bestTriangle])
+				bestTriangle = t;
+		}
+
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> result;
+		result.reserve(triangleCount * 3);
+
+		uint32_t cache[kCacheSize + 3];
+		uint32_t newCache[kCacheSize + 3];
+		int cacheCount = 0;
+		size_t deadEndCursor = 0;
+		constexpr size_t none = static_cast<size_t>(-1);
+
+		for (size_t n = 0; n < triangleCount; ++n)
+		{
+			if (bestTriangle == none)
+			{
+				// nothing in the cache has triangles left, continue with the next one in input order
+				while (emitted[deadEndCursor])
+					deadEndCursor++;
+				bestTriangle = deadEndCursor;
+			}
+
+			const uint32_t* tri = indices + bestTriangle * 3;
+			emitted[bestTriangle] = true;
+			result.insert(result.end(), tri, tri + 3);
+
+			// the triangle goes to the front of the LRU cache
+			int newCount = 0;
+			for (int c = 0; c < 3; ++c)
+			{
+				remainingValence[tri[c]]--;
+				newCache[newCount++] = tri[c];
+			}
+			for (int i = 0; i < cacheCount; ++i)
+			{
+				const uint32_t v = cache[i];
+				if (v != tri[0] && v != tri[1] && v != tri[2])
+					newCache[newCount++] = v;
+			}
+
+			for (int i = 0; i < newCount; ++i)
+			{
+				const uint32_t v = newCache[i];
+				cachePosition[v] = i < kCacheSize ? i : -1;
+				vertexScore[v] = VertexScore(cachePosition[v], remainingValence[v]);
+			}
+
+			// only the triangles of the vertices that moved in the cache change score
+			bestTriangle = none;
+			float bestScore = -1.0f;
+			for (int i = 0; i < newCount; ++i)
+			{
+				const uint32_t v = newCache[i];
+				for (uint32_t a = adjacencyOffset[v]; a < adjacencyOffset[v + 1]; ++a)
+				{
+					const uint32_t t = adjacency[a];
+					if (emitted[t])
+						continue;
+					const float score = vertexScore[indices[t*3]] + vertexScore[indices[t*3+1]] + vertexScore[indices[t*3+2]];
+					triangleScore[t] = score;
+					if (score > bestScore)
+					{
+						bestScore = score;
+						bestTriangle = t;
+					}
+				}
+			}
+
+			cacheCount = std::min(newCount, kCacheSize);
+			std::copy(newCache, newCache + cacheCount, cache);
+		}
+
+		std::copy(result.begin(), result.end(), indices);
+	}
+
+	void MeshOptimizer::OptimizeOverdraw(uint32_t* indices, size_t indexCount, const Vector3* positions, size_t vertexCount)
+	{
+		const size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0)
+			return;
+
+		// a triangle whose 3 vertices all miss the cache starts a cluster, moving clusters around costs no cache hits
+		std::vector<size_t> clusterStart;
+		{
+			std::vector<uint32_t> timestamps(vertexCount, 0);
+			uint32_t time = kStatisticsCacheSize + 1;
+			for (size_t t = 0; t < triangleCount; ++t)
+			{
+				int misses = 0;
+				for (int c = 0; c < 3; ++c)
+				{
+					const uint32_t v = indices[t * 3 + c];
+					if (time - timestamps[v] > static_cast<uint32_t>(kStatisticsCacheSize))
+					{
+						timestamps[v] = time++;
+						misses++;
+					}
+				}
+				if (t == 0 || misses == 3)
+					clusterStart.push_back(t);
+			}
+		}
+		const size_t clusterCount = clusterStart.size();
+		if (clusterCount <= 1)
+			return;
+		clusterStart.push_back(triangleCount);
+
+		// area weighted centroid and normal of every cluster, and of the whole mesh
+		std::vector<Vector3> clusterCentroid(clusterCount, Vector3::zero);
+		std::vector<Vector3> clusterNormal(clusterCount, Vector3::zero);
+		Vector3 meshCentroid = Vector3::zero;
+		float meshArea = 0;
+		for (size_t c = 0; c < clusterCount; ++c)
+		{
+			float clusterArea = 0;
+			for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; ++t)
+			{
+				Vector3 const & p0 = positions[indices[t * 3]];
+				Vector3 const & p1 = positions[indices[t * 3 + 1]];
+				Vector3 const & p2 = positions[indices[t * 3 + 2]];
+				const Vector3 normal = Vector3::Cross(p1 - p0, p2 - p0);
+				const float area = normal.magnitude();
+				const Vector3 centroid = (p0 + p1 + p2) * (1.0f / 3.0f);
+				clusterCentroid[c] += centroid * area;
+				clusterNormal[c] += normal;
+				clusterArea += area;
+			}
+			meshCentroid += clusterCentroid[c];
+			meshArea += clusterArea;
+			if (clusterArea > 0)
+				clusterCentroid[c] = clusterCentroid[c] * (1.0f / clusterArea);
+		}
+		if (meshArea > 0)
+			meshCentroid = meshCentroid * (1.0f / meshArea);
+
+		// clusters far out along their normal are likely to occlude the others, draw them first
+		std::vector<float> sortKey(clusterCount);
+		for (size_t c = 0; c < clusterCount; ++c)
+		{
+			const float length = clusterNormal[c].magnitude();
+			const Vector3 normal = length > 0 ? clusterNormal[c] * (1.0f / length) : Vector3::zero;
+			sortKey[c] = Vector3::Dot(clusterCentroid[c] - meshCentroid, normal);
+		}
+		std::vector<size_t> order(clusterCount);
+		for (size_t c = 0; c < clusterCount; ++c)
+			order[c] = c;
+		std::stable_sort(order.begin(), order.end(), [&sortKey](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+		std::vector<uint32_t> result;
+		result.reserve(triangleCount * 3);
+		for (size_t c : order)
+			result.insert(result.end(), indices + clusterStart[c] * 3, indices + clusterStart[c + 1] * 3);
+		std::copy(result.begin(), result.end(), indices);
+	}
+
+	std::vector<uint32_t> MeshOptimizer::VertexFetchRemap(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+	{
+		constexpr uint32_t unused = static_cast<uint32_t>(-1);
+		std::vector<uint32_t> remap(vertexCount, unused);
+		uint32_t next = 0;
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			const uint32_t v = indices[i];
+			if (remap[v] == unused)
+				remap[v] = next++;
+		}
+		for (auto & r : remap)
+		{
+			if (r == unused)
+				r = next++;
+		}
+		return remap;
+	}
+
+	std::vector<std::pair<size_t, size_t>> MeshOptimizer::SubMeshIndexRanges(Mesh const & mesh)
+	{
+		std::vector<std::pair<size_t, size_t>> ranges;
+		const size_t indexCount = mesh.m_triangles.size();
+		if (mesh.m_subMeshCount <= 1)
+		{
+			ranges.emplace_back(0, indexCount);
+			return ranges;
+		}
+		for (int i = 0; i < mesh.m_subMeshCount; ++i)
+		{
+			size_t begin = mesh.m_subMeshIndexOffset[i];
+			size_t end = i + 1 < mesh.m_subMeshCount ? mesh.m_subMeshIndexOffset[i + 1] : indexCount;
+			ranges.emplace_back(begin, end);
+		}
+		return ranges;
+	}
+
+	MeshOptimizationStatistics MeshOptimizer::Optimize(Mesh & mesh, bool optimizeOverdraw)
+	{
+		MeshOptimizationStatistics stats;
+		auto & indices = mesh.m_triangles;
+		const size_t vertexCount = mesh.m_vertices.size();
+		const auto ranges = SubMeshIndexRanges(mesh);
+
+		for (auto const & r : ranges)
+		{
+			uint32_t* begin = indices.data() + r.first;
+			const size_t count = r.second - r.first;
+			stats.before.Merge(AnalyzeVertexCache(begin, count, vertexCount));
+			OptimizeVertexCache(begin, count, vertexCount);
+			if (optimizeOverdraw)
+				OptimizeOverdraw(begin, count, mesh.m_vertices.data(), vertexCount);
+		}
+
+		// vertices in the order they are drawn, all submeshes share the vertex buffer
+		const auto remap = VertexFetchRemap(indices.data(), indices.size(), vertexCount);
+		for (auto & i : indices)
+			i = remap[i];
+		Permute(mesh.m_vertices, remap);
+		Permute(mesh.m_normals, remap);
+		Permute(mesh.m_uv, remap);
+		Permute(mesh.m_tangents, remap);
+		Permute(mesh.m_boneWeights, remap);
+
+		for (auto const & r : ranges)
+			stats.after.Merge(AnalyzeVertexCache(indices.data() + r.first, r.second - r.first, vertexCount));
+		return stats;
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+#include <FishEngine/Mesh.hpp>
+#include <FishEngine/Vector3.hpp>
+
+namespace FishEditor
+{
+	// Post-transform vertex cache efficiency of an index buffer, simulated with a FIFO cache of
+	// MeshOptimizer::kStatisticsCacheSize entries.
+	struct VertexCacheStatistics
+	{
+		uint32_t triangleCount = 0;
+		uint32_t vertexCount = 0;		// distinct vertices referenced
+		uint32_t transformedCount = 0;	// cache misses, i.e. vertex shader invocations
+
+		// average cache miss ratio: transformed vertices per triangle, 0.5 at best, 3 at worst
+		float acmr() const
+		{
+			return triangleCount == 0 ? 0.0f : static_cast<float>(transformedCount) / triangleCount;
+		}
+
+		// average transformed vertex ratio: 1 means every vertex is transformed once
+		float atvr() const
+		{
+			return vertexCount == 0 ? 0.0f : static_cast<float>(transformedCount) / vertexCount;
+		}
+
+		void Merge(VertexCacheStatistics const & rhs)
+		{
+			triangleCount += rhs.triangleCount;
+			vertexCount += rhs.vertexCount;
+			transformedCount += rhs.transformedCount;
+		}
+	};
+
+	struct MeshOptimizationStatistics
+	{
+		VertexCacheStatistics before;
+		VertexCacheStatistics after;
+
+		void Merge(MeshOptimizationStatistics const & rhs)
+		{
+			before.Merge(rhs.before);
+			after.Merge(rhs.after);
+		}
+	};
+
+	// Reorders the triangles and vertices of a mesh for the GPU, on the CPU at import time.
+	// Every pass is deterministic: the same input always gives the same output.
+	class MeshOptimizer
+	{
+	public:
+		MeshOptimizer() = delete;
+
+		static constexpr int kStatisticsCacheSize = 16;
+
+		static VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, int cacheSize = kStatisticsCacheSize);
+
+		// Triangle order for the vertex cache (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation").
+		static void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+		// Split a vertex cache optimized index buffer into clusters where the cache starts over and draw the
+		// clusters that face outwards first, so that they occlude the rest (Sander et al., "Fast Triangle
+		// Reordering for Vertex Locality and Reduced Overdraw"). The vertex cache efficiency is mostly kept.
+		static void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const FishEngine::Vector3* positions, size_t vertexCount);
+
+		// Remap of the vertices to the order in which the indices first reference them, unreferenced vertices last.
+		// remap[oldIndex] == newIndex
+		static std::vector<uint32_t> VertexFetchRemap(const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+		// [begin, end) of the index buffer of every submesh.
+		static std::vector<std::pair<size_t, size_t>> SubMeshIndexRanges(FishEngine::Mesh const & mesh);
+
+		// All of the above on every submesh, then the vertex fetch reorder of all vertex attributes and bone weights.
+		static MeshOptimizationStatistics Optimize(FishEngine::Mesh & mesh, bool optimizeOverdraw);
+	};
+}
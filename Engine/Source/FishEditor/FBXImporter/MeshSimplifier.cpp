@@ -0,0 +1,485 @@
+#include "MeshSimplifier.hpp"
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
+using namespace FishEngine;
+
+namespace
+{
+	// open borders are held in place by planes perpendicular to the surface, weighted more than the surface itself
+	constexpr double kBorderWeight = 10.0;
+
+	// cosine of the largest rotation of a triangle normal allowed in one collapse
+	constexpr float kFlipThreshold = 0.25f;
+
+	constexpr uint32_t kNone = static_cast<uint32_t>(-1);
+
+	enum class VertexKind : uint8_t
+	{
+		Manifold,	// moves freely
+		Border,		// only along a border edge
+		Locked,		// never moves
+	};
+
+	// symmetric 4x4 matrix of the sum of squared distances to a set of planes
+	struct Quadric
+	{
+		double a2 = 0, ab = 0, ac = 0, ad = 0;
+		double b2 = 0, bc = 0, bd = 0;
+		double c2 = 0, cd = 0;
+		double d2 = 0;
+
+		// plane a*x + b*y + c*z + d = 0 with (a, b, c) normalized
+		void AddPlane(double a, double b, double c, double d, double weight)
+		{
+			a2 += weight * a * a; ab += weight * a * b; ac += weight * a * c; ad += weight * a * d;
+			b2 += weight * b * b; bc += weight * b * c; bd += weight * b * d;
+			c2 += weight * c * c; cd += weight * c * d;
+			d2 += weight * d * d;
+		}
+
+		void Add(Quadric const & q)
+		{
+			a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+			b2 += q.b2; bc += q.bc; bd += q.bd;
+			c2 += q.c2; cd += q.cd;
+			d2 += q.d2;
+		}
+
+		double Error(Vector3 const & p) const
+		{
+			const double x = p.x, y = p.y, z = p.z;
+			const double e = a2*x*x + 2*ab*x*y + 2*ac*x*z + 2*ad*x
+				+ b2*y*y + 2*bc*y*z + 2*bd*y
+				+ c2*z*z + 2*cd*z
+				+ d2;
+			return std::fabs(e);
+		}
+	};
+
+	struct Collapse
+	{
+		double		cost;
+		uint32_t	from;
+		uint32_t	to;
+		uint32_t	fromVersion;
+		uint32_t	toVersion;
+
+		// std::priority_queue is a max heap, the cheapest collapse must come first.
+		// Ties are broken by the vertex ids so that the result does not depend on the push order.
+		bool operator<(Collapse const & rhs) const
+		{
+			if (cost != rhs.cost)
+				return cost > rhs.cost;
+			if (from != rhs.from)
+				return from > rhs.from;
+			return to > rhs.to;
+		}
+	};
+
+	struct PositionKey
+	{
+		uint32_t bits[3];
+
+		bool operator==(PositionKey const & rhs) const
+		{
+			return bits[0] == rhs.bits[0] && bits[1] == rhs.bits[1] && bits[2] == rhs.bits[2];
+		}
+	};
+
+	struct PositionKeyHash
+	{
+		size_t operator()(PositionKey const & key) const
+		{
+			return (key.bits[0] * 73856093u) ^ (key.bits[1] * 19349663u) ^ (key.bits[2] * 83492791u);
+		}
+	};
+
+	inline uint64_t EdgeKey(uint32_t a, uint32_t b)
+	{
+		if (a > b)
+			std::swap(a, b);
+		return (static_cast<uint64_t>(a) << 32) | b;
+	}
+
+	template<typename T>
+	std::vector<T> Compact(std::vector<T> const & data, std::vector<uint32_t> const & usedVertices, size_t vertexCount)
+	{
+		std::vector<T> result;
+		if (data.size() != vertexCount)
+			return result;
+		result.reserve(usedVertices.size());
+		for (auto v : usedVertices)
+			result.push_back(data[v]);
+		return result;
+	}
+}
+
+namespace FishEditor
+{
+	float MeshSimplifier::SimplifyIndices(std::vector<uint32_t> & indices, const Vector3* positions, size_t vertexCount,
+		std::vector<uint32_t>* triangleGroups, size_t targetIndexCount)
+	{
+		const size_t triangleCount = indices.size() / 3;
+		if (triangleCount * 3 <= targetIndexCount)
+			return 0;
+
+		// 1. weld the vertices by position, vertices at the same position differ by their normal/uv/tangent
+		std::vector<uint32_t> positionID(vertexCount, kNone);
+		std::vector<uint32_t> wedgeCount;			// referenced vertices at each position
+		std::vector<uint32_t> representative;		// a vertex at each position
+		{
+			std::unordered_map<PositionKey, uint32_t, PositionKeyHash> lookup;
+			lookup.reserve(vertexCount);
+			for (size_t i = 0; i < triangleCount * 3; ++i)
+			{
+				const uint32_t v = indices[i];
+				if (positionID[v] != kNone)
+					continue;
+				PositionKey key;
+				std::memcpy(key.bits, &positions[v], sizeof(key.bits));
+				auto it = lookup.emplace(key, static_cast<uint32_t>(representative.size()));
+				if (it.second)
+				{
+					representative.push_back(v);
+					wedgeCount.push_back(0);
+				}
+				positionID[v] = it.first->second;
+				wedgeCount[it.first->second]++;
+			}
+		}
+		const size_t positionCount = representative.size();
+		auto positionOf = [&](uint32_t p) -> Vector3 const & { return positions[representative[p]]; };
+
+		std::vector<VertexKind> kind(positionCount, VertexKind::Manifold);
+		for (size_t p = 0; p < positionCount; ++p)
+		{
+			if (wedgeCount[p] > 1)
+				kind[p] = VertexKind::Locked;
+		}
+
+		// 2. triangles around each position, the degenerate ones are dropped
+		std::vector<uint32_t> corners(indices.begin(), indices.begin() + triangleCount * 3);
+		std::vector<bool> alive(triangleCount, false);
+		std::vector<std::vector<uint32_t>> positionTriangles(positionCount);
+		std::vector<uint32_t> positionGroup(positionCount, kNone);
+		size_t liveTriangles = 0;
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			const uint32_t p[3] = { positionID[corners[t*3]], positionID[corners[t*3+1]], positionID[corners[t*3+2]] };
+			if (p[0] == p[1] || p[1] == p[2] || p[2] == p[0])
+				continue;
+			alive[t] = true;
+			liveTriangles++;
+			for (int k = 0; k < 3; ++k)
+			{
+				positionTriangles[p[k]].push_back(static_cast<uint32_t>(t));
+				if (triangleGroups == nullptr)
+					continue;
+				const uint32_t group = (*triangleGroups)[t];
+				if (positionGroup[p[k]] == kNone)
+					positionGroup[p[k]] = group;
+				else if (positionGroup[p[k]] != group)
+					kind[p[k]] = VertexKind::Locked;	// on a submesh boundary
+			}
+		}
+
+		// 3. quadrics of the surface and of the open borders
+		std::unordered_map<uint64_t, uint32_t> edgeTriangleCount;
+		edgeTriangleCount.reserve(liveTriangles * 3);
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			if (!alive[t])
+				continue;
+			for (int k = 0; k < 3; ++k)
+				edgeTriangleCount[EdgeKey(positionID[corners[t*3+k]], positionID[corners[t*3+(k+1)%3]])]++;
+		}
+
+		std::vector<Quadric> quadrics(positionCount);
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			if (!alive[t])
+				continue;
+			const uint32_t p[3] = { positionID[corners[t*3]], positionID[corners[t*3+1]], positionID[corners[t*3+2]] };
+			Vector3 const & p0 = positionOf(p[0]);
+			const Vector3 normal = Vector3::Cross(positionOf(p[1]) - p0, positionOf(p[2]) - p0);
+			const float length = normal.magnitude();
+			if (length <= 0)
+				continue;
+			const Vector3 n = normal * (1.0f / length);
+			const double area = 0.5 * length;
+			for (int k = 0; k < 3; ++k)
+				quadrics[p[k]].AddPlane(n.x, n.y, n.z, -Vector3::Dot(n, p0), area);
+
+			for (int k = 0; k < 3; ++k)
+			{
+				const uint32_t a = p[k];
+				const uint32_t b = p[(k + 1) % 3];
+				const uint32_t count = edgeTriangleCount[EdgeKey(a, b)];
+				if (count > 2)
+				{
+					// non-manifold
+					kind[a] = kind[b] = VertexKind::Locked;
+				}
+				else if (count == 1)
+				{
+					for (auto x : { a, b })
+					{
+						if (kind[x] == VertexKind::Manifold)
+							kind[x] = VertexKind::Border;
+					}
+					const Vector3 edge = positionOf(b) - positionOf(a);
+					Vector3 m = Vector3::Cross(edge, n);
+					const float mLength = m.magnitude();
+					if (mLength <= 0)
+						continue;
+					m = m * (1.0f / mLength);
+					const double weight = kBorderWeight * Vector3::Dot(edge, edge);
+					const double d = -Vector3::Dot(m, positionOf(a));
+					quadrics[a].AddPlane(m.x, m.y, m.z, d, weight);
+					quadrics[b].AddPlane(m.x, m.y, m.z, d, weight);
+				}
+			}
+		}
+
+		// 4. collapse the cheapest edges first
+		std::vector<uint32_t> version(positionCount, 0);
+		std::vector<bool> removed(positionCount, false);
+		std::priority_queue<Collapse> queue;
+
+		auto containsPosition = [&](uint32_t t, uint32_t p)
+		{
+			return positionID[corners[t*3]] == p || positionID[corners[t*3+1]] == p || positionID[corners[t*3+2]] == p;
+		};
+
+		auto sharedTriangleCount = [&](uint32_t a, uint32_t b)
+		{
+			int count = 0;
+			for (auto t : positionTriangles[a])
+			{
+				if (alive[t] && containsPosition(t, b))
+					count++;
+			}
+			return count;
+		};
+
+		auto push = [&](uint32_t from, uint32_t to)
+		{
+			if (kind[from] == VertexKind::Locked)
+				return;
+			if (kind[from] == VertexKind::Border && sharedTriangleCount(from, to) != 1)
+				return;
+			Quadric q = quadrics[from];
+			q.Add(quadrics[to]);
+			queue.push({ q.Error(positionOf(to)), from, to, version[from], version[to] });
+		};
+
+		auto gatherNeighbours = [&](uint32_t p, std::vector<uint32_t> & neighbours)
+		{
+			neighbours.clear();
+			for (auto t : positionTriangles[p])
+			{
+				if (!alive[t])
+					continue;
+				for (int k = 0; k < 3; ++k)
+				{
+					const uint32_t q = positionID[corners[t*3+k]];
+					if (q != p)
+						neighbours.push_back(q);
+				}
+			}
+			std::sort(neighbours.begin(), neighbours.end());
+			neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+		};
+
+		for (auto const & edge : edgeTriangleCount)
+		{
+			const uint32_t a = static_cast<uint32_t>(edge.first >> 32);
+			const uint32_t b = static_cast<uint32_t>(edge.first & 0xFFFFFFFFu);
+			push(a, b);
+			push(b, a);
+		}
+
+		std::vector<uint32_t> fromNeighbours;
+		std::vector<uint32_t> toNeighbours;
+		double lastError = 0;
+		while (liveTriangles * 3 > targetIndexCount && !queue.empty())
+		{
+			const Collapse c = queue.top();
+			queue.pop();
+			const uint32_t u = c.from;
+			const uint32_t v = c.to;
+			if (removed[u] || removed[v] || version[u] != c.fromVersion || version[v] != c.toVersion)
+				continue;
+
+			// the triangles on the edge must agree on the vertex of v, or the edge is a seam at v
+			uint32_t target = kNone;
+			int edgeTriangles = 0;
+			bool seam = false;
+			for (auto t : positionTriangles[u])
+			{
+				if (!alive[t])
+					continue;
+				for (int k = 0; k < 3; ++k)
+				{
+					const uint32_t vertex = corners[t*3+k];
+					if (positionID[vertex] != v)
+						continue;
+					edgeTriangles++;
+					if (target == kNone)
+						target = vertex;
+					else if (target != vertex)
+						seam = true;
+				}
+			}
+			if (edgeTriangles == 0 || seam)
+				continue;
+
+			// link condition: u and v may only share the neighbours of the edge triangles, or the surface gets pinched
+			gatherNeighbours(u, fromNeighbours);
+			gatherNeighbours(v, toNeighbours);
+			std::vector<uint32_t> common;
+			std::set_intersection(fromNeighbours.begin(), fromNeighbours.end(), toNeighbours.begin(), toNeighbours.end(), std::back_inserter(common));
+			if (static_cast<int>(common.size()) > edgeTriangles)
+				continue;
+
+			// reject the collapse if a remaining triangle around u flips or degenerates
+			Vector3 const & to = positionOf(v);
+			bool flipped = false;
+			for (auto t : positionTriangles[u])
+			{
+				if (!alive[t] || containsPosition(t, v))
+					continue;
+				Vector3 p[3];
+				Vector3 moved[3];
+				for (int k = 0; k < 3; ++k)
+				{
+					const uint32_t q = positionID[corners[t*3+k]];
+					p[k] = positionOf(q);
+					moved[k] = q == u ? to : p[k];
+				}
+				const Vector3 before = Vector3::Cross(p[1] - p[0], p[2] - p[0]);
+				const Vector3 after = Vector3::Cross(moved[1] - moved[0], moved[2] - moved[0]);
+				if (Vector3::Dot(before, after) <= kFlipThreshold * before.magnitude() * after.magnitude())
+				{
+					flipped = true;
+					break;
+				}
+			}
+			if (flipped)
+				continue;
+
+			for (auto t : positionTriangles[u])
+			{
+				if (!alive[t])
+					continue;
+				if (containsPosition(t, v))
+				{
+					alive[t] = false;
+					liveTriangles--;
+					continue;
+				}
+				for (int k = 0; k < 3; ++k)
+				{
+					if (positionID[corners[t*3+k]] == u)
+						corners[t*3+k] = target;
+				}
+				positionTriangles[v].push_back(t);
+			}
+			positionTriangles[u].clear();
+			positionTriangles[u].shrink_to_fit();
+			auto & trianglesOfV = positionTriangles[v];
+			trianglesOfV.erase(std::remove_if(trianglesOfV.begin(), trianglesOfV.end(), [&alive](uint32_t t) { return !alive[t]; }), trianglesOfV.end());
+
+			quadrics[v].Add(quadrics[u]);
+			removed[u] = true;
+			version[v]++;
+			lastError = c.cost;
+
+			gatherNeighbours(v, toNeighbours);
+			for (auto w : toNeighbours)
+			{
+				push(v, w);
+				push(w, v);
+			}
+		}
+
+		std::vector<uint32_t> result;
+		result.reserve(liveTriangles * 3);
+		std::vector<uint32_t> groups;
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			if (!alive[t])
+				continue;
+			result.insert(result.end(), corners.begin() + t * 3, corners.begin() + t * 3 + 3);
+			if (triangleGroups != nullptr)
+				groups.push_back((*triangleGroups)[t]);
+		}
+		indices.swap(result);
+		if (triangleGroups != nullptr)
+			triangleGroups->swap(groups);
+		return static_cast<float>(lastError);
+	}
+
+	MeshPtr MeshSimplifier::Simplify(Mesh const & mesh, float ratio)
+	{
+		const auto ranges = MeshOptimizer::SubMeshIndexRanges(mesh);
+		std::vector<uint32_t> indices(mesh.m_triangles);
+		std::vector<uint32_t> groups(indices.size() / 3, 0);
+		for (size_t g = 0; g < ranges.size(); ++g)
+		{
+			for (size_t t = ranges[g].first / 3; t < ranges[g].second / 3; ++t)
+				groups[t] = static_cast<uint32_t>(g);
+		}
+
+		ratio = std::min(std::max(ratio, 0.0f), 1.0f);
+		const size_t targetIndexCount = static_cast<size_t>(indices.size() / 3 * ratio) * 3;
+		const size_t vertexCount = mesh.m_vertices.size();
+		SimplifyIndices(indices, mesh.m_vertices.data(), vertexCount, &groups, targetIndexCount);
+
+		// keep the referenced vertices, in their original order
+		std::vector<uint32_t> remap(vertexCount, kNone);
+		for (auto i : indices)
+			remap[i] = 0;
+		std::vector<uint32_t> usedVertices;
+		for (size_t v = 0; v < vertexCount; ++v)
+		{
+			if (remap[v] == kNone)
+				continue;
+			remap[v] = static_cast<uint32_t>(usedVertices.size());
+			usedVertices.push_back(static_cast<uint32_t>(v));
+		}
+		for (auto & i : indices)
+			i = remap[i];
+
+		auto result = MakeShared<Mesh>(
+			Compact(mesh.m_vertices, usedVertices, vertexCount),
+			Compact(mesh.m_normals, usedVertices, vertexCount),
+			Compact(mesh.m_uv, usedVertices, vertexCount),
+			Compact(mesh.m_tangents, usedVertices, vertexCount),
+			std::move(indices));
+
+		if (mesh.m_subMeshCount > 1)
+		{
+			// groups are still sorted, a submesh may end up empty
+			result->m_subMeshCount = mesh.m_subMeshCount;
+			result->m_subMeshIndexOffset.assign(mesh.m_subMeshCount, 0);
+			for (int g = 0; g < mesh.m_subMeshCount; ++g)
+			{
+				const auto first = std::lower_bound(groups.begin(), groups.end(), static_cast<uint32_t>(g));
+				result->m_subMeshIndexOffset[g] = static_cast<uint32_t>(first - groups.begin()) * 3;
+			}
+		}
+
+		result->m_skinned = mesh.m_skinned;
+		result->m_boneNames = mesh.m_boneNames;
+		result->m_bindposes = mesh.m_bindposes;
+		result->m_boneWeights = Compact(mesh.m_boneWeights, usedVertices, vertexCount);
+		return result;
+	}
+}
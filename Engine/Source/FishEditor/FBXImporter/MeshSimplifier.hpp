@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <FishEngine/Mesh.hpp>
+#include <FishEngine/Vector3.hpp>
+
+namespace FishEditor
+{
+	// Quadric error metric mesh simplification (Garland and Heckbert, "Surface Simplification Using Quadric
+	// Error Metrics"), used to generate the LOD meshes at import time.
+	// Edges are collapsed onto one of their vertices, so the simplified mesh only keeps a subset of the original
+	// vertices and their attributes. To keep the look of the mesh:
+	//  - vertices on a UV or normal seam (several vertices at the same position) never move,
+	//  - vertices shared by several submeshes never move, so do vertices of non-manifold edges,
+	//  - vertices on an open border only slide along the border,
+	//  - collapses that flip a triangle are rejected.
+	// The result is deterministic.
+	class MeshSimplifier
+	{
+	public:
+		MeshSimplifier() = delete;
+
+		// Simplify the triangles of indices down to about targetIndexCount indices, the triangles that are kept stay in
+		// their original order. triangleGroups (one per triangle, may be nullptr) keeps the vertices shared by different
+		// groups in place and is compacted along with indices. Returns the error of the last collapse.
+		static float SimplifyIndices(std::vector<uint32_t> & indices, const FishEngine::Vector3* positions, size_t vertexCount,
+			std::vector<uint32_t>* triangleGroups, size_t targetIndexCount);
+
+		// A new mesh with about ratio * triangleCount triangles, the submeshes and skinning data are kept.
+		// Unreferenced vertices are removed.
+		static FishEngine::MeshPtr Simplify(FishEngine::Mesh const & mesh, float ratio);
+	};
+}
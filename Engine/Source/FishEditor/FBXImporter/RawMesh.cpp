@@ -16,8 +16,7 @@ std::shared_ptr<Mesh> FishEngine::RawMesh::ToMesh()
 	// used to combine vertex with the same position/uv/...
 	//std::map<uint32_t, uint32_t> indexRemapping;
 
-	// TODO: makes indexed meshes more GPU-friendly
-	// https://github.com/zeux/meshoptimizer
+	// the index and vertex order is made GPU-friendly later by MeshOptimizer, once the bone weights are linked
 
 	//positionBuffer.resize(m_vertexCount);
 	normalBuffer.resize(m_vertexCount);    // minimum size
@@ -173,16 +173,18 @@ void Inspector::OnInspectorGUI(const FishEngine::MaterialPtr& material)
 	{
 		if (u.type == GL_FLOAT)
 		{
-			//EditorGUI::Slider(u.name.c_str(), &material->m_uniforms.floats[u.name], 0, 1);
-			EditorGUI::FloatField(u.name, &material->m_uniforms.floats[u.name]);
+			//EditorGUI::Slider(u.name.c_str(), material->PropertyValues(u.nameID, MaterialPropertyType::Float), 0, 1);
+			EditorGUI::FloatField(u.name, material->PropertyValues(u.nameID, MaterialPropertyType::Float));
 		}
 		else if (u.type == GL_FLOAT_VEC3)
 		{
-			EditorGUI::Vector3Field(u.name, &material->m_uniforms.vec3s[u.name]);
+			auto v = reinterpret_cast<Vector3*>(material->PropertyValues(u.nameID, MaterialPropertyType::Float3));
+			EditorGUI::Vector3Field(u.name, v);
 		}
 		else if (u.type == GL_FLOAT_VEC4)
 		{
-			EditorGUI::Vector4Field(u.name, &material->m_uniforms.vec4s[u.name]);
+			auto v = reinterpret_cast<Vector4*>(material->PropertyValues(u.nameID, MaterialPropertyType::Float4));
+			EditorGUI::Vector4Field(u.name, v);
 		}
 		else if (u.type == GL_SAMPLER_2D)
 		{
@@ -191,7 +193,7 @@ void Inspector::OnInspectorGUI(const FishEngine::MaterialPtr& material)
 			//ImGui::Image((void*)tex->GetNativeTexturePtr(), ImVec2(64, 64));
 			//ImGui::SameLine();
 			//ImGui::Button("Select");
-			auto& tex = material->m_textures[u.name];
+			auto& tex = material->PropertyTexture(u.nameID);
 			EditorGUI::TextureField(u.name, tex);
 		}
 	}
@@ -202,11 +204,15 @@ template<>
 void Inspector::OnInspectorGUI(const FishEngine::RendererPtr& renderer)
 {
 	EditorGUI::FloatField("Instance ID", renderer->GetInstanceID());
-	EditorGUI::EnumPopup("Cast Shadows", &renderer->m_shadowCastingMode);
+	// through the setters, RendererRegistry keeps its own copy of the shadow mode and the materials
+	auto shadowCastingMode = renderer->shadowCastingMode();
+	if (EditorGUI::EnumPopup("Cast Shadows", &shadowCastingMode))
+		renderer->setShadowCastingMode(shadowCastingMode);
 	EditorGUI::Toggle("Receive Shadows", &renderer->m_receiveShadows);
 	for (auto & material : renderer->m_materials)
 	{
-		EditorGUI::ObjectField("Material", material);
+		if (EditorGUI::ObjectField("Material", material))
+			RendererRegistry::SetStateDirty(*renderer);
 	}
 }
 
@@ -14,6 +14,7 @@
 #include <FishEngine/Scene.hpp>
 #include <FishEngine/Screen.hpp>
 #include <FishEngine/Graphics.hpp>
+#include <FishEngine/Pipeline.hpp>
 #include <FishEngine/Light.hpp>
 #include <FishEngine/RenderSettings.hpp>
 #include <FishEngine/QualitySettings.hpp>
@@ -31,6 +32,7 @@
 #include <FishEngine/AudioClip.hpp>
 #include <FishEngine/CapsuleCollider.hpp>
 #include <FishEngine/Rigidbody.hpp>
+#include <FishEngine/Render/GLStateCache.hpp>
 
 #include "SceneViewEditor.hpp"
 #include "Selection.hpp"
@@ -887,6 +889,9 @@ namespace FishEditor
 	{
 		GLint framebuffer; // qt's framebuffer
 		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+
+		// qt renders its own widgets into the same context between two frames
+		GLStateCache::Invalidate();
 		
 		//Input::Update();
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -909,7 +914,7 @@ namespace FishEditor
 		}
 		m_mainSceneViewEditor->Render();
 
-		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 		//Graphics::Blit()
 		glViewport(0, 0, Screen::width(), Screen::height());
 		auto quad = Mesh::builtinMesh(PrimitiveType::ScreenAlignedQuad);
@@ -917,6 +922,7 @@ namespace FishEditor
 		mtl->SetVector4("DrawRectParameters", Vector4(-1, -1, 1, 1));
 		mtl->setMainTexture(m_mainSceneViewEditor->m_colorBuffer);
 		Graphics::DrawMesh(quad, mtl);
+		Pipeline::EndFrame();
 		//Debug::Log("paintGL");
 
 		Input::Update();
@@ -693,6 +693,11 @@ namespace FishEditor
 		m_importNormals = rhs.m_importNormals;
 		m_importTangents = rhs.m_importTangents;
 		m_materialSearch = rhs.m_materialSearch;
+		m_optimizeMesh = rhs.m_optimizeMesh;
+		m_optimizeMeshForOverdraw = rhs.m_optimizeMeshForOverdraw;
+		m_generateLODs = rhs.m_generateLODs;
+		m_lodCount = rhs.m_lodCount;
+		m_lodReductionRatio = rhs.m_lodReductionRatio;
 		return *this;
 	}
 	
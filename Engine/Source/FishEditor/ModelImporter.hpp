@@ -2,6 +2,7 @@
 #define ModelImporter_hpp
 
 #include "AssetImporter.hpp"
+#include "FBXImporter/MeshOptimizer.hpp"
 #include <FishEngine/Mesh.hpp>
 #include <FishEngine/Scene.hpp>
 #include <FishEngine/Material.hpp>
@@ -179,6 +180,12 @@ namespace FishEditor
 			m_importTangents = importTangents;
 		}
 
+		// Vertex cache statistics of the meshes of the last import, before and after the optimization.
+		MeshOptimizationStatistics const & meshOptimizationStatistics() const
+		{
+			return m_meshOptimizationStatistics;
+		}
+
 	protected:
 
 		Meta(NonSerializable)
@@ -211,6 +218,24 @@ namespace FishEditor
 		// Existing material search setting.
 		ModelImporterMaterialSearch m_materialSearch;
 
+		// Reorder the triangles and vertices of the meshes for the vertex cache and vertex fetch.
+		bool m_optimizeMesh = true;
+
+		// Also reorder the triangles to reduce overdraw, at a small cost of vertex cache efficiency.
+		bool m_optimizeMeshForOverdraw = false;
+
+		// Generate simplified meshes for the LODs of every mesh and put them in a LODGroup.
+		bool m_generateLODs = false;
+
+		// Number of LODs including the original mesh, at most LODGroup::kMaxLODs.
+		int m_lodCount = 3;
+
+		// Triangle count of each LOD relative to the previous one.
+		float m_lodReductionRatio = 0.5f;
+
+		Meta(NonSerializable)
+		MeshOptimizationStatistics m_meshOptimizationStatistics;
+
 		// remove dummy nodes
 		Meta(NonSerializable)
 		std::map<std::string, std::map<std::string, FishEngine::Matrix4x4>> m_nodeTransformations;
@@ -22,6 +22,7 @@
 #include <FishEngine/Command.hpp>
 #include <FishEngine/RenderBuffer.hpp>
 #include <FishEngine/Light.hpp>
+#include <FishEngine/Render/GLStateCache.hpp>
 
 #include "Selection.hpp"
 #include "EditorResources.hpp"
@@ -135,9 +136,9 @@ namespace FishEditor
 		/************************************************************************/
 		/* Gizmos                                                               */
 		/************************************************************************/
-		glDepthFunc(GL_LEQUAL);
+		GLStateCache::SetDepthFunc(GL_LEQUAL);
 		Scene::OnDrawGizmos();
-		glDepthFunc(GL_LESS);
+		GLStateCache::SetDepthFunc(GL_LESS);
 
 		Gizmos::setColor(Color::red);
 		Bounds b = Scene::bounds();
@@ -7,6 +7,8 @@
 #include <FishEngine/Common.hpp>
 #include <FishEngine/Mathf.hpp>
 #include <FishEngine/Texture2D.hpp>
+#include <FishEngine/Render/TextureStreaming.hpp>
+#include <FishEngine/Render/GLStateCache.hpp>
 
 #include "AssetDataBase.hpp"
 
@@ -95,6 +97,190 @@ BOOL SwapRedBlue32(FIBITMAP* dib) {
 }
 
 
+// Decode the image at path into level 0 of image and a 64px thumbnail, runs on a TextureStreaming worker.
+static bool DecodeImage(Path const & path, TextureStreamingImage & image, QImage & thumbnailImage)
+{
+	FREE_IMAGE_FORMAT fif = FIF_UNKNOWN;
+	FIBITMAP *dib = nullptr;
+	uint8_t * bits = nullptr;
+	unsigned int width = 0, height = 0;
+#if FISHENGINE_PLATFORM_WINDOWS
+	auto filename = path.wstring();
+	fif = FreeImage_GetFileTypeU(filename.c_str());
+	if (fif == FIF_UNKNOWN)
+	{
+		fif = FreeImage_GetFIFFromFilenameU(filename.c_str());
+	}
+	if (fif == FIF_UNKNOWN || !FreeImage_FIFSupportsReading(fif))
+	{
+		return false;
+	}
+	dib = FreeImage_LoadU(fif, filename.c_str());
+#else
+	auto filename = path.c_str();
+	fif = FreeImage_GetFileType(filename);
+	if (fif == FIF_UNKNOWN)
+	{
+		fif = FreeImage_GetFIFFromFilename(filename);
+	}
+	if (fif == FIF_UNKNOWN || !FreeImage_FIFSupportsReading(fif))
+	{
+		return false;
+	}
+	dib = FreeImage_Load(fif, filename);
+#endif
+	if (dib == nullptr)
+	{
+		return false;
+	}
+
+	//retrieve the image data
+	bits = FreeImage_GetBits(dib);
+	//get the image width and height
+	width = FreeImage_GetWidth(dib);
+	height = FreeImage_GetHeight(dib);
+	//if this somehow one of these failed (they shouldn't), return failure
+	if ((bits == 0) || (width == 0) || (height == 0))
+	{
+		FreeImage_Unload(dib);
+		return false;
+	}
+
+	bool needResize = false;
+	if ( ! Mathf::IsPowerOfTwo(width) )
+	{
+		width = Mathf::NextPowerOfTwo(width);
+		needResize = true;
+	}
+	if ( ! Mathf::IsPowerOfTwo(height) )
+	{
+		height = Mathf::NextPowerOfTwo(height);
+		needResize = true;
+	}
+
+	if (needResize)
+	{
+		LogWarning("resize image");
+		auto newdib = FreeImage_Rescale(dib, width, height);
+		FreeImage_Unload(dib);
+		dib = newdib;
+	}
+
+	auto imageType = FreeImage_GetImageType(dib);
+	auto colorType = FreeImage_GetColorType(dib);
+	auto bpp = FreeImage_GetBPP(dib);
+
+	TextureFormat format;
+	bool supported = true;
+
+	if (imageType == FIT_BITMAP)
+	{
+		if (colorType == FIC_MINISWHITE || colorType == FIC_MINISBLACK)
+		{
+			auto newBitmap = FreeImage_ConvertToGreyscale(dib);
+			FreeImage_Unload(dib);
+			dib = newBitmap;
+			bpp = FreeImage_GetBPP(dib);
+			colorType = FreeImage_GetColorType(dib);
+		}
+		else if (bpp < 8 || colorType == FIC_PALETTE || colorType == FIC_CMYK)
+		{
+			auto newBitmap = FreeImage_ConvertTo24Bits(dib);
+			FreeImage_Unload(dib);
+			dib = newBitmap;
+			bpp = FreeImage_GetBPP(dib);
+			colorType = FreeImage_GetColorType(dib);
+		}
+
+		// by this stage, 8-bit is greyscale, 16/24/32 bit are RGB[A]
+		switch (bpp)
+		{
+			case 8:
+				format = TextureFormat::R8;
+				break;
+			case 24:
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+				// unity does not support BGR24
+				SwapRedBlue32(dib);
+#endif
+				format = TextureFormat::RGB24;
+				break;
+			case 32:
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_RGB
+				format = TextureFormat::RGBA32;
+#else
+				format = TextureFormat::BGRA32;
+#endif
+				break;
+			default:
+				// 16 bit (565 or 555): Format not supported by the engine. TODO.
+				supported = false;
+				break;
+		}
+	}
+	else if (imageType == FIT_FLOAT)
+	{
+		format = TextureFormat::RFloat;
+	}
+	else
+	{
+		// INT and RGB16 pixel formats: Format not supported by the engine. TODO.
+		supported = false;
+	}
+
+	unsigned char* srcData = FreeImage_GetBits(dib);
+	unsigned srcPitch = FreeImage_GetPitch(dib);
+	if (!supported || srcPitch != width * (bpp / 8))
+	{
+		FreeImage_Unload(dib);
+		return false;
+	}
+
+	int length = width * height * (bpp / 8);
+	image.width = width;
+	image.height = height;
+	image.format = format;
+	image.data.assign(srcData, srcData + length);
+
+	// get icon
+	auto thumbnail = FreeImage_MakeThumbnail(dib, 64);
+	FreeImage_FlipVertical(thumbnail);	// flip for Qt
+	QImage::Format qformat = QImage::Format_Invalid;
+	if (format == TextureFormat::RGBA32)
+	{
+		qformat = QImage::Format_RGBA8888;
+	}
+	else if (format == TextureFormat::BGRA32)
+	{
+		// TODO
+		SwapRedBlue32(thumbnail);
+		qformat = QImage::Format_RGBA8888;
+	}
+	else if (format == TextureFormat::RGB24)
+	{
+		qformat = QImage::Format_RGB888;
+	}
+	else if (format == TextureFormat::R8)
+	{
+		qformat = QImage::Format_Grayscale8;
+	}
+	if (qformat != QImage::Format_Invalid)
+	{
+		auto data = FreeImage_GetBits(thumbnail);
+		width = FreeImage_GetWidth(thumbnail);
+		height = FreeImage_GetHeight(thumbnail);
+		length = width * height * (bpp / 8);
+		thumbnailImage = QImage(width, height, qformat);
+		std::copy(data, data + length, thumbnailImage.bits());
+	}
+
+	// clean
+	FreeImage_Unload(thumbnail);
+	FreeImage_Unload(dib);
+	return true;
+}
+
+
 namespace FishEditor
 {
 	TextureImporter& TextureImporter::operator=(TextureImporter const & rhs)
@@ -180,221 +366,48 @@ namespace FishEditor
 	
 	void TextureImporter::ImportTo(FishEngine::Texture2DPtr & texture)
 	{
-		auto fm_instance = FreeImagePlugin::instance();
-		FREE_IMAGE_FORMAT fif = FIF_UNKNOWN;
-		FIBITMAP *dib = nullptr;
-		uint8_t * bits = nullptr;
-		unsigned int width = 0, height = 0;
-#if FISHENGINE_PLATFORM_WINDOWS
-		auto filename = m_assetPath.wstring().c_str();
-		fif = FreeImage_GetFileTypeU(filename);
-		if (fif == FIF_UNKNOWN)
-		{
-			fif = FreeImage_GetFIFFromFilenameU(filename);
-		}
-		if (fif == FIF_UNKNOWN)
-		{
-			abort();
-		}
-		if (FreeImage_FIFSupportsReading(fif))
-		{
-			dib = FreeImage_LoadU(fif, filename);
-		}
-		else
-		{
-			abort();
-		}
-#else
-		auto filename = m_assetPath.c_str();
-		fif = FreeImage_GetFileType(filename);
-		if (fif == FIF_UNKNOWN)
-		{
-			fif = FreeImage_GetFIFFromFilename(filename);
-		}
-		if (fif == FIF_UNKNOWN)
-		{
-			abort();
-		}
-		if (FreeImage_FIFSupportsReading(fif))
-		{
-			dib = FreeImage_Load(fif, filename);
-		}
-		else
-		{
-			abort();
-		}
-#endif
-			
-		//retrieve the image data
-		bits = FreeImage_GetBits(dib);
-		//get the image width and height
-		width = FreeImage_GetWidth(dib);
-		height = FreeImage_GetHeight(dib);
-		//if this somehow one of these failed (they shouldn't), return failure
-		if ((bits == 0) || (width == 0) || (height == 0))
-		{
-			abort();
-		}
+		FreeImagePlugin::instance();
+		auto path = m_assetPath;
 
-		bool needResize = false;
-		if ( ! Mathf::IsPowerOfTwo(width) )
+		if (!TextureStreaming::enabled())
 		{
-			width = Mathf::NextPowerOfTwo(width);
-			needResize = true;
-		}
-		if ( ! Mathf::IsPowerOfTwo(height) )
-		{
-			height = Mathf::NextPowerOfTwo(height);
-			needResize = true;
-		}
-			
-		if (needResize)
-		{
-			LogWarning("resize image");
-			auto newdib = FreeImage_Rescale(dib, width, height);
-			FreeImage_Unload(dib);
-			dib = newdib;
-		}
-			
-		auto imageType = FreeImage_GetImageType(dib);
-		auto colorType = FreeImage_GetColorType(dib);
-		auto bpp = FreeImage_GetBPP(dib);
-			
-		TextureFormat format;
-			
-		if (imageType == FIT_BITMAP)
-		{
-			if (colorType == FIC_MINISWHITE || colorType == FIC_MINISBLACK)
+			// decode here, Texture2D::UploadToGPU uploads the pixels on first use
+			TextureStreamingImage image;
+			QImage thumbnail;
+			if (!DecodeImage(path, image, thumbnail))
 			{
-				auto newBitmap = FreeImage_ConvertToGreyscale(dib);
-				FreeImage_Unload(dib);
-				dib = newBitmap;
-				bpp = FreeImage_GetBPP(dib);
-				colorType = FreeImage_GetColorType(dib);
+				LogError("TextureImporter: failed to load " + path.string());
+				return;
 			}
-			else if (bpp < 8 || colorType == FIC_PALETTE || colorType == FIC_CMYK)
+			if (texture->m_streaming)
+				TextureStreaming::Cancel(texture.get());
+			// reimport: drop the previous contents
+			if (texture->m_GLNativeTexture != 0)
 			{
-				auto newBitmap = FreeImage_ConvertTo24Bits(dib);
-				FreeImage_Unload(dib);
-				dib = newBitmap;
-				bpp = FreeImage_GetBPP(dib);
-				colorType = FreeImage_GetColorType(dib);
+				GLStateCache::DeleteTexture(texture->m_GLNativeTexture);
+				texture->m_GLNativeTexture = 0;
 			}
-				
-			// by this stage, 8-bit is greyscale, 16/24/32 bit are RGB[A]
-			switch (bpp)
-			{
-				case 8:
-					format = TextureFormat::R8;
-					break;
-				case 16:
-					if (FreeImage_GetGreenMask(dib) == FI16_565_GREEN_MASK)
-					{
-						//"Format not supported by the engine. TODO."
-						abort();
-					}
-					else
-					{
-						//"Format not supported by the engine. TODO."
-						abort();
-					}
-					break;
-				case 24:
-#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
-					// unity does not support BGR24
-					SwapRedBlue32(dib);
-#endif
-					format = TextureFormat::RGB24;
-					break;
-				case 32:
-#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_RGB
-					format = TextureFormat::RGBA32;
-#else
-					format = TextureFormat::BGRA32;
-#endif
-					break;
-				default:
-					break;
-			}
-		}
-		else if (imageType == FIT_UINT16 || imageType == FIT_INT16)
-		{
-			// "No INT pixel formats supported currently. TODO."
-			abort();
-		}
-		else if (imageType == FIT_FLOAT)
-		{
-			format = TextureFormat::RFloat;
-		}
-		else if (imageType == FIT_RGB16)
-		{
-			// Format not supported by the engine. TODO.
-			abort();
-		}
-		else
-		{
-			abort();
-		}
-			
-		unsigned char* srcData = FreeImage_GetBits(dib);
-		unsigned srcPitch = FreeImage_GetPitch(dib);
-		if (srcPitch != width * (bpp / 8))
-		{
-			abort();
+			texture->m_uploaded = false;
+			texture->m_width = image.width;
+			texture->m_height = image.height;
+			texture->m_format = image.format;
+			texture->m_data.swap(image.data);
+			if (!thumbnail.isNull())
+				AssetDatabase::s_cacheIcons[path] = QIcon(QPixmap::fromImage(thumbnail));
+			return;
 		}
-			
-		int length = width * height * (bpp / 8);
-//			if (expectedBytes != length)
-//			{
-//				abort();
-//			}
-		auto data = srcData;
-		texture->m_width = width;
-		texture->m_height = height;
-		texture->m_format = format;
-		texture->m_data.resize(length);
-		std::copy(data, data + length, texture->m_data.begin());
-			
-		// get icon
-		auto thumbnail = FreeImage_MakeThumbnail(dib, 64);
-		FreeImage_FlipVertical(thumbnail);	// flip for Qt
-		QImage::Format qformat;
-		if (format == TextureFormat::RGBA32)
-		{
-			qformat = QImage::Format_RGBA8888;
-		}
-		else if (format == TextureFormat::BGRA32)
-		{
-			// TODO
-			SwapRedBlue32(thumbnail);
-			//data = FreeImage_GetBits(dib);
-			qformat = QImage::Format_RGBA8888;
-		}
-		else if (format == TextureFormat::RGB24)
-		{
-			qformat = QImage::Format_RGB888;
-				
-		}
-		else if (format == TextureFormat::R8)
+
+		auto thumbnail = std::make_shared<QImage>();
+		auto decoder = [path, thumbnail](TextureStreamingImage & image)
 		{
-			qformat = QImage::Format_Grayscale8;
-		}
-		else
+			return DecodeImage(path, image, *thumbnail);
+		};
+		auto onLoaded = [path, thumbnail](Texture2D &)
 		{
-			abort();
-		}
-		data = FreeImage_GetBits(thumbnail);
-		width = FreeImage_GetWidth(thumbnail);
-		height = FreeImage_GetHeight(thumbnail);
-		length = width * height * (bpp / 8);
-		auto qimage = QImage(width, height, qformat);
-		std::copy(data, data + length, qimage.bits());
-		auto qpixmap = QPixmap::fromImage(std::move(qimage));
-		AssetDatabase::s_cacheIcons[m_assetPath] = QIcon(qpixmap);
-
-		// clean
-		FreeImage_Unload(thumbnail);
-		FreeImage_Unload(dib);
+			if (!thumbnail->isNull())
+				AssetDatabase::s_cacheIcons[path] = QIcon(QPixmap::fromImage(*thumbnail));
+		};
+		TextureStreaming::Load(texture.get(), decoder, onLoaded);
 	}
 
 	FishEngine::TexturePtr TextureImporter::Import(Path const & path)
@@ -1,3 +1,6 @@
+// QOpenGLFunctions declares members named like the gl* entry points, keep them out of the device dispatch.
+// This file makes no GL calls itself.
+#define FISHENGINE_NO_GL_DISPATCH
 #include <FishEngine/GLEnvironment.hpp>
 #include "GLWidget.hpp"
 #include <QMouseEvent>
@@ -21,6 +21,7 @@
 #include <FishEngine/Path.hpp>
 #include <FishEngine/Shader.hpp>
 #include <FishEngine/ShaderCompiler.hpp>
+#include <FishEngine/Render/ShaderCache.hpp>
 
 #include "EditorResources.hpp"
 #include "Inspector.hpp"
@@ -213,6 +214,7 @@ void MainWindow::Init()
 	ShaderCompiler::setShaderIncludeDir(shaderIncludeDir.string());
 	//ShaderCompiler::s_shaderIncludeDir = shaderRootDirectory() / "include";
 	
+	ShaderCache::Init(ShaderCache::DefaultDirectory());
 	Shader::Init(shaderRoot.string());
 
 	//FishEngine::Timer t("Load assets");
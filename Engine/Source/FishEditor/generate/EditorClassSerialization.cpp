@@ -225,6 +225,11 @@ namespace FishEditor
 		archive << FishEngine::make_nvp("m_importNormals", m_importNormals); // FishEditor::ModelImporterNormals
 		archive << FishEngine::make_nvp("m_importTangents", m_importTangents); // FishEditor::ModelImporterTangents
 		archive << FishEngine::make_nvp("m_materialSearch", m_materialSearch); // FishEditor::ModelImporterMaterialSearch
+		archive << FishEngine::make_nvp("m_optimizeMesh", m_optimizeMesh); // bool
+		archive << FishEngine::make_nvp("m_optimizeMeshForOverdraw", m_optimizeMeshForOverdraw); // bool
+		archive << FishEngine::make_nvp("m_generateLODs", m_generateLODs); // bool
+		archive << FishEngine::make_nvp("m_lodCount", m_lodCount); // int
+		archive << FishEngine::make_nvp("m_lodReductionRatio", m_lodReductionRatio); // float
 		//archive.EndClass();
 	}
 
@@ -236,6 +241,11 @@ namespace FishEditor
 		archive >> FishEngine::make_nvp("m_importNormals", m_importNormals); // FishEditor::ModelImporterNormals
 		archive >> FishEngine::make_nvp("m_importTangents", m_importTangents); // FishEditor::ModelImporterTangents
 		archive >> FishEngine::make_nvp("m_materialSearch", m_materialSearch); // FishEditor::ModelImporterMaterialSearch
+		archive >> FishEngine::make_nvp("m_optimizeMesh", m_optimizeMesh); // bool
+		archive >> FishEngine::make_nvp("m_optimizeMeshForOverdraw", m_optimizeMeshForOverdraw); // bool
+		archive >> FishEngine::make_nvp("m_generateLODs", m_generateLODs); // bool
+		archive >> FishEngine::make_nvp("m_lodCount", m_lodCount); // int
+		archive >> FishEngine::make_nvp("m_lodReductionRatio", m_lodReductionRatio); // float
 		//archive.EndClass();
 	}
 
@@ -7,6 +7,9 @@
 #include <FishEngine/AnimationClip.hpp>
 #include <FishEngine/Time.hpp>
 #include <FishEngine/Avatar.hpp>
+#include <FishEngine/GameObject.hpp>
+#include <FishEngine/SkinnedMeshRenderer.hpp>
+#include <FishEngine/Render/RendererRegistry.hpp>
 
 using namespace FishEngine;
 
@@ -36,12 +39,44 @@ void GetSkeleton(
 
 void Animation::Start()
 {
+	CollectRenderers();
+
 	if (m_clip == nullptr)
 		return;
 	auto t = transform();
 	GetSkeleton(t, "", m_skeleton, m_clip->m_avatar->m_boneToIndex);
 }
 
+void Animation::CollectRenderers() const
+{
+	// renderers added, removed or re-parented below this game object bump the structure version
+	const uint32_t structureVersion = RendererRegistry::structureVersion();
+	if (m_renderersVersion == structureVersion)
+		return;
+	m_renderers.clear();
+	for (auto & renderer : gameObject()->GetComponentsInChildren<SkinnedMeshRenderer>())
+	{
+		m_renderers.push_back(renderer);
+	}
+	m_renderersVersion = structureVersion;
+}
+
+bool Animation::IsVisible() const
+{
+	CollectRenderers();
+	bool hasRenderer = false;
+	for (auto & r : m_renderers)
+	{
+		auto renderer = r.lock();
+		if (renderer == nullptr)
+			continue;
+		if (renderer->isVisible())
+			return true;
+		hasRenderer = true;
+	}
+	return !hasRenderer;
+}
+
 TransformPtr GetBone(std::string const & path, std::map<std::string, TransformPtr> const & skeleton)
 {
 	auto it = skeleton.find(path);
@@ -58,7 +93,13 @@ void Animation::Update()
 {
 	if (m_clip == nullptr)
 		return;
+	const bool visible = m_cullingMode == AnimationCullingMode::AlwaysAnimate || IsVisible();
+	if (!visible && m_cullingMode == AnimationCullingMode::CullCompletely)
+		return;
 	m_localTimer += Time::deltaTime();
+	// the bones keep their pose, so the renderers skip skinning too
+	if (!visible)
+		return;
 	for (auto & curve : m_clip->m_positionCurve)
 	{
 		auto t = GetBone(curve.path, m_skeleton);
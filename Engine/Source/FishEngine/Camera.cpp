@@ -1,4 +1,7 @@
 #include <FishEngine/Camera.hpp>
+
+#include <algorithm>
+
 #include <FishEngine/GameObject.hpp>
 #include <FishEngine/Scene.hpp>
 #include <FishEngine/Screen.hpp>
@@ -88,6 +91,43 @@ namespace FishEngine
 		return transform()->worldToLocalMatrix();
 	}
 
+	void Camera::AddCommandBuffer(Rendering::CameraEvent evt, Rendering::CommandBufferPtr const & buffer)
+	{
+		assert(buffer != nullptr);
+		m_commandBuffers[static_cast<int>(evt)].push_back(buffer);
+	}
+
+	void Camera::RemoveCommandBuffer(Rendering::CameraEvent evt, Rendering::CommandBufferPtr const & buffer)
+	{
+		auto & buffers = m_commandBuffers[static_cast<int>(evt)];
+		buffers.erase(std::remove(buffers.begin(), buffers.end(), buffer), buffers.end());
+	}
+
+	void Camera::RemoveCommandBuffers(Rendering::CameraEvent evt)
+	{
+		m_commandBuffers[static_cast<int>(evt)].clear();
+	}
+
+	void Camera::RemoveAllCommandBuffers()
+	{
+		for (auto & buffers : m_commandBuffers)
+			buffers.clear();
+	}
+
+	int Camera::commandBufferCount() const
+	{
+		std::size_t count = 0;
+		for (auto & buffers : m_commandBuffers)
+			count += buffers.size();
+		return static_cast<int>(count);
+	}
+
+	void Camera::ExecuteCommandBuffers(Rendering::CameraEvent evt) const
+	{
+		for (auto & buffer : m_commandBuffers[static_cast<int>(evt)])
+			buffer->Execute();
+	}
+
 	void Camera::OnDrawGizmos()
 	{
 		Gizmos::DrawIcon(transform()->position(), "Camera");
@@ -0,0 +1,394 @@
+#include <FishEngine/CommandBuffer.hpp>
+
+#include <cstring>
+#include <cassert>
+
+#include <FishEngine/GLEnvironment.hpp>
+#include <FishEngine/Matrix4x4.hpp>
+#include <FishEngine/Vector4.hpp>
+#include <FishEngine/Mesh.hpp>
+#include <FishEngine/Material.hpp>
+#include <FishEngine/Shader.hpp>
+#include <FishEngine/Texture.hpp>
+#include <FishEngine/Graphics.hpp>
+#include <FishEngine/Pipeline.hpp>
+#include <FishEngine/RenderTarget.hpp>
+#include <FishEngine/PrimitiveType.hpp>
+#include <FishEngine/Render/GLStateCache.hpp>
+
+namespace FishEngine
+{
+namespace Rendering
+{
+	enum class CommandBuffer::CommandType : uint16_t
+	{
+		DrawMesh,
+		DrawMeshInstanced,
+		SetRenderTarget,
+		ClearRenderTarget,
+		SetFloat,
+		SetVector,
+		SetMatrix,
+		SetTexture,
+		Blit,
+	};
+
+	namespace
+	{
+		constexpr uint32_t kNullReference = ~0u;
+
+		struct CommandHeader
+		{
+			uint16_t	type;
+			uint16_t	padding;
+			uint32_t	size;	// payload + extra data, in bytes
+		};
+
+		struct DrawMeshCommand
+		{
+			uint32_t	mesh;
+			uint32_t	material;
+			int32_t		subMeshIndex;
+			Matrix4x4	matrix;
+		};
+
+		struct DrawMeshInstancedCommand
+		{
+			uint32_t	mesh;
+			uint32_t	material;
+			int32_t		subMeshIndex;
+			uint32_t	count;		// followed by count matrices
+		};
+
+		struct SetRenderTargetCommand
+		{
+			uint32_t	renderTarget;
+		};
+
+		struct ClearRenderTargetCommand
+		{
+			uint32_t	clearColor;
+			uint32_t	clearDepth;
+			float		color[4];
+			float		depth;
+		};
+
+		template<class T>
+		struct SetPropertyCommand
+		{
+			uint32_t	material;
+			int32_t		nameID;		// Shader::PropertyToID
+			T			value;
+		};
+
+		struct BlitCommand
+		{
+			uint32_t	source;
+			uint32_t	dest;
+			uint32_t	material;
+		};
+
+		// the stream is not aligned, copy the payload out
+		template<class T>
+		inline T Read(const uint8_t* data)
+		{
+			T t;
+			std::memcpy(&t, data, sizeof(T));
+			return t;
+		}
+
+		// consecutive commands usually reference the same objects
+		template<class T>
+		inline uint32_t AddReference(std::vector<T> & table, T const & value)
+		{
+			if (!table.empty() && table.back() == value)
+				return static_cast<uint32_t>(table.size() - 1);
+			table.push_back(value);
+			return static_cast<uint32_t>(table.size() - 1);
+		}
+	}
+
+	void CommandBuffer::Clear()
+	{
+		m_commandCount = 0;
+		m_stream.clear();
+		m_meshes.clear();
+		m_materials.clear();
+		m_textures.clear();
+		m_renderTargets.clear();
+	}
+
+	void CommandBuffer::Append(CommandType type, const void* payload, uint32_t size, const void* extra, uint32_t extraSize)
+	{
+		CommandHeader header;
+		header.type = static_cast<uint16_t>(type);
+		header.padding = 0;
+		header.size = size + extraSize;
+
+		const std::size_t offset = m_stream.size();
+		m_stream.resize(offset + sizeof(header) + header.size);
+		uint8_t* dst = m_stream.data() + offset;
+		std::memcpy(dst, &header, sizeof(header));
+		std::memcpy(dst + sizeof(header), payload, size);
+		if (extraSize > 0)
+			std::memcpy(dst + sizeof(header) + size, extra, extraSize);
+		m_commandCount++;
+	}
+
+	uint32_t CommandBuffer::Reference(MeshPtr const & mesh)
+	{
+		return AddReference(m_meshes, mesh);
+	}
+
+	uint32_t CommandBuffer::Reference(MaterialPtr const & material)
+	{
+		return AddReference(m_materials, material);
+	}
+
+	uint32_t CommandBuffer::Reference(TexturePtr const & texture)
+	{
+		return AddReference(m_textures, texture);
+	}
+
+	uint32_t CommandBuffer::Reference(RenderTargetPtr const & renderTarget)
+	{
+		if (renderTarget == nullptr)
+			return kNullReference;
+		return AddReference(m_renderTargets, renderTarget);
+	}
+
+	void CommandBuffer::DrawMesh(MeshPtr const & mesh, Matrix4x4 const & matrix, MaterialPtr const & material, int subMeshIndex)
+	{
+		assert(mesh != nullptr && material != nullptr);
+		DrawMeshCommand cmd;
+		cmd.mesh = Reference(mesh);
+		cmd.material = Reference(material);
+		cmd.subMeshIndex = subMeshIndex;
+		cmd.matrix = matrix;
+		Append(CommandType::DrawMesh, &cmd, sizeof(cmd));
+	}
+
+	void CommandBuffer::DrawMeshInstanced(MeshPtr const & mesh, int subMeshIndex, MaterialPtr const & material, std::vector<Matrix4x4> const & matrices)
+	{
+		assert(mesh != nullptr && material != nullptr);
+		if (matrices.empty())
+			return;
+		DrawMeshInstancedCommand cmd;
+		cmd.mesh = Reference(mesh);
+		cmd.material = Reference(material);
+		cmd.subMeshIndex = subMeshIndex;
+		cmd.count = static_cast<uint32_t>(matrices.size());
+		Append(CommandType::DrawMeshInstanced, &cmd, sizeof(cmd), matrices.data(), static_cast<uint32_t>(matrices.size() * sizeof(Matrix4x4)));
+	}
+
+	void CommandBuffer::SetRenderTarget(RenderTargetPtr const & renderTarget)
+	{
+		SetRenderTargetCommand cmd;
+		cmd.renderTarget = Reference(renderTarget);
+		Append(CommandType::SetRenderTarget, &cmd, sizeof(cmd));
+	}
+
+	void CommandBuffer::ClearRenderTarget(bool clearDepth, bool clearColor, Color const & backgroundColor, float depth)
+	{
+		ClearRenderTargetCommand cmd;
+		cmd.clearColor = clearColor ? 1 : 0;
+		cmd.clearDepth = clearDepth ? 1 : 0;
+		cmd.color[0] = backgroundColor.r;
+		cmd.color[1] = backgroundColor.g;
+		cmd.color[2] = backgroundColor.b;
+		cmd.color[3] = backgroundColor.a;
+		cmd.depth = depth;
+		Append(CommandType::ClearRenderTarget, &cmd, sizeof(cmd));
+	}
+
+	void CommandBuffer::SetMaterialFloat(MaterialPtr const & material, std::string const & name, float value)
+	{
+		SetMaterialFloat(material, Shader::PropertyToID(name), value);
+	}
+
+	void CommandBuffer::SetMaterialFloat(MaterialPtr const & material, int nameID, float value)
+	{
+		SetPropertyCommand<float> cmd;
+		cmd.material = Reference(material);
+		cmd.nameID = nameID;
+		cmd.value = value;
+		Append(CommandType::SetFloat, &cmd, sizeof(cmd));
+	}
+
+	void CommandBuffer::SetMaterialVector(MaterialPtr const & material, std::string const & name, Vector4 const & value)
+	{
+		SetMaterialVector(material, Shader::PropertyToID(name), value);
+	}
+
+	void CommandBuffer::SetMaterialVector(MaterialPtr const & material, int nameID, Vector4 const & value)
+	{
+		SetPropertyCommand<Vector4> cmd;
+		cmd.material = Reference(material);
+		cmd.nameID = nameID;
+		cmd.value = value;
+		Append(CommandType::SetVector, &cmd, sizeof(cmd));
+	}
+
+	void CommandBuffer::SetMaterialMatrix(MaterialPtr const & material, std::string const & name, Matrix4x4 const & value)
+	{
+		SetMaterialMatrix(material, Shader::PropertyToID(name), value);
+	}
+
+	void CommandBuffer::SetMaterialMatrix(MaterialPtr const & material, int nameID, Matrix4x4 const & value)
+	{
+		SetPropertyCommand<Matrix4x4> cmd;
+		cmd.material = Reference(material);
+		cmd.nameID = nameID;
+		cmd.value = value;
+		Append(CommandType::SetMatrix, &cmd, sizeof(cmd));
+	}
+
+	void CommandBuffer::SetMaterialTexture(MaterialPtr const & material, std::string const & name, TexturePtr const & texture)
+	{
+		SetMaterialTexture(material, Shader::PropertyToID(name), texture);
+	}
+
+	void CommandBuffer::SetMaterialTexture(MaterialPtr const & material, int nameID, TexturePtr const & texture)
+	{
+		SetPropertyCommand<uint32_t> cmd;
+		cmd.material = Reference(material);
+		cmd.nameID = nameID;
+		cmd.value = Reference(texture);
+		Append(CommandType::SetTexture, &cmd, sizeof(cmd));
+	}
+
+	void CommandBuffer::Blit(TexturePtr const & source, RenderTargetPtr const & dest, MaterialPtr const & material)
+	{
+		assert(source != nullptr);
+		BlitCommand cmd;
+		cmd.source = Reference(source);
+		cmd.dest = Reference(dest);
+		cmd.material = material == nullptr ? kNullReference : Reference(material);
+		Append(CommandType::Blit, &cmd, sizeof(cmd));
+	}
+
+	void CommandBuffer::Execute() const
+	{
+		// render targets pushed by this buffer, popped again at the end
+		int pushedRenderTargets = 0;
+
+		const uint8_t* data = m_stream.data();
+		const std::size_t streamSize = m_stream.size();
+		std::size_t cursor = 0;
+		while (cursor < streamSize)
+		{
+			auto header = Read<CommandHeader>(data + cursor);
+			cursor += sizeof(CommandHeader);
+			const uint8_t* payload = data + cursor;
+			cursor += header.size;
+
+			switch (static_cast<CommandType>(header.type))
+			{
+			case CommandType::DrawMesh:
+			{
+				auto cmd = Read<DrawMeshCommand>(payload);
+				Pipeline::UpdatePerDrawUniforms(cmd.matrix);
+				Graphics::DrawMesh(m_meshes[cmd.mesh], m_materials[cmd.material], cmd.subMeshIndex);
+				break;
+			}
+			case CommandType::DrawMeshInstanced:
+			{
+				auto cmd = Read<DrawMeshInstancedCommand>(payload);
+				thread_local std::vector<Matrix4x4> matrices;
+				matrices.resize(cmd.count);
+				std::memcpy(matrices.data(), payload + sizeof(cmd), cmd.count * sizeof(Matrix4x4));
+				Graphics::DrawMeshInstanced(m_meshes[cmd.mesh], cmd.subMeshIndex, m_materials[cmd.material], matrices);
+				break;
+			}
+			case CommandType::SetRenderTarget:
+			{
+				auto cmd = Read<SetRenderTargetCommand>(payload);
+				if (pushedRenderTargets > 0)
+				{
+					Pipeline::PopRenderTarget();
+					pushedRenderTargets--;
+				}
+				if (cmd.renderTarget != kNullReference)
+				{
+					Pipeline::PushRenderTarget(m_renderTargets[cmd.renderTarget]);
+					pushedRenderTargets++;
+				}
+				break;
+			}
+			case CommandType::ClearRenderTarget:
+			{
+				auto cmd = Read<ClearRenderTargetCommand>(payload);
+				if (cmd.clearColor)
+				{
+					glClearBufferfv(GL_COLOR, 0, cmd.color);
+				}
+				if (cmd.clearDepth)
+				{
+					// glClear respects the depth mask
+					GLStateCache::SetDepthMask(true);
+					glClearBufferfv(GL_DEPTH, 0, &cmd.depth);
+				}
+				break;
+			}
+			case CommandType::SetFloat:
+			{
+				auto cmd = Read<SetPropertyCommand<float>>(payload);
+				m_materials[cmd.material]->SetFloat(cmd.nameID, cmd.value);
+				break;
+			}
+			case CommandType::SetVector:
+			{
+				auto cmd = Read<SetPropertyCommand<Vector4>>(payload);
+				m_materials[cmd.material]->SetVector4(cmd.nameID, cmd.value);
+				break;
+			}
+			case CommandType::SetMatrix:
+			{
+				auto cmd = Read<SetPropertyCommand<Matrix4x4>>(payload);
+				m_materials[cmd.material]->SetMatrix(cmd.nameID, cmd.value);
+				break;
+			}
+			case CommandType::SetTexture:
+			{
+				auto cmd = Read<SetPropertyCommand<uint32_t>>(payload);
+				m_materials[cmd.material]->SetTexture(cmd.nameID, m_textures[cmd.value]);
+				break;
+			}
+			case CommandType::Blit:
+			{
+				auto cmd = Read<BlitCommand>(payload);
+				if (cmd.dest != kNullReference)
+					Pipeline::PushRenderTarget(m_renderTargets[cmd.dest]);
+				MaterialPtr material;
+				if (cmd.material == kNullReference)
+				{
+					material = Material::builtinMaterial("DrawQuad");
+					material->SetVector4("DrawRectParameters", Vector4(-1, -1, 1, 1));
+				}
+				else
+				{
+					material = m_materials[cmd.material];
+				}
+				material->setMainTexture(m_textures[cmd.source]);
+				GLStateCache::SetDepthFunc(GL_ALWAYS);
+				GLStateCache::SetDepthMask(false);
+				Graphics::DrawMesh(Mesh::builtinMesh(PrimitiveType::ScreenAlignedQuad), material);
+				GLStateCache::SetDepthMask(true);
+				GLStateCache::SetDepthFunc(GL_LESS);
+				if (cmd.dest != kNullReference)
+					Pipeline::PopRenderTarget();
+				break;
+			}
+			default:
+				assert(false);
+				break;
+			}
+		}
+
+		while (pushedRenderTargets-- > 0)
+		{
+			Pipeline::PopRenderTarget();
+		}
+	}
+}
+}
@@ -4,6 +4,7 @@
 #include <FishEngine/Camera.hpp>
 #include <FishEngine/Animator.hpp>
 #include <FishEngine/MeshFilter.hpp>
+#include <FishEngine/LODGroup.hpp>
 #include <FishEngine/Rigidbody.hpp>
 #include <FishEngine/MeshRenderer.hpp>
 #include <FishEngine/SkinnedMeshRenderer.hpp>
@@ -24,6 +25,7 @@ AddComponentToGameObject(
 	CASE(Animator)
 	CASE(MeshFilter)
 	CASE(MeshRenderer)
+	CASE(LODGroup)
 	CASE(Rigidbody)
 	CASE(SkinnedMeshRenderer)
 	CASE(BoxCollider)
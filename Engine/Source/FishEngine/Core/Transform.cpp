@@ -2,6 +2,7 @@
 #include <FishEngine/GameObject.hpp>
 #include <FishEngine/Debug.hpp>
 #include <FishEngine/Common.hpp>
+#include <FishEngine/Render/RendererRegistry.hpp>
 
 namespace FishEngine
 {
@@ -28,7 +29,7 @@ namespace FishEngine
 		if (!m_parent.expired()) {
 			m_localToWorldMatrix = m_parent.lock()->localToWorldMatrix() * m_localToWorldMatrix;
 		}
-		m_worldToLocalMatrix = m_localToWorldMatrix.inverse();
+		m_worldToLocalMatrix = Matrix4x4::InverseAffine(m_localToWorldMatrix);
 #else
 		// TODO this version is not right, take a look to see where the bug is.
 		// maybe in the TRS
@@ -78,24 +79,7 @@ namespace FishEngine
 	Bounds Transform::TransformBounds(const Bounds& bounds) const
 	{
 		//Update();
-		if (!bounds.IsValid())
-			return bounds;
-		auto l2w = localToWorldMatrix();
-		auto center = bounds.center();
-		auto extents = bounds.extents();
-		float weights[] = {
-			1, 1, 1,  1, 1, -1,
-			1, -1, 1,  -1, 1, 1,
-			1, -1, -1,  -1, 1, -1,
-			-1, -1, 1,  -1, -1, -1};
-		Bounds result;
-		for (int i = 0; i < 8; ++i)
-		{
-			Vector3 corner = center + extents * Vector3(weights+i*3);
-			corner = l2w.MultiplyPoint(corner);
-			result.Encapsulate(corner);
-		}
-		return result;
+		return localToWorldMatrix().TransformBounds(bounds);
 	}
 	
 	Bounds Transform::InverseTransformBounds(const Bounds& bounds) const
@@ -226,6 +210,7 @@ namespace FishEngine
 		}
 		//UpdateMatrix();
 		MakeDirty();
+		RendererRegistry::OnHierarchyChanged(gameObject());
 	}
 
 	//std::shared_ptr<Transform>
@@ -287,6 +272,7 @@ namespace FishEngine
 				c->MakeDirty();
 			}
 			m_isDirty = true;
+			m_version++;
 		}
 	}
 
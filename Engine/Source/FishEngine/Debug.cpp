@@ -1,6 +1,7 @@
 #include <FishEngine/Debug.hpp>
 
 #include <iostream>
+#include <mutex>
 
 #if FISHENGINE_PLATFORM_WINDOWS
 #include <windows.h>
@@ -15,6 +16,9 @@ using std::cout;
 namespace FishEngine
 {
 	bool Debug::s_colorMode = false;
+
+	// messages can be logged from any thread
+	static std::mutex s_logMutex;
 	
 	void Debug::Init()
 	{
@@ -107,6 +111,7 @@ namespace FishEngine
 
 void FishEngine::Debug::Log(LogType channel, std::string const & message, const char* file, int line, const char * func)
 {
+	std::lock_guard<std::mutex> lock(s_logMutex);
 	if (s_colorMode)
 	{
 #if FISHENGINE_PLATFORM_WINDOWS
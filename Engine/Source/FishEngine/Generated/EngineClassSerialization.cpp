@@ -33,6 +33,7 @@
 #include <FishEngine/MeshCollider.hpp> 
 #include <FishEngine/SkinnedMeshRenderer.hpp> 
 #include <FishEngine/MeshFilter.hpp> 
+#include <FishEngine/LODGroup.hpp> 
 #include <FishEngine/Animation.hpp> 
 #include <FishEngine/CameraController.hpp> 
 #include <FishEngine/AudioSystem.hpp> 
@@ -40,6 +41,7 @@
 #include <FishEngine/MeshRenderer.hpp> 
 #include <FishEngine/ShaderProperty.hpp> 
 #include <FishEngine/Skybox.hpp> 
+#include <FishEngine/ShaderVariantCollection.hpp> 
 #include <FishEngine/GameObject.hpp> 
 #include <FishEngine/Frustum.hpp> 
 #include <FishEngine/Color.hpp> 
@@ -261,9 +263,9 @@ namespace FishEngine
 	{
 		//archive.BeginClass();
 		FishEngine::Object::Serialize(archive);
-		archive << FishEngine::make_nvp("m_textures", m_textures); // std::map<std::string, TexturePtr>
-		archive << FishEngine::make_nvp("m_uniforms", m_uniforms); // FishEngine::ShaderUniforms
 		archive << FishEngine::make_nvp("m_properties", m_properties); // std::vector<MaterialProperty>
+		archive << FishEngine::make_nvp("m_values", m_values); // std::vector<float>
+		archive << FishEngine::make_nvp("m_textureValues", m_textureValues); // std::vector<TexturePtr>
 		//archive.EndClass();
 	}
 
@@ -271,9 +273,11 @@ namespace FishEngine
 	{
 		//archive.BeginClass(2);
 		FishEngine::Object::Deserialize(archive);
-		archive >> FishEngine::make_nvp("m_textures", m_textures); // std::map<std::string, TexturePtr>
-		archive >> FishEngine::make_nvp("m_uniforms", m_uniforms); // FishEngine::ShaderUniforms
+		if (DeserializeLegacy(archive))
+			return;
 		archive >> FishEngine::make_nvp("m_properties", m_properties); // std::vector<MaterialProperty>
+		archive >> FishEngine::make_nvp("m_values", m_values); // std::vector<float>
+		archive >> FishEngine::make_nvp("m_textureValues", m_textureValues); // std::vector<TexturePtr>
 		//archive.EndClass();
 	}
 
@@ -332,6 +336,69 @@ namespace FishEngine
 	}
 
 
+	// FishEngine::LOD
+	FishEngine::OutputArchive & operator << ( FishEngine::OutputArchive & archive, FishEngine::LOD const & value )
+	{
+		archive.BeginClass();
+		archive << FishEngine::make_nvp("screenRelativeTransitionHeight", value.screenRelativeTransitionHeight); // float
+		archive << FishEngine::make_nvp("fadeTransitionWidth", value.fadeTransitionWidth); // float
+		archive << FishEngine::make_nvp("gameObjects", value.gameObjects); // std::vector<std::weak_ptr<GameObject> >
+		archive.EndClass();
+		return archive;
+	}
+
+	FishEngine::InputArchive & operator >> ( FishEngine::InputArchive & archive, FishEngine::LOD & value )
+	{
+		archive.BeginClass();
+		archive >> FishEngine::make_nvp("screenRelativeTransitionHeight", value.screenRelativeTransitionHeight); // float
+		archive >> FishEngine::make_nvp("fadeTransitionWidth", value.fadeTransitionWidth); // float
+		archive >> FishEngine::make_nvp("gameObjects", value.gameObjects); // std::vector<std::weak_ptr<GameObject> >
+		archive.EndClass();
+		return archive;
+	}
+
+
+	// FishEngine::LODGroup
+	void FishEngine::LODGroup::Serialize ( FishEngine::OutputArchive & archive ) const
+	{
+		//archive.BeginClass();
+		FishEngine::Component::Serialize(archive);
+		archive << FishEngine::make_nvp("m_localReferencePoint", m_localReferencePoint); // FishEngine::Vector3
+		archive << FishEngine::make_nvp("m_size", m_size); // float
+		archive << FishEngine::make_nvp("m_fadeMode", m_fadeMode); // FishEngine::LODFadeMode
+		archive << FishEngine::make_nvp("m_lods", m_lods); // std::vector<LOD>
+		//archive.EndClass();
+	}
+
+	void FishEngine::LODGroup::Deserialize ( FishEngine::InputArchive & archive )
+	{
+		//archive.BeginClass(5);
+		FishEngine::Component::Deserialize(archive);
+		archive >> FishEngine::make_nvp("m_localReferencePoint", m_localReferencePoint); // FishEngine::Vector3
+		archive >> FishEngine::make_nvp("m_size", m_size); // float
+		archive >> FishEngine::make_nvp("m_fadeMode", m_fadeMode); // FishEngine::LODFadeMode
+		archive >> FishEngine::make_nvp("m_lods", m_lods); // std::vector<LOD>
+		//archive.EndClass();
+	}
+
+	FishEngine::ComponentPtr FishEngine::LODGroup::Clone(FishEngine::CloneUtility & cloneUtility) const
+	{
+		auto ret = FishEngine::MakeShared<FishEngine::LODGroup>();
+		cloneUtility.m_clonedObject[this->GetInstanceID()] = ret;
+		this->CopyValueTo(ret, cloneUtility);
+		return ret;
+	}
+
+	void FishEngine::LODGroup::CopyValueTo(std::shared_ptr<FishEngine::LODGroup> target, FishEngine::CloneUtility & cloneUtility) const
+	{
+		FishEngine::Component::CopyValueTo(target, cloneUtility);
+		cloneUtility.Clone(this->m_localReferencePoint, target->m_localReferencePoint); // FishEngine::Vector3
+		cloneUtility.Clone(this->m_size, target->m_size); // float
+		cloneUtility.Clone(this->m_fadeMode, target->m_fadeMode); // FishEngine::LODFadeMode
+		cloneUtility.Clone(this->m_lods, target->m_lods); // std::vector<LOD>
+	}
+
+
 	// FishEngine::BoxCollider
 	void FishEngine::BoxCollider::Serialize ( FishEngine::OutputArchive & archive ) const
 	{
@@ -801,6 +868,7 @@ namespace FishEngine
 		archive.BeginClass();
 		archive << FishEngine::make_nvp("name", value.name); // std::string
 		archive << FishEngine::make_nvp("type", value.type); // FishEngine::MaterialPropertyType
+		archive << FishEngine::make_nvp("offset", value.offset); // uint32_t
 		archive.EndClass();
 		return archive;
 	}
@@ -810,10 +878,47 @@ namespace FishEngine
 		archive.BeginClass();
 		archive >> FishEngine::make_nvp("name", value.name); // std::string
 		archive >> FishEngine::make_nvp("type", value.type); // FishEngine::MaterialPropertyType
+		archive >> FishEngine::make_nvp("offset", value.offset); // uint32_t
 		archive.EndClass();
 		return archive;
 	}
 
+	// FishEngine::ShaderVariant
+	FishEngine::OutputArchive & operator << ( FishEngine::OutputArchive & archive, FishEngine::ShaderVariant const & value )
+	{
+		archive.BeginClass();
+		archive << FishEngine::make_nvp("shader", value.shader); // ShaderPtr
+		archive << FishEngine::make_nvp("keywords", value.keywords); // ShaderKeywords
+		archive.EndClass();
+		return archive;
+	}
+
+	FishEngine::InputArchive & operator >> ( FishEngine::InputArchive & archive, FishEngine::ShaderVariant & value )
+	{
+		archive.BeginClass();
+		archive >> FishEngine::make_nvp("shader", value.shader); // ShaderPtr
+		archive >> FishEngine::make_nvp("keywords", value.keywords); // ShaderKeywords
+		archive.EndClass();
+		return archive;
+	}
+
+	// FishEngine::ShaderVariantCollection
+	void FishEngine::ShaderVariantCollection::Serialize ( FishEngine::OutputArchive & archive ) const
+	{
+		//archive.BeginClass();
+		FishEngine::Object::Serialize(archive);
+		archive << FishEngine::make_nvp("m_variants", m_variants); // std::vector<ShaderVariant>
+		//archive.EndClass();
+	}
+
+	void FishEngine::ShaderVariantCollection::Deserialize ( FishEngine::InputArchive & archive )
+	{
+		//archive.BeginClass(2);
+		FishEngine::Object::Deserialize(archive);
+		archive >> FishEngine::make_nvp("m_variants", m_variants); // std::vector<ShaderVariant>
+		//archive.EndClass();
+	}
+
 	// FishEngine::SkinnedMeshRenderer
 	void FishEngine::SkinnedMeshRenderer::Serialize ( FishEngine::OutputArchive & archive ) const
 	{
@@ -823,6 +928,8 @@ namespace FishEngine
 		archive << FishEngine::make_nvp("m_avatar", m_avatar); // AvatarPtr
 		archive << FishEngine::make_nvp("m_rootBone", m_rootBone); // std::weak_ptr<Transform>
 		archive << FishEngine::make_nvp("m_bones", m_bones); // std::vector<std::weak_ptr<Transform> >
+		archive << FishEngine::make_nvp("m_skinningBackend", m_skinningBackend); // FishEngine::SkinningBackend
+		archive << FishEngine::make_nvp("m_cullingMode", m_cullingMode); // FishEngine::AnimationCullingMode
 		//archive.EndClass();
 	}
 
@@ -834,6 +941,8 @@ namespace FishEngine
 		archive >> FishEngine::make_nvp("m_avatar", m_avatar); // AvatarPtr
 		archive >> FishEngine::make_nvp("m_rootBone", m_rootBone); // std::weak_ptr<Transform>
 		archive >> FishEngine::make_nvp("m_bones", m_bones); // std::vector<std::weak_ptr<Transform> >
+		archive >> FishEngine::make_nvp("m_skinningBackend", m_skinningBackend); // FishEngine::SkinningBackend
+		archive >> FishEngine::make_nvp("m_cullingMode", m_cullingMode); // FishEngine::AnimationCullingMode
 		//archive.EndClass();
 	}
 
@@ -852,6 +961,8 @@ namespace FishEngine
 		cloneUtility.Clone(this->m_avatar, target->m_avatar); // AvatarPtr
 		cloneUtility.Clone(this->m_rootBone, target->m_rootBone); // std::weak_ptr<Transform>
 		cloneUtility.Clone(this->m_bones, target->m_bones); // std::vector<std::weak_ptr<Transform> >
+		cloneUtility.Clone(this->m_skinningBackend, target->m_skinningBackend); // FishEngine::SkinningBackend
+		cloneUtility.Clone(this->m_cullingMode, target->m_cullingMode); // FishEngine::AnimationCullingMode
 	}
 
 
@@ -1520,6 +1631,7 @@ namespace FishEngine
 		archive << FishEngine::make_nvp("m_isPlaying", m_isPlaying); // bool
 		archive << FishEngine::make_nvp("m_playAutomatically", m_playAutomatically); // bool
 		archive << FishEngine::make_nvp("m_wrapMode", m_wrapMode); // FishEngine::WrapMode
+		archive << FishEngine::make_nvp("m_cullingMode", m_cullingMode); // FishEngine::AnimationCullingMode
 		//archive.EndClass();
 	}
 
@@ -1531,6 +1643,7 @@ namespace FishEngine
 		archive >> FishEngine::make_nvp("m_isPlaying", m_isPlaying); // bool
 		archive >> FishEngine::make_nvp("m_playAutomatically", m_playAutomatically); // bool
 		archive >> FishEngine::make_nvp("m_wrapMode", m_wrapMode); // FishEngine::WrapMode
+		archive >> FishEngine::make_nvp("m_cullingMode", m_cullingMode); // FishEngine::AnimationCullingMode
 		//archive.EndClass();
 	}
 
@@ -1549,6 +1662,7 @@ namespace FishEngine
 		cloneUtility.Clone(this->m_isPlaying, target->m_isPlaying); // bool
 		cloneUtility.Clone(this->m_playAutomatically, target->m_playAutomatically); // bool
 		cloneUtility.Clone(this->m_wrapMode, target->m_wrapMode); // FishEngine::WrapMode
+		cloneUtility.Clone(this->m_cullingMode, target->m_cullingMode); // FishEngine::AnimationCullingMode
 	}
 
 
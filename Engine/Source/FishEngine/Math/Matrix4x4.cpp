@@ -1,64 +1,144 @@
 #include <FishEngine/Matrix4x4.hpp>
+#include <FishEngine/Bounds.hpp>
 #include <cassert>
 
 namespace FishEngine
 {
 
-	Matrix4x4 Matrix4x4::Inverse(const Matrix4x4& m)
+	namespace
 	{
-		float p10_21 = m.m[1][0] * m.m[2][1] - m.m[2][0] * m.m[1][1];
-		float p10_22 = m.m[1][0] * m.m[2][2] - m.m[2][0] * m.m[1][2];
-		float p10_23 = m.m[1][0] * m.m[2][3] - m.m[2][0] * m.m[1][3];
-		float p11_22 = m.m[1][1] * m.m[2][2] - m.m[2][1] * m.m[1][2];
-		float p11_23 = m.m[1][1] * m.m[2][3] - m.m[2][1] * m.m[1][3];
-		float p12_23 = m.m[1][2] * m.m[2][3] - m.m[2][2] * m.m[1][3];
-		float p10_31 = m.m[1][0] * m.m[3][1] - m.m[3][0] * m.m[1][1];
-		float p10_32 = m.m[1][0] * m.m[3][2] - m.m[3][0] * m.m[1][2];
-		float p10_33 = m.m[1][0] * m.m[3][3] - m.m[3][0] * m.m[1][3];
-		float p11_32 = m.m[1][1] * m.m[3][2] - m.m[3][1] * m.m[1][2];
-		float p11_33 = m.m[1][1] * m.m[3][3] - m.m[3][1] * m.m[1][3];
-		float p12_33 = m.m[1][2] * m.m[3][3] - m.m[3][2] * m.m[1][3];
-		float p20_31 = m.m[2][0] * m.m[3][1] - m.m[3][0] * m.m[2][1];
-		float p20_32 = m.m[2][0] * m.m[3][2] - m.m[3][0] * m.m[2][2];
-		float p20_33 = m.m[2][0] * m.m[3][3] - m.m[3][0] * m.m[2][3];
-		float p21_32 = m.m[2][1] * m.m[3][2] - m.m[3][1] * m.m[2][2];
-		float p21_33 = m.m[2][1] * m.m[3][3] - m.m[3][1] * m.m[2][3];
-		float p22_33 = m.m[2][2] * m.m[3][3] - m.m[3][2] * m.m[2][3];
-		Matrix4x4 A;
-		A.m[0][0] = +(m.m[1][1] * p22_33 - m.m[1][2] * p21_33 + m.m[1][3] * p21_32);
-		A.m[1][0] = -(m.m[1][0] * p22_33 - m.m[1][2] * p20_33 + m.m[1][3] * p20_32);
-		A.m[2][0] = +(m.m[1][0] * p21_33 - m.m[1][1] * p20_33 + m.m[1][3] * p20_31);
-		A.m[3][0] = -(m.m[1][0] * p21_32 - m.m[1][1] * p20_32 + m.m[1][2] * p20_31);
-		A.m[0][1] = -(m.m[0][1] * p22_33 - m.m[0][2] * p21_33 + m.m[0][3] * p21_32);
-		A.m[1][1] = +(m.m[0][0] * p22_33 - m.m[0][2] * p20_33 + m.m[0][3] * p20_32);
-		A.m[2][1] = -(m.m[0][0] * p21_33 - m.m[0][1] * p20_33 + m.m[0][3] * p20_31);
-		A.m[3][1] = +(m.m[0][0] * p21_32 - m.m[0][1] * p20_32 + m.m[0][2] * p20_31);
-		A.m[0][2] = +(m.m[0][1] * p12_33 - m.m[0][2] * p11_33 + m.m[0][3] * p11_32);
-		A.m[1][2] = -(m.m[0][0] * p12_33 - m.m[0][2] * p10_33 + m.m[0][3] * p10_32);
-		A.m[2][2] = +(m.m[0][0] * p11_33 - m.m[0][1] * p10_33 + m.m[0][3] * p10_31);
-		A.m[3][2] = -(m.m[0][0] * p11_32 - m.m[0][1] * p10_32 + m.m[0][2] * p10_31);
-		A.m[0][3] = -(m.m[0][1] * p12_23 - m.m[0][2] * p11_23 + m.m[0][3] * p11_22);
-		A.m[1][3] = +(m.m[0][0] * p12_23 - m.m[0][2] * p10_23 + m.m[0][3] * p10_22);
-		A.m[2][3] = -(m.m[0][0] * p11_23 - m.m[0][1] * p10_23 + m.m[0][3] * p10_21);
-		A.m[3][3] = +(m.m[0][0] * p11_22 - m.m[0][1] * p10_22 + m.m[0][2] * p10_21);
-
-		float det = 0;
-		det += m.m[0][0] * A.m[0][0];
-		det += m.m[0][1] * A.m[1][0];
-		det += m.m[0][2] * A.m[2][0];
-		det += m.m[0][3] * A.m[3][0];
-		float inv_det = 1.f / det;
-		for (int i = 0; i < 4; i++) {
-			for (int j = 0; j < 4; j++) {
-				A.m[i][j] *= inv_det;
-			}
+		using namespace SIMD;
+
+		// 2x2 matrices in a float4 as (m00, m01, m10, m11)
+
+		// a * b
+		inline float4 Mat2Mul(float4 a, float4 b)
+		{
+			return MulAdd(a, Swizzle<0, 3, 0, 3>(b), Mul(Swizzle<1, 0, 3, 2>(a), Swizzle<2, 1, 2, 1>(b)));
 		}
 
-		//auto I = A*m;
-		//if (!I.isIdentity()) {
-		//    abort();
-		//}
-		return A;
+		// adjugate(a) * b
+		inline float4 Mat2AdjMul(float4 a, float4 b)
+		{
+			return NegMulAdd(Swizzle<1, 1, 2, 2>(a), Swizzle<2, 3, 0, 1>(b), Mul(Swizzle<3, 3, 0, 0>(a), b));
+		}
+
+		// a * adjugate(b)
+		inline float4 Mat2MulAdj(float4 a, float4 b)
+		{
+			return NegMulAdd(Swizzle<1, 0, 3, 2>(a), Swizzle<2, 1, 2, 1>(b), Mul(a, Swizzle<3, 0, 3, 0>(b)));
+		}
+
+		struct Rows
+		{
+			float4 r[4];
+		};
+
+		inline Rows LoadRows(const Matrix4x4 & m)
+		{
+			return { { Load(m.m[0]), Load(m.m[1]), Load(m.m[2]), Load(m.m[3]) } };
+		}
+
+		inline void StoreRows(const Rows & rows, Matrix4x4 & m)
+		{
+			for (int i = 0; i < 4; ++i)
+				Store(m.m[i], rows.r[i]);
+		}
+
+		// the columns of m, c[3] is the translation of an affine matrix
+		inline Rows LoadColumns(const Matrix4x4 & m)
+		{
+			Rows c = LoadRows(m);
+			Transpose(c.r[0], c.r[1], c.r[2], c.r[3]);
+			return c;
+		}
+	}
+
+	Matrix4x4 Matrix4x4::Inverse(const Matrix4x4& m)
+	{
+		// blockwise inversion with 2x2 blocks  M = | A B |
+		//                                          | C D |
+		// inverse(M) = 1/|M| * | X Y |, where X = adj(|D|A - B adj(D) C), W = adj(|A|D - C adj(A) B),
+		//                      | Z W |        Y = -adj(|B|C - D adj(adj(A) B)), Z = -adj(|C|B - A adj(adj(D) C)),
+		// |M| = |A||D| + |B||C| - tr(adj(A) B adj(D) C)
+		const Rows rows = LoadRows(m);
+		const float4 A = Shuffle<0, 1, 0, 1>(rows.r[0], rows.r[1]);
+		const float4 B = Shuffle<2, 3, 2, 3>(rows.r[0], rows.r[1]);
+		const float4 C = Shuffle<0, 1, 0, 1>(rows.r[2], rows.r[3]);
+		const float4 D = Shuffle<2, 3, 2, 3>(rows.r[2], rows.r[3]);
+
+		// (|A|, |B|, |C|, |D|)
+		const float4 detSub = Sub(
+			Mul(Shuffle<0, 2, 0, 2>(rows.r[0], rows.r[2]), Shuffle<1, 3, 1, 3>(rows.r[1], rows.r[3])),
+			Mul(Shuffle<1, 3, 1, 3>(rows.r[0], rows.r[2]), Shuffle<0, 2, 0, 2>(rows.r[1], rows.r[3])));
+		const float4 detA = Broadcast<0>(detSub);
+		const float4 detB = Broadcast<1>(detSub);
+		const float4 detC = Broadcast<2>(detSub);
+		const float4 detD = Broadcast<3>(detSub);
+
+		const float4 D_C = Mat2AdjMul(D, C);
+		const float4 A_B = Mat2AdjMul(A, B);
+		float4 X_ = Sub(Mul(detD, A), Mat2Mul(B, D_C));
+		float4 W_ = Sub(Mul(detA, D), Mat2Mul(C, A_B));
+		float4 Y_ = Sub(Mul(detB, C), Mat2MulAdj(D, A_B));
+		float4 Z_ = Sub(Mul(detC, B), Mat2MulAdj(A, D_C));
+
+		float4 trace = Mul(A_B, Swizzle<0, 2, 1, 3>(D_C));
+		trace = Add(trace, Swizzle<1, 0, 3, 2>(trace));
+		trace = Add(trace, Swizzle<2, 3, 0, 1>(trace));
+		const float4 detM = Sub(MulAdd(detA, detD, Mul(detB, detC)), trace);
+
+		// the signs of the adjugates
+		const float4 rcpDetM = Div(Set(1, -1, -1, 1), detM);
+		X_ = Mul(X_, rcpDetM);
+		Y_ = Mul(Y_, rcpDetM);
+		Z_ = Mul(Z_, rcpDetM);
+		W_ = Mul(W_, rcpDetM);
+
+		// the swaps of the adjugates
+		Matrix4x4 result;
+		Store(result.m[0], Shuffle<3, 1, 3, 1>(X_, Y_));
+		Store(result.m[1], Shuffle<2, 0, 2, 0>(X_, Y_));
+		Store(result.m[2], Shuffle<3, 1, 3, 1>(Z_, W_));
+		Store(result.m[3], Shuffle<2, 0, 2, 0>(Z_, W_));
+		return result;
+	}
+
+	Matrix4x4 Matrix4x4::InverseAffine(const Matrix4x4& m)
+	{
+		// M = | R t |, inverse(M) = | inverse(R) -inverse(R)t |
+		//     | 0 1 |               | 0          1            |
+		// The columns of inverse(R) are the cross products of the rows of R over det(R).
+		// Lane 3 of the rows holds t, the shuffles of Cross keep it out of lanes 0..2. Whatever is left in lane 3
+		// only reaches the last row, which is written explicitly.
+		const Rows rows = LoadRows(m);
+		auto Cross = [](float4 a, float4 b)
+		{
+			return NegMulAdd(Swizzle<2, 0, 1, 3>(a), Swizzle<1, 2, 0, 3>(b), Mul(Swizzle<1, 2, 0, 3>(a), Swizzle<2, 0, 1, 3>(b)));
+		};
+		float4 c0 = Cross(rows.r[1], rows.r[2]);
+		float4 c1 = Cross(rows.r[2], rows.r[0]);
+		float4 c2 = Cross(rows.r[0], rows.r[1]);
+
+		const float4 r0xyz = Mul(rows.r[0], Set(1, 1, 1, 0));
+		const float4 rcpDet = Div(Splat(1.0f), Dot4(r0xyz, c0));
+		c0 = Mul(c0, rcpDet);
+		c1 = Mul(c1, rcpDet);
+		c2 = Mul(c2, rcpDet);
+
+		float4 t = Mul(c0, Broadcast<3>(rows.r[0]));
+		t = MulAdd(c1, Broadcast<3>(rows.r[1]), t);
+		t = MulAdd(c2, Broadcast<3>(rows.r[2]), t);
+		t = Sub(Zero(), t);
+
+		// c0, c1, c2 and t as columns
+		SIMD::Transpose(c0, c1, c2, t);
+		Matrix4x4 result;
+		Store(result.m[0], c0);
+		Store(result.m[1], c1);
+		Store(result.m[2], c2);
+		Store(result.m[3], Set(0, 0, 0, 1));
+		return result;
 	}
 
 	bool Zero(float f) {
@@ -103,21 +183,25 @@ namespace FishEngine
 
 	FishEngine::Matrix4x4 Matrix4x4::TRS(const Vector3& pos, const Quaternion& q, const Vector3& s)
 	{
-		Matrix4x4 mat = Matrix4x4::FromRotation(q);
-
-		mat.m[0][3] = pos.x;
-		mat.m[1][3] = pos.y;
-		mat.m[2][3] = pos.z;
-		mat.m[0][0] *= s.x;
-		mat.m[0][1] *= s.y;
-		mat.m[0][2] *= s.z;
-		mat.m[1][0] *= s.x;
-		mat.m[1][1] *= s.y;
-		mat.m[1][2] *= s.z;
-		mat.m[2][0] *= s.x;
-		mat.m[2][1] *= s.y;
-		mat.m[2][2] *= s.z;
-		mat.m[3][3] = 1.f;
+		// the rotation of FromRotation with its columns scaled by s, pos in the last column
+		const float x = 2.0f * q.x;
+		const float y = 2.0f * q.y;
+		const float z = 2.0f * q.z;
+		const float qxx = q.x * x;
+		const float qyy = q.y * y;
+		const float qzz = q.z * z;
+		const float qxy = q.x * y;
+		const float qxz = q.x * z;
+		const float qyz = q.y * z;
+		const float qwx = q.w * x;
+		const float qwy = q.w * y;
+		const float qwz = q.w * z;
+
+		const float4 scale = Set(s.x, s.y, s.z, 1.f);
+		Matrix4x4 mat;
+		Store(mat.m[0], Mul(Set(1.f - (qyy + qzz), qxy - qwz, qxz + qwy, pos.x), scale));
+		Store(mat.m[1], Mul(Set(qxy + qwz, 1.f - (qxx + qzz), qyz - qwx, pos.y), scale));
+		Store(mat.m[2], Mul(Set(qxz - qwy, qyz + qwx, 1.f - (qxx + qyy), pos.z), scale));
 		return mat;
 	}
 
@@ -191,29 +275,25 @@ namespace FishEngine
 		Quaternion*         outRotation, 
 		Vector3*            outScale)
 	{
+		// the length of the columns of the upper 3x3
+		const Rows rows = LoadRows(transformation);
+		float4 sqrScale = Mul(rows.r[0], rows.r[0]);
+		sqrScale = MulAdd(rows.r[1], rows.r[1], sqrScale);
+		sqrScale = MulAdd(rows.r[2], rows.r[2], sqrScale);
+		const float4 scale = Sqrt(sqrScale);
+		float s[4];
+		Store(s, scale);
+		outScale->Set(s[0], s[1], s[2]);
+
 		auto& m = transformation;
-		outScale->x = sqrtf(m.m[0][0]*m.m[0][0] + m.m[1][0]*m.m[1][0] + m.m[2][0]*m.m[2][0]);
-		outScale->y = sqrtf(m.m[0][1]*m.m[0][1] + m.m[1][1]*m.m[1][1] + m.m[2][1]*m.m[2][1]);
-		outScale->z = sqrtf(m.m[0][2]*m.m[0][2] + m.m[1][2]*m.m[1][2] + m.m[2][2]*m.m[2][2]);
-		
 		outTranslation->Set(m.m[0][3], m.m[1][3], m.m[2][3]);
+
+		// lane 3 is the translation, dropped from the rotation
+		const float4 rcpScale = Div(Set(1, 1, 1, 0), Max(scale, Set(0, 0, 0, 1)));
 		Matrix4x4 rot_mat;
-		rot_mat.m[0][0] = m.m[0][0] / outScale->x;
-		rot_mat.m[1][0] = m.m[1][0] / outScale->x;
-		rot_mat.m[2][0] = m.m[2][0] / outScale->x;
-		rot_mat.m[3][0] = 0;
-		rot_mat.m[0][1] = m.m[0][1] / outScale->y;
-		rot_mat.m[1][1] = m.m[1][1] / outScale->y;
-		rot_mat.m[2][1] = m.m[2][1] / outScale->y;
-		rot_mat.m[3][1] = 0;
-		rot_mat.m[0][2] = m.m[0][2] / outScale->z;
-		rot_mat.m[1][2] = m.m[1][2] / outScale->z;
-		rot_mat.m[2][2] = m.m[2][2] / outScale->z;
-		rot_mat.m[3][2] = 0;
-		rot_mat.m[0][3] = 0;
-		rot_mat.m[1][3] = 0;
-		rot_mat.m[2][3] = 0;
-		rot_mat.m[3][3] = 1;
+		Store(rot_mat.m[0], Mul(rows.r[0], rcpScale));
+		Store(rot_mat.m[1], Mul(rows.r[1], rcpScale));
+		Store(rot_mat.m[2], Mul(rows.r[2], rcpScale));
 		*outRotation = rot_mat.ToRotation();
 	}
 
@@ -384,6 +464,101 @@ namespace FishEngine
 		return result;
 	}
 
+	void Matrix4x4::MultiplyPoints(const Vector3* points, Vector3* result, std::size_t count) const
+	{
+		const Rows c = LoadColumns(*this);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const Vector3 & p = points[i];
+			float4 r = MulAdd(c.r[0], Splat(p.x), c.r[3]);
+			r = MulAdd(c.r[1], Splat(p.y), r);
+			r = MulAdd(c.r[2], Splat(p.z), r);
+			Store3(&result[i].x, Div(r, Broadcast<3>(r)));
+		}
+	}
+
+	void Matrix4x4::MultiplyPoints3x4(const Vector3* points, Vector3* result, std::size_t count) const
+	{
+		const Rows c = LoadColumns(*this);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const Vector3 & p = points[i];
+			float4 r = MulAdd(c.r[0], Splat(p.x), c.r[3]);
+			r = MulAdd(c.r[1], Splat(p.y), r);
+			r = MulAdd(c.r[2], Splat(p.z), r);
+			Store3(&result[i].x, r);
+		}
+	}
+
+	void Matrix4x4::MultiplyVectors(const Vector3* vectors, Vector3* result, std::size_t count) const
+	{
+		const Rows c = LoadColumns(*this);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const Vector3 & v = vectors[i];
+			float4 r = Mul(c.r[0], Splat(v.x));
+			r = MulAdd(c.r[1], Splat(v.y), r);
+			r = MulAdd(c.r[2], Splat(v.z), r);
+			Store3(&result[i].x, r);
+		}
+	}
+
+	Bounds Matrix4x4::TransformBounds(const Bounds& bounds) const
+	{
+		Bounds result;
+		TransformBounds(&bounds, &result, 1);
+		return result;
+	}
+
+	void Matrix4x4::TransformBounds(const Bounds* bounds, Bounds* result, std::size_t count) const
+	{
+		// Arvo: the new center is the transformed center, the new extents are |M| * extents,
+		// the same box as the one around the 8 transformed corners.
+		const Rows c = LoadColumns(*this);
+		const float4 abs0 = Abs(c.r[0]);
+		const float4 abs1 = Abs(c.r[1]);
+		const float4 abs2 = Abs(c.r[2]);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const Bounds & b = bounds[i];
+			if (!b.IsValid())
+			{
+				result[i] = b;
+				continue;
+			}
+			const Vector3 center = b.center();
+			const Vector3 extents = b.extents();
+			float4 newCenter = MulAdd(c.r[0], Splat(center.x), c.r[3]);
+			newCenter = MulAdd(c.r[1], Splat(center.y), newCenter);
+			newCenter = MulAdd(c.r[2], Splat(center.z), newCenter);
+			float4 newExtents = Mul(abs0, Splat(extents.x));
+			newExtents = MulAdd(abs1, Splat(extents.y), newExtents);
+			newExtents = MulAdd(abs2, Splat(extents.z), newExtents);
+
+			float out[2][4];
+			Store(out[0], newCenter);
+			Store(out[1], newExtents);
+			result[i].setCenter(Vector3(out[0][0], out[0][1], out[0][2]));
+			result[i].setExtents(Vector3(out[1][0], out[1][1], out[1][2]));
+		}
+	}
+
+	void Matrix4x4::Multiply(const Matrix4x4& lhs, const Matrix4x4* rhs, Matrix4x4* result, std::size_t count)
+	{
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			MultiplyMatrix4x4(lhs.m, rhs[i].m, result[i].m);
+		}
+	}
+
+	void Matrix4x4::Multiply(const Matrix4x4* lhs, const Matrix4x4* rhs, Matrix4x4* result, std::size_t count)
+	{
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			MultiplyMatrix4x4(lhs[i].m, rhs[i].m, result[i].m);
+		}
+	}
+
 	const Matrix4x4 Matrix4x4::identity(
 		1, 0, 0, 0,
 		0, 1, 0, 0,
@@ -289,16 +289,9 @@ namespace FishEngine {
 
 		float cosTheta = Quaternion::Dot(a, b);
 
-		// adjust signs (if necessary)
-		Quaternion end = b;
-		if (cosTheta < 0.0f)
-		{
-			cosTheta = -cosTheta;
-			end.x = -end.x;
-			end.y = -end.y;
-			end.z = -end.z;
-			end.w = -end.w;
-		}
+		// adjust signs (if necessary), the sign goes into the weight of b
+		const float sign = cosTheta < 0.0f ? -1.0f : 1.0f;
+		cosTheta *= sign;
 
 		float sclp, sclq;
 		if ((1.0f - cosTheta) > 0.0001f) {
@@ -315,11 +308,11 @@ namespace FishEngine {
 			sclq = t;
 		}
 
-		return Quaternion(
-			sclp * a.x + sclq * end.x,
-			sclp * a.y + sclq * end.y,
-			sclp * a.z + sclq * end.z,
-			sclp * a.w + sclq * end.w);
+		sclq *= sign;
+
+		float result[4];
+		SIMD::Store(result, SIMD::MulAdd(SIMD::Splat(sclp), SIMD::Load(a.m), SIMD::Mul(SIMD::Splat(sclq), SIMD::Load(b.m))));
+		return Quaternion(result[0], result[1], result[2], result[3]);
 #endif
 	}
 
@@ -4,12 +4,19 @@
 #include <fstream>
 #include <sstream>
 #include <cstdio>
+#include <cstring>
+#include <algorithm>
 
 #include <FishEngine/Shader.hpp>
 #include <FishEngine/Debug.hpp>
 #include <FishEngine/Common.hpp>
+#include <FishEngine/Render/BonePalette.hpp>
 #include <FishEngine/ShaderVariables_gen.hpp>
 #include <FishEngine/Generated/Enum_PrimitiveType.hpp>
+#include <FishEngine/Render/GLStateCache.hpp>
+#include <FishEngine/Render/VertexLayout.hpp>
+#include <FishEngine/Render/CPUSkinning.hpp>
+#include <FishEngine/Serialization/MeshFile.hpp>
 
 using namespace std;
 
@@ -57,11 +64,13 @@ namespace FishEngine
 
 	Mesh::~Mesh()
 	{
-		glDeleteVertexArrays(1, &m_VAO);
-		glDeleteBuffers(1, &m_positionVBO);
-		glDeleteBuffers(1, &m_normalVBO);
-		glDeleteBuffers(1, &m_tangentVBO);
-		glDeleteBuffers(1, &m_indexVBO);
+		GeometryArena::Free(m_arenaAllocation);
+		GLStateCache::DeleteVertexArray(m_VAO);
+		GLStateCache::DeleteVertexArray(m_animationInputVAO);
+		for (GLuint buffer : { m_VBO, m_indexVBO, m_animationOutputPositionVBO, m_animationOutputNormalVBO, m_animationOutputTangentVBO })
+		{
+			glDeleteBuffers(1, &buffer);
+		}
 	}
 
 	void Mesh::RecalculateBounds()
@@ -94,10 +103,53 @@ namespace FishEngine
 		GenerateBuffer();
 		BindBuffer();
 		glCheckError();
+		// the GPU has its own copy, unmap the mesh file
+		m_bufferData.reset();
 
 		//m_vertexCount = static_cast<uint32_t>(m_vertices.size());
 		//m_triangleCount = static_cast<uint32_t>(m_triangles.size() / 3);
 		m_isReadable = !markNoLogerReadable;
+
+		if (m_skinned)
+		{
+			m_affineBindposes.clear();
+			for (auto const & bindpose : m_bindposes)
+				m_affineBindposes.emplace_back(bindpose);
+		}
+
+		// CPUSkinning needs the bind pose, take it over instead of copying when it is cleared anyway
+		if (m_skinned && m_vertexCount > 0 && m_boneWeights.size() == m_vertexCount && m_vertices.size() == m_vertexCount)
+		{
+			CalculateBoneBounds();
+			m_skinningSource = std::make_shared<SkinningSource>();
+			if (markNoLogerReadable)
+			{
+				m_skinningSource->positions.swap(m_vertices);
+				m_skinningSource->normals.swap(m_normals);
+				m_skinningSource->tangents.swap(m_tangents);
+				m_skinningSource->boneWeights.swap(m_boneWeights);
+			}
+			else
+			{
+				m_skinningSource->positions = m_vertices;
+				m_skinningSource->normals = m_normals;
+				m_skinningSource->tangents = m_tangents;
+				m_skinningSource->boneWeights = m_boneWeights;
+			}
+			if (m_skinningSource->normals.size() != m_vertexCount)
+				m_skinningSource->normals.clear();
+			if (m_skinningSource->tangents.size() != m_vertexCount)
+				m_skinningSource->tangents.clear();
+		}
+
+		if (m_skinned && m_affineBindposes.size() > MAX_BONE_SIZE)
+		{
+			if (m_skinningSource != nullptr)
+				LogWarning(Format("Mesh %1% has %2% bones, GPU skinning supports %3%, it is skinned on the CPU", name(), m_affineBindposes.size(), MAX_BONE_SIZE));
+			else
+				LogWarning(Format("Mesh %1% has %2% bones, GPU skinning supports %3%, and no bone weights to skin it on the CPU; it is not animated", name(), m_affineBindposes.size(), MAX_BONE_SIZE));
+		}
+
 		if (markNoLogerReadable)
 		{
 			Clear();
@@ -129,113 +181,202 @@ namespace FishEngine
 	//    glBindVertexArray(0);
 	//}
 	
+	VertexLayout Mesh::ChooseVertexLayout() const
+	{
+		VertexLayout layout;
+		layout.Add(PositionIndex, VertexAttributeFormat::Float32, 3);
+		layout.Add(NormalIndex, VertexAttributeFormat::SNorm2_10_10_10, 3);
+		layout.Add(TangentIndex, VertexAttributeFormat::SNorm2_10_10_10, 3);
+
+		// a half has 10 bits of mantissa: 1/2048 steps below 1 but 1/512 in [2, 4), keep floats for tiled uvs
+		bool halfUV = true;
+		for (auto const & uv : m_uv)
+		{
+			if (Mathf::Abs(uv.x) > 2.0f || Mathf::Abs(uv.y) > 2.0f)
+			{
+				halfUV = false;
+				break;
+			}
+		}
+		layout.Add(UVIndex, halfUV ? VertexAttributeFormat::Float16 : VertexAttributeFormat::Float32, 2);
+
+		if (m_skinned)
+		{
+			int maxBoneIndex = 0;
+			for (auto const & b : m_boneWeights)
+			{
+				for (int i : b.boneIndex)
+					maxBoneIndex = std::max(maxBoneIndex, i);
+			}
+			layout.Add(BoneIndexIndex, maxBoneIndex < 256 ? VertexAttributeFormat::UInt8 : VertexAttributeFormat::UInt16, 4);
+			layout.Add(BoneWeightIndex, VertexAttributeFormat::UNorm8, 4);
+		}
+		return layout;
+	}
+
+	void Mesh::EncodeVertexBuffer(VertexLayout const & layout, std::vector<uint8_t> & vertices) const
+	{
+		// one interleaved VBO, an attribute the mesh does not have is filled with 0
+		const uint32_t vertexCount = static_cast<uint32_t>(m_vertices.size());
+		vertices.assign(static_cast<size_t>(layout.stride()) * vertexCount, 0);
+		auto write = [&layout, &vertices, vertexCount](GLuint location, const float* data, size_t size, int dimension)
+		{
+			layout.Write(vertices.data(), location, size == vertexCount ? data : nullptr, dimension, dimension * sizeof(float), vertexCount);
+		};
+		write(PositionIndex, reinterpret_cast<const float*>(m_vertices.data()), m_vertices.size(), 3);
+		write(NormalIndex, reinterpret_cast<const float*>(m_normals.data()), m_normals.size(), 3);
+		write(TangentIndex, reinterpret_cast<const float*>(m_tangents.data()), m_tangents.size(), 3);
+		write(UVIndex, reinterpret_cast<const float*>(m_uv.data()), m_uv.size(), 2);
+
+		if (m_skinned)
+		{
+			// weights are stored in 8 bits, make each vertex sum up to exactly 255
+			std::vector<float> boneWeights(m_boneWeights.size() * 4);
+			for (size_t i = 0; i < m_boneWeights.size(); ++i)
+			{
+				auto const & b = m_boneWeights[i];
+				float sum = 0;
+				for (int c = 0; c < 4; ++c)
+					sum += Mathf::Clamp01(b.weight[c]);
+				if (sum <= 0)
+					continue;
+				int quantized[4];
+				int total = 0;
+				int largest = 0;
+				for (int c = 0; c < 4; ++c)
+				{
+					quantized[c] = static_cast<int>(std::lround(Mathf::Clamp01(b.weight[c]) / sum * 255.0f));
+					total += quantized[c];
+					if (quantized[c] > quantized[largest])
+						largest = c;
+				}
+				quantized[largest] += 255 - total;
+				for (int c = 0; c < 4; ++c)
+					boneWeights[i * 4 + c] = quantized[c] / 255.0f;
+			}
+			write(BoneWeightIndex, boneWeights.data(), m_boneWeights.size(), 4);
+			if (m_boneWeights.size() == vertexCount)
+				layout.WriteInt(vertices.data(), BoneIndexIndex, m_boneWeights.data()->boneIndex, sizeof(BoneWeight), vertexCount);
+		}
+	}
+
+	void Mesh::EncodeIndexBuffer(GLenum indexType, std::vector<uint8_t> & indices) const
+	{
+		if (indexType == GL_UNSIGNED_SHORT)
+		{
+			indices.resize(m_triangles.size() * sizeof(uint16_t));
+			auto dst = reinterpret_cast<uint16_t*>(indices.data());
+			for (size_t i = 0; i < m_triangles.size(); ++i)
+				dst[i] = static_cast<uint16_t>(m_triangles[i]);
+		}
+		else
+		{
+			indices.resize(m_triangles.size() * sizeof(uint32_t));
+			if (!m_triangles.empty())
+				std::memcpy(indices.data(), m_triangles.data(), indices.size());
+		}
+	}
+
 	void Mesh::GenerateBuffer()
 	{
+		assert(m_VAO == 0 && m_arenaAllocation.pool < 0);
+
+		// loaded from a mesh file: the buffers are already encoded (m_vertexLayout and m_indexType are set)
+		std::vector<uint8_t> encodedVertices;
+		std::vector<uint8_t> encodedIndices;
+		const void* vertexData;
+		size_t vertexDataSize;
+		const void* indexData;
+		size_t indexDataSize;
+		if (m_bufferData != nullptr)
+		{
+			vertexData = m_bufferData->vertices;
+			vertexDataSize = m_bufferData->verticesSize;
+			indexData = m_bufferData->indices;
+			indexDataSize = m_bufferData->indicesSize;
+		}
+		else
+		{
+			// 16-bit indices when every index fits
+			m_indexType = ChooseIndexType();
+			if (m_indexType == GL_UNSIGNED_SHORT)
+			{
+				EncodeIndexBuffer(m_indexType, encodedIndices);
+				indexData = encodedIndices.data();
+				indexDataSize = encodedIndices.size();
+			}
+			else
+			{
+				indexData = m_triangles.data();
+				indexDataSize = m_triangles.size() * sizeof(uint32_t);
+			}
+
+			m_vertexLayout = ChooseVertexLayout();
+			EncodeVertexBuffer(m_vertexLayout, encodedVertices);
+			vertexData = encodedVertices.data();
+			vertexDataSize = encodedVertices.size();
+		}
+
+		// static meshes share the buffers of the arena, skinned ones need their own for transform feedback
+		if (!m_skinned && GeometryArena::enabled())
+		{
+			const uint32_t indexSize = m_indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+			m_arenaAllocation = GeometryArena::Allocate(m_vertexLayout, m_indexType, vertexData, m_vertexCount, indexData, static_cast<uint32_t>(indexDataSize / indexSize));
+			if (m_arenaAllocation.pool >= 0)
+				return;
+		}
+
 		// VAO
-		assert(m_VAO == 0);
 		glGenVertexArrays(1, &m_VAO);
-		
+
+		// GL_ELEMENT_ARRAY_BUFFER binding is VAO state, do not clobber the VAO left bound by the last draw
+		GLStateCache::BindVertexArray(0);
+
 		// index VBO
 		glGenBuffers(1, &m_indexVBO);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexVBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_triangles.size() * 4, m_triangles.data(), GL_STATIC_DRAW);
-		
-		glGenBuffers(1, &m_positionVBO);
-		glBindBuffer(GL_ARRAY_BUFFER, m_positionVBO);
-		glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * 3 * 4, m_vertices.data(), GL_STATIC_DRAW);
-		
-		glGenBuffers(1, &m_normalVBO);
-		glBindBuffer(GL_ARRAY_BUFFER, m_normalVBO);
-		glBufferData(GL_ARRAY_BUFFER, m_normals.size() * 3 * 4, m_normals.data(), GL_STATIC_DRAW);
-		
-		glGenBuffers(1, &m_uvVBO);
-		glBindBuffer(GL_ARRAY_BUFFER, m_uvVBO);
-		glBufferData(GL_ARRAY_BUFFER, m_uv.size() * 2 * 4, m_uv.data(), GL_STATIC_DRAW);
-		
-		//float* tangents = new float[m_tangents.size() * 4];
-		//for (int i = 0; i < m_tangents.size(); ++i)
-		//{
-		//	Vector3 const & n = m_normals[i];
-		//	Vector3 const & t = m_tangents[i];
-		//}
-		glGenBuffers(1, &m_tangentVBO);
-		glBindBuffer(GL_ARRAY_BUFFER, m_tangentVBO);
-		glBufferData(GL_ARRAY_BUFFER, m_tangents.size() * 3 * 4, m_tangents.data(), GL_STATIC_DRAW);
-		
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexDataSize, indexData, GL_STATIC_DRAW);
+
+		glGenBuffers(1, &m_VBO);
+		glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+		glBufferData(GL_ARRAY_BUFFER, vertexDataSize, vertexData, GL_STATIC_DRAW);
+
 		if (m_skinned)
 		{
-			std::vector<Int4> boneIndexBuffer;
-			std::vector<Vector4> boneWeightBuffer;
-			boneIndexBuffer.reserve(m_boneWeights.size());
-			boneIndexBuffer.reserve(m_boneWeights.size());
-			for (auto const & b : m_boneWeights)
-			{
-				boneIndexBuffer.emplace_back(b.boneIndex[0], b.boneIndex[1], b.boneIndex[2], b.boneIndex[3]);
-				boneWeightBuffer.emplace_back(b.weight[0], b.weight[1], b.weight[2], b.weight[3]);
-			}
-
+			// transform feedback writes floats
 			glGenTransformFeedbacks(1, &m_TFBO);
 
 			glGenVertexArrays(1, &m_animationInputVAO);
 
 			glGenBuffers(1, &m_animationOutputPositionVBO);
 			glBindBuffer(GL_ARRAY_BUFFER, m_animationOutputPositionVBO);
-			glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * 3 * sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
+			glBufferData(GL_ARRAY_BUFFER, m_vertexCount * 3 * sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
 			
 			glGenBuffers(1, &m_animationOutputNormalVBO);
 			glBindBuffer(GL_ARRAY_BUFFER, m_animationOutputNormalVBO);
-			glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * 3 * sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
+			glBufferData(GL_ARRAY_BUFFER, m_vertexCount * 3 * sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
 
 			glGenBuffers(1, &m_animationOutputTangentVBO);
 			glBindBuffer(GL_ARRAY_BUFFER, m_animationOutputTangentVBO);
-			glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * 3 * sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
-
-			glGenBuffers(1, &m_boneIndexVBO);
-			glBindBuffer(GL_ARRAY_BUFFER, m_boneIndexVBO);
-			glBufferData(GL_ARRAY_BUFFER, boneIndexBuffer.size() * 4 * sizeof(int), boneIndexBuffer.data(), GL_STATIC_DRAW);
-
-			glGenBuffers(1, &m_boneWeightVBO);
-			glBindBuffer(GL_ARRAY_BUFFER, m_boneWeightVBO);
-			glBufferData(GL_ARRAY_BUFFER, boneWeightBuffer.size() * 4 * sizeof(GLfloat), boneWeightBuffer.data(), GL_STATIC_DRAW);
-
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			glBufferData(GL_ARRAY_BUFFER, m_vertexCount * 3 * sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
 		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 	
 	void Mesh::BindBuffer()
 	{
+		// the VAO of the arena pool is already set up
+		if (m_arenaAllocation.pool >= 0)
+			return;
+
 		if (m_skinned)
 		{
-			// Transform feedback input
-			glBindVertexArray(m_animationInputVAO);
-			
-			// position
-			glBindBuffer(GL_ARRAY_BUFFER, m_positionVBO);
-			glVertexAttribPointer(PositionIndex, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-			glEnableVertexAttribArray(PositionIndex);
-
-			// normal
-			glBindBuffer(GL_ARRAY_BUFFER, m_normalVBO);
-			glVertexAttribPointer(NormalIndex, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-			glEnableVertexAttribArray(NormalIndex);
-
-			// tangent
-			glBindBuffer(GL_ARRAY_BUFFER, m_tangentVBO);
-			glVertexAttribPointer(TangentIndex, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-			glEnableVertexAttribArray(TangentIndex);
-			
-			// bone indices
-			glBindBuffer(GL_ARRAY_BUFFER, m_boneIndexVBO);
-			glVertexAttribIPointer(BoneIndexIndex, 4, GL_INT, 4 * sizeof(GLint), (GLvoid*)0);
-			glEnableVertexAttribArray(BoneIndexIndex);
-			
-			// bone weights
-			glBindBuffer(GL_ARRAY_BUFFER, m_boneWeightVBO);
-			glVertexAttribPointer(BoneWeightIndex, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*)0);
-			glEnableVertexAttribArray(BoneWeightIndex);
-			
+			// Transform feedback input: position, normal, tangent, bone indices and weights
+			GLStateCache::BindVertexArray(m_animationInputVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+			m_vertexLayout.Apply();
 			glBindBuffer(GL_ARRAY_BUFFER, 0);
-			glBindVertexArray(0);
+			GLStateCache::BindVertexArray(0);
 			
 			glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, m_TFBO);
 			glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_animationOutputPositionVBO);
@@ -244,53 +385,27 @@ namespace FishEngine
 			glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
 		}
 		
-		glBindVertexArray(m_VAO);
+		GLStateCache::BindVertexArray(m_VAO);
 		
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexVBO);
 		
+		glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+		m_vertexLayout.Apply();
+
 		if (m_skinned)
 		{
+			// the skinned position, normal and tangent come from the transform feedback output
 			glBindBuffer(GL_ARRAY_BUFFER, m_animationOutputPositionVBO);
-		}
-		else
-		{
-			glBindBuffer(GL_ARRAY_BUFFER, m_positionVBO);
-		}
-		glVertexAttribPointer(PositionIndex, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-		glEnableVertexAttribArray(PositionIndex);
-		
-		
-		if (m_skinned)
-		{
+			glVertexAttribPointer(PositionIndex, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
 			glBindBuffer(GL_ARRAY_BUFFER, m_animationOutputNormalVBO);
-		}
-		else
-		{
-			glBindBuffer(GL_ARRAY_BUFFER, m_normalVBO);
-		}
-		//glBindBuffer(GL_ARRAY_BUFFER, m_normalVBO);
-		glVertexAttribPointer(NormalIndex, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-		glEnableVertexAttribArray(NormalIndex);
-		
-		glBindBuffer(GL_ARRAY_BUFFER, m_uvVBO);
-		glVertexAttribPointer(UVIndex, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (GLvoid*)0);
-		glEnableVertexAttribArray(UVIndex);
-		
-		if (m_skinned)
-		{
+			glVertexAttribPointer(NormalIndex, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
 			glBindBuffer(GL_ARRAY_BUFFER, m_animationOutputTangentVBO);
+			glVertexAttribPointer(TangentIndex, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
 		}
-		else
-		{
-			glBindBuffer(GL_ARRAY_BUFFER, m_tangentVBO);
-		}
-		//glBindBuffer(GL_ARRAY_BUFFER, m_tangentVBO);
-		glVertexAttribPointer(TangentIndex, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-		glEnableVertexAttribArray(TangentIndex);
 		
 		glBindBuffer(GL_ARRAY_BUFFER, 0); // Note that this is allowed, the call to glVertexAttribPointer registered VBO as the currently bound vertex buffer object so afterwards we can safely unbind
 		
-		glBindVertexArray(0); // Unbind VAO (it's always a good thing to unbind any buffer/array to prevent strange bugs), remember: do NOT unbind the EBO, keep it bound to this VAO
+		GLStateCache::BindVertexArray(0); // Unbind VAO (it's always a good thing to unbind any buffer/array to prevent strange bugs), remember: do NOT unbind the EBO, keep it bound to this VAO
 	}
 
 	void Mesh::Render( int subMeshIndex /* = -1*/)
@@ -301,8 +416,28 @@ namespace FishEngine
 			UploadMeshData();
 		}
 		
-		glBindVertexArray(m_VAO);
-			
+		// the VAO stays bound, the next draw of the same mesh (or of the same arena pool) skips the bind
+		GLStateCache::BindVertexArray(vertexArray());
+		DrawElements(subMeshIndex, 1);
+	}
+
+	void Mesh::RenderInstanced(int subMeshIndex, int instanceCount, GLuint instanceBuffer, GLintptr instanceOffset)
+	{
+		if (!m_uploaded)
+		{
+			UploadMeshData();
+		}
+
+		GLStateCache::BindVertexArray(vertexArray());
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		VertexLayout::ApplyInstanceMatrices(instanceOffset);
+
+		DrawElements(subMeshIndex, instanceCount);
+		VertexLayout::ResetInstanceMatrices();
+	}
+
+	Mesh::DrawRange Mesh::GetDrawRange(int subMeshIndex) const
+	{
 		if (subMeshIndex < 0 && subMeshIndex != -1)
 		{
 			LogWarning(Format( "invalid subMeshIndex %1%", subMeshIndex ));
@@ -313,28 +448,37 @@ namespace FishEngine
 			//Debug::LogWarning("invalid subMeshIndex %d", subMeshIndex);
 			subMeshIndex = m_subMeshCount;
 		}
-			
-		if (subMeshIndex == -1 || m_subMeshCount == 1)
-		{
-			glDrawElements(GL_TRIANGLES, m_triangleCount * 3, GL_UNSIGNED_INT, 0);
-		}
-		else
+
+		DrawRange range;
+		range.indexCount = m_triangleCount * 3;
+		range.firstIndex = m_arenaAllocation.firstIndex;
+		range.baseVertex = static_cast<GLint>(m_arenaAllocation.baseVertex);
+		if (subMeshIndex != -1 && m_subMeshCount != 1)
 		{
-			GLvoid * offset = (GLvoid *)( m_subMeshIndexOffset[subMeshIndex] * sizeof(GLuint) );
-			int index_count = 0;
+			range.firstIndex += m_subMeshIndexOffset[subMeshIndex];
 			if (subMeshIndex == m_subMeshCount-1) // the last one
 			{
-				index_count = m_triangleCount * 3 - m_subMeshIndexOffset[m_subMeshCount-1];
+				range.indexCount = m_triangleCount * 3 - m_subMeshIndexOffset[m_subMeshCount-1];
 				//index_count = 0;
 			}
 			else
 			{
-				index_count = m_subMeshIndexOffset[subMeshIndex+1] - m_subMeshIndexOffset[subMeshIndex];
+				range.indexCount = m_subMeshIndexOffset[subMeshIndex+1] - m_subMeshIndexOffset[subMeshIndex];
 			}
-			glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, offset);
 		}
-		
-		glBindVertexArray(0);
+		return range;
+	}
+
+	void Mesh::DrawElements(int subMeshIndex, int instanceCount)
+	{
+		const auto range = GetDrawRange(subMeshIndex);
+		const size_t indexSize = m_indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+		GLvoid * offset = (GLvoid *)( range.firstIndex * indexSize );
+
+		if (instanceCount == 1)
+			glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, m_indexType, offset, range.baseVertex);
+		else
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, m_indexType, offset, instanceCount, range.baseVertex);
 	}
 	
 	void Mesh::RenderSkinned()
@@ -346,7 +490,7 @@ namespace FishEngine
 		
 		glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, m_TFBO);
 		glEnable(GL_RASTERIZER_DISCARD);
-		glBindVertexArray(m_animationInputVAO);
+		GLStateCache::BindVertexArray(m_animationInputVAO);
 		//glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, m_animationOutputPositionVBO);
 		//glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_animationOutputPositionVBO);
 		glBeginTransformFeedback(GL_POINTS);
@@ -354,39 +498,68 @@ namespace FishEngine
 		glEndTransformFeedback();
 		//glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
 		//glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
-		glBindVertexArray(0);
 		glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
 		glDisable(GL_RASTERIZER_DISCARD);
 		glCheckError();
 	}
 
-	void Mesh::ToBinaryFile(std::ostream & os)
+	void Mesh::CalculateBoneBounds()
 	{
-		os.write((char*)&m_vertexCount, sizeof(m_vertexCount));
-		os.write((char*)&m_triangleCount, sizeof(m_triangleCount));
-		os.write((char*)m_vertices.data(), sizeof(decltype(m_vertices)::value_type) * m_vertices.size());
-		os.write((char*)m_normals.data(), sizeof(decltype(m_normals)::value_type) * m_normals.size());
-		os.write((char*)m_uv.data(), sizeof(decltype(m_uv)::value_type) * m_uv.size());
-		os.write((char*)m_tangents.data(), sizeof(decltype(m_tangents)::value_type) * m_tangents.size());
-		os.write((char*)m_triangles.data(), sizeof(decltype(m_triangles)::value_type) * m_triangles.size());
+		// the bind pose is the inverse of the bone transform, its inverse maps the bone origin to the mesh
+		std::vector<Vector3> origins(m_bindposes.size());
+		for (size_t i = 0; i < m_bindposes.size(); ++i)
+		{
+			origins[i] = m_bindposes[i].inverse().MultiplyPoint(Vector3::zero);
+		}
+
+		m_boneBounds.resize(m_bindposes.size());
+		for (size_t i = 0; i < m_bindposes.size(); ++i)
+		{
+			m_boneBounds[i] = Vector4(origins[i], -1.0f);
+		}
+		for (uint32_t v = 0; v < m_vertexCount; ++v)
+		{
+			auto const & boneWeight = m_boneWeights[v];
+			for (int k = 0; k < MaxBoneForEachVertex; ++k)
+			{
+				const uint32_t bone = static_cast<uint32_t>(boneWeight.boneIndex[k]);
+				if (boneWeight.weight[k] == 0.0f || bone >= m_boneBounds.size())
+					continue;
+				const float distance = Vector3::Distance(m_vertices[v], origins[bone]);
+				m_boneBounds[bone].w = std::max(m_boneBounds[bone].w, distance);
+			}
+		}
 	}
 
-	MeshPtr Mesh::FromBinaryFile(std::istream &is)
+	void Mesh::BindSkinnedVertices(GLuint buffer)
 	{
-		auto mesh = MakeShared<Mesh>();
-		is.read((char*)&mesh->m_vertexCount, sizeof(mesh->m_vertexCount));
-		is.read((char*)&mesh->m_triangleCount, sizeof(mesh->m_triangleCount));
-		mesh->m_vertices.resize(mesh->m_vertexCount);
-		mesh->m_normals.resize(mesh->m_vertexCount);
-		mesh->m_uv.resize(mesh->m_vertexCount);
-		mesh->m_tangents.resize(mesh->m_vertexCount);
-		mesh->m_triangles.resize(mesh->m_triangleCount * 3);
-		is.read((char*)mesh->m_vertices.data(), sizeof(decltype(mesh->m_vertices)::value_type) * mesh->m_vertices.size());
-		is.read((char*)mesh->m_normals.data(), sizeof(decltype(m_normals)::value_type) * mesh->m_normals.size());
-		is.read((char*)mesh->m_uv.data(), sizeof(decltype(m_uv)::value_type) * mesh->m_uv.size());
-		is.read((char*)mesh->m_tangents.data(), sizeof(decltype(m_tangents)::value_type) * mesh->m_tangents.size());
-		is.read((char*)mesh->m_triangles.data(), sizeof(decltype(m_triangles)::value_type) * mesh->m_triangles.size());
-		return mesh;
+		if (!m_uploaded)
+		{
+			UploadMeshData();
+		}
+		if (!m_skinned || buffer == m_skinnedVertexBuffer)
+			return;
+		m_skinnedVertexBuffer = buffer;
+
+		GLStateCache::BindVertexArray(m_VAO);
+		if (buffer == 0)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, m_animationOutputPositionVBO);
+			glVertexAttribPointer(PositionIndex, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
+			glBindBuffer(GL_ARRAY_BUFFER, m_animationOutputNormalVBO);
+			glVertexAttribPointer(NormalIndex, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
+			glBindBuffer(GL_ARRAY_BUFFER, m_animationOutputTangentVBO);
+			glVertexAttribPointer(TangentIndex, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
+		}
+		else
+		{
+			const size_t streamSize = m_vertexCount * 3 * sizeof(GLfloat);
+			glBindBuffer(GL_ARRAY_BUFFER, buffer);
+			glVertexAttribPointer(PositionIndex, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
+			glVertexAttribPointer(NormalIndex, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)streamSize);
+			glVertexAttribPointer(TangentIndex, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)(streamSize * 2));
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 
 	MeshPtr Mesh::FromTextFile(std::istream & is)
@@ -434,8 +607,26 @@ namespace FishEngine
 		for (auto & t : { PrimitiveType::Sphere, PrimitiveType::Capsule, PrimitiveType::Cylinder, PrimitiveType::Quad, PrimitiveType::Cube, PrimitiveType::Plane, PrimitiveType::Cone })
 		{
 			std::string n = FishEngine::EnumToString(t);
-			std::ifstream is((dir / (n + ".txt")).string());
-			auto mesh = Mesh::FromTextFile(is);
+			auto textPath = dir / (n + ".txt");
+			auto binaryPath = dir / (n + ".mesh");
+			MeshPtr mesh;
+			// the text file may be missing when only the binary ones are shipped
+			boost::system::error_code ec;
+			const auto textTime = boost::filesystem::last_write_time(textPath, ec);
+			if (boost::filesystem::exists(binaryPath) && (ec || boost::filesystem::last_write_time(binaryPath) >= textTime))
+			{
+				mesh = MeshFile::Load(binaryPath);
+			}
+			if (mesh == nullptr)
+			{
+				// parse the text once, the next runs map the binary file.
+				// Builtin meshes keep their CPU data (bounds, picking, colliders), so the binary file must too.
+				std::ifstream is(textPath.string());
+				mesh = Mesh::FromTextFile(is);
+				MeshFileOptions options;
+				options.readable = true;
+				MeshFile::Save(*mesh, binaryPath, options);
+			}
 			mesh->setName(n);
 			s_builtinMeshes[t] = mesh;
 		}
@@ -467,7 +658,7 @@ namespace FishEngine
 		m_drawMode(drawMode)
 	{
 		glGenVertexArrays(1, &m_VAO);
-		glBindVertexArray(m_VAO);
+		GLStateCache::BindVertexArray(m_VAO);
 		glGenBuffers(1, &m_VBO);
 		glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
 		glBufferData(GL_ARRAY_BUFFER, m_positionBuffer.size() * sizeof(GLfloat), m_positionBuffer.data(), GL_DYNAMIC_DRAW);
@@ -486,16 +677,15 @@ namespace FishEngine
 
 	void SimpleMesh::Render() const
 	{
-		glBindVertexArray(m_VAO);
+		GLStateCache::BindVertexArray(m_VAO);
 		glDrawArrays(m_drawMode, 0, static_cast<GLsizei>(m_positionBuffer.size() / 3));
-		glBindVertexArray(0);
 	}
 
 	void DynamicMesh::Render(const float* positionBuffer, uint32_t vertexCount, GLenum drawMode)
 	{
 		if (m_VAO == 0)
 			glGenVertexArrays(1, &m_VAO);
-		glBindVertexArray(m_VAO);
+		GLStateCache::BindVertexArray(m_VAO);
 		if (m_VBO == 0)
 			glGenBuffers(1, &m_VBO);
 		glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
@@ -503,6 +693,5 @@ namespace FishEngine
 		glVertexAttribPointer(PositionIndex, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
 		glEnableVertexAttribArray(PositionIndex);
 		glDrawArrays(m_drawMode, 0, vertexCount);
-		glBindVertexArray(0);
 	}
 }
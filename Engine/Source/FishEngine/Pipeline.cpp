@@ -1,6 +1,7 @@
 #include <FishEngine/Pipeline.hpp>
 
 #include <cassert>
+#include <algorithm>
 
 #include <FishEngine/GLEnvironment.hpp>
 #include <FishEngine/Camera.hpp>
@@ -11,6 +12,7 @@
 #include <FishEngine/RenderTexture.hpp>
 #include <FishEngine/RenderTarget.hpp>
 #include <FishEngine/QualitySettings.hpp>
+#include <FishEngine/Render/UniformRingBuffer.hpp>
 
 namespace FishEngine
 {
@@ -23,18 +25,73 @@ namespace FishEngine
 
 	PerCameraUniforms   Pipeline::s_perCameraUniforms;
 
-	unsigned int        Pipeline::s_perCameraUBO = 0;
-	unsigned int        Pipeline::s_perDrawUBO = 0;
-	unsigned int        Pipeline::s_lightingUBO = 0;
-	unsigned int        Pipeline::s_bonesUBO = 0;
+	Bones               Pipeline::s_bonesUniforms;
+	uint32_t            Pipeline::s_boneCount = 0;
+
+	UniformRingBuffer   Pipeline::s_uniformRing;
+	uint32_t            Pipeline::s_uniformGeneration = 0;
+	uint32_t            Pipeline::s_uploadedBlocks = 0;
+
+	// per segment, one segment holds the uniforms of one frame
+	constexpr uint32_t kUniformRingSegmentSize = 4 * 1024 * 1024;
 
 	void Pipeline::Init()
 	{
-		glGenBuffers(1, &s_perCameraUBO);
-		assert(s_perCameraUBO > 0);
-		glGenBuffers(1, &s_perDrawUBO);
-		glGenBuffers(1, &s_lightingUBO);
-		glGenBuffers(1, &s_bonesUBO);
+		s_uniformRing.Init(kUniformRingSegmentSize);
+		s_uniformGeneration = s_uniformRing.generation();
+	}
+
+	void Pipeline::Clean()
+	{
+		s_uniformRing.Destroy();
+		s_uploadedBlocks = 0;
+	}
+
+	void Pipeline::EndFrame()
+	{
+		s_uniformRing.NextFrame();
+	}
+
+	void Pipeline::UploadUniformBlock(unsigned int bindingPoint)
+	{
+		auto upload = [](unsigned int bindingPoint)
+		{
+			switch (bindingPoint)
+			{
+			case PerCameraUBOBindingPoint:
+				s_uniformRing.Upload(bindingPoint, &s_perCameraUniforms, sizeof(s_perCameraUniforms));
+				break;
+			case PerDrawUBOBindingPoint:
+				s_uniformRing.Upload(bindingPoint, &s_perDrawUniforms, sizeof(s_perDrawUniforms));
+				break;
+			case LightingUBOBindingPoint:
+				s_uniformRing.Upload(bindingPoint, &s_lightingUniforms, sizeof(s_lightingUniforms));
+				break;
+			case BonesUBOBindingPoint:
+				// always bind the whole block, the shader declares MAX_BONE_SIZE matrices
+				s_uniformRing.Upload(bindingPoint, &s_bonesUniforms, s_boneCount * sizeof(AffineMatrix), sizeof(s_bonesUniforms));
+				break;
+			default:
+				assert(false);
+			}
+		};
+
+		upload(bindingPoint);
+		s_uploadedBlocks |= 1u << bindingPoint;
+
+		if (s_uniformRing.generation() != s_uniformGeneration)
+		{
+			// the ring moved to a new segment, the ranges still bound for the other blocks
+			// point into the retired one and must not be read by the following draws
+			s_uniformGeneration = s_uniformRing.generation();
+			for (unsigned int i = 0; i <= BonesUBOBindingPoint; ++i)
+			{
+				if (i != bindingPoint && (s_uploadedBlocks & (1u << i)))
+					upload(i);
+			}
+			assert(s_uniformRing.generation() == s_uniformGeneration);
+		}
+		glCheckError();
 	}
 
 	void Pipeline::BindCamera(const CameraPtr& camera)
@@ -70,11 +127,7 @@ namespace FishEngine
 		s_perCameraUniforms.ZBufferParams.z = s_perCameraUniforms.ZBufferParams.x / far;
 		s_perCameraUniforms.ZBufferParams.w = s_perCameraUniforms.ZBufferParams.y / far;
 
-		glBindBuffer(GL_UNIFORM_BUFFER, s_perCameraUBO);
-		//auto size = sizeof(perFrameUniformData);
-		glBufferData(GL_UNIFORM_BUFFER, sizeof(s_perCameraUniforms), (void*)&s_perCameraUniforms, GL_DYNAMIC_DRAW);
-		glBindBufferBase(GL_UNIFORM_BUFFER, PerCameraUBOBindingPoint, s_perCameraUBO);
-		glCheckError();
+		UploadUniformBlock(PerCameraUBOBindingPoint);
 	}
 
 	float CalculateShadowDistance(const CameraPtr & camera)
@@ -139,37 +192,36 @@ namespace FishEngine
 			s_lightingUniforms.LightMatrix[i] = s_lightingUniforms.LightMatrix[i].transpose();
 		}
 
-		glBindBuffer(GL_UNIFORM_BUFFER, s_lightingUBO);
-		//auto size = sizeof(perFrameUniformData);
-		glBufferData(GL_UNIFORM_BUFFER, sizeof(s_lightingUniforms), (void*)&s_lightingUniforms, GL_DYNAMIC_DRAW);
-		glBindBufferBase(GL_UNIFORM_BUFFER, LightingUBOBindingPoint, s_lightingUBO);
-		glCheckError();
+		UploadUniformBlock(LightingUBOBindingPoint);
 	}
 
-	void Pipeline::UpdatePerDrawUniforms(const Matrix4x4& modelMatrix)
+	void Pipeline::UpdatePerDrawUniforms(const Matrix4x4& modelMatrix, float lodFade)
 	{
 		glCheckError();
 		auto mv = Pipeline::s_perCameraUniforms.MATRIX_V * modelMatrix;
 		s_perDrawUniforms.MATRIX_MVP = Pipeline::s_perCameraUniforms.MATRIX_VP * modelMatrix;
 		s_perDrawUniforms.MATRIX_MV = mv;
 		s_perDrawUniforms.MATRIX_M = modelMatrix;
-		s_perDrawUniforms.MATRIX_IT_MV = mv.transpose().inverse();
 		s_perDrawUniforms.MATRIX_IT_M = modelMatrix.transpose().inverse();
+		// (V*M)^-T = V^-T * M^-T, V^-1 is already known from BindCamera
+		s_perDrawUniforms.MATRIX_IT_MV = Pipeline::s_perCameraUniforms.MATRIX_I_V.transpose() * s_perDrawUniforms.MATRIX_IT_M;
+		s_perDrawUniforms.LODFade = Vector4(lodFade, 0, 0, 0);
 
-		glBindBuffer(GL_UNIFORM_BUFFER, s_perDrawUBO);
-		//auto size = sizeof(perDrawUniformData);
-		glBufferData(GL_UNIFORM_BUFFER, sizeof(s_perDrawUniforms), (void*)&s_perDrawUniforms, GL_DYNAMIC_DRAW);
-		glBindBufferBase(GL_UNIFORM_BUFFER, PerDrawUBOBindingPoint, s_perDrawUBO);
-		glCheckError();
+		UploadUniformBlock(PerDrawUBOBindingPoint);
 	}
 
-	void Pipeline::UpdateBonesUniforms(const std::vector<Matrix4x4>& bones)
+	void Pipeline::UpdateBonesUniforms(const std::vector<AffineMatrix>& bones)
 	{
-		glBindBuffer(GL_UNIFORM_BUFFER, s_bonesUBO);
-		//auto size = sizeof(perFrameUniformData);
-		glBufferData(GL_UNIFORM_BUFFER, bones.size() * sizeof(Matrix4x4), (void*)bones.data(), GL_DYNAMIC_DRAW);
-		glBindBufferBase(GL_UNIFORM_BUFFER, BonesUBOBindingPoint, s_bonesUBO);
-		glCheckError();
+		// meshes with more bones are skinned on the CPU (see SkinnedMeshRenderer::UseCPUSkinning)
+		if (bones.size() > MAX_BONE_SIZE)
+		{
+			LogError(Format("UpdateBonesUniforms: %1% bones, the block holds at most %2%", bones.size(), MAX_BONE_SIZE));
+			return;
+		}
+		// keep a copy, the block has to be uploaded again if the ring buffer moves to a new segment
+		s_boneCount = static_cast<uint32_t>(bones.size());
+		std::copy(bones.begin(), bones.begin() + s_boneCount, s_bonesUniforms.BoneTransformations);
+		UploadUniformBlock(BonesUBOBindingPoint);
 	}
 
 	void Pipeline::PushRenderTarget(const RenderTargetPtr& renderTarget)
@@ -35,6 +35,10 @@ namespace FishEngine
 
 	float QualitySettings::m_shadowNearPlaneOffset = 2.0f;
 
+	float QualitySettings::s_lodBias = 1.0f;
+
+	int QualitySettings::s_maximumLODLevel = 0;
+
 }
 
 
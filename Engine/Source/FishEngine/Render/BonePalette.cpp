@@ -0,0 +1,117 @@
+#include <FishEngine/Render/BonePalette.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#include <FishEngine/Transform.hpp>
+
+#include <FishEngine/SIMD.hpp>
+
+namespace FishEngine
+{
+	namespace
+	{
+#if FISHENGINE_SIMD
+		using namespace SIMD;
+
+		struct AffineRows
+		{
+			float4 r[3];
+		};
+
+		inline AffineRows LoadRows(const AffineMatrix & m)
+		{
+			return { { Load(&m.rows[0].x), Load(&m.rows[1].x), Load(&m.rows[2].x) } };
+		}
+
+		inline AffineRows LoadRows(const Matrix4x4 & m)
+		{
+			return { { Load(m.m[0]), Load(m.m[1]), Load(m.m[2]) } };
+		}
+
+		inline void StoreRows(const AffineRows & a, AffineMatrix & m)
+		{
+			Store(&m.rows[0].x, a.r[0]);
+			Store(&m.rows[1].x, a.r[1]);
+			Store(&m.rows[2].x, a.r[2]);
+		}
+
+		// row i of a * b = a[i][0] * b[0] + a[i][1] * b[1] + a[i][2] * b[2] + a[i][3] * (0, 0, 0, 1)
+		inline AffineRows Multiply(const AffineRows & a, const AffineRows & b)
+		{
+			const float4 unitW = Set(0, 0, 0, 1);
+			AffineRows result;
+			for (int i = 0; i < 3; ++i)
+			{
+				const float4 row = a.r[i];
+				float4 r = Mul(row, unitW);
+				r = MulAdd(Broadcast<0>(row), b.r[0], r);
+				r = MulAdd(Broadcast<1>(row), b.r[1], r);
+				r = MulAdd(Broadcast<2>(row), b.r[2], r);
+				result.r[i] = r;
+			}
+			return result;
+		}
+#else
+		inline void MultiplyScalar(const float a[3][4], const float b[3][4], float result[3][4])
+		{
+			for (int i = 0; i < 3; ++i)
+			{
+				for (int j = 0; j < 4; ++j)
+				{
+					result[i][j] = a[i][0] * b[0][j] + a[i][1] * b[1][j] + a[i][2] * b[2][j];
+				}
+				result[i][3] += a[i][3];
+			}
+		}
+#endif
+	}
+
+	float AffineMatrix::maxScale() const
+	{
+		float sqrScale = 0;
+		for (int j = 0; j < 3; ++j)
+		{
+			const float x = (&rows[0].x)[j];
+			const float y = (&rows[1].x)[j];
+			const float z = (&rows[2].x)[j];
+			sqrScale = std::max(sqrScale, x * x + y * y + z * z);
+		}
+		return std::sqrt(sqrScale);
+	}
+
+	void BonePalette::Multiply(const AffineMatrix & a, const AffineMatrix & b, AffineMatrix & result)
+	{
+#if FISHENGINE_SIMD
+		StoreRows(FishEngine::Multiply(LoadRows(a), LoadRows(b)), result);
+#else
+		float r[3][4];
+		MultiplyScalar(reinterpret_cast<const float(*)[4]>(&a.rows[0].x), reinterpret_cast<const float(*)[4]>(&b.rows[0].x), r);
+		for (int i = 0; i < 3; ++i)
+			result.rows[i] = Vector4(r[i][0], r[i][1], r[i][2], r[i][3]);
+#endif
+	}
+
+	void BonePalette::Build(const AffineMatrix & worldToLocal, Transform* const * bones, const AffineMatrix * bindposes,
+		std::size_t count, AffineMatrix * palette)
+	{
+#if FISHENGINE_SIMD
+		const AffineRows w2l = LoadRows(worldToLocal);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			AffineRows m = LoadRows(bindposes[i]);
+			if (bones[i] != nullptr)
+				m = FishEngine::Multiply(LoadRows(bones[i]->localToWorldMatrix()), m);
+			StoreRows(FishEngine::Multiply(w2l, m), palette[i]);
+		}
+#else
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			AffineMatrix m = bindposes[i];
+			if (bones[i] != nullptr)
+				Multiply(AffineMatrix(bones[i]->localToWorldMatrix()), m, m);
+			Multiply(worldToLocal, m, palette[i]);
+		}
+#endif
+	}
+}
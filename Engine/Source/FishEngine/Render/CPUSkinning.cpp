@@ -0,0 +1,268 @@
+#include <FishEngine/Render/CPUSkinning.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include <FishEngine/SIMD.hpp>
+
+namespace
+{
+	using namespace FishEngine;
+
+	struct SkinningTask
+	{
+		const SkinningJob*	job;
+		uint32_t			first;
+		uint32_t			last;
+	};
+
+	// Persistent threads, woken once per Run. Each one (and the calling thread) takes tasks from a shared
+	// atomic index until they are all taken.
+	class WorkerPool
+	{
+	public:
+		~WorkerPool()
+		{
+			Resize(0);
+		}
+
+		int size() const
+		{
+			return static_cast<int>(m_threads.size());
+		}
+
+		void Resize(int count)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_quit = true;
+			}
+			m_wake.notify_all();
+			for (auto & t : m_threads)
+				t.join();
+			m_threads.clear();
+			m_quit = false;
+			for (int i = 0; i < count; ++i)
+				m_threads.emplace_back([this]() { WorkerMain(); });
+		}
+
+		void Run(const SkinningJob* jobs, int jobCount)
+		{
+			{
+				// a worker woken late for the previous Run may still be looking at m_tasks
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_finished.wait(lock, [this]() { return m_active == 0; });
+				m_tasks.clear();
+				for (int i = 0; i < jobCount; ++i)
+				{
+					const uint32_t vertexCount = jobs[i].source->vertexCount();
+					for (uint32_t first = 0; first < vertexCount; first += CPUSkinning::kVerticesPerTask)
+					{
+						const uint32_t last = std::min(first + CPUSkinning::kVerticesPerTask, vertexCount);
+						m_tasks.push_back({ &jobs[i], first, last });
+					}
+				}
+				m_next = 0;
+				if (m_tasks.size() > 1 && !m_threads.empty())
+					++m_generation;
+			}
+			m_wake.notify_all();
+
+			Work();
+
+			// every task is taken, the ones still running belong to active workers
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_finished.wait(lock, [this]() { return m_active == 0; });
+		}
+
+	private:
+		void Work()
+		{
+			for (std::size_t i = m_next++; i < m_tasks.size(); i = m_next++)
+			{
+				auto const & task = m_tasks[i];
+				CPUSkinning::Skin(*task.job, task.first, task.last);
+			}
+		}
+
+		void WorkerMain()
+		{
+			uint64_t generation = 0;
+			for (;;)
+			{
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_wake.wait(lock, [&]() { return m_quit || m_generation != generation; });
+					if (m_quit)
+						return;
+					generation = m_generation;
+					++m_active;
+				}
+				Work();
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					--m_active;
+				}
+				m_finished.notify_all();
+			}
+		}
+
+		std::vector<std::thread>	m_threads;
+		std::vector<SkinningTask>	m_tasks;
+		std::atomic<std::size_t>	m_next{ 0 };
+		std::mutex					m_mutex;
+		std::condition_variable		m_wake;
+		std::condition_variable		m_finished;
+		uint64_t					m_generation = 0;
+		int							m_active = 0;
+		bool						m_quit = false;
+	};
+
+	WorkerPool & Pool()
+	{
+		static WorkerPool pool;
+		return pool;
+	}
+
+	int s_workerCount = -1;	// -1: hardware_concurrency() - 1, set on the first Run
+
+	void ApplyWorkerCount()
+	{
+		if (s_workerCount < 0)
+		{
+			const int hardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+			s_workerCount = std::max(hardwareThreads - 1, 0);
+		}
+		if (Pool().size() != s_workerCount)
+			Pool().Resize(s_workerCount);
+	}
+
+	void ZeroStream(float* out, uint32_t first, uint32_t last)
+	{
+		std::memset(out + first * 3, 0, (last - first) * 3 * sizeof(float));
+	}
+}
+
+namespace FishEngine
+{
+	void CPUSkinning::Skin(SkinningJob const & job, uint32_t first, uint32_t last)
+	{
+		auto const & source = *job.source;
+		assert(source.boneWeights.size() == source.vertexCount());
+		const bool hasNormals = !source.normals.empty();
+		const bool hasTangents = !source.tangents.empty();
+		if (!hasNormals)
+			ZeroStream(job.normals, first, last);
+		if (!hasTangents)
+			ZeroStream(job.tangents, first, last);
+
+		for (uint32_t v = first; v < last; ++v)
+		{
+			auto const & boneWeight = source.boneWeights[v];
+			auto const & p = source.positions[v];
+
+			// blend the 3 rows of the affine palette entries, then transpose them to columns
+#if FISHENGINE_SIMD
+			using namespace SIMD;
+			float4 c0 = Zero();
+			float4 c1 = Zero();
+			float4 c2 = Zero();
+			float4 c3 = Zero();
+			for (int k = 0; k < MaxBoneForEachVertex; ++k)
+			{
+				const float weight = boneWeight.weight[k];
+				const uint32_t bone = static_cast<uint32_t>(boneWeight.boneIndex[k]);
+				if (weight == 0.0f || bone >= job.boneCount)
+					continue;
+				const float* m = &job.palette[bone].rows[0].x;
+				const float4 w = Splat(weight);
+				c0 = MulAdd(w, Load(m), c0);
+				c1 = MulAdd(w, Load(m + 4), c1);
+				c2 = MulAdd(w, Load(m + 8), c2);
+			}
+			Transpose(c0, c1, c2, c3);
+
+			float4 r = MulAdd(c0, Splat(p.x), c3);
+			r = MulAdd(c1, Splat(p.y), r);
+			r = MulAdd(c2, Splat(p.z), r);
+			Store3(job.positions + v * 3, r);
+			if (hasNormals)
+			{
+				auto const & n = source.normals[v];
+				r = Mul(c0, Splat(n.x));
+				r = MulAdd(c1, Splat(n.y), r);
+				r = MulAdd(c2, Splat(n.z), r);
+				Store3(job.normals + v * 3, r);
+			}
+			if (hasTangents)
+			{
+				auto const & t = source.tangents[v];
+				r = Mul(c0, Splat(t.x));
+				r = MulAdd(c1, Splat(t.y), r);
+				r = MulAdd(c2, Splat(t.z), r);
+				Store3(job.tangents + v * 3, r);
+			}
+#else
+			float r[12] = { 0 };
+			for (int k = 0; k < MaxBoneForEachVertex; ++k)
+			{
+				const float weight = boneWeight.weight[k];
+				const uint32_t bone = static_cast<uint32_t>(boneWeight.boneIndex[k]);
+				if (weight == 0.0f || bone >= job.boneCount)
+					continue;
+				const float* m = &job.palette[bone].rows[0].x;
+				for (int i = 0; i < 12; ++i)
+					r[i] += weight * m[i];
+			}
+
+			float* out = job.positions + v * 3;
+			for (int i = 0; i < 3; ++i)
+				out[i] = r[i * 4] * p.x + r[i * 4 + 1] * p.y + r[i * 4 + 2] * p.z + r[i * 4 + 3];
+			if (hasNormals)
+			{
+				auto const & n = source.normals[v];
+				out = job.normals + v * 3;
+				for (int i = 0; i < 3; ++i)
+					out[i] = r[i * 4] * n.x + r[i * 4 + 1] * n.y + r[i * 4 + 2] * n.z;
+			}
+			if (hasTangents)
+			{
+				auto const & t = source.tangents[v];
+				out = job.tangents + v * 3;
+				for (int i = 0; i < 3; ++i)
+					out[i] = r[i * 4] * t.x + r[i * 4 + 1] * t.y + r[i * 4 + 2] * t.z;
+			}
+#endif
+		}
+	}
+
+	void CPUSkinning::Run(const SkinningJob* jobs, int jobCount)
+	{
+		if (jobCount <= 0)
+			return;
+		ApplyWorkerCount();
+		Pool().Run(jobs, jobCount);
+	}
+
+	int CPUSkinning::workerCount()
+	{
+		if (s_workerCount < 0)
+			return std::max(static_cast<int>(std::thread::hardware_concurrency()) - 1, 0);
+		return s_workerCount;
+	}
+
+	void CPUSkinning::setWorkerCount(int count)
+	{
+		s_workerCount = std::max(count, 0);
+	}
+
+	bool CPUSkinning::simdEnabled()
+	{
+		return FISHENGINE_SIMD != 0;
+	}
+}
@@ -0,0 +1,217 @@
+#include <FishEngine/Render/Culling.hpp>
+
+#include <FishEngine/Camera.hpp>
+
+#include <FishEngine/SIMD.hpp>
+
+namespace FishEngine
+{
+	// big enough to never be culled, small enough to not overflow when summed
+	constexpr float kInfiniteExtent = 1e30f;
+
+	FrustumPlanes FrustumPlanes::FromMatrix(const Matrix4x4 & m)
+	{
+		// column vector convention: clip = m * p
+		// -w <= x <= w  =>  (row3 + row0).p >= 0 && (row3 - row0).p >= 0, etc.
+		FrustumPlanes f;
+		f.planes[0] = m.rows[3] + m.rows[0];	// left
+		f.planes[1] = m.rows[3] - m.rows[0];	// right
+		f.planes[2] = m.rows[3] + m.rows[1];	// bottom
+		f.planes[3] = m.rows[3] - m.rows[1];	// top
+		f.planes[4] = m.rows[3] + m.rows[2];	// near
+		f.planes[5] = m.rows[3] - m.rows[2];	// far
+		return f;
+	}
+
+	FrustumPlanes FrustumPlanes::FromCamera(const Camera & camera)
+	{
+		return FromMatrix(camera.projectionMatrix() * camera.worldToCameraMatrix());
+	}
+
+
+	void BoundsArray::Clear()
+	{
+		m_size = 0;
+		m_centerX.clear();
+		m_centerY.clear();
+		m_centerZ.clear();
+		m_extentX.clear();
+		m_extentY.clear();
+		m_extentZ.clear();
+	}
+
+	void BoundsArray::Reserve(std::size_t count)
+	{
+		count = (count + 3) & ~std::size_t(3);
+		m_centerX.reserve(count);
+		m_centerY.reserve(count);
+		m_centerZ.reserve(count);
+		m_extentX.reserve(count);
+		m_extentY.reserve(count);
+		m_extentZ.reserve(count);
+	}
+
+	uint32_t BoundsArray::Add(const Bounds & bounds)
+	{
+		if (m_size % 4 == 0)
+		{
+			// grow by one SIMD lane group; padding boxes are degenerate points at the origin
+			const std::size_t padded = m_size + 4;
+			m_centerX.resize(padded, 0.f);
+			m_centerY.resize(padded, 0.f);
+			m_centerZ.resize(padded, 0.f);
+			m_extentX.resize(padded, 0.f);
+			m_extentY.resize(padded, 0.f);
+			m_extentZ.resize(padded, 0.f);
+		}
+		auto index = static_cast<uint32_t>(m_size);
+		m_size++;
+		Set(index, bounds);
+		return index;
+	}
+
+	void BoundsArray::Set(uint32_t index, const Bounds & bounds)
+	{
+		Assert(index < m_size);
+		if (bounds.IsValid())
+		{
+			const auto c = bounds.center();
+			const auto e = bounds.extents();
+			m_centerX[index] = c.x;
+			m_centerY[index] = c.y;
+			m_centerZ[index] = c.z;
+			m_extentX[index] = e.x;
+			m_extentY[index] = e.y;
+			m_extentZ[index] = e.z;
+		}
+		else
+		{
+			m_centerX[index] = m_centerY[index] = m_centerZ[index] = 0.f;
+			m_extentX[index] = m_extentY[index] = m_extentZ[index] = kInfiniteExtent;
+		}
+	}
+
+	void BoundsArray::RemoveSwapBack(uint32_t index)
+	{
+		Assert(index < m_size);
+		const std::size_t last = m_size - 1;
+		for (auto array : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ })
+		{
+			(*array)[index] = (*array)[last];
+			(*array)[last] = 0.f;
+		}
+		m_size--;
+		// keep the padding to a multiple of 4
+		if (m_size % 4 == 0)
+		{
+			for (auto array : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ })
+				array->resize(m_size);
+		}
+	}
+
+
+	std::size_t Culling::CullBounds(const FrustumPlanes & frustum, const BoundsArray & bounds, std::vector<uint8_t> & visible)
+	{
+		const std::size_t count = bounds.size();
+		visible.resize(count);
+		if (count == 0)
+			return 0;
+
+		const float* cx = bounds.m_centerX.data();
+		const float* cy = bounds.m_centerY.data();
+		const float* cz = bounds.m_centerZ.data();
+		const float* ex = bounds.m_extentX.data();
+		const float* ey = bounds.m_extentY.data();
+		const float* ez = bounds.m_extentZ.data();
+
+		// the box is outside of plane (n, d) if dot(n, c) + d < -dot(|n|, e)
+		float absPlanes[6][3];
+		for (int p = 0; p < 6; ++p)
+		{
+			absPlanes[p][0] = std::fabs(frustum.planes[p].x);
+			absPlanes[p][1] = std::fabs(frustum.planes[p].y);
+			absPlanes[p][2] = std::fabs(frustum.planes[p].z);
+		}
+
+		std::size_t visibleCount = 0;
+
+#if FISHENGINE_SIMD
+		using namespace SIMD;
+		float4 planeX[6], planeY[6], planeZ[6], planeW[6];
+		float4 absX[6], absY[6], absZ[6];
+		for (int p = 0; p < 6; ++p)
+		{
+			planeX[p] = Splat(frustum.planes[p].x);
+			planeY[p] = Splat(frustum.planes[p].y);
+			planeZ[p] = Splat(frustum.planes[p].z);
+			planeW[p] = Splat(frustum.planes[p].w);
+			absX[p] = Splat(absPlanes[p][0]);
+			absY[p] = Splat(absPlanes[p][1]);
+			absZ[p] = Splat(absPlanes[p][2]);
+		}
+
+		// arrays are padded to a multiple of 4
+		for (std::size_t i = 0; i < count; i += 4)
+		{
+			const float4 x = Load(cx + i);
+			const float4 y = Load(cy + i);
+			const float4 z = Load(cz + i);
+			const float4 sx = Load(ex + i);
+			const float4 sy = Load(ey + i);
+			const float4 sz = Load(ez + i);
+
+			float4 outside = Zero();
+			for (int p = 0; p < 6; ++p)
+			{
+				float4 d = MulAdd(x, planeX[p], planeW[p]);
+				d = MulAdd(y, planeY[p], d);
+				d = MulAdd(z, planeZ[p], d);
+				d = MulAdd(sx, absX[p], d);
+				d = MulAdd(sy, absY[p], d);
+				d = MulAdd(sz, absZ[p], d);
+				outside = Or(outside, CmpLt(d, Zero()));
+			}
+
+			const int mask = MoveMask(outside);
+			const std::size_t n = count - i < 4 ? count - i : 4;
+			for (std::size_t k = 0; k < n; ++k)
+			{
+				uint8_t v = (mask & (1 << k)) == 0 ? 1 : 0;
+				visible[i + k] = v;
+				visibleCount += v;
+			}
+		}
+#else
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			bool outside = false;
+			for (int p = 0; p < 6 && !outside; ++p)
+			{
+				const auto & plane = frustum.planes[p];
+				float d = cx[i] * plane.x + cy[i] * plane.y + cz[i] * plane.z + plane.w;
+				float r = ex[i] * absPlanes[p][0] + ey[i] * absPlanes[p][1] + ez[i] * absPlanes[p][2];
+				outside = d + r < 0;
+			}
+			visible[i] = outside ? 0 : 1;
+			visibleCount += visible[i];
+		}
+#endif
+		return visibleCount;
+	}
+
+	bool Culling::IsVisible(const FrustumPlanes & frustum, const Bounds & bounds)
+	{
+		if (!bounds.IsValid())
+			return true;
+		const auto c = bounds.center();
+		const auto e = bounds.extents();
+		for (auto & plane : frustum.planes)
+		{
+			float d = c.x * plane.x + c.y * plane.y + c.z * plane.z + plane.w;
+			float r = e.x * std::fabs(plane.x) + e.y * std::fabs(plane.y) + e.z * std::fabs(plane.z);
+			if (d + r < 0)
+				return false;
+		}
+		return true;
+	}
+}
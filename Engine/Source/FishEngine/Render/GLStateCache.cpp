@@ -0,0 +1,298 @@
+#include <FishEngine/Render/GLStateCache.hpp>
+
+namespace FishEngine
+{
+	uint32_t GLStateCounters::totalIssued() const
+	{
+		uint32_t sum = 0;
+		for (auto c : issued)
+			sum += c;
+		return sum;
+	}
+
+	uint32_t GLStateCounters::totalSkipped() const
+	{
+		uint32_t sum = 0;
+		for (auto c : skipped)
+			sum += c;
+		return sum;
+	}
+
+	namespace
+	{
+		constexpr GLuint	kUnknown = ~0u;
+		constexpr int8_t	kUnknownFlag = -1;
+		constexpr int		kMaxTextureUnits = 32;
+		constexpr int		kTextureTargetCount = 3;	// 2D, CUBE_MAP, 2D_ARRAY
+
+		struct GLState
+		{
+			GLuint	program;
+			GLuint	vao;
+			GLuint	activeTextureUnit;
+			GLuint	textures[kMaxTextureUnits][kTextureTargetCount];
+			GLuint	samplers[kMaxTextureUnits];
+			int8_t	cullEnabled;
+			GLenum	cullFace;
+			int8_t	blendEnabled;
+			GLenum	blendFunc[4];
+			int8_t	depthTest;
+			int8_t	depthMask;
+			GLenum	depthFunc;
+			GLuint	drawFramebuffer;
+			GLuint	readFramebuffer;
+
+			void Reset()
+			{
+				program = vao = activeTextureUnit = kUnknown;
+				for (auto & unit : textures)
+					for (auto & t : unit)
+						t = kUnknown;
+				for (auto & s : samplers)
+					s = kUnknown;
+				cullEnabled = blendEnabled = depthTest = depthMask = kUnknownFlag;
+				cullFace = depthFunc = kUnknown;
+				for (auto & f : blendFunc)
+					f = kUnknown;
+				drawFramebuffer = readFramebuffer = kUnknown;
+			}
+		};
+
+		GLState s_state = [] { GLState s; s.Reset(); return s; }();
+		GLStateCounters s_counters;
+
+		inline bool Skip(GLStateType type, bool same)
+		{
+			if (same)
+				s_counters.skipped[static_cast<int>(type)]++;
+			else
+				s_counters.issued[static_cast<int>(type)]++;
+			return same;
+		}
+
+		inline int TextureTargetIndex(GLenum target)
+		{
+			switch (target)
+			{
+			case GL_TEXTURE_2D:			return 0;
+			case GL_TEXTURE_CUBE_MAP:	return 1;
+			case GL_TEXTURE_2D_ARRAY:	return 2;
+			default:					return -1;
+			}
+		}
+
+		inline void SetActiveTextureUnit(GLuint unit)
+		{
+			if (Skip(GLStateType::Texture, s_state.activeTextureUnit == unit))
+				return;
+			glActiveTexture(GL_TEXTURE0 + unit);
+			s_state.activeTextureUnit = unit;
+		}
+
+		inline void SetFlag(int8_t & cached, bool value, GLenum cap, GLStateType type)
+		{
+			const int8_t v = value ? 1 : 0;
+			if (Skip(type, cached == v))
+				return;
+			if (value)
+				glEnable(cap);
+			else
+				glDisable(cap);
+			cached = v;
+		}
+	}
+
+	void GLStateCache::Invalidate()
+	{
+		s_state.Reset();
+	}
+
+	void GLStateCache::UseProgram(GLuint program)
+	{
+		if (Skip(GLStateType::Program, s_state.program == program))
+			return;
+		glUseProgram(program);
+		s_state.program = program;
+	}
+
+	void GLStateCache::BindVertexArray(GLuint vao)
+	{
+		if (Skip(GLStateType::VertexArray, s_state.vao == vao))
+			return;
+		glBindVertexArray(vao);
+		s_state.vao = vao;
+	}
+
+	void GLStateCache::BindTexture(GLenum target, GLuint texture)
+	{
+		const GLuint unit = s_state.activeTextureUnit;
+		const int t = TextureTargetIndex(target);
+		if (unit >= kMaxTextureUnits || t < 0)
+		{
+			// untracked, make sure the cache does not lie afterwards
+			Skip(GLStateType::Texture, false);
+			glBindTexture(target, texture);
+			if (unit < kMaxTextureUnits)
+				for (auto & tex : s_state.textures[unit])
+					tex = kUnknown;
+			return;
+		}
+		if (Skip(GLStateType::Texture, s_state.textures[unit][t] == texture))
+			return;
+		glBindTexture(target, texture);
+		s_state.textures[unit][t] = texture;
+	}
+
+	void GLStateCache::BindTexture(GLuint unit, GLenum target, GLuint texture)
+	{
+		const int t = TextureTargetIndex(target);
+		if (unit < kMaxTextureUnits && t >= 0 && s_state.textures[unit][t] == texture)
+		{
+			// no need to even switch the active unit
+			Skip(GLStateType::Texture, true);
+			return;
+		}
+		SetActiveTextureUnit(unit);
+		BindTexture(target, texture);
+	}
+
+	void GLStateCache::BindSampler(GLuint unit, GLuint sampler)
+	{
+		if (unit >= kMaxTextureUnits)
+		{
+			Skip(GLStateType::Sampler, false);
+			glBindSampler(unit, sampler);
+			return;
+		}
+		if (Skip(GLStateType::Sampler, s_state.samplers[unit] == sampler))
+			return;
+		glBindSampler(unit, sampler);
+		s_state.samplers[unit] = sampler;
+	}
+
+	void GLStateCache::SetCullFace(bool enabled, GLenum face)
+	{
+		SetFlag(s_state.cullEnabled, enabled, GL_CULL_FACE, GLStateType::Cull);
+		if (!enabled)
+			return;
+		if (Skip(GLStateType::Cull, s_state.cullFace == face))
+			return;
+		glCullFace(face);
+		s_state.cullFace = face;
+	}
+
+	void GLStateCache::SetBlend(bool enabled)
+	{
+		SetFlag(s_state.blendEnabled, enabled, GL_BLEND, GLStateType::Blend);
+	}
+
+	void GLStateCache::SetBlendFunc(GLenum src, GLenum dst)
+	{
+		SetBlendFuncSeparate(src, dst, src, dst);
+	}
+
+	void GLStateCache::SetBlendFuncSeparate(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha)
+	{
+		auto & f = s_state.blendFunc;
+		bool same = f[0] == srcRGB && f[1] == dstRGB && f[2] == srcAlpha && f[3] == dstAlpha;
+		if (Skip(GLStateType::Blend, same))
+			return;
+		glBlendFuncSeparate(srcRGB, dstRGB, srcAlpha, dstAlpha);
+		f[0] = srcRGB;
+		f[1] = dstRGB;
+		f[2] = srcAlpha;
+		f[3] = dstAlpha;
+	}
+
+	void GLStateCache::SetDepthTest(bool enabled)
+	{
+		SetFlag(s_state.depthTest, enabled, GL_DEPTH_TEST, GLStateType::Depth);
+	}
+
+	void GLStateCache::SetDepthMask(bool write)
+	{
+		const int8_t v = write ? 1 : 0;
+		if (Skip(GLStateType::Depth, s_state.depthMask == v))
+			return;
+		glDepthMask(write ? GL_TRUE : GL_FALSE);
+		s_state.depthMask = v;
+	}
+
+	void GLStateCache::SetDepthFunc(GLenum func)
+	{
+		if (Skip(GLStateType::Depth, s_state.depthFunc == func))
+			return;
+		glDepthFunc(func);
+		s_state.depthFunc = func;
+	}
+
+	void GLStateCache::BindFramebuffer(GLenum target, GLuint fbo)
+	{
+		bool same;
+		if (target == GL_READ_FRAMEBUFFER)
+			same = s_state.readFramebuffer == fbo;
+		else if (target == GL_DRAW_FRAMEBUFFER)
+			same = s_state.drawFramebuffer == fbo;
+		else
+			same = s_state.drawFramebuffer == fbo && s_state.readFramebuffer == fbo;
+		if (Skip(GLStateType::Framebuffer, same))
+			return;
+		glBindFramebuffer(target, fbo);
+		if (target != GL_READ_FRAMEBUFFER)
+			s_state.drawFramebuffer = fbo;
+		if (target != GL_DRAW_FRAMEBUFFER)
+			s_state.readFramebuffer = fbo;
+	}
+
+	void GLStateCache::DeleteProgram(GLuint program)
+	{
+		// a program in use is only flagged for deletion and stays installed until the next glUseProgram,
+		// so the binding is not 0; a new program may also reuse the name
+		if (s_state.program == program)
+			s_state.program = kUnknown;
+		glDeleteProgram(program);
+	}
+
+	void GLStateCache::DeleteVertexArray(GLuint vao)
+	{
+		if (s_state.vao == vao)
+			s_state.vao = 0;
+		glDeleteVertexArrays(1, &vao);
+	}
+
+	void GLStateCache::DeleteTexture(GLuint texture)
+	{
+		for (auto & unit : s_state.textures)
+			for (auto & t : unit)
+				if (t == texture)
+					t = 0;
+		glDeleteTextures(1, &texture);
+	}
+
+	void GLStateCache::DeleteSampler(GLuint sampler)
+	{
+		for (auto & s : s_state.samplers)
+			if (s == sampler)
+				s = 0;
+		glDeleteSamplers(1, &sampler);
+	}
+
+	void GLStateCache::DeleteFramebuffer(GLuint fbo)
+	{
+		if (s_state.drawFramebuffer == fbo)
+			s_state.drawFramebuffer = 0;
+		if (s_state.readFramebuffer == fbo)
+			s_state.readFramebuffer = 0;
+		glDeleteFramebuffers(1, &fbo);
+	}
+
+	const GLStateCounters & GLStateCache::counters()
+	{
+		return s_counters;
+	}
+
+	void GLStateCache::ResetCounters()
+	{
+		s_counters = GLStateCounters();
+	}
+}
@@ -0,0 +1,362 @@
+#include <FishEngine/Render/GeometryArena.hpp>
+
+#include <algorithm>
+#include <cassert>
+
+#include <FishEngine/Debug.hpp>
+#include <FishEngine/Matrix4x4.hpp>
+#include <FishEngine/Render/GLStateCache.hpp>
+
+namespace FishEngine
+{
+	constexpr uint32_t FreeListAllocator::kInvalidOffset;
+	constexpr uint32_t GeometryArena::kMaxPoolBytes;
+
+	FreeListAllocator::FreeListAllocator(uint32_t capacity)
+	{
+		Grow(capacity);
+	}
+
+	uint32_t FreeListAllocator::Allocate(uint32_t size)
+	{
+		if (size == 0)
+			return kInvalidOffset;
+
+		// the smallest free range that fits
+		auto best = m_freeBySize.lower_bound({ size, 0 });
+		if (best == m_freeBySize.end())
+			return kInvalidOffset;
+
+		const uint32_t rangeSize = best->first;
+		const uint32_t offset = best->second;
+		EraseFree(m_freeByOffset.find(offset));
+		if (rangeSize > size)
+			InsertFree(offset + size, rangeSize - size);
+		m_used += size;
+		return offset;
+	}
+
+	void FreeListAllocator::Free(uint32_t offset, uint32_t size)
+	{
+		if (size == 0)
+			return;
+		assert(offset + size <= m_capacity);
+		assert(m_used >= size);
+		m_used -= size;
+
+		// merge with the free ranges right after and right before
+		auto next = m_freeByOffset.lower_bound(offset);
+		if (next != m_freeByOffset.end() && next->first == offset + size)
+		{
+			size += next->second;
+			next = std::next(next);
+			EraseFree(std::prev(next));
+		}
+		if (next != m_freeByOffset.begin())
+		{
+			auto prev = std::prev(next);
+			assert(prev->first + prev->second <= offset);
+			if (prev->first + prev->second == offset)
+			{
+				offset = prev->first;
+				size += prev->second;
+				EraseFree(prev);
+			}
+		}
+		InsertFree(offset, size);
+	}
+
+	void FreeListAllocator::Grow(uint32_t newCapacity)
+	{
+		if (newCapacity <= m_capacity)
+			return;
+		const uint32_t oldCapacity = m_capacity;
+		m_capacity = newCapacity;
+		// Free() merges the new space with a free range at the end
+		m_used += newCapacity - oldCapacity;
+		Free(oldCapacity, newCapacity - oldCapacity);
+	}
+
+	void FreeListAllocator::InsertFree(uint32_t offset, uint32_t size)
+	{
+		m_freeByOffset.emplace(offset, size);
+		m_freeBySize.emplace(size, offset);
+	}
+
+	void FreeListAllocator::EraseFree(std::map<uint32_t, uint32_t>::iterator it)
+	{
+		m_freeBySize.erase({ it->second, it->first });
+		m_freeByOffset.erase(it);
+	}
+
+
+	bool GeometryArena::s_enabled = true;
+
+	namespace
+	{
+		constexpr uint32_t kInitialVertexBytes = 4 * 1024 * 1024;
+		constexpr uint32_t kInitialIndexBytes = 2 * 1024 * 1024;
+
+		struct Pool
+		{
+			VertexLayout		layout;
+			GLenum				indexType = GL_UNSIGNED_SHORT;
+			uint32_t			indexSize = 2;
+			GLuint				vao = 0;
+			GLuint				vertexBuffer = 0;
+			GLuint				indexBuffer = 0;
+			uint32_t			vertexBufferCapacity = 0;	// in vertices
+			uint32_t			indexBufferCapacity = 0;	// in indices
+			FreeListAllocator	vertices;
+			FreeListAllocator	indices;
+		};
+
+		// never destroyed: meshes may be released during static destruction, after this translation unit
+		std::vector<Pool> & Pools()
+		{
+			static auto pools = new std::vector<Pool>();
+			return *pools;
+		}
+
+		GLuint s_indirectBuffer = 0;
+
+		GLuint CreateBuffer(GLenum target, GLsizeiptr size)
+		{
+			GLuint buffer = 0;
+			glGenBuffers(1, &buffer);
+			glBindBuffer(target, buffer);
+			glBufferData(target, size, nullptr, GL_STATIC_DRAW);
+			return buffer;
+		}
+
+		// a larger buffer with the content of buffer, which is deleted
+		GLuint ReallocateBuffer(GLuint buffer, GLsizeiptr oldSize, GLsizeiptr newSize)
+		{
+			GLuint newBuffer = CreateBuffer(GL_COPY_WRITE_BUFFER, newSize);
+			glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			glDeleteBuffers(1, &buffer);
+			return newBuffer;
+		}
+
+		// point the VAO of the pool at its (new) buffers
+		void BindPoolBuffers(Pool const & pool)
+		{
+			GLStateCache::BindVertexArray(pool.vao);
+			glBindBuffer(GL_ARRAY_BUFFER, pool.vertexBuffer);
+			pool.layout.Apply();
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.indexBuffer);
+		}
+
+		int CreatePool(VertexLayout const & layout, GLenum indexType, uint32_t vertexCount, uint32_t indexCount)
+		{
+			Pool pool;
+			pool.layout = layout;
+			pool.indexType = indexType;
+			pool.indexSize = indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+			pool.vertices.Grow(std::max(kInitialVertexBytes / layout.stride(), vertexCount));
+			pool.indices.Grow(std::max(kInitialIndexBytes / pool.indexSize, indexCount));
+
+			glGenVertexArrays(1, &pool.vao);
+			// GL_ELEMENT_ARRAY_BUFFER binding is VAO state, do not clobber the VAO left bound by the last draw
+			GLStateCache::BindVertexArray(0);
+			pool.vertexBufferCapacity = pool.vertices.capacity();
+			pool.indexBufferCapacity = pool.indices.capacity();
+			pool.vertexBuffer = CreateBuffer(GL_ARRAY_BUFFER, GLsizeiptr(pool.vertexBufferCapacity) * layout.stride());
+			pool.indexBuffer = CreateBuffer(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(pool.indexBufferCapacity) * pool.indexSize);
+			BindPoolBuffers(pool);
+
+			auto & pools = Pools();
+			pools.push_back(std::move(pool));
+			return static_cast<int>(pools.size()) - 1;
+		}
+
+		// Allocate count units, doubling the capacity (up to maxCapacity) if allowed.
+		uint32_t GrowAndAllocate(FreeListAllocator & allocator, uint32_t count, uint32_t maxCapacity, bool grow)
+		{
+			uint32_t offset = allocator.Allocate(count);
+			if (offset != FreeListAllocator::kInvalidOffset || !grow || allocator.capacity() >= maxCapacity)
+				return offset;
+			uint64_t capacity = allocator.capacity();
+			do
+			{
+				capacity *= 2;
+			} while (capacity < maxCapacity && capacity - allocator.capacity() < count);
+			allocator.Grow(static_cast<uint32_t>(std::min<uint64_t>(capacity, maxCapacity)));
+			return allocator.Allocate(count);
+		}
+
+		bool AllocateInPool(Pool & pool, bool grow, uint32_t vertexCount, uint32_t indexCount, GeometryArena::Allocation & allocation)
+		{
+			const uint32_t stride = pool.layout.stride();
+			const uint32_t baseVertex = GrowAndAllocate(pool.vertices, vertexCount, GeometryArena::kMaxPoolBytes / stride, grow);
+			if (baseVertex == FreeListAllocator::kInvalidOffset)
+				return false;
+			const uint32_t firstIndex = GrowAndAllocate(pool.indices, indexCount, GeometryArena::kMaxPoolBytes / pool.indexSize, grow);
+			if (firstIndex == FreeListAllocator::kInvalidOffset)
+			{
+				pool.vertices.Free(baseVertex, vertexCount);
+				return false;
+			}
+
+			// the allocators may have grown (now or by a failed attempt), the buffers follow
+			bool reallocated = false;
+			if (pool.vertices.capacity() > pool.vertexBufferCapacity)
+			{
+				pool.vertexBuffer = ReallocateBuffer(pool.vertexBuffer, GLsizeiptr(pool.vertexBufferCapacity) * stride, GLsizeiptr(pool.vertices.capacity()) * stride);
+				pool.vertexBufferCapacity = pool.vertices.capacity();
+				reallocated = true;
+			}
+			if (pool.indices.capacity() > pool.indexBufferCapacity)
+			{
+				pool.indexBuffer = ReallocateBuffer(pool.indexBuffer, GLsizeiptr(pool.indexBufferCapacity) * pool.indexSize, GLsizeiptr(pool.indices.capacity()) * pool.indexSize);
+				pool.indexBufferCapacity = pool.indices.capacity();
+				reallocated = true;
+			}
+			if (reallocated)
+			{
+				BindPoolBuffers(pool);
+			}
+
+			allocation.baseVertex = baseVertex;
+			allocation.firstIndex = firstIndex;
+			allocation.vertexCount = vertexCount;
+			allocation.indexCount = indexCount;
+			return true;
+		}
+	}
+
+	GeometryArena::Allocation GeometryArena::Allocate(VertexLayout const & layout, GLenum indexType, const void* vertices, uint32_t vertexCount, const void* indices, uint32_t indexCount)
+	{
+		Allocation allocation;
+		const uint32_t stride = layout.stride();
+		const uint32_t indexSize = indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+		if (vertexCount == 0 || indexCount == 0 || stride == 0
+			|| uint64_t(vertexCount) * stride > kMaxPoolBytes || uint64_t(indexCount) * indexSize > kMaxPoolBytes)
+			return allocation;
+
+		// fill the holes of the existing pools first, then grow them, then start a new one
+		auto & pools = Pools();
+		int poolIndex = -1;
+		for (bool grow : { false, true })
+		{
+			for (int i = 0; i < static_cast<int>(pools.size()) && poolIndex < 0; ++i)
+			{
+				auto & pool = pools[i];
+				if (pool.indexType == indexType && pool.layout == layout && AllocateInPool(pool, grow, vertexCount, indexCount, allocation))
+					poolIndex = i;
+			}
+		}
+		if (poolIndex < 0)
+		{
+			poolIndex = CreatePool(layout, indexType, vertexCount, indexCount);
+			bool allocated = AllocateInPool(pools[poolIndex], false, vertexCount, indexCount, allocation);
+			assert(allocated);
+			(void)allocated;
+		}
+		allocation.pool = poolIndex;
+
+		auto & pool = pools[poolIndex];
+		GLStateCache::BindVertexArray(pool.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, pool.vertexBuffer);
+		glBufferSubData(GL_ARRAY_BUFFER, GLintptr(allocation.baseVertex) * stride, GLsizeiptr(vertexCount) * stride, vertices);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		// the index buffer of the pool is bound to its VAO
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, GLintptr(allocation.firstIndex) * indexSize, GLsizeiptr(indexCount) * indexSize, indices);
+		glCheckError();
+		return allocation;
+	}
+
+	void GeometryArena::Free(Allocation & allocation)
+	{
+		if (allocation.pool < 0)
+			return;
+		auto & pool = Pools()[allocation.pool];
+		pool.vertices.Free(allocation.baseVertex, allocation.vertexCount);
+		pool.indices.Free(allocation.firstIndex, allocation.indexCount);
+		allocation = Allocation();
+	}
+
+	GLuint GeometryArena::vertexArray(int pool)
+	{
+		return Pools()[pool].vao;
+	}
+
+	GLenum GeometryArena::indexType(int pool)
+	{
+		return Pools()[pool].indexType;
+	}
+
+	bool GeometryArena::multiDrawIndirectSupported()
+	{
+#if defined(GL_VERSION_4_3)
+		if (GraphicsDevice::isNull())
+			return true;
+	#if defined(__glew_h__)
+		return GLEW_VERSION_4_3 != 0;
+	#else
+		return true;
+	#endif
+#else
+		return false;	// e.g. macOS, GL 4.1
+#endif
+	}
+
+	void GeometryArena::MultiDrawInstanced(int poolIndex, const DrawElementsIndirectCommand* commands, int commandCount, GLuint instanceBuffer)
+	{
+		if (commandCount <= 0)
+			return;
+		auto & pool = Pools()[poolIndex];
+		GLStateCache::BindVertexArray(pool.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+#if defined(GL_VERSION_4_3)
+		if (multiDrawIndirectSupported())
+		{
+			VertexLayout::ApplyInstanceMatrices(0);
+			if (s_indirectBuffer == 0)
+			{
+				glGenBuffers(1, &s_indirectBuffer);
+			}
+			// orphan, the previous commands may still be in flight
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, s_indirectBuffer);
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, commandCount * sizeof(DrawElementsIndirectCommand), commands, GL_STREAM_DRAW);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, pool.indexType, nullptr, commandCount, 0);
+			VertexLayout::ResetInstanceMatrices();
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			return;
+		}
+#endif
+
+		// no baseInstance: move the instance attributes to the first instance of each command instead
+		constexpr GLintptr instanceSize = 2 * sizeof(Matrix4x4);
+		for (int i = 0; i < commandCount; ++i)
+		{
+			auto const & c = commands[i];
+			VertexLayout::ApplyInstanceMatrices(c.baseInstance * instanceSize);
+			const GLvoid* offset = reinterpret_cast<const GLvoid*>(GLintptr(c.firstIndex) * pool.indexSize);
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, c.count, pool.indexType, offset, c.instanceCount, c.baseVertex);
+		}
+		VertexLayout::ResetInstanceMatrices();
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	GeometryArenaStats GeometryArena::stats()
+	{
+		GeometryArenaStats stats;
+		for (auto const & pool : Pools())
+		{
+			const uint32_t stride = pool.layout.stride();
+			stats.pools++;
+			stats.vertexBytes += uint64_t(pool.vertices.used()) * stride;
+			stats.vertexCapacityBytes += uint64_t(pool.vertices.capacity()) * stride;
+			stats.indexBytes += uint64_t(pool.indices.used()) * pool.indexSize;
+			stats.indexCapacityBytes += uint64_t(pool.indices.capacity()) * pool.indexSize;
+		}
+		return stats;
+	}
+}
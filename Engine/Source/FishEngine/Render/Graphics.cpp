@@ -1,4 +1,7 @@
 #include <FishEngine/Graphics.hpp>
+
+#include <algorithm>
+
 #include <FishEngine/Pipeline.hpp>
 #include <FishEngine/Material.hpp>
 #include <FishEngine/Shader.hpp>
@@ -6,9 +9,56 @@
 #include <FishEngine/Light.hpp>
 #include <FishEngine/RenderSettings.hpp>
 #include <FishEngine/RenderSystem.hpp>
+#include <FishEngine/Render/GeometryArena.hpp>
 
 namespace FishEngine
 {
+	// instances per glDrawElementsInstanced, bounds the size of the instance buffer
+	constexpr int kMaxInstancesPerDraw = 1024;
+
+	static GLuint s_instanceBuffer = 0;
+	static std::vector<Matrix4x4> s_instanceData;
+	static std::vector<DrawElementsIndirectCommand> s_drawCommands;
+
+	// fill s_instanceBuffer with the instance attributes of count matrices
+	static void UploadInstanceMatrices(const Matrix4x4* matrices, int count)
+	{
+		if (s_instanceBuffer == 0)
+		{
+			glGenBuffers(1, &s_instanceBuffer);
+		}
+
+		// attributes are column-major: MATRIX_M is uploaded transposed,
+		// and MATRIX_IT_M = inverse(M)^T transposed is just inverse(M)
+		s_instanceData.resize(count * 2);
+		for (int i = 0; i < count; ++i)
+		{
+			auto const & m = matrices[i];
+			s_instanceData[i * 2] = m.transpose();
+			s_instanceData[i * 2 + 1] = m.inverse();
+		}
+
+		// orphan, the previous batch may still be in flight
+		glBindBuffer(GL_ARRAY_BUFFER, s_instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, s_instanceData.size() * sizeof(Matrix4x4), s_instanceData.data(), GL_STREAM_DRAW);
+	}
+
+	static void SetBuiltinTextures(const ShaderPtr& shader, const MaterialPtr& material)
+	{
+		static const int ambientCubemapID = Shader::PropertyToID("AmbientCubemap");
+		static const int preIntegratedGFID = Shader::PropertyToID("PreIntegratedGF");
+		if (shader->HasUniform(ambientCubemapID))
+		{
+			//shader->BindTexture("AmbientCubemap", RenderSettings::ambientCubemap());
+			material->SetTexture(ambientCubemapID, RenderSettings::ambientCubemap());
+		}
+		if (shader->HasUniform(preIntegratedGFID))
+		{
+			//shader->BindTexture("PreIntegratedGF", RenderSettings::preintegratedGF());
+			material->SetTexture(preIntegratedGFID, RenderSettings::preintegratedGF());
+		}
+	}
+
 	void Graphics::DrawMesh(const MeshPtr& mesh, const Matrix4x4& matrix, const MaterialPtr& material)
 	{
 		Pipeline::UpdatePerDrawUniforms(matrix);
@@ -42,24 +92,126 @@ namespace FishEngine
 		//}
 		
 		auto shader = material->shader();
-		if (shader->HasUniform("AmbientCubemap"))
+		SetBuiltinTextures(shader, material);
+		
+		shader->Use();
+		shader->PreRender();
+		material->BindProperties();
+		shader->CheckStatus();
+		mesh->Render(subMeshIndex);
+		shader->PostRender();
+	}
+
+	void Graphics::DrawMeshInstanced(const MeshPtr& mesh, int subMeshIndex, const MaterialPtr& material, const std::vector<Matrix4x4>& matrices)
+	{
+		DrawMeshInstanced(mesh, subMeshIndex, material, matrices.data(), static_cast<int>(matrices.size()));
+	}
+
+	void Graphics::DrawMeshInstanced(const MeshPtr& mesh, int subMeshIndex, const MaterialPtr& material, const Matrix4x4* matrices, int count)
+	{
+		if (count <= 0)
+			return;
+
+		auto shader = material->shader();
+		if (!shader->SupportsInstancing())
 		{
-			//shader->BindTexture("AmbientCubemap", RenderSettings::ambientCubemap());
-			material->SetTexture("AmbientCubemap", RenderSettings::ambientCubemap());
+			for (int i = 0; i < count; ++i)
+			{
+				Pipeline::UpdatePerDrawUniforms(matrices[i]);
+				DrawMesh(mesh, material, subMeshIndex);
+			}
+			return;
 		}
-		if (shader->HasUniform("PreIntegratedGF"))
+
+		// switch to the instancing variant before the uniforms of the material are bound
+		shader->SetLocalKeywords(ShaderKeyword::Instancing, true);
+		SetBuiltinTextures(shader, material);
+
+		shader->Use();
+		shader->PreRender();
+		material->BindProperties();
+		shader->CheckStatus();
+
+		for (int first = 0; first < count; first += kMaxInstancesPerDraw)
 		{
-			//shader->BindTexture("PreIntegratedGF", RenderSettings::preintegratedGF());
-			material->SetTexture("PreIntegratedGF", RenderSettings::preintegratedGF());
+			const int n = std::min(count - first, kMaxInstancesPerDraw);
+			UploadInstanceMatrices(matrices + first, n);
+			mesh->RenderInstanced(subMeshIndex, n, s_instanceBuffer);
 		}
 
-		
+		shader->PostRender();
+		shader->SetLocalKeywords(ShaderKeyword::Instancing, false);
+		glCheckError();
+	}
+
+	void Graphics::DrawMeshesInstanced(const MeshPtr* meshes, const int* subMeshIndices, const MaterialPtr& material, const Matrix4x4* matrices, int count)
+	{
+		if (count <= 0)
+			return;
+
+		// the arena pool is only known once the meshes are uploaded
+		int pool = -1;
+		for (int i = 0; i < count; ++i)
+		{
+			meshes[i]->UploadMeshData();
+			const int p = meshes[i]->arenaPool();
+			if (p < 0 || (i > 0 && p != pool))
+			{
+				pool = -1;
+				break;
+			}
+			pool = p;
+		}
+
+		auto shader = material->shader();
+		if (pool < 0 || !shader->SupportsInstancing())
+		{
+			int first = 0;
+			for (int i = 1; i <= count; ++i)
+			{
+				if (i == count || meshes[i] != meshes[first] || subMeshIndices[i] != subMeshIndices[first])
+				{
+					DrawMeshInstanced(meshes[first], subMeshIndices[first], material, matrices + first, i - first);
+					first = i;
+				}
+			}
+			return;
+		}
+
+		shader->SetLocalKeywords(ShaderKeyword::Instancing, true);
+		SetBuiltinTextures(shader, material);
+
 		shader->Use();
 		shader->PreRender();
 		material->BindProperties();
 		shader->CheckStatus();
-		mesh->Render(subMeshIndex);
+
+		for (int first = 0; first < count; first += kMaxInstancesPerDraw)
+		{
+			const int n = std::min(count - first, kMaxInstancesPerDraw);
+			UploadInstanceMatrices(matrices + first, n);
+
+			// one command per draw, consecutive draws of the same submesh become one command with more instances
+			s_drawCommands.clear();
+			for (int i = 0; i < n; ++i)
+			{
+				const auto range = meshes[first + i]->GetDrawRange(subMeshIndices[first + i]);
+				if (!s_drawCommands.empty())
+				{
+					auto & last = s_drawCommands.back();
+					if (last.count == static_cast<GLuint>(range.indexCount) && last.firstIndex == range.firstIndex && last.baseVertex == range.baseVertex)
+					{
+						last.instanceCount++;
+						continue;
+					}
+				}
+				s_drawCommands.push_back({ static_cast<GLuint>(range.indexCount), 1, range.firstIndex, range.baseVertex, static_cast<GLuint>(i) });
+			}
+			GeometryArena::MultiDrawInstanced(pool, s_drawCommands.data(), static_cast<int>(s_drawCommands.size()), s_instanceBuffer);
+		}
+
 		shader->PostRender();
+		shader->SetLocalKeywords(ShaderKeyword::Instancing, false);
+		glCheckError();
 	}
 }
-
@@ -0,0 +1,293 @@
+// the table is filled from the real entry points, so they must not be redirected in this file
+#define FISHENGINE_NO_GL_DISPATCH
+#include <FishEngine/Render/GraphicsDevice.hpp>
+
+#include <unordered_set>
+
+#include <FishEngine/Debug.hpp>
+#include <FishEngine/Render/GLStateCache.hpp>
+
+#if defined(GLAPIENTRY)
+	#define FE_GLAPIENTRY GLAPIENTRY
+#elif defined(APIENTRY)
+	#define FE_GLAPIENTRY APIENTRY
+#else
+	#define FE_GLAPIENTRY
+#endif
+
+namespace FishEngine
+{
+	GLFunctionTable		GraphicsDevice::s_gl;
+	GraphicsDeviceType	GraphicsDevice::s_type = GraphicsDeviceType::OpenGLCore;
+
+	namespace
+	{
+		GraphicsDeviceCounters s_counters;
+
+		// Null backend
+
+		// default: do nothing, return 0 / nullptr
+		template <typename F>
+		struct NullFunction;
+
+		template <typename R, typename... Args>
+		struct NullFunction<R (FE_GLAPIENTRY *)(Args...)>
+		{
+			static R FE_GLAPIENTRY Call(Args...)
+			{
+				return R();
+			}
+
+			// same, but count the call
+			template <uint32_t GraphicsDeviceCounters::*Counter>
+			static R FE_GLAPIENTRY CountedCall(Args...)
+			{
+				(s_counters.*Counter)++;
+				return R();
+			}
+		};
+
+		struct NullNames
+		{
+			GLuint						next = 1;
+			std::unordered_set<GLuint>	live;
+		};
+
+		NullNames s_names[static_cast<int>(GraphicsResourceType::Count)];
+
+		GLuint NullCreateName(GraphicsResourceType type)
+		{
+			auto & names = s_names[static_cast<int>(type)];
+			GLuint name = names.next++;
+			names.live.insert(name);
+			s_counters.liveResources[static_cast<int>(type)] = static_cast<uint32_t>(names.live.size());
+			return name;
+		}
+
+		void NullDeleteName(GraphicsResourceType type, GLuint name)
+		{
+			// like GL, 0 and unknown names are silently ignored
+			auto & names = s_names[static_cast<int>(type)];
+			names.live.erase(name);
+			s_counters.liveResources[static_cast<int>(type)] = static_cast<uint32_t>(names.live.size());
+		}
+
+		template <GraphicsResourceType Type>
+		void FE_GLAPIENTRY NullGenNames(GLsizei n, GLuint* names)
+		{
+			for (GLsizei i = 0; i < n; ++i)
+				names[i] = NullCreateName(Type);
+		}
+
+		template <GraphicsResourceType Type>
+		void FE_GLAPIENTRY NullDeleteNames(GLsizei n, const GLuint* names)
+		{
+			for (GLsizei i = 0; i < n; ++i)
+				NullDeleteName(Type, names[i]);
+		}
+
+		template <GraphicsResourceType Type>
+		void FE_GLAPIENTRY NullDeleteObject(GLuint name)
+		{
+			NullDeleteName(Type, name);
+		}
+
+		GLuint FE_GLAPIENTRY NullCreateProgram()
+		{
+			return NullCreateName(GraphicsResourceType::Program);
+		}
+
+		GLuint FE_GLAPIENTRY NullCreateShader(GLenum)
+		{
+			return NullCreateName(GraphicsResourceType::Shader);
+		}
+
+		void FE_GLAPIENTRY NullGetIntegerv(GLenum pname, GLint* data)
+		{
+			*data = (pname == GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT) ? 256 : 0;
+		}
+
+		void FE_GLAPIENTRY NullGetShaderiv(GLuint, GLenum pname, GLint* params)
+		{
+			*params = (pname == GL_COMPILE_STATUS) ? GL_TRUE : 0;
+		}
+
+		// no active uniforms or uniform blocks, an empty info log
+		void FE_GLAPIENTRY NullGetProgramiv(GLuint, GLenum pname, GLint* params)
+		{
+			*params = (pname == GL_LINK_STATUS) ? GL_TRUE : 0;
+		}
+
+		GLuint FE_GLAPIENTRY NullGetUniformBlockIndex(GLuint, const GLchar*)
+		{
+			return GL_INVALID_INDEX;
+		}
+
+		GLint FE_GLAPIENTRY NullGetUniformLocation(GLuint, const GLchar*)
+		{
+			return -1;
+		}
+
+		const GLubyte* FE_GLAPIENTRY NullGetString(GLenum)
+		{
+			return reinterpret_cast<const GLubyte*>("Null");
+		}
+
+		GLenum FE_GLAPIENTRY NullCheckFramebufferStatus(GLenum)
+		{
+			return GL_FRAMEBUFFER_COMPLETE;
+		}
+
+		inline void NullDraw(GLsizei count, GLsizei instanceCount)
+		{
+			s_counters.drawCalls++;
+			s_counters.instances += instanceCount;
+			s_counters.vertices += static_cast<uint64_t>(count) * instanceCount;
+		}
+
+		void FE_GLAPIENTRY NullDrawArrays(GLenum, GLint, GLsizei count)
+		{
+			NullDraw(count, 1);
+		}
+
+		void FE_GLAPIENTRY NullDrawElements(GLenum, GLsizei count, GLenum, const void*)
+		{
+			NullDraw(count, 1);
+		}
+
+		void FE_GLAPIENTRY NullDrawElementsInstanced(GLenum, GLsizei count, GLenum, const void*, GLsizei instanceCount)
+		{
+			NullDraw(count, instanceCount);
+		}
+
+		void FE_GLAPIENTRY NullDrawElementsBaseVertex(GLenum, GLsizei count, GLenum, const void*, GLint)
+		{
+			NullDraw(count, 1);
+		}
+
+		void FE_GLAPIENTRY NullDrawElementsInstancedBaseVertex(GLenum, GLsizei count, GLenum, const void*, GLsizei instanceCount, GLint)
+		{
+			NullDraw(count, instanceCount);
+		}
+
+#if defined(GL_VERSION_4_3)
+		// the commands are in a buffer the Null device never stores: one draw call, one instance per command
+		void FE_GLAPIENTRY NullMultiDrawElementsIndirect(GLenum, GLenum, const void*, GLsizei drawCount, GLsizei)
+		{
+			s_counters.drawCalls++;
+			s_counters.instances += drawCount;
+		}
+#endif
+
+		void FE_GLAPIENTRY NullBufferData(GLenum, GLsizeiptr size, const void* data, GLenum)
+		{
+			// glBufferData(nullptr) only (re)allocates
+			if (data != nullptr)
+			{
+				s_counters.bufferUploads++;
+				s_counters.bufferUploadBytes += size;
+			}
+		}
+
+		void FE_GLAPIENTRY NullBufferSubData(GLenum, GLintptr, GLsizeiptr size, const void*)
+		{
+			s_counters.bufferUploads++;
+			s_counters.bufferUploadBytes += size;
+		}
+
+		void InitNull(GLFunctionTable & gl)
+		{
+#define FISHENGINE_GL_BIND_NULL(name) gl.name = NullFunction<decltype(gl.name)>::Call;
+			FISHENGINE_GL_FUNCTIONS(FISHENGINE_GL_BIND_NULL)
+#undef FISHENGINE_GL_BIND_NULL
+
+			for (auto & names : s_names)
+				names = NullNames();
+
+			gl.GenBuffers				= NullGenNames<GraphicsResourceType::Buffer>;
+			gl.GenTextures				= NullGenNames<GraphicsResourceType::Texture>;
+			gl.GenSamplers				= NullGenNames<GraphicsResourceType::Sampler>;
+			gl.GenVertexArrays			= NullGenNames<GraphicsResourceType::VertexArray>;
+			gl.GenFramebuffers			= NullGenNames<GraphicsResourceType::Framebuffer>;
+			gl.GenTransformFeedbacks	= NullGenNames<GraphicsResourceType::TransformFeedback>;
+			gl.DeleteBuffers			= NullDeleteNames<GraphicsResourceType::Buffer>;
+			gl.DeleteTextures			= NullDeleteNames<GraphicsResourceType::Texture>;
+			gl.DeleteSamplers			= NullDeleteNames<GraphicsResourceType::Sampler>;
+			gl.DeleteVertexArrays		= NullDeleteNames<GraphicsResourceType::VertexArray>;
+			gl.DeleteFramebuffers		= NullDeleteNames<GraphicsResourceType::Framebuffer>;
+			gl.DeleteProgram			= NullDeleteObject<GraphicsResourceType::Program>;
+			gl.DeleteShader				= NullDeleteObject<GraphicsResourceType::Shader>;
+			gl.CreateProgram			= NullCreateProgram;
+			gl.CreateShader				= NullCreateShader;
+
+			gl.GetIntegerv				= NullGetIntegerv;
+			gl.GetShaderiv				= NullGetShaderiv;
+			gl.GetProgramiv				= NullGetProgramiv;
+			gl.GetString				= NullGetString;
+			gl.GetUniformBlockIndex		= NullGetUniformBlockIndex;
+			gl.GetUniformLocation		= NullGetUniformLocation;
+			gl.CheckFramebufferStatus	= NullCheckFramebufferStatus;
+
+			gl.DrawArrays				= NullDrawArrays;
+			gl.DrawElements				= NullDrawElements;
+			gl.DrawElementsInstanced	= NullDrawElementsInstanced;
+			gl.DrawElementsBaseVertex	= NullDrawElementsBaseVertex;
+			gl.DrawElementsInstancedBaseVertex = NullDrawElementsInstancedBaseVertex;
+#if defined(GL_VERSION_4_3)
+			gl.MultiDrawElementsIndirect = NullMultiDrawElementsIndirect;
+#endif
+			gl.BufferData				= NullBufferData;
+			gl.BufferSubData			= NullBufferSubData;
+
+#define FISHENGINE_GL_BIND_TEXTURE_UPLOAD(name) \
+			gl.name = NullFunction<decltype(gl.name)>::CountedCall<&GraphicsDeviceCounters::textureUploads>;
+			FISHENGINE_GL_BIND_TEXTURE_UPLOAD(TexImage2D)
+			FISHENGINE_GL_BIND_TEXTURE_UPLOAD(TexImage3D)
+			FISHENGINE_GL_BIND_TEXTURE_UPLOAD(TexSubImage1D)
+			FISHENGINE_GL_BIND_TEXTURE_UPLOAD(TexSubImage2D)
+			FISHENGINE_GL_BIND_TEXTURE_UPLOAD(TexSubImage3D)
+#undef FISHENGINE_GL_BIND_TEXTURE_UPLOAD
+		}
+
+		// OpenGLCore backend
+
+		void InitOpenGL(GLFunctionTable & gl)
+		{
+#define FISHENGINE_GL_BIND(name) \
+			gl.name = gl##name; \
+			if (gl.name == nullptr) \
+				LogWarning("GraphicsDevice: gl" #name " is not available");
+			FISHENGINE_GL_FUNCTIONS(FISHENGINE_GL_BIND)
+#undef FISHENGINE_GL_BIND
+		}
+	}
+
+	void GraphicsDevice::Init(GraphicsDeviceType type)
+	{
+		s_type = type;
+		s_counters = GraphicsDeviceCounters();
+		if (type == GraphicsDeviceType::Null)
+		{
+			InitNull(s_gl);
+			LogInfo("GraphicsDevice: Null");
+		}
+		else
+		{
+			InitOpenGL(s_gl);
+		}
+		GLStateCache::Invalidate();
+	}
+
+	const GraphicsDeviceCounters & GraphicsDevice::counters()
+	{
+		return s_counters;
+	}
+
+	void GraphicsDevice::ResetFrameCounters()
+	{
+		GraphicsDeviceCounters counters;
+		for (int i = 0; i < static_cast<int>(GraphicsResourceType::Count); ++i)
+			counters.liveResources[i] = s_counters.liveResources[i];
+		s_counters = counters;
+	}
+}
@@ -0,0 +1,107 @@
+#include <FishEngine/LODGroup.hpp>
+
+#include <algorithm>
+
+#include <FishEngine/GameObject.hpp>
+#include <FishEngine/Transform.hpp>
+#include <FishEngine/Renderer.hpp>
+#include <FishEngine/Camera.hpp>
+#include <FishEngine/Mathf.hpp>
+#include <FishEngine/Debug.hpp>
+#include <FishEngine/QualitySettings.hpp>
+#include <FishEngine/Render/RendererRegistry.hpp>
+
+namespace FishEngine
+{
+	constexpr int LODGroup::kMaxLODs;
+
+	void LODGroup::SetLODs(std::vector<LOD> const & lods)
+	{
+		if (lods.size() > kMaxLODs)
+		{
+			LogWarning(Format("LODGroup supports at most %1% LODs, %2% given", kMaxLODs, lods.size()));
+		}
+		m_lods.assign(lods.begin(), lods.begin() + std::min<size_t>(lods.size(), kMaxLODs));
+		RendererRegistry::SetLODDirty();
+	}
+
+	void LODGroup::RecalculateBounds()
+	{
+		Bounds bounds;
+		for (auto const & lod : m_lods)
+		{
+			for (auto const & weak_go : lod.gameObjects)
+			{
+				auto go = weak_go.lock();
+				if (go == nullptr)
+					continue;
+				auto renderer = go->GetComponent<Renderer>();
+				if (renderer != nullptr)
+					bounds.Encapsulate(renderer->bounds());
+			}
+		}
+		if (!bounds.IsValid())
+			return;
+
+		auto t = transform();
+		m_localReferencePoint = t->worldToLocalMatrix().MultiplyPoint(bounds.center());
+		auto size = bounds.size();
+		auto scale = t->lossyScale();
+		float maxScale = std::max({ Mathf::Abs(scale.x), Mathf::Abs(scale.y), Mathf::Abs(scale.z) });
+		m_size = std::max({ size.x, size.y, size.z }) / (maxScale > 0 ? maxScale : 1.0f);
+	}
+
+	float LODGroup::ScreenRelativeHeight(const Camera & camera) const
+	{
+		auto t = transform();
+		auto scale = t->lossyScale();
+		float worldSize = m_size * std::max({ Mathf::Abs(scale.x), Mathf::Abs(scale.y), Mathf::Abs(scale.z) });
+		if (camera.orghographic())
+		{
+			return worldSize / (2.0f * camera.orthographicSize());
+		}
+		auto center = t->localToWorldMatrix().MultiplyPoint(m_localReferencePoint);
+		float distance = Vector3::Distance(center, camera.transform()->position());
+		float halfHeight = distance * Mathf::Tan(camera.fieldOfView() * 0.5f * Mathf::Deg2Rad);
+		if (halfHeight <= 0)
+			return 1.0f;
+		return worldSize / (2.0f * halfHeight);
+	}
+
+	int LODGroup::SelectLOD(const Camera & camera, float & fade) const
+	{
+		fade = 1.0f;
+		const int count = lodCount();
+		if (count == 0)
+			return 0;
+		if (m_forcedLOD >= 0)
+			return std::min(m_forcedLOD, count - 1);
+
+		const float height = ScreenRelativeHeight(camera) * QualitySettings::lodBias();
+		int level = count;
+		for (int i = 0; i < count; ++i)
+		{
+			if (height >= m_lods[i].screenRelativeTransitionHeight)
+			{
+				level = i;
+				break;
+			}
+		}
+
+		// the lowest LOD the quality settings allow stays until the object is culled
+		const int maximumLODLevel = std::min(QualitySettings::maximumLODLevel(), count - 1);
+		if (level < maximumLODLevel)
+			level = maximumLODLevel;
+
+		if (level < count && m_fadeMode == LODFadeMode::CrossFade)
+		{
+			// the fade zone is at the far end of the LOD's range [h, upper)
+			const float h = m_lods[level].screenRelativeTransitionHeight;
+			const float upper = level == 0 ? 1.0f : m_lods[level-1].screenRelativeTransitionHeight;
+			const float width = m_lods[level].fadeTransitionWidth * (upper - h);
+			if (width > 0 && height < h + width)
+				fade = Mathf::Clamp01((height - h) / width);
+		}
+		return level;
+	}
+}
@@ -1,66 +1,116 @@
 #include <FishEngine/Material.hpp>
 
 #include <cassert>
+#include <cstring>
+#include <algorithm>
 
 #include <FishEngine/Debug.hpp>
 #include <FishEngine/Color.hpp>
 #include <FishEngine/Shader.hpp>
 #include <FishEngine/Vector2.hpp>
+#include <FishEngine/Texture.hpp>
+#include <FishEngine/Pipeline.hpp>
+#include <FishEngine/Render/GLStateCache.hpp>
+#include <FishEngine/Serialization/Archive.hpp>
 
 namespace FishEngine
 {
 	std::map<std::string, MaterialPtr> Material::s_builtinMaterialInstance;
 	//MaterialPtr Material::s_defaultMaterial = nullptr;
 
-	// https://www.opengl.org/sdk/docs/man/html/glGetActiveUniform.xhtml
-	template<typename T>
-	constexpr GLenum GLType();
-	//{
-	//    static_assert(false, "Not implemented");
-	//}
+	// Generated/EngineClassSerialization.cpp
+	InputArchive & operator >> (InputArchive & archive, ShaderUniforms & value);
 
-	template<>
-	constexpr GLenum GLType<float>()
+	namespace
 	{
-		return GL_FLOAT;
-	}
+		inline bool IsTexture(MaterialPropertyType type)
+		{
+			return type >= MaterialPropertyType::Texture2D;
+		}
 
-	template<>
-	constexpr GLenum GLType<Vector2>()
-	{
-		return GL_FLOAT_VEC2;
-	}
+		// number of floats in Material::m_values, 0 for textures
+		inline uint32_t FloatCount(MaterialPropertyType type)
+		{
+			switch (type)
+			{
+			case MaterialPropertyType::Float:	return 1;
+			case MaterialPropertyType::Float2:	return 2;
+			case MaterialPropertyType::Float3:	return 3;
+			case MaterialPropertyType::Float4:	return 4;
+			case MaterialPropertyType::Mat4:	return 16;
+			default:							return 0;
+			}
+		}
 
-	template<>
-	constexpr GLenum GLType<Vector3>()
-	{
-		return GL_FLOAT_VEC3;
-	}
+		// false if a material can not store a uniform of this type
+		bool ToMaterialPropertyType(GLenum uniformType, MaterialPropertyType & type)
+		{
+			switch (uniformType)
+			{
+			case GL_FLOAT:						type = MaterialPropertyType::Float; break;
+			case GL_FLOAT_VEC2:					type = MaterialPropertyType::Float2; break;
+			case GL_FLOAT_VEC3:					type = MaterialPropertyType::Float3; break;
+			case GL_FLOAT_VEC4:					type = MaterialPropertyType::Float4; break;
+			case GL_FLOAT_MAT4:					type = MaterialPropertyType::Mat4; break;
+			case GL_SAMPLER_2D:					type = MaterialPropertyType::Texture2D; break;
+			case GL_SAMPLER_2D_ARRAY:			type = MaterialPropertyType::Texture2DArray; break;
+			case GL_SAMPLER_2D_ARRAY_SHADOW:	type = MaterialPropertyType::Texture2DArrayShadow; break;
+			case GL_SAMPLER_3D:					type = MaterialPropertyType::Texture3D; break;
+			case GL_SAMPLER_CUBE:				type = MaterialPropertyType::TextureCube; break;
+			default:							return false;
+			}
+			return true;
+		}
 
-	template<>
-	constexpr GLenum GLType<Vector4>()
-	{
-		return GL_FLOAT_VEC4;
-	}
+		// a texture property can be bound to any sampler
+		inline bool Compatible(MaterialPropertyType a, MaterialPropertyType b)
+		{
+			return a == b || (IsTexture(a) && IsTexture(b));
+		}
 
-	template<>
-	constexpr GLenum GLType<Matrix4x4>()
-	{
-		return GL_FLOAT_MAT4;
-	}
+		inline GLenum SamplerTarget(GLenum samplerType)
+		{
+			switch (samplerType)
+			{
+			case GL_SAMPLER_CUBE:				return GL_TEXTURE_CUBE_MAP;
+			case GL_SAMPLER_3D:					return GL_TEXTURE_3D;
+			case GL_SAMPLER_2D_ARRAY:
+			case GL_SAMPLER_2D_ARRAY_SHADOW:	return GL_TEXTURE_2D_ARRAY;
+			default:							return GL_TEXTURE_2D;
+			}
+		}
 
-	template<typename T>
-	bool FindUniformInShader(std::vector<UniformInfo>& uniforms, const std::string& name)
-	{
-		constexpr auto type = GLType<T>();
-		for (auto& u : uniforms)
+		inline uint64_t Mix(uint64_t x)
 		{
-			if (u.name == name && u.type == type)
+			x ^= x >> 33;
+			x *= 0xff51afd7ed558ccdULL;
+			x ^= x >> 33;
+			return x;
+		}
+
+		// identifies what UpdateUniformBuffer writes: the block size and the name, type and place of every member.
+		// Members are combined in any order, the programs of two variants may list them differently.
+		uint64_t BlockLayoutKey(int blockSize, const std::vector<UniformInfo>& uniforms)
+		{
+			uint64_t key = Mix(static_cast<uint64_t>(blockSize) + 1);
+			for (auto const & u : uniforms)
 			{
-				return true;
+				if (u.blockOffset < 0)
+					continue;
+				uint64_t member = static_cast<uint32_t>(u.nameID);
+				member = Mix(member ^ (static_cast<uint64_t>(u.type) << 32));
+				member = Mix(member ^ static_cast<uint64_t>(u.blockOffset));
+				member = Mix(member ^ (static_cast<uint64_t>(u.matrixStride) << 1 | (u.rowMajor ? 1 : 0)));
+				key += member;
 			}
+			return key;
 		}
-		return false;
+	}
+
+	Material::~Material()
+	{
+		if (m_uniformBuffer.buffer != 0)
+			glDeleteBuffers(1, &m_uniformBuffer.buffer);
 	}
 
 	int Material::renderQueue()
@@ -73,61 +123,174 @@ namespace FishEngine
 		if (shader == nullptr)
 			abort();
 		m_shader = shader;
-		m_uniforms.floats.clear();
-		m_uniforms.vec2s.clear();
-		m_uniforms.vec3s.clear();
-		m_uniforms.vec4s.clear();
-		m_uniforms.mat4s.clear();
+
+		// textures are kept when the shader changes
+		std::vector<std::pair<int, TexturePtr>> textures;
+		for (int i = 0; i < static_cast<int>(m_properties.size()); ++i)
+		{
+			auto const & p = m_properties[i];
+			if (IsTexture(p.type) && m_textureValues[p.offset] != nullptr)
+				textures.emplace_back(Shader::PropertyToID(p.name), m_textureValues[p.offset]);
+		}
+
 		m_properties.clear();
+		m_values.clear();
+		m_textureValues.clear();
+		m_uniformBindings.clear();
+		m_uniformBuffer.dirty = true;
 		m_savedProperties = shader->m_savedProperties;
 		for (auto& u : m_shader->uniforms())
 		{
-			if (u.type == GL_FLOAT)
+			MaterialPropertyType type;
+			if (!ToMaterialPropertyType(u.type, type))
 			{
-				m_uniforms.floats[u.name] = 1.0f;
-				m_properties.emplace_back(MaterialProperty{ u.name, MaterialPropertyType::Float });
-			}
-			else if (u.type == GL_FLOAT_VEC2)
-			{
-				m_uniforms.vec2s[u.name] = Vector2::one;
-				m_properties.emplace_back(MaterialProperty{ u.name, MaterialPropertyType::Float2 });
-			}
-			else if (u.type == GL_FLOAT_VEC3)
-			{
-				m_uniforms.vec3s[u.name] = Vector3::one;
-				m_properties.emplace_back(MaterialProperty{ u.name, MaterialPropertyType::Float3 });
-			}
-			else if (u.type == GL_FLOAT_VEC4)
-			{
-				m_uniforms.vec4s[u.name] = Vector4::one;
-				m_properties.emplace_back(MaterialProperty{ u.name, MaterialPropertyType::Float4 });
-			}
-			else if (u.type == GL_FLOAT_MAT4)
-			{
-				m_uniforms.mat4s[u.name] = Matrix4x4::identity;
-				m_properties.emplace_back(MaterialProperty{ u.name, MaterialPropertyType::Mat4 });
-			}
-			else if (u.type == GL_SAMPLER_2D)
-			{
-				m_properties.emplace_back(MaterialProperty{ u.name, MaterialPropertyType::Texture2D });
+				LogError("Unknown shader property type");
+				abort();
 			}
-			else if (u.type == GL_SAMPLER_2D_ARRAY)
+			auto & p = GetOrAddProperty(u.nameID, type);
+			if (type == MaterialPropertyType::Mat4)
+				std::copy(Matrix4x4::identity.data(), Matrix4x4::identity.data() + 16, m_values.begin() + p.offset);
+			else
+				std::fill_n(m_values.begin() + p.offset, FloatCount(type), 1.0f);
+		}
+
+		for (auto & t : textures)
+		{
+			PropertyTexture(t.first) = t.second;
+		}
+	}
+
+	int Material::FindProperty(int nameID)
+	{
+		const int count = static_cast<int>(m_properties.size());
+		for (int i = 0; i < count; ++i)
+		{
+			auto & p = m_properties[i];
+			if (p.nameID < 0)	// deserialized
+				p.nameID = Shader::PropertyToID(p.name);
+			if (p.nameID == nameID)
+				return i;
+		}
+		return -1;
+	}
+
+	MaterialProperty & Material::GetOrAddProperty(int nameID, MaterialPropertyType type)
+	{
+		auto allocate = [this](MaterialPropertyType type)
+		{
+			if (IsTexture(type))
 			{
-				m_properties.emplace_back(MaterialProperty{ u.name, MaterialPropertyType::Texture2DArray });
+				m_textureValues.emplace_back(nullptr);
+				return static_cast<uint32_t>(m_textureValues.size() - 1);
 			}
-			else if (u.type == GL_SAMPLER_2D_ARRAY_SHADOW)
+			auto offset = static_cast<uint32_t>(m_values.size());
+			m_values.resize(offset + FloatCount(type), 0.0f);
+			return offset;
+		};
+
+		int i = FindProperty(nameID);
+		if (i >= 0)
+		{
+			auto & p = m_properties[i];
+			if (Compatible(p.type, type))
+				return p;
+			// set with a value of another type, the old storage is left unused
+			p.type = type;
+			p.offset = allocate(type);
+			m_uniformBindings.clear();
+			return p;
+		}
+
+		MaterialProperty p;
+		p.name = Shader::PropertyIDToName(nameID);
+		p.type = type;
+		p.offset = allocate(type);
+		p.nameID = nameID;
+		m_properties.push_back(p);
+		m_uniformBindings.clear();
+		return m_properties.back();
+	}
+
+	float* Material::PropertyValues(int nameID, MaterialPropertyType type)
+	{
+		auto & p = GetOrAddProperty(nameID, type);
+		m_uniformBuffer.dirty = true;
+		return m_values.data() + p.offset;
+	}
+
+	TexturePtr & Material::PropertyTexture(int nameID)
+	{
+		auto & p = GetOrAddProperty(nameID, MaterialPropertyType::Texture2D);
+		return m_textureValues[p.offset];
+	}
+
+	const Material::UniformBindingCache& Material::UniformBinding(GLuint program, const std::vector<UniformInfo>& uniforms)
+	{
+		for (auto & b : m_uniformBindings)
+		{
+			if (b.program == program && b.properties.size() == uniforms.size())
+				return b;
+		}
+
+		UniformBindingCache binding;
+		binding.program = program;
+		binding.blockLayout = BlockLayoutKey(m_shader->materialBlockSize(), uniforms);
+		binding.properties.resize(uniforms.size(), -1);
+		for (size_t i = 0; i < uniforms.size(); ++i)
+		{
+			MaterialPropertyType type;
+			int p = FindProperty(uniforms[i].nameID);
+			if (p >= 0 && ToMaterialPropertyType(uniforms[i].type, type) && Compatible(m_properties[p].type, type))
+				binding.properties[i] = p;
+		}
+		m_uniformBindings.push_back(std::move(binding));
+		return m_uniformBindings.back();
+	}
+
+	void Material::UpdateUniformBuffer(const std::vector<UniformInfo>& uniforms, const UniformBindingCache& binding)
+	{
+		const int size = m_shader->materialBlockSize();
+		static std::vector<uint8_t> block;	// GL thread only
+		block.assign(size, 0);
+		for (size_t i = 0; i < uniforms.size(); ++i)
+		{
+			auto const & u = uniforms[i];
+			const int index = binding.properties[i];
+			if (u.blockOffset < 0 || index < 0)
+				continue;
+			const float* v = m_values.data() + m_properties[index].offset;
+			uint8_t* dst = block.data() + u.blockOffset;
+			if (u.type == GL_FLOAT_MAT4)
 			{
-				m_properties.emplace_back(MaterialProperty{ u.name, MaterialPropertyType::Texture2DArrayShadow });
+				// v is row major (see Matrix4x4), the block is column major unless declared row_major
+				for (int row = 0; row < 4; ++row)
+				{
+					for (int col = 0; col < 4; ++col)
+					{
+						const int offset = u.rowMajor ? row * u.matrixStride + col * 4 : col * u.matrixStride + row * 4;
+						std::memcpy(dst + offset, v + row * 4 + col, sizeof(float));
+					}
+				}
 			}
-			else if (u.type == GL_SAMPLER_CUBE)
+			else
 			{
-				m_properties.emplace_back(MaterialProperty{ u.name, MaterialPropertyType::TextureCube });
-			}
-			else {
-				LogError("Unknown shader property type");
-				abort();
+				std::memcpy(dst, v, FloatCount(m_properties[index].type) * sizeof(float));
 			}
 		}
+
+		glBindBuffer(GL_UNIFORM_BUFFER, m_uniformBuffer.buffer);
+		if (size != m_uniformBuffer.size)
+		{
+			glBufferData(GL_UNIFORM_BUFFER, size, block.data(), GL_DYNAMIC_DRAW);
+			m_uniformBuffer.size = size;
+		}
+		else
+		{
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, size, block.data());
+		}
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		m_uniformBuffer.layout = binding.blockLayout;
+		m_uniformBuffer.dirty = false;
 	}
 
 	void Material::DisableKeywords(ShaderKeywords keyword)
@@ -153,70 +316,163 @@ namespace FishEngine
 
 	void Material::BindProperties()
 	{
-		m_shader->BindUniforms(m_uniforms);
-		m_shader->BindTextures(m_textures);
+		auto & uniforms = m_shader->uniforms();
+		const GLuint program = m_shader->m_GLNativeProgram;
+		auto const & cache = UniformBinding(program, uniforms);
+		auto const & binding = cache.properties;
+
+		if (m_shader->materialBlockSize() > 0)
+		{
+			if (m_uniformBuffer.buffer == 0)
+				glGenBuffers(1, &m_uniformBuffer.buffer);
+			// the variants of a shader (instancing, keywords) usually lay the block out the same way,
+			// switching between them must not upload it again
+			if (m_uniformBuffer.dirty || m_uniformBuffer.layout != cache.blockLayout)
+				UpdateUniformBuffer(uniforms, cache);
+			glBindBufferRange(GL_UNIFORM_BUFFER, Pipeline::MaterialUBOBindingPoint, m_uniformBuffer.buffer, 0, m_uniformBuffer.size);
+		}
+
+		for (size_t i = 0; i < uniforms.size(); ++i)
+		{
+			const int index = binding[i];
+			if (index < 0)
+				continue;
+			auto & u = uniforms[i];
+			if (u.blockOffset >= 0)		// in the uniform buffer
+			{
+				u.binded = true;
+				continue;
+			}
+			auto const & p = m_properties[index];
+			const float* v = m_values.data() + p.offset;
+			switch (u.type)
+			{
+			case GL_FLOAT:
+				glProgramUniform1f(program, u.location, *v);
+				break;
+			case GL_FLOAT_VEC2:
+				glProgramUniform2fv(program, u.location, 1, v);
+				break;
+			case GL_FLOAT_VEC3:
+				glProgramUniform3fv(program, u.location, 1, v);
+				break;
+			case GL_FLOAT_VEC4:
+				glProgramUniform4fv(program, u.location, 1, v);
+				break;
+			case GL_FLOAT_MAT4:
+				glProgramUniformMatrix4fv(program, u.location, 1, GL_TRUE, v);
+				break;
+			default:	// samplers
+			{
+				auto const & texture = m_textureValues[p.offset];
+				if (texture == nullptr)
+					continue;
+				GLStateCache::BindTexture(u.textureBindPoint, SamplerTarget(u.type), texture->GetNativeTexturePtr());
+				break;
+			}
+			}
+			u.binded = true;
+		}
+		glCheckError();
+	}
+
+	bool Material::HasProperty(const std::string& propertyName)
+	{
+		return HasProperty(Shader::PropertyToID(propertyName));
+	}
+
+	bool Material::HasProperty(int nameID)
+	{
+		return FindProperty(nameID) >= 0;
 	}
 
 	void Material::SetFloat(const std::string& name, const float value)
 	{
-//		if (FindUniformInShader<float>(m_shader->m_uniforms, name))
-//		{
-//			m_uniforms.floats[name] = value;
-//			return;
-//		}
-//		Debug::LogWarning("Uniform %s[float] not found.", name.c_str());
-		
-		m_uniforms.floats[name] = value;
+		SetFloat(Shader::PropertyToID(name), value);
 	}
 
+	void Material::SetFloat(int nameID, const float value)
+	{
+		*PropertyValues(nameID, MaterialPropertyType::Float) = value;
+	}
 
 	void Material::SetVector2(const std::string& name, const Vector2& value)
 	{
-//		if (FindUniformInShader<Vector2>(m_shader->m_uniforms, name))
-//		{
-//			m_uniforms.vec2s[name] = value;
-//			return;
-//		}
-//		Debug::LogWarning("Uniform %s[vec2] not found.", name.c_str());
-		m_uniforms.vec2s[name] = value;
+		SetVector2(Shader::PropertyToID(name), value);
+	}
+
+	void Material::SetVector2(int nameID, const Vector2& value)
+	{
+		std::copy_n(value.data(), 2, PropertyValues(nameID, MaterialPropertyType::Float2));
 	}
 
 	void Material::SetVector3(const std::string& name, const Vector3& value)
 	{
-//		if (FindUniformInShader<Vector3>(m_shader->m_uniforms, name))
-//		{
-//			m_uniforms.vec3s[name] = value;
-//			return;
-//		}
-//		Debug::LogWarning("Uniform %s[vec3] not found.", name.c_str());
-		m_uniforms.vec3s[name] = value;
+		SetVector3(Shader::PropertyToID(name), value);
 	}
 
+	void Material::SetVector3(int nameID, const Vector3& value)
+	{
+		std::copy_n(value.data(), 3, PropertyValues(nameID, MaterialPropertyType::Float3));
+	}
 
 	void Material::SetVector4(const std::string& name, const Vector4& value)
 	{
-//		if (FindUniformInShader<Vector4>(m_shader->m_uniforms, name))
-//		{
-//			m_uniforms.vec4s[name] = value;
-//			return;
-//		}
-//		Debug::LogWarning("Uniform %s[vec4] not found.", name.c_str());
-		m_uniforms.vec4s[name] = value;
+		SetVector4(Shader::PropertyToID(name), value);
 	}
 
+	void Material::SetVector4(int nameID, const Vector4& value)
+	{
+		std::copy_n(value.data(), 4, PropertyValues(nameID, MaterialPropertyType::Float4));
+	}
+
+	void Material::SetMatrix(const std::string& name, const Matrix4x4& value)
+	{
+		SetMatrix(Shader::PropertyToID(name), value);
+	}
+
+	void Material::SetMatrix(int nameID, const Matrix4x4& value)
+	{
+		std::copy_n(value.data(), 16, PropertyValues(nameID, MaterialPropertyType::Mat4));
+	}
 
 	void Material::SetTexture(const std::string& name, TexturePtr texture)
 	{
-//		for (auto& u : m_shader->m_uniforms)
-//		{
-//			if (u.name == name && (u.type == GL_SAMPLER_2D || u.type == GL_SAMPLER_CUBE || u.type == GL_SAMPLER_2D_ARRAY || u.type == GL_SAMPLER_2D_ARRAY_SHADOW))
-//			{
-//				m_textures[name] = texture;
-//				return;
-//			}
-//		}
-//		Debug::LogWarning("Uniform %s[texture] not found.", name.c_str());
-		m_textures[name] = texture;
+		SetTexture(Shader::PropertyToID(name), texture);
+	}
+
+	void Material::SetTexture(int nameID, TexturePtr texture)
+	{
+		PropertyTexture(nameID) = texture;
+	}
+
+	bool Material::DeserializeLegacy(InputArchive & archive)
+	{
+		if (!archive.HasNVP("m_uniforms"))
+			return false;
+
+		std::map<std::string, TexturePtr> textures;
+		ShaderUniforms uniforms;
+		archive >> FishEngine::make_nvp("m_textures", textures);
+		archive >> FishEngine::make_nvp("m_uniforms", uniforms);
+		// the old m_properties only listed names and types, they are rebuilt from the values
+
+		m_properties.clear();
+		m_values.clear();
+		m_textureValues.clear();
+		for (auto & u : uniforms.floats)
+			SetFloat(u.first, u.second);
+		for (auto & u : uniforms.vec2s)
+			SetVector2(u.first, u.second);
+		for (auto & u : uniforms.vec3s)
+			SetVector3(u.first, u.second);
+		for (auto & u : uniforms.vec4s)
+			SetVector4(u.first, u.second);
+		for (auto & u : uniforms.mat4s)
+			SetMatrix(u.first, u.second);
+		for (auto & t : textures)
+			SetTexture(t.first, t.second);
+		return true;
 	}
 
 
@@ -258,7 +514,7 @@ namespace FishEngine
 	{
 		for (auto& pair : textures)
 		{
-			m_textures[pair.first] = pair.second;
+			SetTexture(pair.first, pair.second);
 		}
 	}
 
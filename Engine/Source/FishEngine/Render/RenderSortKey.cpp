@@ -0,0 +1,93 @@
+#include <FishEngine/Render/RenderSortKey.hpp>
+
+#include <algorithm>
+
+namespace FishEngine
+{
+namespace Rendering
+{
+	inline uint64_t Bits(uint32_t value, int bitCount)
+	{
+		return static_cast<uint64_t>(value) & ((uint64_t(1) << bitCount) - 1);
+	}
+
+	inline uint32_t QuantizeDepth(float depth01, int bitCount)
+	{
+		depth01 = std::min(std::max(depth01, 0.0f), 1.0f);
+		const uint32_t maxValue = (uint32_t(1) << bitCount) - 1;
+		return static_cast<uint32_t>(depth01 * maxValue);
+	}
+
+	uint64_t MakeOpaqueSortKey(int renderQueue, uint32_t program, uint32_t material, uint32_t mesh, float depth01)
+	{
+		return (Bits(renderQueue, 13) << 51)
+			| (Bits(program, 12) << 39)
+			| (Bits(material, 12) << 27)
+			| (Bits(mesh, 11) << 16)
+			| Bits(QuantizeDepth(depth01, 16), 16);
+	}
+
+	uint64_t MakeTransparentSortKey(int renderQueue, uint32_t program, uint32_t material, uint32_t mesh, float depth01)
+	{
+		const uint32_t maxDepth = (uint32_t(1) << 24) - 1;
+		return (Bits(renderQueue, 13) << 51)
+			| (Bits(maxDepth - QuantizeDepth(depth01, 24), 24) << 27)
+			| (Bits(program, 9) << 18)
+			| (Bits(material, 9) << 9)
+			| Bits(mesh, 9);
+	}
+
+	void RadixSort(std::vector<uint64_t> const & keys, std::vector<uint32_t> & outOrder)
+	{
+		const std::size_t count = keys.size();
+		outOrder.resize(count);
+		for (std::size_t i = 0; i < count; ++i)
+			outOrder[i] = static_cast<uint32_t>(i);
+		if (count <= 1)
+			return;
+
+		// one histogram per byte, built in a single pass over the keys
+		uint32_t histograms[8][256] = {};
+		for (auto key : keys)
+		{
+			for (int pass = 0; pass < 8; ++pass)
+			{
+				histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+			}
+		}
+
+		std::vector<uint32_t> temp(count);
+		uint32_t* src = outOrder.data();
+		uint32_t* dst = temp.data();
+		for (int pass = 0; pass < 8; ++pass)
+		{
+			auto & histogram = histograms[pass];
+			const int shift = pass * 8;
+
+			// all keys have the same byte
+			if (histogram[(keys[0] >> shift) & 0xFF] == count)
+				continue;
+
+			uint32_t offset = 0;
+			for (auto & h : histogram)
+			{
+				uint32_t c = h;
+				h = offset;
+				offset += c;
+			}
+
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				uint32_t index = src[i];
+				dst[histogram[(keys[index] >> shift) & 0xFF]++] = index;
+			}
+			std::swap(src, dst);
+		}
+
+		if (src != outOrder.data())
+		{
+			std::copy(src, src + count, outOrder.data());
+		}
+	}
+}
+}
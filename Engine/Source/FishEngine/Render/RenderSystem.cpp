@@ -19,6 +19,12 @@
 #include <FishEngine/RenderTarget.hpp>
 #include <FishEngine/Timer.hpp>
 #include <FishEngine/MeshFilter.hpp>
+#include <FishEngine/Render/Culling.hpp>
+#include <FishEngine/Render/RendererRegistry.hpp>
+#include <FishEngine/Render/RenderSortKey.hpp>
+#include <FishEngine/Render/GLStateCache.hpp>
+#include <FishEngine/Render/GraphicsDevice.hpp>
+#include <FishEngine/Render/TextureStreaming.hpp>
 
 using namespace FishEngine;
 
@@ -29,14 +35,123 @@ struct RenderObject
 	MaterialPtr		material;
 	MeshPtr			mesh;
 	int				subMeshID = -1;
+	uint64_t		sortKey = 0;
+	bool			instancing = false;	// may be merged with its neighbours into one instanced draw
+	float			lodFade = 1.0f;		// RendererRegistry::s_lodFade, cross-fading draws are never instanced
+	bool			skinned = false;	// SkinnedMeshRenderer, never instanced
 
-	RenderObject(int renderQueue, RendererPtr renderer, MaterialPtr material, MeshPtr mesh, int subMeshID = -1)
-		: renderQueue(renderQueue), renderer(renderer), material(material), mesh(mesh), subMeshID(subMeshID)
+	RenderObject(int renderQueue, RendererPtr renderer, MaterialPtr material, MeshPtr mesh, int subMeshID = -1, uint64_t sortKey = 0)
+		: renderQueue(renderQueue), renderer(renderer), material(material), mesh(mesh), subMeshID(subMeshID), sortKey(sortKey)
 	{
 
 	}
 };
 
+// a skinned mesh may be shared by several renderers, each with its own skinned vertices
+static void DrawRenderObject(RenderObject const & ro)
+{
+	auto model = ro.renderer->transform()->localToWorldMatrix();
+	Pipeline::UpdatePerDrawUniforms(model, ro.lodFade);
+	if (ro.skinned)
+	{
+		std::static_pointer_cast<SkinnedMeshRenderer>(ro.renderer)->BindSkinnedVertices();
+	}
+	Graphics::DrawMesh(ro.mesh, ro.material, ro.subMeshID);
+}
+
+// order the queue by RenderObject::sortKey
+static void SortRenderQueue(std::vector<RenderObject> & queue)
+{
+	std::vector<uint64_t> keys;
+	keys.reserve(queue.size());
+	for (auto & ro : queue)
+	{
+		keys.push_back(ro.sortKey);
+	}
+	std::vector<uint32_t> order;
+	Rendering::RadixSort(keys, order);
+
+	std::vector<RenderObject> sorted;
+	sorted.reserve(queue.size());
+	for (auto index : order)
+	{
+		sorted.push_back(std::move(queue[index]));
+	}
+	queue.swap(sorted);
+}
+
+// the GeometryArena pool of the mesh, -1 if it has its own buffers
+static int ArenaPool(MeshPtr const & mesh)
+{
+	mesh->UploadMeshData();
+	return mesh->arenaPool();
+}
+
+// sorted queue: runs of the same mesh + material + submesh are drawn with Graphics::DrawMeshInstanced,
+// runs of the same material over meshes of the same arena pool with Graphics::DrawMeshesInstanced
+static void DrawRenderQueue(std::vector<RenderObject> const & queue)
+{
+	static std::vector<Matrix4x4> matrices;
+	static std::vector<MeshPtr> meshes;
+	static std::vector<int> subMeshIndices;
+	const std::size_t count = queue.size();
+	std::size_t first = 0;
+	while (first < count)
+	{
+		auto & ro = queue[first];
+		std::size_t last = first + 1;
+		bool sameMesh = true;
+		if (ro.instancing)
+		{
+			const int pool = ArenaPool(ro.mesh);
+			while (last < count
+				&& queue[last].instancing
+				&& queue[last].material == ro.material)
+			{
+				auto & next = queue[last];
+				if (next.mesh != ro.mesh || next.subMeshID != ro.subMeshID)
+				{
+					if (pool < 0 || ArenaPool(next.mesh) != pool)
+						break;
+					sameMesh = false;
+				}
+				++last;
+			}
+		}
+
+		if (last - first > 1)
+		{
+			matrices.clear();
+			for (std::size_t i = first; i < last; ++i)
+			{
+				matrices.push_back(queue[i].renderer->transform()->localToWorldMatrix());
+			}
+			if (sameMesh)
+			{
+				Graphics::DrawMeshInstanced(ro.mesh, ro.subMeshID, ro.material, matrices);
+			}
+			else
+			{
+				meshes.clear();
+				subMeshIndices.clear();
+				for (std::size_t i = first; i < last; ++i)
+				{
+					meshes.push_back(queue[i].mesh);
+					subMeshIndices.push_back(queue[i].subMeshID);
+				}
+				Graphics::DrawMeshesInstanced(meshes.data(), subMeshIndices.data(), ro.material, matrices.data(), static_cast<int>(matrices.size()));
+				// do not keep the meshes alive
+				meshes.clear();
+			}
+		}
+		else
+		{
+			DrawRenderObject(ro);
+		}
+		first = last;
+	}
+}
+
 namespace FishEngine
 {
 	//FishEngine::GBuffer RenderSystem::m_GBuffer;
@@ -52,6 +167,8 @@ namespace FishEngine
 
 	FishEngine::RenderTargetPtr     RenderSystem::m_colorOnlyRenderTarget;
 
+	uint32_t						RenderSystem::s_frameCount = 0;
+
 	//FishEngine::ColorBufferPtr      RenderSystem::m_blurredScreenShadowMap;
 	//FishEngine::RenderTargetPtr     RenderSystem::m_blurScreenShadowMapRenderTarget1;
 	//FishEngine::RenderTargetPtr     RenderSystem::m_blurScreenShadowMapRenderTarget2;
@@ -70,6 +187,7 @@ namespace FishEngine
 			abort();
 		}
 #endif
+		GraphicsDevice::Init(GraphicsDeviceType::OpenGLCore);
 	}
 
 	void RenderSystem::Init()
@@ -83,8 +201,8 @@ namespace FishEngine
 		Scene::Init();
 		glFrontFace(GL_CW);
 		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_CULL_FACE);
+		GLStateCache::SetDepthTest(true);
+		GLStateCache::SetCullFace(true);
 		glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 		//glEnable(GL_LINE_SMOOTH);
 
@@ -124,7 +242,12 @@ namespace FishEngine
 
 	void RenderSystem::Render()
 	{
+		s_frameCount++;
 		glCheckError();
+		// GLStateCache::counters() and GraphicsDevice::counters() report the previous frame until here
+		GLStateCache::ResetCounters();
+		GraphicsDevice::ResetFrameCounters();
+		TextureStreaming::Update();
 		float white[] = { 1.0f, 1.0f, 1.0f, 1.0f };
 		float black[] = { 0.0f, 0.0f, 0.0f, 1.0f };
 		float error_color[] = { 1.0f, 1.0f, 0.0f, 1.0f };
@@ -139,89 +262,124 @@ namespace FishEngine
 		/************************************************************************/
 
 		// forward
-		std::deque<RenderObject> forwardRenderQueueGeometry;
-		std::deque<RenderObject> forwardRenderQueueTransparent;
+		std::vector<RenderObject> forwardRenderQueueGeometry;
+		std::vector<RenderObject> forwardRenderQueueTransparent;
 		
 		// deferred
-		std::deque<RenderObject> deferredRenderQueue;	// for now, geometry only
+		std::vector<RenderObject> deferredRenderQueue;	// for now, geometry only
 
-		std::deque<SkinnedMeshRendererPtr> skinnedMeshRenderers;	// for animation
+		std::vector<SkinnedMeshRenderer*> skinnedMeshRenderers;	// for animation, kept alive by RendererRegistry
 
 		bool deferred_enabled = false;
 
-		std::deque<GameObjectPtr> todo;
-		for (auto& go : Scene::m_gameObjects)
-		{
-			todo.push_back(go);
-		}
-		while (!todo.empty())
+		/************************************************************************/
+		/* Culling                                                              */
+		/************************************************************************/
+		RendererRegistry::Update();
+		RendererRegistry::UpdateLOD(*camera);
+		const auto & worldToCamera = camera->worldToCameraMatrix();
+		const float nearClip = camera->nearClipPlane();
+		const float invDepthRange = 1.0f / (camera->farClipPlane() - nearClip);
+		std::vector<uint8_t> visible;
+		Culling::CullBounds(FrustumPlanes::FromCamera(*camera), RendererRegistry::s_worldBounds, visible);
+
+		for (std::size_t index = 0; index < RendererRegistry::size(); ++index)
 		{
-			auto go = todo.front();
-			todo.pop_front();
-			for (auto && child : go->transform()->children())
-			{
-				todo.push_back(child->gameObject());
-			}
-
-			if (!go->activeInHierarchy())
+			const auto flags = RendererRegistry::s_flags[index];
+			if ((flags & RendererRegistry::Active) == 0)
+				continue;
+			auto & renderer = RendererRegistry::s_renderers[index];
+			auto & mesh = RendererRegistry::s_meshes[index];
+			if (mesh == nullptr)
 				continue;
-			RendererPtr renderer = go->GetComponent<Renderer>();
-			if (renderer == nullptr || !renderer->enabled())
+			// not in the current LOD of its LODGroup
+			const float lodFade = RendererRegistry::s_lodFade[index];
+			if (lodFade == 0.0f)
 				continue;
 
-			MeshPtr mesh;
-			if (renderer->ClassID() == ClassID<MeshRenderer>())
-			{
-				auto meshFilter = go->GetComponent<MeshFilter>();
-				if (meshFilter == nullptr)
-					continue;
-				mesh = meshFilter->mesh();
-			}
-			else
+			const bool skinned = (flags & RendererRegistry::Skinned) != 0;
+			if (skinned)
 			{
-				auto r = As<SkinnedMeshRenderer>(renderer);
-				mesh = r->sharedMesh();
-				skinnedMeshRenderers.push_back(r);
+				// culled ones are skinned by Scene::RenderShadow if they cast shadows into a cascade
+				auto skinnedMeshRenderer = static_cast<SkinnedMeshRenderer*>(renderer.get());
+				if (visible[index])
+					skinnedMeshRenderer->MarkVisible();
+				if (visible[index] || skinnedMeshRenderer->cullingMode() == AnimationCullingMode::AlwaysAnimate)
+					skinnedMeshRenderers.push_back(skinnedMeshRenderer);
 			}
 
-			if (mesh == nullptr)
+			if (!visible[index])
 				continue;
 
-			auto & materials = renderer->materials();
-			for (int i = 0; i < materials.size(); ++i)
+			// normalized view depth of the bounds center
+			auto & bounds = RendererRegistry::s_worldBounds;
+			Vector3 center(bounds.m_centerX[index], bounds.m_centerY[index], bounds.m_centerZ[index]);
+			float depth = (worldToCamera.MultiplyPoint(center).z - nearClip) * invDepthRange;
+			uint32_t meshID = mesh->GetInstanceID();
+
+			const uint32_t firstMaterial = RendererRegistry::s_materialOffsets[index];
+			const int materialCount = static_cast<int>(RendererRegistry::s_materialCounts[index]);
+			for (int i = 0; i < materialCount; ++i)
 			{
-				auto & material = materials[i];
+				auto & material = RendererRegistry::s_materials[firstMaterial + i];
 				if (material == nullptr)
 				{
 					continue;
 				}
 
-				// TODO: find correct render queue and submeshID
+				// TODO: find correct submeshID
 
-				if (material->shader()->IsTransparent())
+				auto shader = material->shader();
+				// a shader without the dither keeps the outgoing LOD until the fade ends, then switches
+				float fade = lodFade;
+				if (!shader->SupportsLODFade())
 				{
-					forwardRenderQueueTransparent.emplace_back(0, renderer, material, mesh, i);
+					if (fade < 0.0f)
+						continue;
+					fade = 1.0f;
+				}
+				int queue = material->renderQueue();
+				uint32_t shaderID = shader->GetInstanceID();
+				uint32_t materialID = material->GetInstanceID();
+
+				if (shader->IsTransparent())
+				{
+					auto key = Rendering::MakeTransparentSortKey(queue, shaderID, materialID, meshID, depth);
+					forwardRenderQueueTransparent.emplace_back(queue, renderer, material, mesh, i, key);
+					forwardRenderQueueTransparent.back().lodFade = fade;
+					forwardRenderQueueTransparent.back().skinned = skinned;
 					continue;
 				}
-				else if (material->shader()->IsDeferred())
+
+				auto key = Rendering::MakeOpaqueSortKey(queue, shaderID, materialID, meshID, depth);
+				// skinned meshes are animated per renderer
+				const bool instancing = shader->SupportsInstancing() && !skinned && fade == 1.0f;
+				if (shader->IsDeferred())
 				{
 					// Deferred
 					deferred_enabled = true;
-					deferredRenderQueue.emplace_back(0, renderer, material, mesh, i);
+					deferredRenderQueue.emplace_back(queue, renderer, material, mesh, i, key);
+					deferredRenderQueue.back().instancing = instancing;
+					deferredRenderQueue.back().lodFade = fade;
+					deferredRenderQueue.back().skinned = skinned;
 					continue;
 				}
 				else
 				{
-					forwardRenderQueueGeometry.emplace_back(0, renderer, material, mesh, i);
+					forwardRenderQueueGeometry.emplace_back(queue, renderer, material, mesh, i, key);
+					forwardRenderQueueGeometry.back().instancing = instancing;
+					forwardRenderQueueGeometry.back().lodFade = fade;
+					forwardRenderQueueGeometry.back().skinned = skinned;
 				}
 				
 			}
 		}
 
-		for (auto & r : skinnedMeshRenderers)
-		{
-			r->UpdataAnimation();
-		}
+		SortRenderQueue(deferredRenderQueue);
+		SortRenderQueue(forwardRenderQueueGeometry);
+		SortRenderQueue(forwardRenderQueueTransparent);
+
+		SkinnedMeshRenderer::UpdateAnimations(skinnedMeshRenderers.data(), skinnedMeshRenderers.size());
 		skinnedMeshRenderers.clear();
 
 
@@ -258,19 +416,15 @@ namespace FishEngine
 			glClearBufferfv(GL_COLOR, 2, error_color);
 			glClearBufferfv(GL_DEPTH, 0, white);
 
-			for (auto & ro : deferredRenderQueue)
-			{
-				//ro.renderer->PreRender();
-				auto model = ro.renderer->transform()->localToWorldMatrix();
-				Pipeline::UpdatePerDrawUniforms(model);
-				Graphics::DrawMesh(ro.mesh, ro.material, ro.subMeshID);
-			}
+			camera->ExecuteCommandBuffers(Rendering::CameraEvent::BeforeGBuffer);
+			DrawRenderQueue(deferredRenderQueue);
+			camera->ExecuteCommandBuffers(Rendering::CameraEvent::AfterGBuffer);
 
 			Pipeline::PopRenderTarget();
 
 			Pipeline::PushRenderTarget(m_colorOnlyRenderTarget);
-			glDepthFunc(GL_ALWAYS);
-			glDepthMask(GL_FALSE);
+			GLStateCache::SetDepthFunc(GL_ALWAYS);
+			GLStateCache::SetDepthMask(false);
 			auto quad = Mesh::builtinMesh(PrimitiveType::ScreenAlignedQuad);
 			auto mtl = Material::builtinMaterial("Deferred");
 			mtl->SetTexture("DBufferATexture", m_GBuffer[0]);
@@ -278,21 +432,17 @@ namespace FishEngine
 			mtl->SetTexture("DBufferCTexture", m_GBuffer[2]);
 			mtl->SetTexture("SceneDepthTexture", m_mainDepthBuffer);
 			Graphics::DrawMesh(quad, mtl);
-			glDepthMask(GL_TRUE);
-			glDepthFunc(GL_LESS);
+			GLStateCache::SetDepthMask(true);
+			GLStateCache::SetDepthFunc(GL_LESS);
 			Pipeline::PopRenderTarget();
 		}
 
 		/************************************************************************/
 		/* Forward                                                              */
 		/************************************************************************/
-		for (auto & ro : forwardRenderQueueGeometry)
-		{
-			//ro.renderer->PreRender();
-			auto model = ro.renderer->transform()->localToWorldMatrix();
-			Pipeline::UpdatePerDrawUniforms(model);
-			Graphics::DrawMesh(ro.mesh, ro.material, ro.subMeshID);
-		}
+		camera->ExecuteCommandBuffers(Rendering::CameraEvent::BeforeForwardOpaque);
+		DrawRenderQueue(forwardRenderQueueGeometry);
+		camera->ExecuteCommandBuffers(Rendering::CameraEvent::AfterForwardOpaque);
 
 		Pipeline::PopRenderTarget(); // m_mainRenderTarget
 
@@ -304,8 +454,8 @@ namespace FishEngine
 		// no depth buffer
 		Pipeline::PushRenderTarget(m_screenShadowMapRenderTarget);
 		{
-			glDepthFunc(GL_ALWAYS);
-			glDepthMask(GL_FALSE);
+			GLStateCache::SetDepthFunc(GL_ALWAYS);
+			GLStateCache::SetDepthMask(false);
 			auto light = Light::mainLight();
 			LayeredDepthBufferPtr shadowMap;
 			if (light != nullptr)
@@ -325,14 +475,14 @@ namespace FishEngine
 			mtl->SetVector4("_ShadowMapTexture_TexelSize", Vector4(shadowMapTexelSize, shadowMapTexelSize, shadowMapSize, shadowMapSize));
 			mtl->SetTexture("SceneDepthTexture", m_mainDepthBuffer);
 			Graphics::DrawMesh(quad, mtl);
-			glDepthMask(GL_TRUE);
-			glDepthFunc(GL_LESS);
+			GLStateCache::SetDepthMask(true);
+			GLStateCache::SetDepthFunc(GL_LESS);
 		}
 		Pipeline::PopRenderTarget();
 		
 		// add shadow
-		glDepthFunc(GL_ALWAYS);
-		glDepthMask(GL_FALSE);
+		GLStateCache::SetDepthFunc(GL_ALWAYS);
+		GLStateCache::SetDepthMask(false);
 		//Pipeline::PushRenderTarget(m_addShadowRenderTarget);
 		//glClearBufferfv(GL_COLOR, 0, black);
 		auto quad = Mesh::builtinMesh(PrimitiveType::ScreenAlignedQuad);
@@ -341,8 +491,8 @@ namespace FishEngine
 		mtl->SetTexture("ScreenShadow", m_screenShadowMap);
 		Graphics::DrawMesh(quad, mtl);
 		//Pipeline::PopRenderTarget();
-		glDepthMask(GL_TRUE);
-		glDepthFunc(GL_LESS);
+		GLStateCache::SetDepthMask(true);
+		GLStateCache::SetDepthFunc(GL_LESS);
 #else
 		m_mainRenderTarget->AttachForRead();
 		glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
@@ -355,7 +505,7 @@ namespace FishEngine
 		m_mainRenderTarget->AttachForRead();
 		glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
 		//m_mainRenderTarget->Detach();
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		GLStateCache::BindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 
 		/************************************************************************/
 		/* Skybox                                                               */
@@ -363,19 +513,23 @@ namespace FishEngine
 		Matrix4x4 model;
 		model.SetTRS(Camera::main()->transform()->position(), Quaternion::identity, Vector3::one * 2000);
 		//Matrix4x4 model = Matrix4x4::Scale(1000);
+		camera->ExecuteCommandBuffers(Rendering::CameraEvent::BeforeSkybox);
 		Graphics::DrawMesh(Mesh::builtinMesh(PrimitiveType::Sphere), model, RenderSettings::skybox());
+		camera->ExecuteCommandBuffers(Rendering::CameraEvent::AfterSkybox);
 
 
 		/************************************************************************/
 		/* Transparent                                                          */
 		/************************************************************************/
+		camera->ExecuteCommandBuffers(Rendering::CameraEvent::BeforeForwardAlpha);
 		for (auto & ro : forwardRenderQueueTransparent)
 		{
 			//ro.renderer->PreRender();
-			auto model = ro.renderer->transform()->localToWorldMatrix();
-			Pipeline::UpdatePerDrawUniforms(model);
-			Graphics::DrawMesh(ro.mesh, ro.material, ro.subMeshID);
+			DrawRenderObject(ro);
 		}
+		camera->ExecuteCommandBuffers(Rendering::CameraEvent::AfterForwardAlpha);
+
+		camera->ExecuteCommandBuffers(Rendering::CameraEvent::AfterEverything);
 
 #if 0
 		glDepthFunc(GL_ALWAYS);
@@ -410,7 +564,8 @@ namespace FishEngine
 
 	void RenderSystem::Clean()
 	{
-
+		TextureStreaming::Clean();
+		Pipeline::Clean();
 	}
 
 	void RenderSystem::ResizeBufferSize(const int width, const int height)
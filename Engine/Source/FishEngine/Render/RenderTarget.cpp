@@ -6,6 +6,7 @@
 #include <FishEngine/Texture.hpp>
 #include <FishEngine/Debug.hpp>
 #include <FishEngine/RenderBuffer.hpp>
+#include <FishEngine/Render/GLStateCache.hpp>
 
 
 namespace FishEngine
@@ -48,24 +49,24 @@ namespace FishEngine
 
 	void RenderTarget::Attach()
 	{
-		glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+		GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, m_fbo);
 	}
 
 	void RenderTarget::AttachForRead()
 	{
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbo);
+		GLStateCache::BindFramebuffer(GL_READ_FRAMEBUFFER, m_fbo);
 	}
 
 	void RenderTarget::Detach()
 	{
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
 	void RenderTarget::Init()
 	{
 		glGenFramebuffers(1, &m_fbo);
 		assert(m_fbo > 0);
-		glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+		GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, m_fbo);
 
 		if (m_useDepthBuffer)
 		{
@@ -111,7 +112,7 @@ namespace FishEngine
 #undef TEMP_CASE
 		}
 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, 0);
 
 		glCheckError();
 	}
@@ -1,5 +1,6 @@
 #include <FishEngine/RenderTexture.hpp>
 #include <FishEngine/Debug.hpp>
+#include <FishEngine/Render/GLStateCache.hpp>
 
 #include <boost/lexical_cast.hpp>
 
@@ -8,7 +9,7 @@ namespace FishEngine
 
 	RenderTexture::~RenderTexture()
 	{
-		glDeleteFramebuffers(1, &m_FBO);
+		GLStateCache::DeleteFramebuffer(m_FBO);
 	}
 
 	//RenderTexturePtr RenderTexture::CreateShadowMap()
@@ -51,7 +52,7 @@ namespace FishEngine
 
 		glGenFramebuffers(1, &rt->m_FBO);
 		glGenTextures(1, &rt->m_GLNativeTexture);
-		glBindTexture(GL_TEXTURE_2D, rt->m_GLNativeTexture);
+		GLStateCache::BindTexture(GL_TEXTURE_2D, rt->m_GLNativeTexture);
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, rt->m_width, rt->m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -59,7 +60,7 @@ namespace FishEngine
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
 		glGenTextures(1, &rt->m_depthBuffer);
-		glBindTexture(GL_TEXTURE_2D, rt->m_depthBuffer);
+		GLStateCache::BindTexture(GL_TEXTURE_2D, rt->m_depthBuffer);
 		//glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, rt->m_width, rt->m_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, rt->m_width, rt->m_height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -67,12 +68,12 @@ namespace FishEngine
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-		glBindFramebuffer(GL_FRAMEBUFFER, rt->m_FBO);
+		GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, rt->m_FBO);
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, rt->m_GLNativeTexture, 0);
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, rt->m_depthBuffer, 0);
 		//glDrawBuffer(GL_NONE);
 		//glReadBuffer(GL_NONE);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, 0);
 		return rt;
 	}
 
@@ -83,10 +84,10 @@ namespace FishEngine
 			return;
 		m_width = newWidth;
 		m_height = newHeight;
-		glBindTexture(GL_TEXTURE_2D, m_GLNativeTexture);
+		GLStateCache::BindTexture(GL_TEXTURE_2D, m_GLNativeTexture);
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-		glBindTexture(GL_TEXTURE_2D, m_depthBuffer);
+		GLStateCache::BindTexture(GL_TEXTURE_2D, m_depthBuffer);
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, m_width, m_height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		GLStateCache::BindTexture(GL_TEXTURE_2D, 0);
 	}
 } // namespace FishEngine
@@ -0,0 +1,492 @@
+#include <FishEngine/Render/RendererRegistry.hpp>
+
+#include <deque>
+#include <algorithm>
+#include <unordered_set>
+
+#include <FishEngine/Scene.hpp>
+#include <FishEngine/GameObject.hpp>
+#include <FishEngine/Transform.hpp>
+#include <FishEngine/MeshRenderer.hpp>
+#include <FishEngine/MeshFilter.hpp>
+#include <FishEngine/SkinnedMeshRenderer.hpp>
+#include <FishEngine/LODGroup.hpp>
+
+namespace FishEngine
+{
+	std::vector<RendererPtr>	RendererRegistry::s_renderers;
+	std::vector<MeshFilterPtr>	RendererRegistry::s_meshFilters;
+	std::vector<MeshPtr>		RendererRegistry::s_meshes;
+	std::vector<uint8_t>		RendererRegistry::s_flags;
+	BoundsArray					RendererRegistry::s_worldBounds;
+	std::vector<MaterialPtr>	RendererRegistry::s_materials;
+	std::vector<uint32_t>		RendererRegistry::s_materialOffsets;
+	std::vector<uint32_t>		RendererRegistry::s_materialCounts;
+	std::vector<float>			RendererRegistry::s_lodFade;
+	std::vector<uint32_t>		RendererRegistry::s_transformVersions;
+	std::vector<uint8_t>		RendererRegistry::s_stateDirty;
+	std::vector<uint32_t>		RendererRegistry::s_dirtyIndices;
+	std::vector<LODGroupPtr>	RendererRegistry::s_lodGroups;
+	std::vector<int32_t>		RendererRegistry::s_lodGroupIndex;
+	std::vector<uint8_t>		RendererRegistry::s_lodMask;
+	std::size_t					RendererRegistry::s_unusedMaterials = 0;
+	std::vector<std::weak_ptr<Component>>	RendererRegistry::s_addedComponents;
+	std::vector<std::weak_ptr<GameObject>>	RendererRegistry::s_movedGameObjects;
+	bool						RendererRegistry::s_structureDirty = true;
+	uint32_t					RendererRegistry::s_structureVersion = 1;
+	bool						RendererRegistry::s_lodDirty = false;
+
+	inline bool AffectsRegistry(ComponentPtr const & component)
+	{
+		auto id = component->ClassID();
+		return IsSubClassOf<Renderer>(id) || IsSubClassOf<MeshFilter>(id) || id == ClassID<LODGroup>();
+	}
+
+	// go and its children, depth first
+	template<class Function>
+	void ForEachInHierarchy(GameObject const & go, Function && function)
+	{
+		function(go);
+		for (auto && child : go.transform()->children())
+		{
+			ForEachInHierarchy(*child->gameObject(), function);
+		}
+	}
+
+	void RendererRegistry::SetStateDirty(Renderer const & renderer)
+	{
+		const int32_t index = renderer.m_registryIndex;
+		if (index < 0 || s_stateDirty[index] != 0)
+			return;
+		s_stateDirty[index] = 1;
+		s_dirtyIndices.push_back(static_cast<uint32_t>(index));
+	}
+
+	void RendererRegistry::SetStateDirty(GameObject const & go)
+	{
+		ForEachInHierarchy(go, [](GameObject const & g) {
+			auto renderer = g.GetComponent<Renderer>();
+			if (renderer != nullptr)
+				SetStateDirty(*renderer);
+		});
+	}
+
+	void RendererRegistry::OnComponentAdded(ComponentPtr const & component)
+	{
+		if (!AffectsRegistry(component))
+			return;
+		++s_structureVersion;
+		s_addedComponents.push_back(component);
+	}
+
+	void RendererRegistry::OnComponentRemoved(ComponentPtr const & component)
+	{
+		if (!AffectsRegistry(component))
+			return;
+		++s_structureVersion;
+		auto id = component->ClassID();
+		if (IsSubClassOf<Renderer>(id))
+		{
+			auto & renderer = static_cast<Renderer&>(*component);
+			if (renderer.m_registryIndex >= 0)
+				Remove(static_cast<uint32_t>(renderer.m_registryIndex));
+		}
+		else if (id == ClassID<LODGroup>())
+		{
+			RemoveLODGroup(static_cast<LODGroup*>(component.get()));
+		}
+		else if (component->gameObject() != nullptr)
+		{
+			// the renderer next to it loses its mesh
+			auto renderer = component->gameObject()->GetComponent<Renderer>();
+			if (renderer != nullptr)
+				SetStateDirty(*renderer);
+		}
+	}
+
+	void RendererRegistry::OnHierarchyChanged(GameObjectPtr const & go)
+	{
+		++s_structureVersion;
+		s_movedGameObjects.push_back(go);
+	}
+
+	void RendererRegistry::OnGameObjectDestroyed(GameObject const & go)
+	{
+		++s_structureVersion;
+		auto renderer = go.GetComponent<Renderer>();
+		if (renderer != nullptr && renderer->m_registryIndex >= 0)
+			Remove(static_cast<uint32_t>(renderer->m_registryIndex));
+		auto lodGroup = go.GetComponent<LODGroup>();
+		if (lodGroup != nullptr)
+			RemoveLODGroup(lodGroup.get());
+	}
+
+	void RendererRegistry::Update()
+	{
+		if (s_structureDirty)
+		{
+			Rebuild();
+		}
+		else if (!s_addedComponents.empty() || !s_movedGameObjects.empty())
+		{
+			ApplyPendingChanges();
+		}
+
+		for (auto index : s_dirtyIndices)
+		{
+			// stale after a removal swapped the renderers
+			if (index < s_renderers.size() && s_stateDirty[index] != 0)
+				Refresh(index);
+		}
+		s_dirtyIndices.clear();
+		if (s_unusedMaterials > s_materials.size() / 2)
+			CompactMaterials();
+		if (s_lodDirty)
+			MapLODs();
+
+		const std::size_t count = s_renderers.size();
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			if ((s_flags[i] & Active) == 0)
+				continue;
+
+			auto & renderer = s_renderers[i];
+			MeshPtr mesh;
+			if (s_flags[i] & Skinned)
+			{
+				auto skinned = static_cast<SkinnedMeshRenderer*>(renderer.get());
+				mesh = skinned->sharedMesh();
+				if (mesh != nullptr)
+					skinned->UpdateBounds();
+			}
+			else if (s_meshFilters[i] != nullptr)
+				mesh = s_meshFilters[i]->mesh();
+
+			// the bounds of a skinned mesh follow its bones
+			const uint32_t version = renderer->transform()->version();
+			if (mesh != s_meshes[i] || version != s_transformVersions[i] || (s_flags[i] & Skinned))
+			{
+				s_meshes[i] = mesh;
+				s_worldBounds.Set(static_cast<uint32_t>(i), mesh == nullptr ? Bounds() : renderer->bounds());
+				s_transformVersions[i] = version;
+			}
+		}
+	}
+
+	void RendererRegistry::Rebuild()
+	{
+		for (auto & renderer : s_renderers)
+			renderer->m_registryIndex = -1;
+		s_renderers.clear();
+		s_meshFilters.clear();
+		s_meshes.clear();
+		s_flags.clear();
+		s_worldBounds.Clear();
+		s_materials.clear();
+		s_materialOffsets.clear();
+		s_materialCounts.clear();
+		s_transformVersions.clear();
+		s_stateDirty.clear();
+		s_dirtyIndices.clear();
+		s_lodFade.clear();
+		s_lodGroups.clear();
+		s_lodGroupIndex.clear();
+		s_lodMask.clear();
+		s_unusedMaterials = 0;
+		s_addedComponents.clear();
+		s_movedGameObjects.clear();
+
+		std::deque<GameObjectPtr> todo(Scene::GameObjects().begin(), Scene::GameObjects().end());
+		while (!todo.empty())
+		{
+			auto go = todo.front();
+			todo.pop_front();
+			for (auto && child : go->transform()->children())
+			{
+				todo.push_back(child->gameObject());
+			}
+
+			auto lodGroup = go->GetComponent<LODGroup>();
+			if (lodGroup != nullptr && std::find(s_lodGroups.begin(), s_lodGroups.end(), lodGroup) == s_lodGroups.end())
+				s_lodGroups.push_back(lodGroup);
+
+			RendererPtr renderer = go->GetComponent<Renderer>();
+			if (renderer != nullptr && renderer->m_registryIndex < 0)
+				Add(renderer);
+		}
+
+		s_structureDirty = false;
+		s_lodDirty = true;
+	}
+
+	// whether go or one of its parents is a game object of the scene
+	static bool InScene(GameObject const & go, std::unordered_set<GameObject const *> const & sceneGameObjects)
+	{
+		for (auto t = go.transform(); t != nullptr; t = t->parent())
+		{
+			if (sceneGameObjects.count(t->gameObject().get()) > 0)
+				return true;
+		}
+		return false;
+	}
+
+	void RendererRegistry::ApplyPendingChanges()
+	{
+		std::unordered_set<GameObject const *> sceneGameObjects;
+		for (auto & go : Scene::GameObjects())
+			sceneGameObjects.insert(go.get());
+
+		for (auto & weak_component : s_addedComponents)
+		{
+			auto component = weak_component.lock();
+			if (component == nullptr)
+				continue;
+			auto go = component->gameObject();
+			if (go == nullptr)
+				continue;
+			auto id = component->ClassID();
+			if (IsSubClassOf<Renderer>(id))
+			{
+				auto renderer = As<Renderer>(component);
+				// removed again, or not the one GetComponent<Renderer> finds
+				if (renderer->m_registryIndex < 0 && go->GetComponent<Renderer>() == renderer && InScene(*go, sceneGameObjects))
+					Add(renderer);
+			}
+			else if (id == ClassID<LODGroup>())
+			{
+				auto lodGroup = As<LODGroup>(component);
+				if (go->GetComponent<LODGroup>() == lodGroup && InScene(*go, sceneGameObjects)
+					&& std::find(s_lodGroups.begin(), s_lodGroups.end(), lodGroup) == s_lodGroups.end())
+				{
+					s_lodGroups.push_back(lodGroup);
+					s_lodDirty = true;
+				}
+			}
+			else
+			{
+				// the renderer next to it gets its mesh
+				auto renderer = go->GetComponent<Renderer>();
+				if (renderer != nullptr)
+					SetStateDirty(*renderer);
+			}
+		}
+		s_addedComponents.clear();
+
+		for (auto & weak_go : s_movedGameObjects)
+		{
+			auto moved = weak_go.lock();
+			if (moved == nullptr || moved->transform() == nullptr)
+				continue;
+			const bool inScene = InScene(*moved, sceneGameObjects);
+			ForEachInHierarchy(*moved, [inScene](GameObject const & go) {
+				auto renderer = go.GetComponent<Renderer>();
+				if (renderer != nullptr)
+				{
+					if (inScene && renderer->m_registryIndex < 0)
+						Add(renderer);
+					else if (!inScene && renderer->m_registryIndex >= 0)
+						Remove(static_cast<uint32_t>(renderer->m_registryIndex));
+				}
+				auto lodGroup = go.GetComponent<LODGroup>();
+				if (lodGroup != nullptr)
+				{
+					auto it = std::find(s_lodGroups.begin(), s_lodGroups.end(), lodGroup);
+					if (inScene && it == s_lodGroups.end())
+					{
+						s_lodGroups.push_back(lodGroup);
+						s_lodDirty = true;
+					}
+					else if (!inScene && it != s_lodGroups.end())
+						RemoveLODGroup(lodGroup.get());
+				}
+			});
+		}
+		s_movedGameObjects.clear();
+	}
+
+	void RendererRegistry::Add(RendererPtr const & renderer)
+	{
+		const auto index = static_cast<uint32_t>(s_renderers.size());
+		renderer->m_registryIndex = static_cast<int32_t>(index);
+		s_renderers.push_back(renderer);
+		s_meshFilters.push_back(nullptr);
+		s_meshes.push_back(nullptr);
+		s_flags.push_back(renderer->ClassID() == ClassID<SkinnedMeshRenderer>() ? Skinned : 0);
+		s_transformVersions.push_back(renderer->transform()->version());
+		s_worldBounds.Add(Bounds());
+		s_materialOffsets.push_back(static_cast<uint32_t>(s_materials.size()));
+		s_materialCounts.push_back(0);
+		s_stateDirty.push_back(0);
+		s_lodFade.push_back(1.0f);
+		s_lodGroupIndex.push_back(-1);
+		s_lodMask.push_back(0);
+		Refresh(index);
+
+		MeshPtr mesh;
+		if (s_flags[index] & Skinned)
+			mesh = As<SkinnedMeshRenderer>(renderer)->sharedMesh();
+		else if (s_meshFilters[index] != nullptr)
+			mesh = s_meshFilters[index]->mesh();
+		s_meshes[index] = mesh;
+		s_worldBounds.Set(index, mesh == nullptr ? Bounds() : renderer->bounds());
+		// it may be in a LOD of a group that is already mapped
+		if (!s_lodGroups.empty())
+			s_lodDirty = true;
+	}
+
+	void RendererRegistry::Remove(uint32_t index)
+	{
+		s_renderers[index]->m_registryIndex = -1;
+		s_unusedMaterials += s_materialCounts[index];
+
+		const auto last = static_cast<uint32_t>(s_renderers.size() - 1);
+		if (index != last)
+		{
+			s_renderers[index] = std::move(s_renderers[last]);
+			s_renderers[index]->m_registryIndex = static_cast<int32_t>(index);
+			s_meshFilters[index] = std::move(s_meshFilters[last]);
+			s_meshes[index] = std::move(s_meshes[last]);
+			s_flags[index] = s_flags[last];
+			s_transformVersions[index] = s_transformVersions[last];
+			s_materialOffsets[index] = s_materialOffsets[last];
+			s_materialCounts[index] = s_materialCounts[last];
+			s_lodFade[index] = s_lodFade[last];
+			s_lodGroupIndex[index] = s_lodGroupIndex[last];
+			s_lodMask[index] = s_lodMask[last];
+			// the index of the last one in s_dirtyIndices goes stale
+			s_stateDirty[index] = s_stateDirty[last];
+			if (s_stateDirty[index] != 0)
+				s_dirtyIndices.push_back(index);
+		}
+		s_worldBounds.RemoveSwapBack(index);
+		s_renderers.pop_back();
+		s_meshFilters.pop_back();
+		s_meshes.pop_back();
+		s_flags.pop_back();
+		s_transformVersions.pop_back();
+		s_materialOffsets.pop_back();
+		s_materialCounts.pop_back();
+		s_lodFade.pop_back();
+		s_lodGroupIndex.pop_back();
+		s_lodMask.pop_back();
+		s_stateDirty.pop_back();
+	}
+
+	void RendererRegistry::Refresh(uint32_t index)
+	{
+		Renderer const & renderer = *s_renderers[index];
+		uint8_t flags = s_flags[index] & Skinned;
+		if (renderer.enabled() && renderer.gameObject()->activeInHierarchy())
+			flags |= Active;
+		if (renderer.shadowCastingMode() != ShadowCastingMode::Off)
+			flags |= CastShadows;
+		s_flags[index] = flags;
+
+		// Update picks up the mesh of a new MeshFilter and its bounds
+		if ((flags & Skinned) == 0)
+			s_meshFilters[index] = renderer.gameObject()->GetComponent<MeshFilter>();
+
+		// overwrite the materials in place when their count is unchanged, append them otherwise
+		auto const & materials = renderer.materials();
+		const auto count = static_cast<uint32_t>(materials.size());
+		if (count != s_materialCounts[index])
+		{
+			s_unusedMaterials += s_materialCounts[index];
+			s_materialOffsets[index] = static_cast<uint32_t>(s_materials.size());
+			s_materialCounts[index] = count;
+			s_materials.resize(s_materials.size() + count);
+		}
+		std::copy(materials.begin(), materials.end(), s_materials.begin() + s_materialOffsets[index]);
+		s_stateDirty[index] = 0;
+	}
+
+	void RendererRegistry::CompactMaterials()
+	{
+		std::vector<MaterialPtr> materials;
+		materials.reserve(s_materials.size() - s_unusedMaterials);
+		for (std::size_t i = 0; i < s_renderers.size(); ++i)
+		{
+			auto first = s_materials.begin() + s_materialOffsets[i];
+			s_materialOffsets[i] = static_cast<uint32_t>(materials.size());
+			materials.insert(materials.end(), first, first + s_materialCounts[i]);
+		}
+		s_materials.swap(materials);
+		s_unusedMaterials = 0;
+	}
+
+	void RendererRegistry::RemoveLODGroup(LODGroup const * lodGroup)
+	{
+		auto it = std::find_if(s_lodGroups.begin(), s_lodGroups.end(), [lodGroup](LODGroupPtr const & g) {
+			return g.get() == lodGroup;
+		});
+		if (it == s_lodGroups.end())
+			return;
+		s_lodGroups.erase(it);
+		s_lodDirty = true;
+	}
+
+	// map the renderers to the LODs they are in
+	void RendererRegistry::MapLODs()
+	{
+		std::fill(s_lodGroupIndex.begin(), s_lodGroupIndex.end(), -1);
+		std::fill(s_lodMask.begin(), s_lodMask.end(), 0);
+		std::fill(s_lodFade.begin(), s_lodFade.end(), 1.0f);
+		for (std::size_t g = 0; g < s_lodGroups.size(); ++g)
+		{
+			auto const & lods = s_lodGroups[g]->GetLODs();
+			for (std::size_t level = 0; level < lods.size(); ++level)
+			{
+				for (auto const & weak_go : lods[level].gameObjects)
+				{
+					auto lodGo = weak_go.lock();
+					if (lodGo == nullptr)
+						continue;
+					auto renderer = lodGo->GetComponent<Renderer>();
+					if (renderer == nullptr || renderer->m_registryIndex < 0)
+						continue;
+					const int32_t index = renderer->m_registryIndex;
+					s_lodGroupIndex[index] = static_cast<int32_t>(g);
+					s_lodMask[index] |= static_cast<uint8_t>(1u << level);
+				}
+			}
+		}
+		s_lodDirty = false;
+	}
+
+	void RendererRegistry::UpdateLOD(Camera const & camera)
+	{
+		if (s_lodGroups.empty())
+			return;
+
+		// per group: the selected LOD and its fade
+		std::vector<int> levels(s_lodGroups.size());
+		std::vector<float> fades(s_lodGroups.size());
+		for (std::size_t g = 0; g < s_lodGroups.size(); ++g)
+		{
+			levels[g] = s_lodGroups[g]->SelectLOD(camera, fades[g]);
+		}
+
+		const std::size_t count = s_renderers.size();
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const int32_t g = s_lodGroupIndex[i];
+			if (g < 0)
+			{
+				s_lodFade[i] = 1.0f;
+				continue;
+			}
+			const int level = levels[g];
+			const float fade = fades[g];
+			const bool inCurrent = level < LODGroup::kMaxLODs && (s_lodMask[i] & (1u << level)) != 0;
+			const bool inNext = fade < 1.0f && level + 1 < LODGroup::kMaxLODs && (s_lodMask[i] & (1u << (level + 1))) != 0;
+			if (inCurrent && inNext)
+				s_lodFade[i] = 1.0f;
+			else if (inCurrent)
+				s_lodFade[i] = fade;
+			else if (inNext)
+				s_lodFade[i] = -(1.0f - fade);
+			else
+				s_lodFade[i] = 0.0f;
+		}
+	}
+}
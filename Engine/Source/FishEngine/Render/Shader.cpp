@@ -6,6 +6,10 @@
 #include <cassert>
 #include <set>
 #include <regex>
+#include <algorithm>
+#include <mutex>
+#include <deque>
+#include <unordered_map>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
@@ -15,6 +19,9 @@
 #include <FishEngine/Debug.hpp>
 #include <FishEngine/Pipeline.hpp>
 #include <FishEngine/ShaderCompiler.hpp>
+#include <FishEngine/Render/GLStateCache.hpp>
+#include <FishEngine/Render/ShaderCache.hpp>
+#include <FishEngine/Render/Shader/ShaderCompileError.hpp>
 
 //#include EnumHeader(CullFace)
 #include <FishEngine/Generated/Enum_Cullface.hpp>
@@ -24,8 +31,10 @@
 using namespace std;
 using namespace FishEngine;
 
+// The compile and link functions only issue the GL calls, the status is read by CheckShader / CheckProgram.
+// With GL_ARB_parallel_shader_compile the driver works in the background until then.
 GLuint
-CompileShader(
+CompileShaderAsync(
 	GLenum             shader_type,
 	const std::string& shader_str)
 {
@@ -34,6 +43,12 @@ CompileShader(
 	assert(shader > 0);
 	glShaderSource(shader, 1, &shader_c_str, NULL);
 	glCompileShader(shader);
+	return shader;
+}
+
+void
+CheckShader(GLuint shader)
+{
 	GLint success = GL_FALSE;
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
 	if (!success)
@@ -42,18 +57,16 @@ CompileShader(
 		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLogLength);
 		std::vector<char> infoLog(infoLogLength + 1);
 		glGetShaderInfoLog(shader, infoLogLength, NULL, infoLog.data());
-		throw std::runtime_error(infoLog.data());
+		throw ShaderInfoLogError(ShaderCompileStage::Compile, infoLog.data());
 	}
-	return shader;
-};
+}
 
 
 GLuint
-LinkShader(GLuint vs,
-	GLuint tcs,
-	GLuint tes,
+LinkProgramAsync(GLuint vs,
 	GLuint gs,
-	GLuint fs)
+	GLuint fs,
+	bool transformFeedback)
 {
 	glCheckError();
 	GLuint program = glCreateProgram();
@@ -61,12 +74,22 @@ LinkShader(GLuint vs,
 	glAttachShader(program, fs);
 	if (gs != 0)
 		glAttachShader(program, gs);
-	if (tes != 0) {
-		if (tcs != 0) glAttachShader(program, tcs);
-		glAttachShader(program, tes);
+	if (transformFeedback)
+	{
+		const char* const varyings[] = {"OutputPosition", "OutputNormal", "OutputTangent"};
+		glTransformFeedbackVaryings(program, 3, varyings, GL_SEPARATE_ATTRIBS);
 	}
+	if (ShaderCache::enabled())
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(program);
-	GLint success;
+	glCheckError();
+	return program;
+}
+
+void
+CheckProgram(GLuint program)
+{
+	GLint success = GL_FALSE;
 	glGetProgramiv(program, GL_LINK_STATUS, &success);
 	if (!success)
 	{
@@ -74,68 +97,78 @@ LinkShader(GLuint vs,
 		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLogLength);
 		std::vector<char> infoLog(infoLogLength + 1);
 		glGetProgramInfoLog(program, infoLogLength, NULL, infoLog.data());
-		throw std::runtime_error(infoLog.data());
+		throw ShaderInfoLogError(ShaderCompileStage::Link, infoLog.data());
 	}
+}
 
-	glDetachShader(program, vs);
-	glDetachShader(program, fs);
-	if (gs != 0) {
-		glDetachShader(program, gs);
+// the line number in a line of a GL info log, 0 if there is none
+uint32_t InfoLogLineNumber(std::string const & line)
+{
+#if FISHENGINE_PLATFORM_WINDOWS
+	auto begin = line.find_first_of('(');
+	auto end = line.find_first_of(')');
+#else
+	auto begin = line.find_first_of(':');
+	begin = line.find_first_of(':', begin + 1);
+	auto end = line.find_first_of(':', begin + 1);
+#endif
+	try
+	{
+		return boost::lexical_cast<uint32_t>(line.substr(begin + 1, end - begin - 1));
 	}
-	if (tes != 0) {
-		if (tcs != 0) glDetachShader(program, tcs);
-		glDetachShader(program, tes);
+	catch (exception const &)
+	{
+		return 0;
 	}
-
-	glCheckError();
-	return program;
 }
 
-GLuint
-LinkShader_tf(GLuint vs,
-		   GLuint tcs,
-		   GLuint tes,
-		   GLuint gs,
-		   GLuint fs)
+// one diagnostic per error line of an info log, the whole message if no line says "error"
+void AppendDiagnostics(std::vector<ShaderDiagnostic> & diagnostics, ShaderKeywords keywords, std::exception const & error)
 {
-	glCheckError();
-	GLuint program = glCreateProgram();
-	glAttachShader(program, vs);
-	glAttachShader(program, fs);
-	if (gs != 0)
-		glAttachShader(program, gs);
-	if (tes != 0) {
-		if (tcs != 0) glAttachShader(program, tcs);
-		glAttachShader(program, tes);
-	}
-	const char* const varyings[] = {"OutputPosition", "OutputNormal", "OutputTangent"};
-	glCheckError();
-	glTransformFeedbackVaryings(program, 3, varyings, GL_SEPARATE_ATTRIBS);
-	glCheckError();
-	glLinkProgram(program);
-	GLint success;
-	glGetProgramiv(program, GL_LINK_STATUS, &success);
-	if (!success)
+	ShaderDiagnostic diagnostic;
+	diagnostic.keywords = keywords;
+	if (auto e = dynamic_cast<ShaderInfoLogError const *>(&error))
+		diagnostic.stage = e->stage();
+	else if (auto e = dynamic_cast<ShaderCompileError const *>(&error))
 	{
-		GLint infoLogLength = 0;
-		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLogLength);
-		std::vector<char> infoLog(infoLogLength + 1);
-		glGetProgramInfoLog(program, infoLogLength, NULL, infoLog.data());
-		throw std::runtime_error(infoLog.data());
+		diagnostic.stage = e->stage();
+		diagnostic.lineNumber = e->lineNumber();
 	}
-	
-	glDetachShader(program, vs);
-	glDetachShader(program, fs);
-	if (gs != 0) {
-		glDetachShader(program, gs);
+
+	const std::string message = error.what();
+	const size_t count = diagnostics.size();
+	std::vector<std::string> lines;
+	boost::split(lines, message, boost::is_any_of("\n"));
+	for (auto & line : lines)
+	{
+		boost::trim_right(line);
+		if (!boost::icontains(line, "error"))
+			continue;
+		diagnostic.lineNumber = InfoLogLineNumber(line);
+		diagnostic.message = line;
+		diagnostics.push_back(diagnostic);
 	}
-	if (tes != 0) {
-		if (tcs != 0) glDetachShader(program, tcs);
-		glDetachShader(program, tes);
+	if (diagnostics.size() == count)
+	{
+		diagnostic.message = boost::trim_right_copy(message);
+		diagnostics.push_back(diagnostic);
 	}
-	
-	glCheckError();
-	return program;
+}
+
+bool ParallelCompileSupported()
+{
+#if defined(GL_ARB_parallel_shader_compile) && defined(__glew_h__)
+	// optional extension, called through GLEW directly instead of the GraphicsDevice table
+	static const bool supported = [] {
+		if (GraphicsDevice::isNull() || !GLEW_ARB_parallel_shader_compile)
+			return false;
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);	// as many as the driver likes
+		return true;
+	}();
+	return supported;
+#else
+	return false;
+#endif
 }
 
 std::string AddLineNumber(const std::string& str)
@@ -204,7 +237,12 @@ namespace FishEngine
 		{
 			for (auto& e : m_keywordToGLPrograms)
 			{
-				glDeleteProgram(e.second);
+				GLStateCache::DeleteProgram(e.second);
+			}
+			for (auto& p : m_pending)
+			{
+				DeleteShaders(p);
+				GLStateCache::DeleteProgram(p.program);
 			}
 		}
 
@@ -213,34 +251,115 @@ namespace FishEngine
 			m_shaderTextRaw = shaderText;
 		}
 
-		GLuint CompileAndLink(ShaderKeywords keywords)
+		// a variant that is being compiled, see BeginCompileAndLink
+		struct PendingProgram
+		{
+			ShaderKeywords  keywords = 0;
+			GLuint          program = 0;
+			GLuint          vs = 0;		// vs/gs/fs are 0 when the program was loaded from ShaderCache
+			GLuint          gs = 0;
+			GLuint          fs = 0;
+			uint64_t        cacheKey = 0;
+		};
+
+		// issue the compile and link of a variant without waiting for the driver
+		PendingProgram BeginCompileAndLink(ShaderKeywords keywords)
 		{
+			PendingProgram pending;
+			pending.keywords = keywords;
+			if (ShaderCache::enabled())
+			{
+				pending.cacheKey = ShaderCache::Key(m_shaderTextRaw, keywords, m_transformFeedback);
+				pending.program = ShaderCache::Load(pending.cacheKey);
+				if (pending.program != 0)
+					return pending;
+			}
+
 			//Debug::LogWarning("CompileAndLink %s", m_filePath.c_str());
-			auto vs = Compile(ShaderType::VertexShader, keywords);
-			GLuint gs = 0;
+			pending.vs = Compile(ShaderType::VertexShader, keywords);
 			if (m_hasGeometryShader)
-				gs = Compile(ShaderType::GeometryShader, keywords);
-			auto fs = Compile(ShaderType::FragmentShader, keywords);
-			//auto glsl_program = LinkShader(vs, 0, 0, gs, fs);
-			GLuint glsl_program = LinkShader(vs, 0, 0, gs, fs);
-			if (m_transformFeedback)
+				pending.gs = Compile(ShaderType::GeometryShader, keywords);
+			pending.fs = Compile(ShaderType::FragmentShader, keywords);
+			pending.program = LinkProgramAsync(pending.vs, pending.gs, pending.fs, m_transformFeedback);
+			return pending;
+		}
+
+		// false while the driver is still compiling the variant in the background
+		static bool IsReady(PendingProgram const & pending)
+		{
+			if (pending.vs == 0 || !ParallelCompileSupported())
+				return true;
+			GLint done = GL_TRUE;
+			glGetProgramiv(pending.program, GL_COMPLETION_STATUS_ARB, &done);
+			return done == GL_TRUE;
+		}
+
+		// wait for the variant and check it, throws the info log on errors
+		GLuint EndCompileAndLink(PendingProgram & pending)
+		{
+			if (pending.vs != 0)
 			{
-				glsl_program = LinkShader_tf(vs, 0, 0, gs, fs);
+				try
+				{
+					CheckShader(pending.vs);
+					if (pending.gs != 0)
+						CheckShader(pending.gs);
+					CheckShader(pending.fs);
+					CheckProgram(pending.program);
+				}
+				catch (...)
+				{
+					DeleteShaders(pending);
+					GLStateCache::DeleteProgram(pending.program);
+					throw;
+				}
+				DeleteShaders(pending);
+				if (pending.cacheKey != 0)
+				{
+					ShaderCache::Store(pending.cacheKey, pending.program);
+				}
 			}
-			else
+			m_keywordToGLPrograms[pending.keywords] = pending.program;
+			GetAllUniforms(pending.program);
+			glCheckError();
+			return pending.program;
+		}
+
+		GLuint CompileAndLink(ShaderKeywords keywords)
+		{
+			auto pending = BeginCompileAndLink(keywords);
+			return EndCompileAndLink(pending);
+		}
+
+		bool HasProgram(ShaderKeywords keywords) const
+		{
+			return m_keywordToGLPrograms.find(keywords) != m_keywordToGLPrograms.end();
+		}
+
+		bool IsPending(ShaderKeywords keywords) const
+		{
+			for (auto const & p : m_pending)
 			{
-				glsl_program = LinkShader(vs, 0, 0, gs, fs);
+				if (p.keywords == keywords)
+					return true;
+			}
+			return false;
+		}
+
+		static void DeleteShaders(PendingProgram & pending)
+		{
+			for (GLuint * shader : { &pending.vs, &pending.gs, &pending.fs })
+			{
+				if (*shader != 0)
+				{
+					glDetachShader(pending.program, *shader);
+					glDeleteShader(*shader);
+					*shader = 0;
+				}
 			}
-			m_keywordToGLPrograms[keywords] = glsl_program;
-			GetAllUniforms(glsl_program);
-			glDeleteShader(vs);
-			glDeleteShader(fs);
-			if (gs != 0) glDeleteShader(gs);
-			glCheckError();
-			return glsl_program;
 		}
 
-		GLuint glslProgram(ShaderKeywords keywords, std::vector<UniformInfo>& uniforms)
+		GLuint glslProgram(ShaderKeywords keywords, std::vector<UniformInfo>& uniforms, GLint& materialBlockSize)
 		{
 			GLuint program = 0;
 			auto it = m_keywordToGLPrograms.find(keywords);
@@ -250,9 +369,21 @@ namespace FishEngine
 			}
 			else
 			{
-				program = CompileAndLink(keywords);
+				auto pending = std::find_if(m_pending.begin(), m_pending.end(), [keywords](PendingProgram const & p) { return p.keywords == keywords; });
+				if (pending != m_pending.end())
+				{
+					// still warming up, wait for it
+					auto p = *pending;
+					m_pending.erase(pending);
+					program = EndCompileAndLink(p);
+				}
+				else
+				{
+					program = CompileAndLink(keywords);
+				}
 			}
 			uniforms = m_GLProgramToUniforms[program];
+			materialBlockSize = m_GLProgramToMaterialBlockSize[program];
 			return program;
 		}
 
@@ -272,6 +403,8 @@ namespace FishEngine
 		std::map<ShaderKeywords, GLuint>    m_keywordToGLPrograms;
 		std::map<GLuint, std::vector<UniformInfo>>
 			m_GLProgramToUniforms;
+		std::map<GLuint, GLint>				m_GLProgramToMaterialBlockSize;		// 0: no MaterialUniforms block
+		std::vector<PendingProgram>			m_pending;		// started by Shader::BeginWarmup
 		int m_renderQueue = -1;
 
 
@@ -311,10 +444,14 @@ namespace FishEngine
 			{
 				add_macro_definition("_AMBIENT_IBL");
 			}
+			if (keywords & static_cast<ShaderKeywords>(ShaderKeyword::Instancing))
+			{
+				add_macro_definition("_INSTANCING");
+			}
 
 			text += m_shaderTextRaw;
 
-			return CompileShader(t, text);
+			return CompileShaderAsync(t, text);
 		}
 
 		void GetAllUniforms(GLuint program) noexcept
@@ -362,6 +499,16 @@ namespace FishEngine
 				assert(blockSize == sizeof(Bones));
 			}
 
+			// per-material values, see Material::BindProperties
+			GLuint materialBlockID = glGetUniformBlockIndex(program, "MaterialUniforms");
+			GLint materialBlockSize = 0;
+			if (materialBlockID != GL_INVALID_INDEX)
+			{
+				glUniformBlockBinding(program, materialBlockID, Pipeline::MaterialUBOBindingPoint);
+				glGetActiveUniformBlockiv(program, materialBlockID, GL_UNIFORM_BLOCK_DATA_SIZE, &materialBlockSize);
+			}
+			m_GLProgramToMaterialBlockSize[program] = materialBlockSize;
+
 			GLint count;
 			GLint size; // size of the variable
 			GLenum type; // type of the variable (float, vec3 or mat4, etc)
@@ -382,11 +529,14 @@ namespace FishEngine
 					UniformInfo u;
 					u.type = type;
 					u.name = name;
+					u.nameID = Shader::PropertyToID(boost::ends_with(u.name, "[0]") ? u.name.substr(0, u.name.size() - 3) : u.name);
 					u.location = loc;
 					if (UniformIsTexture(type))
 					{
 						u.textureBindPoint = texture_count;
 						texture_count++;
+						// sampler -> texture unit is program state, set it once after linking
+						glProgramUniform1i(program, loc, u.textureBindPoint);
 					}
 					else {
 						u.textureBindPoint = -1;
@@ -394,6 +544,27 @@ namespace FishEngine
 					u.binded = false;
 					uniforms.emplace_back(u);
 				}
+				else if (materialBlockID != GL_INVALID_INDEX)
+				{
+					const GLuint index = static_cast<GLuint>(i);
+					GLint block = -1;
+					glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &block);
+					if (block != static_cast<GLint>(materialBlockID))
+						continue;
+					UniformInfo u;
+					u.type = type;
+					u.name = name;
+					u.nameID = Shader::PropertyToID(u.name);
+					u.location = GL_INVALID_INDEX;
+					u.textureBindPoint = -1;
+					u.binded = false;
+					GLint rowMajor = 0;
+					glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_OFFSET, &u.blockOffset);
+					glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_MATRIX_STRIDE, &u.matrixStride);
+					glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_IS_ROW_MAJOR, &rowMajor);
+					u.rowMajor = rowMajor != 0;
+					uniforms.emplace_back(u);
+				}
 			}
 			m_GLProgramToUniforms[program] = uniforms;
 		}
@@ -407,6 +578,7 @@ namespace FishEngine
 {
 
 	std::map<std::string, ShaderPtr> Shader::m_builtinShaders;
+	std::vector<std::weak_ptr<Shader>> Shader::s_loadedShaders;
 
 	Shader::Shader()
 	{
@@ -417,9 +589,29 @@ namespace FishEngine
 	{
 		LogInfo("Compiling " + path.string());
 		auto s = MakeShared<Shader>();
-		if (s->FromFile(path))
-			return s;
-		return nullptr;
+		if (!s->FromFile(path))
+			return nullptr;
+		s_loadedShaders.push_back(s);
+		return s;
+	}
+
+	ShaderPtr Shader::CreateFromPreprocessed(ShaderCompiler const & compiler, std::string const & parsedShaderText,
+		std::vector<ShaderDiagnostic>* diagnostics)
+	{
+		auto s = MakeShared<Shader>();
+		try
+		{
+			s->FromPreprocessed(compiler, parsedShaderText);
+		}
+		catch (const std::exception& e)
+		{
+			s->PrintErrorMessage(e.what());
+			if (diagnostics != nullptr)
+				AppendDiagnostics(*diagnostics, 0, e);
+			return nullptr;
+		}
+		s_loadedShaders.push_back(s);
+		return s;
 	}
 
 	bool Shader::FromFile(const Path& path)
@@ -427,28 +619,8 @@ namespace FishEngine
 		try
 		{
 			ShaderCompiler compiler(path);
-			if (path.stem() == "Internal-GPUSkinning")
-			{
-				m_impl->m_transformFeedback = true;
-			}
 			std::string parsed_shader_text = compiler.Preprocess();
-			std::map<std::string, std::string> settings = compiler.m_settings;
-			m_impl->m_hasGeometryShader = compiler.m_hasGeometryShader;
-			m_cullface = ToEnum<Cullface>(Capitalize(GetValueOrDefault<string, string>(settings, "cull", "back")));
-			m_ZWrite = GetValueOrDefault<string, string>(settings, "zwrite", "on") == "on";
-			//m_blend = GetValueOrDefault<string, string>(settings, "blend", "off") == "on";
-			m_deferred = GetValueOrDefault<string, string>(settings, "deferred", "off") == "on";
-			m_blend = compiler.m_blendEnabled;
-			m_blendFactorCount = compiler.m_blendFactorCount;
-			for (int i = 0; i < m_blendFactorCount; ++i)
-			{
-				m_blendFactors[i] = compiler.m_blendFactors[i];
-			}
-			m_savedProperties = compiler.m_savedProperties;
-
-			m_impl->set(parsed_shader_text);
-			//m_impl->CompileAndLink(m_keywords);
-			//m_GLNativeProgram = m_impl->glslProgram(m_keywords, m_uniforms);
+			FromPreprocessed(compiler, parsed_shader_text);
 		}
 		catch (const std::exception& e)
 		{
@@ -458,6 +630,42 @@ namespace FishEngine
 		return true;
 	}
 
+	void Shader::FromPreprocessed(ShaderCompiler const & compiler, std::string const & parsedShaderText)
+	{
+		auto const & path = compiler.m_path;
+		if (path.stem() == "Internal-GPUSkinning")
+		{
+			m_impl->m_transformFeedback = true;
+		}
+		auto const & settings = compiler.m_settings;
+		m_impl->m_hasGeometryShader = compiler.m_hasGeometryShader;
+		m_cullface = ToEnum<Cullface>(Capitalize(GetValueOrDefault<string, string>(settings, "cull", "back")));
+		m_ZWrite = GetValueOrDefault<string, string>(settings, "zwrite", "on") == "on";
+		//m_blend = GetValueOrDefault<string, string>(settings, "blend", "off") == "on";
+		m_deferred = GetValueOrDefault<string, string>(settings, "deferred", "off") == "on";
+		const bool surfaceShader = path.extension() == ".surf";
+		m_instancing = GetValueOrDefault<string, string>(settings, "instancing", surfaceShader ? "on" : "off") == "on";
+		m_lodFade = GetValueOrDefault<string, string>(settings, "lodfade", "off") == "on";
+		// a keyword that no #if tests compiles to the same program
+		auto & tested = compiler.m_testedMacros;
+		m_variantKeywords = 0;
+		if (tested.count("_AMBIENT_IBL") > 0)
+			m_variantKeywords |= static_cast<ShaderKeywords>(ShaderKeyword::AmbientIBL);
+		if (m_instancing && tested.count("_INSTANCING") > 0)
+			m_variantKeywords |= static_cast<ShaderKeywords>(ShaderKeyword::Instancing);
+		m_blend = compiler.m_blendEnabled;
+		m_blendFactorCount = compiler.m_blendFactorCount;
+		for (int i = 0; i < m_blendFactorCount; ++i)
+		{
+			m_blendFactors[i] = compiler.m_blendFactors[i];
+		}
+		m_savedProperties = compiler.m_savedProperties;
+
+		m_impl->set(parsedShaderText);
+		//m_impl->CompileAndLink(m_keywords);
+		//m_GLNativeProgram = m_impl->glslProgram(m_keywords, m_uniforms, m_materialBlockSize);
+	}
+
 	void Shader::PrintErrorMessage(std::string const & errorMessage) noexcept
 	{
 		LogError(errorMessage);
@@ -466,23 +674,9 @@ namespace FishEngine
 		boost::split(lines, errorMessage, boost::is_any_of("\n"));
 		for (auto & line : lines)
 		{
-#if FISHENGINE_PLATFORM_WINDOWS
-			auto begin = line.find_first_of('(');
-			auto end = line.find_first_of(')');
-#else
-			auto begin = line.find_first_of(':');
-			begin = line.find_first_of(':', begin + 1);
-			auto end = line.find_first_of(':', begin + 1);
-#endif
-			uint32_t line_number = 0;
-			try
-			{
-				line_number = boost::lexical_cast<uint32_t>(line.substr(begin + 1, end - begin - 1));
-			}
-			catch(exception const &)
-			{
+			uint32_t line_number = InfoLogLineNumber(line);
+			if (line_number == 0)
 				continue;
-			}
 			//cout << line_number << endl;
 			uint32_t start_line = m_impl->m_lineCount;
 			auto& text = m_impl->shaderTextRaw();
@@ -525,78 +719,133 @@ namespace FishEngine
 		if (m_GLNativeProgram == 0)
 		{
 			try {
-				m_impl->CompileAndLink(m_keywords);
-				m_GLNativeProgram = m_impl->glslProgram(m_keywords, m_uniforms);
+				// compiles the variant unless it has been warmed up
+				m_GLNativeProgram = m_impl->glslProgram(m_keywords, m_uniforms, m_materialBlockSize);
 			}
 			catch (const std::exception & e)
 			{
 				PrintErrorMessage(e.what());
+				AppendDiagnostics(m_diagnostics, m_keywords, e);
 				m_GLNativeProgram = 0;
 			}
 		}
 		//if (m_GLNativeProgram == 0)
 		//	abort();
 		//assert(m_GLNativeProgram != 0);
-		glUseProgram(m_GLNativeProgram);
-		for (auto& u : m_uniforms)
+		GLStateCache::UseProgram(m_GLNativeProgram);
+	}
+
+	namespace
+	{
+		struct PropertyNames
 		{
-			if (u.textureBindPoint >= 0)
-			{
-				glProgramUniform1i(m_GLNativeProgram, u.location, u.textureBindPoint);
-			}
+			std::mutex								mutex;
+			std::unordered_map<std::string, int>	nameToID;
+			std::deque<std::string>					names;		// stable references
+		};
+
+		// function static: ids may be requested from the static initialization of other files
+		PropertyNames & propertyNames()
+		{
+			static PropertyNames names;
+			return names;
 		}
 	}
 
-	bool Shader::HasUniform(const std::string& name)
+	int Shader::PropertyToID(const std::string& name)
 	{
-		for (auto& u : m_uniforms)
+		auto & table = propertyNames();
+		std::lock_guard<std::mutex> lock(table.mutex);
+		auto it = table.nameToID.find(name);
+		if (it != table.nameToID.end())
+			return it->second;
+		const int id = static_cast<int>(table.names.size());
+		table.names.push_back(name);
+		table.nameToID.emplace(name, id);
+		return id;
+	}
+
+	const std::string& Shader::PropertyIDToName(int nameID)
+	{
+		auto & table = propertyNames();
+		std::lock_guard<std::mutex> lock(table.mutex);
+		assert(nameID >= 0 && nameID < static_cast<int>(table.names.size()));
+		return table.names[nameID];
+	}
+
+	int Shader::FindUniform(int nameID) const
+	{
+		const int count = static_cast<int>(m_uniforms.size());
+		for (int i = 0; i < count; ++i)
 		{
-			if (u.name == name)
-				return true;
+			if (m_uniforms[i].nameID == nameID)
+				return i;
 		}
-		return false;
+		return -1;
+	}
+
+	bool Shader::HasUniform(const std::string& name)
+	{
+		return HasUniform(PropertyToID(name));
+	}
+
+	bool Shader::HasUniform(int nameID)
+	{
+		return FindUniform(nameID) >= 0;
 	}
 
 	void Shader::BindUniformVec4(const char* name, const Vector4& value)
 	{
-		for (auto& u : m_uniforms)
+		BindUniformVec4(PropertyToID(name), value);
+	}
+
+	void Shader::BindUniformVec4(int nameID, const Vector4& value)
+	{
+		int i = FindUniform(nameID);
+		if (i < 0)
 		{
-			if (u.name == name)
-			{
-				glProgramUniform4fv(m_GLNativeProgram, u.location, 1, value.data());
-				u.binded = true;
-				return; 
-			}
+			LogWarning(Format("Uniform %1% not found!", PropertyIDToName(nameID)));
+			return;
 		}
-		LogWarning(Format( "Uniform %1% not found!", name ));
+		auto& u = m_uniforms[i];
+		glProgramUniform4fv(m_GLNativeProgram, u.location, 1, value.data());
+		u.binded = true;
 	}
 
 	void Shader::BindUniformMat4(const char* name, const Matrix4x4& value)
 	{
-		for (auto& u : m_uniforms)
+		BindUniformMat4(PropertyToID(name), value);
+	}
+
+	void Shader::BindUniformMat4(int nameID, const Matrix4x4& value)
+	{
+		int i = FindUniform(nameID);
+		if (i < 0)
 		{
-			if (boost::starts_with(u.name, name))
-			{
-				glProgramUniformMatrix4fv(m_GLNativeProgram, u.location, 1, GL_TRUE, value.data());
-				u.binded = true;
-				return;
-			}
+			LogWarning(Format("Uniform %1% not found!", PropertyIDToName(nameID)));
+			return;
 		}
-		LogWarning(Format("Uniform %1% not found!", name));
+		auto& u = m_uniforms[i];
+		glProgramUniformMatrix4fv(m_GLNativeProgram, u.location, 1, GL_TRUE, value.data());
+		u.binded = true;
 	}
 
 	void Shader::BindMatrixArray(const std::string& name, const std::vector<Matrix4x4>& matrixArray)
 	{
-		for (auto& u : m_uniforms)
+		BindMatrixArray(PropertyToID(name), matrixArray);
+	}
+
+	void Shader::BindMatrixArray(int nameID, const std::vector<Matrix4x4>& matrixArray)
+	{
+		int i = FindUniform(nameID);
+		if (i < 0)
 		{
-			if (boost::starts_with(u.name, name))
-			{
-				glProgramUniformMatrix4fv(m_GLNativeProgram, u.location, static_cast<GLsizei>(matrixArray.size()), GL_TRUE, matrixArray.data()->data());
-				u.binded = true;
-				return;
-			}
+			LogWarning(Format("Uniform %1% not found!", PropertyIDToName(nameID)));
+			return;
 		}
-		LogWarning(Format("Uniform %1% not found!", name));
+		auto& u = m_uniforms[i];
+		glProgramUniformMatrix4fv(m_GLNativeProgram, u.location, static_cast<GLsizei>(matrixArray.size()), GL_TRUE, matrixArray.data()->data());
+		u.binded = true;
 	}
 
 	void Shader::BindUniforms(const ShaderUniforms& uniforms)
@@ -686,9 +935,7 @@ namespace FishEngine
 				else if (u.type == GL_SAMPLER_2D_ARRAY || u.type == GL_SAMPLER_2D_ARRAY_SHADOW)
 					type = GL_TEXTURE_2D_ARRAY;
 				//BindUniformTexture(u.name.c_str(), it->second->GLTexuture(), texture_id, type);
-				glActiveTexture(GLenum(GL_TEXTURE0 + u.textureBindPoint));
-				glCheckError();
-				glBindTexture(type, it->second->GetNativeTexturePtr());
+				GLStateCache::BindTexture(u.textureBindPoint, type, it->second->GetNativeTexturePtr());
 				u.binded = true;
 				glCheckError();
 			}
@@ -732,21 +979,21 @@ namespace FishEngine
 	{
 		if (m_cullface == Cullface::Off)
 		{
-			glDisable(GL_CULL_FACE);
+			GLStateCache::SetCullFace(false);
 		}
 		else
 		{
-			glCullFace((GLenum)m_cullface);
+			GLStateCache::SetCullFace(true, (GLenum)m_cullface);
 		}
-		glDepthMask(m_ZWrite);
+		GLStateCache::SetDepthMask(m_ZWrite);
 		if (m_blend)
 		{
-			glEnable(GL_BLEND);
+			GLStateCache::SetBlend(true);
 			if (m_blendFactorCount == 2)
 			{
 				auto f1 = ShaderBlendFactorToGL(m_blendFactors[0]);
 				auto f2 = ShaderBlendFactorToGL(m_blendFactors[1]);
-				glBlendFunc(f1, f2);
+				GLStateCache::SetBlendFunc(f1, f2);
 			}
 			else
 			{
@@ -755,19 +1002,17 @@ namespace FishEngine
 				auto f3 = ShaderBlendFactorToGL(m_blendFactors[2]);
 				auto f4 = ShaderBlendFactorToGL(m_blendFactors[3]);
 				//glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-				glBlendFuncSeparate(f1, f2, f3, f4);
+				GLStateCache::SetBlendFuncSeparate(f1, f2, f3, f4);
 			}
 		}
 	}
 
+	// restore the default state; through the cache this is free for shaders that use the defaults
 	void Shader::PostRender() const
 	{
-		glDepthMask(GL_TRUE);
-		if (m_cullface == Cullface::Off)
-			glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
-		if (m_blend)
-			glDisable(GL_BLEND);
+		GLStateCache::SetDepthMask(true);
+		GLStateCache::SetCullFace(true, GL_BACK);
+		GLStateCache::SetBlend(false);
 	}
 
 	void Shader::CheckStatus() const
@@ -793,6 +1038,95 @@ namespace FishEngine
 		return nullptr;
 	}
 
+	ShaderKeywords Shader::variantKeywords() const
+	{
+		return m_variantKeywords;
+	}
+
+	bool Shader::BeginWarmup(ShaderKeywords keywords)
+	{
+		if (m_impl->HasProgram(keywords) || m_impl->IsPending(keywords))
+			return false;
+		try
+		{
+			m_impl->m_pending.push_back(m_impl->BeginCompileAndLink(keywords));
+		}
+		catch (const std::exception & e)
+		{
+			PrintErrorMessage(e.what());
+			AppendDiagnostics(m_diagnostics, keywords, e);
+			return false;
+		}
+		return true;
+	}
+
+	bool Shader::EndWarmup(bool wait)
+	{
+		auto & pending = m_impl->m_pending;
+		for (size_t i = 0; i < pending.size(); )
+		{
+			if (!wait && !ShaderImpl::IsReady(pending[i]))
+			{
+				++i;
+				continue;
+			}
+			auto p = pending[i];
+			pending.erase(pending.begin() + i);
+			try
+			{
+				m_impl->EndCompileAndLink(p);
+			}
+			catch (const std::exception & e)
+			{
+				PrintErrorMessage(e.what());
+				AppendDiagnostics(m_diagnostics, p.keywords, e);
+			}
+		}
+		return pending.empty();
+	}
+
+	bool Shader::HasVariant(ShaderKeywords keywords) const
+	{
+		return m_impl->HasProgram(keywords);
+	}
+
+	bool Shader::Warmup(ShaderKeywords keywords)
+	{
+		if (!BeginWarmup(keywords))
+			return false;
+		EndWarmup(true);
+		return true;
+	}
+
+	void Shader::WarmupAllShaders()
+	{
+		std::vector<ShaderPtr> shaders;
+		shaders.reserve(s_loadedShaders.size());
+		for (auto & s : s_loadedShaders)
+		{
+			if (auto shader = s.lock())
+				shaders.push_back(std::move(shader));
+		}
+		s_loadedShaders.assign(shaders.begin(), shaders.end());	// drop the expired ones
+
+		// start every variant first, so that a driver with parallel compile can work on all of them at once
+		int count = 0;
+		for (auto & shader : shaders)
+		{
+			const ShaderKeywords mask = shader->variantKeywords();
+			for (ShaderKeywords keywords = mask; ; keywords = (keywords - 1) & mask)
+			{
+				if (shader->BeginWarmup(keywords))
+					count++;
+				if (keywords == 0)
+					break;
+			}
+		}
+		for (auto & shader : shaders)
+			shader->EndWarmup(true);
+		LogInfo(Format("Shader::WarmupAllShaders: %1% variants of %2% shaders", count, shaders.size()));
+	}
+
 	void Shader::SetLocalKeywords(ShaderKeyword keyword, bool value)
 	{
 		auto k = static_cast<ShaderKeywords>(keyword);
@@ -808,14 +1142,18 @@ namespace FishEngine
 
 	void Shader::EnableLocalKeywords(ShaderKeywords keyword)
 	{
+		if ((m_keywords & keyword) == keyword)
+			return;
 		m_keywords |= keyword;
-		m_GLNativeProgram = m_impl->glslProgram(m_keywords, m_uniforms);
+		m_GLNativeProgram = m_impl->glslProgram(m_keywords, m_uniforms, m_materialBlockSize);
 	}
 
 	void Shader::DisableLocalKeywords(ShaderKeywords keyword)
 	{
+		if ((m_keywords & keyword) == 0)
+			return;
 		m_keywords &= ~keyword;
-		m_GLNativeProgram = m_impl->glslProgram(m_keywords, m_uniforms);
+		m_GLNativeProgram = m_impl->glslProgram(m_keywords, m_uniforms, m_materialBlockSize);
 	}
 
 	int Shader::renderQueue()
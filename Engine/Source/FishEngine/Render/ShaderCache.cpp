@@ -0,0 +1,204 @@
+#include <FishEngine/Render/ShaderCache.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#include <FishEngine/Debug.hpp>
+#include <FishEngine/Render/GraphicsDevice.hpp>
+#include <FishEngine/Render/GLStateCache.hpp>
+
+namespace FishEngine
+{
+	Path				ShaderCache::s_directory;
+	bool				ShaderCache::s_enabled = false;
+	ShaderCacheCounters	ShaderCache::s_counters;
+
+	namespace
+	{
+		constexpr uint32_t kMagic = 0x42504546;	// "FEPB"
+		constexpr uint32_t kVersion = 1;
+
+		struct EntryHeader
+		{
+			uint32_t	magic;
+			uint32_t	version;
+			uint64_t	key;
+			uint32_t	format;		// binaryFormat of glGetProgramBinary
+			uint32_t	length;
+		};
+
+		// FNV-1a
+		inline uint64_t Hash(const void* data, std::size_t size, uint64_t hash = 14695981039346656037ull)
+		{
+			auto bytes = static_cast<const uint8_t*>(data);
+			for (std::size_t i = 0; i < size; ++i)
+			{
+				hash ^= bytes[i];
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+
+		inline std::string GLString(GLenum name)
+		{
+			auto str = glGetString(name);
+			return str == nullptr ? std::string() : std::string(reinterpret_cast<const char*>(str));
+		}
+
+		// a binary is only valid for the driver that created it
+		uint64_t DriverHash()
+		{
+			static const uint64_t hash = [] {
+				const std::string driver = GLString(GL_VENDOR) + "\n" + GLString(GL_RENDERER) + "\n" + GLString(GL_VERSION);
+				return Hash(driver.data(), driver.size());
+			}();
+			return hash;
+		}
+
+		Path EntryPath(Path const & directory, uint64_t key)
+		{
+			char name[32];
+			std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+			return directory / name;
+		}
+	}
+
+	void ShaderCache::Init(Path const & directory)
+	{
+		s_enabled = false;
+		s_directory = directory;
+		boost::system::error_code error;
+		boost::filesystem::create_directories(directory, error);
+		if (error)
+		{
+			LogWarning(Format("ShaderCache: can not create %1%, cache disabled", directory.string()));
+			return;
+		}
+		s_enabled = true;
+	}
+
+	Path ShaderCache::DefaultDirectory()
+	{
+		return boost::filesystem::temp_directory_path() / "FishEngine" / "ShaderCache";
+	}
+
+	bool ShaderCache::enabled()
+	{
+		if (!s_enabled || GraphicsDevice::isNull())
+			return false;
+		static const bool supported = [] {
+			GLint formatCount = 0;
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+			if (formatCount <= 0)
+				LogWarning("ShaderCache: the driver supports no program binary format, cache disabled");
+			return formatCount > 0;
+		}();
+		return supported;
+	}
+
+	uint64_t ShaderCache::Key(std::string const & source, uint32_t keywords, bool transformFeedback)
+	{
+		uint64_t key = Hash(source.data(), source.size());
+		key = Hash(&keywords, sizeof(keywords), key);
+		const uint8_t tf = transformFeedback ? 1 : 0;
+		key = Hash(&tf, sizeof(tf), key);
+		const uint64_t driver = DriverHash();
+		return Hash(&driver, sizeof(driver), key);
+	}
+
+	GLuint ShaderCache::Load(uint64_t key)
+	{
+		const Path path = EntryPath(s_directory, key);
+		std::ifstream file(path.string(), std::ios::binary);
+		EntryHeader header;
+		if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+		{
+			s_counters.misses++;
+			return 0;
+		}
+
+		std::vector<char> binary;
+		bool valid = header.magic == kMagic && header.version == kVersion && header.key == key && header.length > 0;
+		if (valid)
+		{
+			binary.resize(header.length);
+			valid = static_cast<bool>(file.read(binary.data(), header.length));
+		}
+		file.close();
+
+		GLuint program = 0;
+		if (valid)
+		{
+			program = glCreateProgram();
+			glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+			GLint success = GL_FALSE;
+			glGetProgramiv(program, GL_LINK_STATUS, &success);
+			if (!success)
+			{
+				GLStateCache::DeleteProgram(program);
+				program = 0;
+			}
+			// an unknown binaryFormat raises GL_INVALID_ENUM, it is handled here.
+			// the drain is bounded: a lost context keeps reporting GL_CONTEXT_LOST
+			for (int i = 0; i < 8 && glGetError() != GL_NO_ERROR; ++i) { }
+		}
+
+		if (program == 0)
+		{
+			LogInfo(Format("ShaderCache: %1% rejected, compile from source", path.filename().string()));
+			boost::system::error_code error;
+			boost::filesystem::remove(path, error);
+			s_counters.rejected++;
+			return 0;
+		}
+		s_counters.hits++;
+		return program;
+	}
+
+	void ShaderCache::Store(uint64_t key, GLuint program)
+	{
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+		std::vector<char> binary(length);
+		GLenum format = 0;
+		glGetProgramBinary(program, length, &length, &format, binary.data());
+
+		EntryHeader header;
+		header.magic = kMagic;
+		header.version = kVersion;
+		header.key = key;
+		header.format = format;
+		header.length = static_cast<uint32_t>(length);
+
+		// write to a temporary file first, a crash must not leave a truncated entry behind
+		const Path path = EntryPath(s_directory, key);
+		Path temp = path;
+		temp += ".tmp";
+		{
+			std::ofstream file(temp.string(), std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(binary.data(), length);
+			if (!file)
+			{
+				LogWarning(Format("ShaderCache: can not write %1%", temp.string()));
+				return;
+			}
+		}
+		boost::system::error_code error;
+		boost::filesystem::rename(temp, path, error);
+		if (error)
+		{
+			boost::filesystem::remove(temp, error);
+			return;
+		}
+		s_counters.stored++;
+	}
+
+	const ShaderCacheCounters & ShaderCache::counters()
+	{
+		return s_counters;
+	}
+}
@@ -2,6 +2,9 @@
 
 #include <iostream>
 #include <cctype>
+#include <ctime>
+#include <mutex>
+#include <unordered_map>
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
 
@@ -28,12 +31,20 @@ static std::string ReadFile(const FishEngine::Path& path)
 }
 
 
-std::string nextTok(const std::string &shaderText, size_t& cursor)
+typedef boost::string_view StringView;
+
+inline void Append(std::string & text, StringView str)
+{
+	text.append(str.data(), str.size());
+}
+
+// tokens are views into shaderText, nothing is allocated
+StringView nextTok(StringView shaderText, size_t& cursor)
 {
 	size_t start = cursor;
 	size_t end = shaderText.size();
 	
-	string test = shaderText.substr(start, 2);
+	StringView test = shaderText.substr(start, 2);
 	if (test == "//" || test == "/*" || test == "*/")
 	{
 		return test;
@@ -45,11 +56,11 @@ std::string nextTok(const std::string &shaderText, size_t& cursor)
 		cursor += 8;
 		return test;
 	}
-	bool first_is_space = (std::isspace(shaderText[start]) != 0);
+	bool first_is_space = (std::isspace(static_cast<unsigned char>(shaderText[start])) != 0);
 	while (cursor < end)
 	{
 		char c = shaderText[cursor];
-		bool is_space = (std::isspace(c) != 0);
+		bool is_space = (std::isspace(static_cast<unsigned char>(c)) != 0);
 		if ((first_is_space && !is_space) ||
 			(!first_is_space && is_space))
 			break;
@@ -60,7 +71,7 @@ std::string nextTok(const std::string &shaderText, size_t& cursor)
 	return shaderText.substr(start, cursor - start);
 }
 
-void readToNewline(const std::string& shaderText, size_t& cursor)
+void readToNewline(StringView shaderText, size_t& cursor)
 {
 	for (; cursor < shaderText.size(); cursor++)
 	{
@@ -69,13 +80,13 @@ void readToNewline(const std::string& shaderText, size_t& cursor)
 	}
 }
 
-void ignoreSpace(const std::string& text, size_t& cursor)
+void ignoreSpace(StringView text, size_t& cursor)
 {
-	if (std::isspace(text[cursor]))
+	if (std::isspace(static_cast<unsigned char>(text[cursor])))
 		nextTok(text, cursor);
 }
 
-bool expect(const std::string& text, size_t& cursor, char target)
+bool expect(StringView text, size_t& cursor, char target)
 {
 	if (text[cursor] != target)
 		return false;
@@ -83,9 +94,9 @@ bool expect(const std::string& text, size_t& cursor, char target)
 	return true;
 }
 
-bool expect(const std::string& text, size_t& cursor, const std::string& target)
+bool expect(StringView text, size_t& cursor, StringView target)
 {
-	for (int i = 0; i < target.size(); ++i)
+	for (size_t i = 0; i < target.size(); ++i)
 	{
 		if (text[cursor + i] != target[i])
 			return false;
@@ -94,7 +105,7 @@ bool expect(const std::string& text, size_t& cursor, const std::string& target)
 	return true;
 }
 
-size_t findRightPair(const std::string& text, const size_t cursor, char left, char right)
+size_t findRightPair(StringView text, const size_t cursor, char left, char right)
 {
 	int left_count = 1;
 	size_t i = cursor;
@@ -117,7 +128,7 @@ size_t findRightPair(const std::string& text, const size_t cursor, char left, ch
 }
 
 
-size_t findPair(const std::string& text, const size_t cursor)
+size_t findPair(StringView text, const size_t cursor)
 {
 	int left_count = 1;
 	size_t i = cursor;
@@ -157,7 +168,7 @@ public:
 	{
 		RangeCheck();
 		ignoreSpace(m_string, m_cursor);
-		return nextTok(m_string, m_cursor);
+		return nextTok(m_string, m_cursor).to_string();
 	}
 
 	// cursor will point the position right behind target
@@ -256,29 +267,58 @@ enum class ShaderLabPropertyType
 };
 
 
-namespace FishEngine
+namespace
 {
-	std::map<std::string, std::string> ShaderCompiler::s_cachedHeaders;
+	// a preprocessed header and what it set
+	struct IncludeCacheEntry
+	{
+		std::time_t                                         mtime = 0;
+		std::string                                         parsed;
+		std::vector<std::pair<std::string, std::time_t>>    dependencies;	// the headers it includes, directly or not
+		std::map<std::string, std::string>                  settings;
+		std::set<std::string>                               testedMacros;
+		bool                                                hasGeometryShader = false;
+	};
 
-	Path ShaderCompiler::s_shaderIncludeDir;
+	typedef std::shared_ptr<const IncludeCacheEntry> IncludeCacheEntryPtr;
 
-	std::string ShaderCompiler::PreprocessShaderFile(const Path& path)
+	// absolute path -> entry, shared by all ShaderCompilers of the process
+	std::mutex                                              s_includeCacheMutex;
+	std::unordered_map<std::string, IncludeCacheEntryPtr>   s_includeCache;
+
+	std::time_t LastWriteTime(std::string const & path)
+	{
+		boost::system::error_code error;
+		auto time = boost::filesystem::last_write_time(path, error);
+		return error ? static_cast<std::time_t>(-1) : time;
+	}
+
+	bool UpToDate(IncludeCacheEntry const & entry, std::string const & path)
 	{
-		if (path.extension() == ".inc")
+		if (LastWriteTime(path) != entry.mtime)
+			return false;
+		for (auto & dependency : entry.dependencies)
 		{
-			std::string full_path = boost::filesystem::absolute(path).string();
-			auto it = s_cachedHeaders.find(full_path);
-			if (it != s_cachedHeaders.end())
-			{
-				return it->second;
-			}
-			//Debug::LogWarning("Open header %s", path.string().c_str());
-			const std::string& shaderText = ReadFile(path);
-			auto parsed = PreprocessImpl(shaderText, m_path.parent_path());
-			s_cachedHeaders[full_path] = parsed;
-			return parsed;
+			if (LastWriteTime(dependency.first) != dependency.second)
+				return false;
 		}
+		return true;
+	}
+}
+
+
+namespace FishEngine
+{
+	Path ShaderCompiler::s_shaderIncludeDir;
+
+	void ShaderCompiler::ClearIncludeCache()
+	{
+		std::lock_guard<std::mutex> lock(s_includeCacheMutex);
+		s_includeCache.clear();
+	}
 
+	std::string ShaderCompiler::PreprocessShaderFile(const Path& path)
+	{
 		auto shaderText = ReadFile(path);
 		if (path.extension() == ".surf")
 		{
@@ -288,8 +328,51 @@ namespace FishEngine
 
 		return PreprocessImpl(shaderText, m_path.parent_path());
 	}
+
+	void ShaderCompiler::AppendHeader(const Path& path, std::string& parsed)
+	{
+		const std::string fullPath = boost::filesystem::absolute(path).string();
+		IncludeCacheEntryPtr entry;
+		{
+			std::lock_guard<std::mutex> lock(s_includeCacheMutex);
+			auto it = s_includeCache.find(fullPath);
+			if (it != s_includeCache.end())
+				entry = it->second;
+		}
+
+		if (entry == nullptr || !UpToDate(*entry, fullPath))
+		{
+			//Debug::LogWarning("Open header %s", path.string().c_str());
+			// a compiler of its own, to record the settings of the header
+			auto newEntry = std::make_shared<IncludeCacheEntry>();
+			newEntry->mtime = LastWriteTime(fullPath);
+			ShaderCompiler header(path);
+			header.m_includeDepth = m_includeDepth + 1;
+			const std::string headerText = ReadFile(path);
+			newEntry->parsed = header.PreprocessImpl(headerText, path.parent_path());
+			newEntry->dependencies = std::move(header.m_dependencies);
+			newEntry->settings = std::move(header.m_settings);
+			newEntry->testedMacros = std::move(header.m_testedMacros);
+			newEntry->hasGeometryShader = header.m_hasGeometryShader;
+			entry = newEntry;
+
+			std::lock_guard<std::mutex> lock(s_includeCacheMutex);
+			s_includeCache[fullPath] = entry;
+		}
+
+		m_dependencies.emplace_back(fullPath, entry->mtime);
+		m_dependencies.insert(m_dependencies.end(), entry->dependencies.begin(), entry->dependencies.end());
+		// do NOT override settings
+		m_settings.insert(entry->settings.begin(), entry->settings.end());
+		m_hasGeometryShader = m_hasGeometryShader || entry->hasGeometryShader;
+		// a header included from a "#if 0" block tests nothing
+		if (InActiveCode())
+			m_testedMacros.insert(entry->testedMacros.begin(), entry->testedMacros.end());
+		parsed += entry->parsed;
+		parsed += "\n";
+	}
 	
-	ShaderBlendFactor ParseShaderBlendFactor(std::string const & str)
+	ShaderBlendFactor ParseShaderBlendFactor(StringView str)
 	{
 		if (str ==  "One")
 		{
@@ -335,7 +418,7 @@ namespace FishEngine
 		throw ShaderCompileError(ShaderCompileStage::Preprocessor, 0, ShaderCompileErrorType::UnknownType);
 	}
 
-	std::string ShaderCompiler::PreprocessImpl(const std::string& shaderText, const Path& localDir)
+	std::string ShaderCompiler::PreprocessImpl(StringView shaderText, const Path& localDir)
 	{
 		std::string parsed;
 		parsed.reserve(shaderText.size());
@@ -346,11 +429,11 @@ namespace FishEngine
 		while (cursor < end)
 		{
 			size_t begin_of_this_tok = cursor;
-			string tok = nextTok(shaderText, cursor);
+			StringView tok = nextTok(shaderText, cursor);
 			if (tok == "//")
 			{
 				readToNewline(shaderText, cursor);
-				parsed += shaderText.substr(begin_of_this_tok, cursor - begin_of_this_tok);
+				Append(parsed, shaderText.substr(begin_of_this_tok, cursor - begin_of_this_tok));
 			}
 			else if (tok == "/*")
 			{
@@ -366,21 +449,18 @@ namespace FishEngine
 				}
 				assert(found_end_of_comment);
 				cursor = i + 2;
-				parsed += shaderText.substr(begin_of_this_tok, cursor - begin_of_this_tok);
+				Append(parsed, shaderText.substr(begin_of_this_tok, cursor - begin_of_this_tok));
 			}
 			else if (tok == "#include")
 			{
 				ignoreSpace(shaderText, cursor);
 				auto tok = nextTok(shaderText, cursor);
 				bool is_system_include = tok[0] == '<';
-				auto header = tok.substr(1, tok.size() - 2);
+				auto header = tok.substr(1, tok.size() - 2).to_string();
 				//cout << "include " << header << " " << is_system_include << endl;
 				Path header_path = is_system_include ?
 					(s_shaderIncludeDir / header) : (localDir / header);
-				m_includeDepth++;
-				string parsed_header_text = PreprocessShaderFile(header_path);
-				//out_parsedShaderText += shaderText.substr(begin_of_this_tok, begin-begin_of_this_tok);
-				parsed += parsed_header_text + "\n";
+				AppendHeader(header_path, parsed);
 			}
 			else if (tok == "uniform")
 			{
@@ -389,7 +469,7 @@ namespace FishEngine
 				ignoreSpace(shaderText, cursor);
 				auto name = nextTok(shaderText, cursor);
 				//cout << "uniform " << type << " " << name << endl;
-				parsed += shaderText.substr(begin_of_this_tok, cursor - begin_of_this_tok);
+				Append(parsed, shaderText.substr(begin_of_this_tok, cursor - begin_of_this_tok));
 			}
 			else if (tok.size() > 0 && tok[0] == '@')
 			{
@@ -405,7 +485,7 @@ namespace FishEngine
 						throw ShaderCompileError(ShaderCompileStage::Preprocessor, 0, ShaderCompileErrorType::InvalidSyntax);
 					}
 					cursor = end + 1;
-					std::string properitesString = shaderText.substr(begin + 1, end - begin - 1);
+					std::string properitesString = shaderText.substr(begin + 1, end - begin - 1).to_string();
 					//Debug::Log("properitesString %s", properitesString.c_str());
 					boost::trim(properitesString);
 					std::vector<std::string> lines;
@@ -446,7 +526,7 @@ namespace FishEngine
 				}
 				else    // keyword
 				{
-					auto name = tok.substr(1);
+					auto name = tok.substr(1).to_string();
 					boost::to_lower(name);
 					if (name == "deferred")
 					{
@@ -462,7 +542,7 @@ namespace FishEngine
 						cursor--;
 						assert(shaderText[cursor] == '"');
 						auto end = cursor;
-						m_name = shaderText.substr(begin, end-begin);
+						m_name = shaderText.substr(begin, end-begin).to_string();
 					}
 					else if (name == "blend")
 					{
@@ -493,7 +573,7 @@ namespace FishEngine
 					else
 					{
 						ignoreSpace(shaderText, cursor);
-						auto setting = nextTok(shaderText, cursor);
+						auto setting = nextTok(shaderText, cursor).to_string();
 						boost::to_lower(setting);
 						//cout << "Keyword " << name << " " << setting << endl;
 						// TODO: override if smaller depth
@@ -508,13 +588,86 @@ namespace FishEngine
 			}
 			else
 			{
-				parsed += tok;
+				if (tok.size() > 1 && tok[0] == '#')
+				{
+					auto lineEnd = cursor;
+					readToNewline(shaderText, lineEnd);
+					ParseConditional(shaderText.substr(begin_of_this_tok, lineEnd - begin_of_this_tok));
+				}
+				Append(parsed, tok);
 			}
 		}
 		return parsed;
 	}
 
-	std::string ShaderCompiler::parseSubShader(const std::string& shaderText, size_t& cursor, const std::string& str, const Path& localDir)
+	void ShaderCompiler::ParseConditional(StringView line)
+	{
+		size_t nameEnd = 1;
+		while (nameEnd < line.size() && std::isalpha(static_cast<unsigned char>(line[nameEnd])))
+			nameEnd++;
+		const auto directive = line.substr(1, nameEnd - 1);
+		const bool opens = directive == "if" || directive == "ifdef" || directive == "ifndef";
+		if (!opens && directive != "elif")
+		{
+			if (m_conditionals.empty())
+				return;
+			if (directive == "else" && m_conditionals.back() == 1)
+				m_conditionals.back() = 0;
+			else if (directive == "endif")
+				m_conditionals.pop_back();
+			return;
+		}
+
+		// a comment at the end of the line tests nothing
+		auto expression = line.substr(nameEnd);
+		expression = expression.substr(0, std::min(expression.find("//"), expression.find("/*")));
+		while (!expression.empty() && std::isspace(static_cast<unsigned char>(expression.front())))
+			expression.remove_prefix(1);
+		while (!expression.empty() && std::isspace(static_cast<unsigned char>(expression.back())))
+			expression.remove_suffix(1);
+
+		if (opens)
+		{
+			if (!InActiveCode())
+				m_conditionals.push_back(2);
+			else
+				m_conditionals.push_back(directive == "if" && expression == "0" ? 1 : 0);
+		}
+		else if (!m_conditionals.empty() && m_conditionals.back() == 1 && expression != "0")
+		{
+			m_conditionals.back() = 0;
+		}
+
+		if (!InActiveCode())
+			return;
+		// the identifiers of the expression, but "defined"
+		for (size_t i = 0; i < expression.size(); )
+		{
+			const char c = expression[i];
+			if (std::isalpha(static_cast<unsigned char>(c)) || c == '_')
+			{
+				size_t j = i;
+				while (j < expression.size() && (std::isalnum(static_cast<unsigned char>(expression[j])) || expression[j] == '_'))
+					j++;
+				auto name = expression.substr(i, j - i);
+				if (name != "defined")
+					m_testedMacros.insert(name.to_string());
+				i = j;
+			}
+			else if (std::isdigit(static_cast<unsigned char>(c)))
+			{
+				// skip numbers like 1u or 0x10
+				while (i < expression.size() && std::isalnum(static_cast<unsigned char>(expression[i])))
+					i++;
+			}
+			else
+			{
+				i++;
+			}
+		}
+	}
+
+	std::string ShaderCompiler::parseSubShader(StringView shaderText, size_t& cursor, const std::string& str, const Path& localDir)
 	{
 		std::string out_parsedShaderText;
 		ignoreSpace(shaderText, cursor);
@@ -0,0 +1,108 @@
+#include <FishEngine/ShaderVariantCollection.hpp>
+
+#include <chrono>
+#include <algorithm>
+
+#include <FishEngine/Shader.hpp>
+
+namespace FishEngine
+{
+	bool ShaderVariantCollection::Add(ShaderVariant const & variant)
+	{
+		if (variant.shader == nullptr || Contains(variant))
+			return false;
+		m_variants.push_back(variant);
+		return true;
+	}
+
+	bool ShaderVariantCollection::Remove(ShaderVariant const & variant)
+	{
+		auto it = std::find(m_variants.begin(), m_variants.end(), variant);
+		if (it == m_variants.end())
+			return false;
+		const int index = static_cast<int>(it - m_variants.begin());
+		if (index < m_warmupCursor)
+			m_warmupCursor--;
+		m_variants.erase(it);
+		return true;
+	}
+
+	bool ShaderVariantCollection::Contains(ShaderVariant const & variant) const
+	{
+		return std::find(m_variants.begin(), m_variants.end(), variant) != m_variants.end();
+	}
+
+	void ShaderVariantCollection::Clear()
+	{
+		m_variants.clear();
+		m_warmupCursor = 0;
+	}
+
+	int ShaderVariantCollection::shaderCount() const
+	{
+		std::vector<Shader*> shaders;
+		for (auto const & v : m_variants)
+		{
+			if (std::find(shaders.begin(), shaders.end(), v.shader.get()) == shaders.end())
+				shaders.push_back(v.shader.get());
+		}
+		return static_cast<int>(shaders.size());
+	}
+
+	bool ShaderVariantCollection::isWarmedUp() const
+	{
+		for (auto const & v : m_variants)
+		{
+			if (v.shader != nullptr && !v.shader->HasVariant(v.keywords))
+				return false;
+		}
+		return true;
+	}
+
+	void ShaderVariantCollection::Warmup()
+	{
+		// start all of them first, a driver with parallel compile works on them at the same time
+		for (auto const & v : m_variants)
+		{
+			if (v.shader != nullptr)
+				v.shader->BeginWarmup(v.keywords);
+		}
+		for (auto const & v : m_variants)
+		{
+			if (v.shader != nullptr)
+				v.shader->EndWarmup(true);
+		}
+		m_warmupCursor = variantCount();
+	}
+
+	bool ShaderVariantCollection::WarmupProgressive(float timeBudget)
+	{
+		typedef std::chrono::high_resolution_clock clock;
+		const auto start = clock::now();
+		auto elapsed = [start]()
+		{
+			return std::chrono::duration<float, std::milli>(clock::now() - start).count();
+		};
+
+		const int count = variantCount();
+		while (m_warmupCursor < count && elapsed() < timeBudget)
+		{
+			auto const & v = m_variants[m_warmupCursor++];
+			if (v.shader == nullptr)
+				continue;
+			v.shader->BeginWarmup(v.keywords);
+			// without parallel compile this waits for the driver, and the time is spent inside the budget
+			v.shader->EndWarmup(false);
+		}
+
+		// collect what the driver finished in the background
+		bool done = m_warmupCursor >= count;
+		for (int i = 0; i < m_warmupCursor; ++i)
+		{
+			auto const & shader = m_variants[i].shader;
+			if (shader != nullptr && !shader->EndWarmup(false))
+				done = false;
+		}
+		return done;
+	}
+}
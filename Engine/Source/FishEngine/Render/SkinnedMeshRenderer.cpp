@@ -1,6 +1,8 @@
 #include <FishEngine/SkinnedMeshRenderer.hpp>
 
 #include <cassert>
+#include <cmath>
+#include <algorithm>
 
 #include <FishEngine/GameObject.hpp>
 #include <FishEngine/Debug.hpp>
@@ -13,9 +15,15 @@
 #include <FishEngine/Gizmos.hpp>
 #include <FishEngine/Shader.hpp>
 #include <FishEngine/Graphics.hpp>
+#include <FishEngine/RenderSystem.hpp>
+#include <FishEngine/Render/CPUSkinning.hpp>
+#include <FishEngine/Render/RendererRegistry.hpp>
+#include <FishEngine/ShaderVariables_gen.hpp>
 
 namespace FishEngine
 {
+	SkinningBackend SkinnedMeshRenderer::s_defaultSkinningBackend = SkinningBackend::GPU;
+
 	SkinnedMeshRenderer::
 		SkinnedMeshRenderer(MaterialPtr material)
 		: Renderer(material)
@@ -23,9 +31,30 @@ namespace FishEngine
 
 	}
 
+	SkinnedMeshRenderer::~SkinnedMeshRenderer()
+	{
+		if (m_sharedMesh != nullptr && m_sharedMesh->m_transformFeedbackOwner == this)
+			m_sharedMesh->m_transformFeedbackOwner = nullptr;
+		if (m_skinnedVertexBuffer != 0)
+		{
+			// the shared mesh may still read from it
+			if (m_sharedMesh != nullptr && m_sharedMesh->m_skinnedVertexBuffer == m_skinnedVertexBuffer)
+				m_sharedMesh->BindSkinnedVertices(0);
+			glDeleteBuffers(1, &m_skinnedVertexBuffer);
+		}
+	}
+
+	void SkinnedMeshRenderer::setDefaultSkinningBackend(SkinningBackend backend)
+	{
+		assert(backend != SkinningBackend::Default);
+		s_defaultSkinningBackend = backend;
+	}
+
 
 	Bounds SkinnedMeshRenderer::
 		localBounds() const {
+		if (m_skinnedBounds.IsValid())
+			return m_skinnedBounds;
 		return m_sharedMesh->bounds();
 	}
 
@@ -56,25 +85,90 @@ namespace FishEngine
 	{
 		m_sharedMesh = sharedMesh;
 		m_matrixPalette.resize(m_sharedMesh->boneCount());
+		m_boneTable.clear();
+		m_paletteFrame = 0;
+	}
+
+	void SkinnedMeshRenderer::ResolveBones() const
+	{
+		// scene structure changes (destroyed or re-parented game objects) may have expired some bones
+		const uint32_t structureVersion = RendererRegistry::structureVersion();
+		const std::size_t count = m_sharedMesh->boneCount();
+		if (m_boneTable.size() == count && m_boneTableVersion == structureVersion)
+			return;
+		m_boneTable.resize(count);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			m_boneTable[i] = i < m_bones.size() ? m_bones[i].lock().get() : nullptr;
+		}
+		m_boneTableVersion = structureVersion;
 	}
 
 	void SkinnedMeshRenderer::UpdateMatrixPalette() const
 	{
-		m_matrixPalette.resize(m_sharedMesh->boneCount());
+		// once per frame, RendererRegistry::Update asks for it before UpdateAnimations
+		const uint32_t frame = RenderSystem::frameCount();
+		if (frame != 0 && m_paletteFrame == frame)
+			return;
+		m_paletteFrame = frame;
+
+		m_sharedMesh->UploadMeshData();
+		ResolveBones();
+		const auto& bindposes = m_sharedMesh->m_affineBindposes;
+		const std::size_t count = std::min(m_boneTable.size(), bindposes.size());
+		m_matrixPalette.resize(count);
 		//RecursivelyGetTransformation(m_rootBone.lock(), m_avatar->m_boneToIndex, m_matrixPalette);
-		const auto& worldToLocal = gameObject()->transform()->worldToLocalMatrix();
-		const auto& bindposes = m_sharedMesh->bindposes();
-		for (uint32_t i = 0; i < m_matrixPalette.size(); ++i)
+		// we multiply worldToLocal because we assume that the mesh is in local space in shader.
+		const AffineMatrix worldToLocal(gameObject()->transform()->worldToLocalMatrix());
+		BonePalette::Build(worldToLocal, m_boneTable.data(), bindposes.data(), count, m_matrixPalette.data());
+
+		// A vertex of a bone is within radius of the bone origin in the bind pose, so within radius * scale of the
+		// skinned origin now. A blended vertex is in the convex hull of these spheres.
+		const auto& boneBounds = m_sharedMesh->m_boneBounds;
+		const bool hasBoneBounds = boneBounds.size() == count;
+		Vector3 boundsMin(Mathf::Infinity, Mathf::Infinity, Mathf::Infinity);
+		Vector3 boundsMax(Mathf::NegativeInfinity, Mathf::NegativeInfinity, Mathf::NegativeInfinity);
+		for (std::size_t i = 0; hasBoneBounds && i < count; ++i)
 		{
-			auto bone = m_bones[i].lock();
-			auto& mat = m_matrixPalette[i];
-			// we multiply worldToLocal because we assume that the mesh is in local space in shader.
-			mat = worldToLocal * bone->localToWorldMatrix() * bindposes[i];
-
-			// macOS bug
-			// see the definition of Bones in ShaderVariables.inc
-			mat = mat.transpose();
+			auto const & sphere = boneBounds[i];
+			if (sphere.w < 0)
+				continue;
+			auto const & mat = m_matrixPalette[i];
+			const float radius = sphere.w * mat.maxScale();
+			const Vector3 center = mat.MultiplyPoint(Vector3(sphere.x, sphere.y, sphere.z));
+			const Vector3 extents(radius, radius, radius);
+			boundsMin = Vector3::Min(boundsMin, center - extents);
+			boundsMax = Vector3::Max(boundsMax, center + extents);
 		}
+
+		if (boundsMin.x <= boundsMax.x)
+			m_skinnedBounds.SetMinMax(boundsMin, boundsMax);
+		else
+			m_skinnedBounds = Bounds();
+	}
+
+	void SkinnedMeshRenderer::UpdateBounds() const
+	{
+		// the bounds stay where they were when the renderer was culled
+		if (m_cullingMode == AnimationCullingMode::CullCompletely && !isVisible() && m_skinnedBounds.IsValid())
+			return;
+		UpdateMatrixPalette();
+	}
+
+	// FNV-1a over the words of the palette
+	static uint64_t HashPalette(std::vector<AffineMatrix> const & palette)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (auto const & m : palette)
+		{
+			auto words = reinterpret_cast<const uint32_t*>(&m.rows[0].x);
+			for (int i = 0; i < 12; ++i)
+			{
+				hash ^= words[i];
+				hash *= 1099511628211ull;
+			}
+		}
+		return hash;
 	}
 	
 	//std::vector<Matrix4x4> const & SkinnedMeshRenderer::matrixPalette() const
@@ -86,12 +180,6 @@ namespace FishEngine
 	//	return m_matrixPalette;
 	//}
 
-	void SkinnedMeshRenderer::Update()
-	{
-		UpdateMatrixPalette();
-	}
-
-
 	//void SkinnedMeshRenderer::PreRender() const
 	//{
 	//	auto model = transform()->localToWorldMatrix();
@@ -100,18 +188,165 @@ namespace FishEngine
 
 	void SkinnedMeshRenderer::UpdataAnimation()
 	{
-		UpdateMatrixPalette();
-		Pipeline::UpdateBonesUniforms(m_matrixPalette);
-
-		auto shader = Shader::FindBuiltin("Internal-GPUSkinning");
-		shader->Use();
-		shader->PreRender();
-		shader->CheckStatus();
-		m_sharedMesh->RenderSkinned();
-		shader->PostRender();
+		SkinnedMeshRenderer* self = this;
+		UpdateAnimations(&self, 1);
+	}
+
+	bool SkinnedMeshRenderer::isVisible() const
+	{
+		return m_visibleFrame != 0 && RenderSystem::frameCount() - m_visibleFrame <= 1;
+	}
+
+	void SkinnedMeshRenderer::MarkVisible()
+	{
+		m_visibleFrame = RenderSystem::frameCount();
+	}
+
+	void SkinnedMeshRenderer::UpdateAnimationIfCulled()
+	{
+		if (m_skinnedFrame != RenderSystem::frameCount())
+		{
+			UpdataAnimation();
+		}
+	}
+
+	bool SkinnedMeshRenderer::IsSkinningUpToDate(uint64_t paletteHash) const
+	{
+		if (m_skinnedFrame == 0 || paletteHash != m_skinnedPaletteHash)
+			return false;
+		// the transform feedback output is shared by the renderers of the mesh
+		if (m_skinnedOnCPU)
+			return m_skinnedVertexBuffer != 0;
+		return m_sharedMesh->m_transformFeedbackOwner == this;
+	}
+
+	bool SkinnedMeshRenderer::UseCPUSkinning() const
+	{
+		if (m_sharedMesh->m_skinningSource == nullptr)
+			return false;
+		// the bone block of the GPU skinning pass holds MAX_BONE_SIZE matrices
+		if (m_matrixPalette.size() > MAX_BONE_SIZE)
+			return true;
+		auto backend = m_skinningBackend == SkinningBackend::Default ? s_defaultSkinningBackend : m_skinningBackend;
+		return backend == SkinningBackend::CPU;
+	}
+
+	void SkinnedMeshRenderer::UpdateAnimations(SkinnedMeshRenderer* const * renderers, std::size_t count)
+	{
+		static std::vector<SkinningJob> jobs;
+		jobs.clear();
+
+		static std::vector<SkinnedMeshRenderer*> cpuRenderers;
+		cpuRenderers.clear();
+
+		const uint32_t frame = RenderSystem::frameCount();
+		ShaderPtr gpuSkinning;
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			auto r = renderers[i];
+			r->m_sharedMesh->UploadMeshData();
+			r->UpdateMatrixPalette();
+
+			// the bones did not move since the last skinning
+			const uint64_t paletteHash = HashPalette(r->m_matrixPalette);
+			const bool cpu = r->UseCPUSkinning();
+			const bool upToDate = cpu == r->m_skinnedOnCPU && r->IsSkinningUpToDate(paletteHash);
+			r->m_skinnedFrame = frame;
+			if (upToDate)
+				continue;
+			r->m_skinnedPaletteHash = paletteHash;
+			r->m_skinnedOnCPU = cpu;
+			if (cpu)
+			{
+				cpuRenderers.push_back(r);
+				continue;
+			}
+
+			// too many bones and no bind pose to skin on the CPU, Mesh::UploadMeshData warned about it
+			if (r->m_matrixPalette.size() > MAX_BONE_SIZE)
+				continue;
+
+			// the transform feedback pass runs on the GPU while the CPU ones are skinned below
+			if (gpuSkinning == nullptr)
+			{
+				gpuSkinning = Shader::FindBuiltin("Internal-GPUSkinning");
+				gpuSkinning->Use();
+			}
+			Pipeline::UpdateBonesUniforms(r->m_matrixPalette);
+			gpuSkinning->PreRender();
+			gpuSkinning->CheckStatus();
+			r->m_sharedMesh->RenderSkinned();
+			r->m_sharedMesh->m_transformFeedbackOwner = r;
+			gpuSkinning->PostRender();
+		}
+		glCheckError();
+
+		for (auto r : cpuRenderers)
+		{
+			auto const & source = *r->m_sharedMesh->m_skinningSource;
+			const uint32_t vertexCount = source.vertexCount();
+			const GLsizeiptr streamSize = static_cast<GLsizeiptr>(vertexCount) * 3 * sizeof(GLfloat);
+			const GLsizeiptr bufferSize = streamSize * 3;
+			if (r->m_skinnedVertexBuffer == 0)
+			{
+				glGenBuffers(1, &r->m_skinnedVertexBuffer);
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, r->m_skinnedVertexBuffer);
+			if (r->m_skinnedVertexBufferSize != bufferSize)
+			{
+				glBufferData(GL_ARRAY_BUFFER, bufferSize, nullptr, GL_DYNAMIC_DRAW);
+				r->m_skinnedVertexBufferSize = bufferSize;
+			}
+
+			// orphan last frame's vertices, the GPU may still be reading them
+			auto out = static_cast<float*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, bufferSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+			if (out != nullptr)
+			{
+				r->m_skinnedVertices.clear();
+				r->m_skinnedVertices.shrink_to_fit();
+			}
+			else
+			{
+				r->m_skinnedVertices.resize(vertexCount * 9);
+				out = r->m_skinnedVertices.data();
+			}
+
+			SkinningJob job;
+			job.source = &source;
+			job.palette = r->m_matrixPalette.data();
+			job.boneCount = static_cast<uint32_t>(r->m_matrixPalette.size());
+			job.positions = out;
+			job.normals = out + vertexCount * 3;
+			job.tangents = out + vertexCount * 6;
+			jobs.push_back(job);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		if (jobs.empty())
+			return;
+
+		CPUSkinning::Run(jobs.data(), static_cast<int>(jobs.size()));
+
+		for (auto r : cpuRenderers)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, r->m_skinnedVertexBuffer);
+			if (r->m_skinnedVertices.empty())
+			{
+				glUnmapBuffer(GL_ARRAY_BUFFER);
+			}
+			else
+			{
+				glBufferData(GL_ARRAY_BUFFER, r->m_skinnedVertexBufferSize, r->m_skinnedVertices.data(), GL_DYNAMIC_DRAW);
+			}
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		glCheckError();
 	}
 
+	void SkinnedMeshRenderer::BindSkinnedVertices() const
+	{
+		m_sharedMesh->BindSkinnedVertices(m_skinnedOnCPU ? m_skinnedVertexBuffer : 0);
+	}
+
 #if 0
 	void SkinnedMeshRenderer::Render() const
 	{
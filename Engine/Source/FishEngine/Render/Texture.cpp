@@ -5,6 +5,7 @@
 #include <FishEngine/GLEnvironment.hpp>
 #include <FishEngine/Debug.hpp>
 #include <FishEngine/Mathf.hpp>
+#include <FishEngine/Render/GLStateCache.hpp>
 
 namespace FishEngine
 {
@@ -12,14 +13,14 @@ namespace FishEngine
 	{
 		assert(m_GLNativeTexture != 0);
 		const auto& sampler = TextureSampler::GetSampler(m_filterMode, m_wrapMode);
-		glBindSampler(m_GLNativeTexture, sampler.m_nativeGLSampler);
+		GLStateCache::BindSampler(m_GLNativeTexture, sampler.m_nativeGLSampler);
 	}
 
 	std::vector<TexturePtr> Texture::s_textures;
 
 	Texture::~Texture()
 	{
-		glDeleteTextures(1, &m_GLNativeTexture);
+		GLStateCache::DeleteTexture(m_GLNativeTexture);
 	}
 
 	FishEngine::TexturePtr Texture::Create()
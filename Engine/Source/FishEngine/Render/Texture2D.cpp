@@ -2,6 +2,8 @@
 #include <FishEngine/GLEnvironment.hpp>
 #include <FishEngine/Debug.hpp>
 #include <FishEngine/Mathf.hpp>
+#include <FishEngine/Render/GLStateCache.hpp>
+#include <FishEngine/Render/TextureStreaming.hpp>
 
 namespace FishEngine
 {
@@ -31,11 +33,23 @@ namespace FishEngine
 	}
 
 
+	Texture2D::~Texture2D()
+	{
+		if (m_streaming)
+			TextureStreaming::Cancel(this);
+	}
+
 	void Texture2D::UploadToGPU()
 	{
-		if (m_uploaded)
+		if (m_uploaded || m_streaming)
 			return;
 
+		if (TextureStreaming::enabled() && m_data.size() >= TextureStreaming::kMinStreamingBytes)
+		{
+			TextureStreaming::Load(this);
+			return;
+		}
+
 		GLenum internal_format = GL_RGBA8;
 		GLenum format = GL_RGBA;
 		GLenum type = GL_UNSIGNED_INT;
@@ -46,7 +60,7 @@ namespace FishEngine
 
 		glGenTextures(1, &m_GLNativeTexture);
 		glCheckError();
-		glBindTexture(GL_TEXTURE_2D, m_GLNativeTexture);
+		GLStateCache::BindTexture(GL_TEXTURE_2D, m_GLNativeTexture);
 		glCheckError();
 #if 1
 		GLsizei max_mipmap_level_count = Mathf::FloorToInt(std::log2f((float)std::max(m_width, m_height))) + 1;
@@ -67,13 +81,21 @@ namespace FishEngine
 		glCheckError();
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		glCheckError();
-		glBindTexture(GL_TEXTURE_2D, 0);
+		GLStateCache::BindTexture(GL_TEXTURE_2D, 0);
 		m_uploaded = true;
 		m_data.clear();
 		m_data.shrink_to_fit();
 		glCheckError();
 	}
 
+	unsigned int Texture2D::PlaceholderNativeTexture()
+	{
+		auto placeholder = m_streamingPlaceholder != nullptr ? m_streamingPlaceholder : whiteTexture();
+		if (placeholder.get() == this)
+			abort();
+		return placeholder->GetNativeTexturePtr();
+	}
+
 	const uint8_t allWhite[] = {
 		255,255,255,255,
 		255,255,255,255,
@@ -1,4 +1,5 @@
 #include <FishEngine/TextureSampler.hpp>
+#include <FishEngine/Render/GLStateCache.hpp>
 
 namespace FishEngine
 {
@@ -7,7 +8,7 @@ namespace FishEngine
 	TextureSampler::~TextureSampler()
 	{
 		if (m_nativeGLSampler != 0)
-			glDeleteSamplers(1, &m_nativeGLSampler);
+			GLStateCache::DeleteSampler(m_nativeGLSampler);
 	}
 
 	void TextureSampler::Init()
@@ -0,0 +1,623 @@
+#include <FishEngine/Render/TextureStreaming.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <FishEngine/Texture2D.hpp>
+#include <FishEngine/GLEnvironment.hpp>
+#include <FishEngine/Debug.hpp>
+#include <FishEngine/Render/GLStateCache.hpp>
+
+namespace
+{
+	using namespace FishEngine;
+
+	struct DecodeJob
+	{
+		Texture2D*							texture;
+		uint32_t							serial;
+		TextureStreaming::Decoder			decoder;
+		TextureStreaming::LoadedCallback	onLoaded;
+		TextureStreamingImage				image;
+		bool								succeeded = false;
+	};
+
+	struct UploadJob
+	{
+		Texture2D*				texture;
+		TextureStreamingImage	image;
+		GLuint					glTexture = 0;
+		GLenum					internalFormat;
+		GLenum					format;
+		GLenum					type;
+		uint32_t				bytesPerPixel;
+		int						level;			// the level being uploaded, from the smallest one down to 0
+		uint32_t				row = 0;		// the next row of level
+		bool					published = false;	// glTexture is the texture's m_GLNativeTexture
+	};
+
+	struct PixelBuffer
+	{
+		GLuint	buffer = 0;
+		GLsync	fence = nullptr;
+	};
+
+	enum class ChannelType
+	{
+		None,
+		UInt8,
+		UInt16,
+		Float,
+	};
+
+	ChannelType ChannelTypeOf(TextureFormat format)
+	{
+		switch (format)
+		{
+		case TextureFormat::R8:
+		case TextureFormat::RG16:
+		case TextureFormat::RGB24:
+		case TextureFormat::RGBA32:
+		case TextureFormat::BGRA32:
+			return ChannelType::UInt8;
+		case TextureFormat::RG32:
+			return ChannelType::UInt16;
+		case TextureFormat::RFloat:
+		case TextureFormat::RGFloat:
+			return ChannelType::Float;
+		default:
+			return ChannelType::None;
+		}
+	}
+
+	inline uint8_t Average(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+	{
+		return static_cast<uint8_t>((a + b + c + d + 2) / 4);
+	}
+
+	inline uint16_t Average(uint16_t a, uint16_t b, uint16_t c, uint16_t d)
+	{
+		return static_cast<uint16_t>((uint32_t(a) + b + c + d + 2) / 4);
+	}
+
+	inline float Average(float a, float b, float c, float d)
+	{
+		return (a + b + c + d) * 0.25f;
+	}
+
+	// 2x2 box filter, the last row / column is repeated for odd sizes
+	template <typename T>
+	void Downsample(const T* src, uint32_t width, uint32_t height, uint32_t channels, T* dst)
+	{
+		const uint32_t w = std::max(width / 2, 1u);
+		const uint32_t h = std::max(height / 2, 1u);
+		for (uint32_t y = 0; y < h; ++y)
+		{
+			const T* row0 = src + std::min(2 * y, height - 1) * width * channels;
+			const T* row1 = src + std::min(2 * y + 1, height - 1) * width * channels;
+			for (uint32_t x = 0; x < w; ++x)
+			{
+				const uint32_t x0 = std::min(2 * x, width - 1) * channels;
+				const uint32_t x1 = std::min(2 * x + 1, width - 1) * channels;
+				for (uint32_t c = 0; c < channels; ++c)
+					*dst++ = Average(row0[x0 + c], row0[x1 + c], row1[x0 + c], row1[x1 + c]);
+			}
+		}
+	}
+
+	inline uint32_t MipSize(uint32_t size, int level)
+	{
+		return std::max(size >> level, 1u);
+	}
+
+	// append the levels 1..n to level 0, as many as Texture2D::UploadToGPU allocates
+	bool BuildMipChain(TextureStreamingImage & image)
+	{
+		const int bpp = BytePerPixel(image.format);
+		const ChannelType channelType = ChannelTypeOf(image.format);
+		if (bpp <= 0 || channelType == ChannelType::None || image.width == 0 || image.height == 0)
+			return false;
+		const std::size_t baseSize = std::size_t(image.width) * image.height * bpp;
+		if (image.data.size() < baseSize)
+			return false;
+
+		int levelCount = 1;
+		while ((std::max(image.width, image.height) >> levelCount) != 0)
+			++levelCount;
+
+		image.mipOffsets.resize(levelCount);
+		std::size_t total = 0;
+		for (int level = 0; level < levelCount; ++level)
+		{
+			image.mipOffsets[level] = static_cast<uint32_t>(total);
+			total += std::size_t(MipSize(image.width, level)) * MipSize(image.height, level) * bpp;
+		}
+		image.data.resize(total);
+
+		for (int level = 1; level < levelCount; ++level)
+		{
+			const uint8_t* src = image.data.data() + image.mipOffsets[level - 1];
+			uint8_t* dst = image.data.data() + image.mipOffsets[level];
+			const uint32_t w = MipSize(image.width, level - 1);
+			const uint32_t h = MipSize(image.height, level - 1);
+			switch (channelType)
+			{
+			case ChannelType::UInt8:
+				Downsample(src, w, h, bpp, dst);
+				break;
+			case ChannelType::UInt16:
+				Downsample(reinterpret_cast<const uint16_t*>(src), w, h, bpp / 2, reinterpret_cast<uint16_t*>(dst));
+				break;
+			case ChannelType::Float:
+				Downsample(reinterpret_cast<const float*>(src), w, h, bpp / 4, reinterpret_cast<float*>(dst));
+				break;
+			default:
+				break;
+			}
+		}
+		return true;
+	}
+
+	void Decode(DecodeJob & job)
+	{
+		job.succeeded = (job.decoder == nullptr || job.decoder(job.image)) && BuildMipChain(job.image);
+		job.decoder = nullptr;
+	}
+
+	// Persistent threads taking jobs from a FIFO. Finished jobs are handed back to the render thread by TakeFinished.
+	class DecodeQueue
+	{
+	public:
+		~DecodeQueue()
+		{
+			Resize(0);
+		}
+
+		int size() const
+		{
+			return static_cast<int>(m_threads.size());
+		}
+
+		// the queued jobs are kept
+		void Resize(int count)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_quit = true;
+			}
+			m_wake.notify_all();
+			for (auto & t : m_threads)
+				t.join();
+			m_threads.clear();
+			m_quit = false;
+			for (int i = 0; i < count; ++i)
+				m_threads.emplace_back([this]() { WorkerMain(); });
+		}
+
+		void Push(std::unique_ptr<DecodeJob> job)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_queued.push_back(std::move(job));
+			}
+			m_wake.notify_one();
+		}
+
+		// Move the finished jobs to out. wait: block until there is one, unless nothing is queued or running.
+		// Without workers, the queued jobs are decoded here, one per call unless waiting.
+		void TakeFinished(std::vector<std::unique_ptr<DecodeJob>> & out, bool wait)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (m_threads.empty() && !m_queued.empty())
+			{
+				auto job = std::move(m_queued.front());
+				m_queued.pop_front();
+				lock.unlock();
+				Decode(*job);
+				lock.lock();
+				m_finished.push_back(std::move(job));
+				if (!wait)
+					break;
+			}
+			if (wait)
+				m_done.wait(lock, [this]() { return !m_finished.empty() || (m_queued.empty() && m_running == 0); });
+			for (auto & job : m_finished)
+				out.push_back(std::move(job));
+			m_finished.clear();
+		}
+
+		// the jobs running now are still handed back by TakeFinished
+		void Clear()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queued.clear();
+			m_finished.clear();
+		}
+
+	private:
+		void WorkerMain()
+		{
+			for (;;)
+			{
+				std::unique_ptr<DecodeJob> job;
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_wake.wait(lock, [this]() { return m_quit || !m_queued.empty(); });
+					if (m_quit)
+						return;
+					job = std::move(m_queued.front());
+					m_queued.pop_front();
+					++m_running;
+				}
+				Decode(*job);
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_finished.push_back(std::move(job));
+					--m_running;
+				}
+				m_done.notify_all();
+			}
+		}
+
+		std::vector<std::thread>				m_threads;
+		std::deque<std::unique_ptr<DecodeJob>>	m_queued;
+		std::vector<std::unique_ptr<DecodeJob>>	m_finished;
+		std::mutex								m_mutex;
+		std::condition_variable					m_wake;
+		std::condition_variable					m_done;
+		int										m_running = 0;
+		bool									m_quit = false;
+	};
+
+	DecodeQueue & Queue()
+	{
+		static DecodeQueue queue;
+		return queue;
+	}
+
+	int s_workerCount = -1;	// -1: see DefaultWorkerCount(), set on the first Load
+
+	int DefaultWorkerCount()
+	{
+		const int hardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+		return std::min(std::max(hardwareThreads - 1, 1), 4);
+	}
+
+	void ApplyWorkerCount()
+	{
+		if (s_workerCount < 0)
+			s_workerCount = DefaultWorkerCount();
+		if (Queue().size() != s_workerCount)
+			Queue().Resize(s_workerCount);
+	}
+
+	// render thread state
+
+	std::unordered_map<Texture2D const *, uint32_t>	s_pending;	// texture -> serial of its latest Load
+	uint32_t										s_serial = 0;
+	std::deque<UploadJob>							s_uploads;
+	PixelBuffer										s_pixelBuffers[TextureStreaming::kPixelBufferCount];
+	int												s_nextPixelBuffer = 0;
+
+	bool IsCurrent(Texture2D const * texture, uint32_t serial)
+	{
+		auto it = s_pending.find(texture);
+		return it != s_pending.end() && it->second == serial;
+	}
+
+	void DeleteUnpublished(UploadJob & job)
+	{
+		if (job.glTexture != 0 && !job.published)
+			GLStateCache::DeleteTexture(job.glTexture);
+		job.glTexture = 0;
+	}
+
+	// a published GL texture is owned by the texture now, it stays until it is replaced
+	void DropUploads(Texture2D const * texture)
+	{
+		for (auto it = s_uploads.begin(); it != s_uploads.end(); )
+		{
+			if (it->texture == texture)
+			{
+				DeleteUnpublished(*it);
+				it = s_uploads.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	void CreateTexture(UploadJob & job)
+	{
+		const GLsizei levelCount = static_cast<GLsizei>(job.image.mipOffsets.size());
+		glGenTextures(1, &job.glTexture);
+		GLStateCache::BindTexture(GL_TEXTURE_2D, job.glTexture);
+		glTexStorage2D(GL_TEXTURE_2D, levelCount, job.internalFormat, job.image.width, job.image.height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, levelCount - 1);
+		glCheckError();
+	}
+
+	// The next pixel buffer of the ring, nullptr when the GPU still reads it and wait is false.
+	PixelBuffer* AcquirePixelBuffer(bool wait)
+	{
+		auto & buffer = s_pixelBuffers[s_nextPixelBuffer];
+		if (buffer.buffer == 0)
+		{
+			glGenBuffers(1, &buffer.buffer);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.buffer);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, TextureStreaming::kPixelBufferSize, nullptr, GL_STREAM_DRAW);
+		}
+		if (buffer.fence != nullptr)
+		{
+			GLenum result = glClientWaitSync(buffer.fence, 0, 0);
+			while (wait && result == GL_TIMEOUT_EXPIRED)
+			{
+				result = glClientWaitSync(buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);	// 1ms
+			}
+			if (result == GL_TIMEOUT_EXPIRED)
+				return nullptr;
+			if (result == GL_WAIT_FAILED)
+			{
+				LogError("TextureStreaming: glClientWaitSync failed");
+			}
+			glDeleteSync(buffer.fence);
+			buffer.fence = nullptr;
+		}
+		s_nextPixelBuffer = (s_nextPixelBuffer + 1) % TextureStreaming::kPixelBufferCount;
+		return &buffer;
+	}
+
+	// Upload rows [job.row, job.row + rowCount) of job.level through a pixel buffer, straight from client memory
+	// when it can not be mapped. false: no pixel buffer is free.
+	bool UploadRows(UploadJob & job, uint32_t rowCount, bool wait)
+	{
+		auto buffer = AcquirePixelBuffer(wait);
+		if (buffer == nullptr)
+			return false;
+
+		const uint32_t width = MipSize(job.image.width, job.level);
+		const uint32_t rowBytes = width * job.bytesPerPixel;
+		const uint32_t size = rowCount * rowBytes;
+		const uint8_t* pixels = job.image.data.data() + job.image.mipOffsets[job.level] + job.row * rowBytes;
+
+		GLStateCache::BindTexture(GL_TEXTURE_2D, job.glTexture);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer->buffer);
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+		void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+		if (mapped != nullptr)
+		{
+			std::memcpy(mapped, pixels, size);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glTexSubImage2D(GL_TEXTURE_2D, job.level, 0, job.row, width, rowCount, job.format, job.type, nullptr);
+			buffer->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+		else
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glTexSubImage2D(GL_TEXTURE_2D, job.level, 0, job.row, width, rowCount, job.format, job.type, pixels);
+		}
+		glCheckError();
+		return true;
+	}
+
+	bool HasUpload(Texture2D const * texture)
+	{
+		for (auto const & job : s_uploads)
+			if (job.texture == texture)
+				return true;
+		return false;
+	}
+}
+
+namespace FishEngine
+{
+	bool		TextureStreaming::s_enabled = true;
+	uint64_t	TextureStreaming::s_uploadBudget = 16 * 1024 * 1024;
+	uint64_t	TextureStreaming::s_frameUploadBytes = 0;
+
+	void TextureStreaming::Collect(bool wait)
+	{
+		std::vector<std::unique_ptr<DecodeJob>> finished;
+		Queue().TakeFinished(finished, wait);
+		for (auto & job : finished)
+		{
+			Texture2D* texture = job->texture;
+			if (!IsCurrent(texture, job->serial))
+				continue;	// cancelled or superseded
+			if (!job->succeeded)
+			{
+				LogError("TextureStreaming: failed to load " + texture->name());
+				s_pending.erase(texture);
+				texture->m_streaming = false;
+				texture->m_uploaded = true;	// keep the placeholder (or the previous contents)
+				continue;
+			}
+
+			auto & image = job->image;
+			texture->m_width = image.width;
+			texture->m_height = image.height;
+			texture->m_format = image.format;
+			texture->m_mipmapCount = static_cast<uint32_t>(image.mipOffsets.size());
+			if (job->onLoaded != nullptr)
+				job->onLoaded(*texture);
+
+			UploadJob upload;
+			upload.texture = texture;
+			upload.image = std::move(image);
+			TextureFormat2GLFormat(upload.image.format, &upload.internalFormat, &upload.format, &upload.type);
+			upload.bytesPerPixel = BytePerPixel(upload.image.format);
+			upload.level = static_cast<int>(upload.image.mipOffsets.size()) - 1;
+			s_uploads.push_back(std::move(upload));
+		}
+	}
+
+	uint64_t TextureStreaming::Upload(uint64_t budget, bool wait)
+	{
+		if (s_uploads.empty())
+			return 0;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		uint64_t uploaded = 0;
+		while (!s_uploads.empty())
+		{
+			auto & job = s_uploads.front();
+			if (job.glTexture == 0)
+				CreateTexture(job);
+
+			const uint32_t rowBytes = MipSize(job.image.width, job.level) * job.bytesPerPixel;
+			const uint32_t levelHeight = MipSize(job.image.height, job.level);
+			uint32_t rowCount = std::min(levelHeight - job.row, std::max(kPixelBufferSize / rowBytes, 1u));
+			if (budget > 0)
+			{
+				const uint64_t left = uploaded < budget ? budget - uploaded : 0;
+				if (left < rowBytes && uploaded > 0)
+					break;
+				rowCount = static_cast<uint32_t>(std::min<uint64_t>(rowCount, std::max<uint64_t>(left / rowBytes, 1)));
+			}
+			if (!UploadRows(job, rowCount, wait))
+				break;
+			uploaded += uint64_t(rowCount) * rowBytes;
+			job.row += rowCount;
+			if (job.row < levelHeight)
+				continue;
+
+			// the level is complete, make it visible
+			Texture2D* texture = job.texture;
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, job.level);
+			if (!job.published)
+			{
+				if (texture->m_GLNativeTexture != 0)
+					GLStateCache::DeleteTexture(texture->m_GLNativeTexture);
+				texture->m_GLNativeTexture = job.glTexture;
+				job.published = true;
+			}
+			if (job.level > 0)
+			{
+				job.level--;
+				job.row = 0;
+				continue;
+			}
+			texture->m_uploaded = true;
+			texture->m_streaming = false;
+			s_pending.erase(texture);
+			s_uploads.pop_front();
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		GLStateCache::BindTexture(GL_TEXTURE_2D, 0);
+		glCheckError();
+		return uploaded;
+	}
+
+	void TextureStreaming::Load(Texture2D* texture, Decoder decoder, LoadedCallback onLoaded)
+	{
+		assert(texture != nullptr);
+		DropUploads(texture);
+		const uint32_t serial = ++s_serial;
+		s_pending[texture] = serial;
+		texture->m_streaming = true;
+
+		std::unique_ptr<DecodeJob> job(new DecodeJob);
+		job->texture = texture;
+		job->serial = serial;
+		job->decoder = std::move(decoder);
+		job->onLoaded = std::move(onLoaded);
+		if (job->decoder == nullptr)
+		{
+			job->image.width = texture->m_width;
+			job->image.height = texture->m_height;
+			job->image.format = texture->m_format;
+			job->image.data = std::move(texture->m_data);
+			texture->m_data.clear();
+		}
+		ApplyWorkerCount();
+		Queue().Push(std::move(job));
+	}
+
+	void TextureStreaming::Cancel(Texture2D* texture)
+	{
+		DropUploads(texture);
+		s_pending.erase(texture);
+		texture->m_streaming = false;
+	}
+
+	void TextureStreaming::Update()
+	{
+		s_frameUploadBytes = 0;
+		if (s_pending.empty())
+			return;
+		Collect(false);
+		s_frameUploadBytes = Upload(std::max<uint64_t>(s_uploadBudget, 1), false);
+	}
+
+	void TextureStreaming::Finish(Texture2D* texture)
+	{
+		for (;;)
+		{
+			const bool pending = (texture == nullptr) ? !s_pending.empty() : IsPending(texture);
+			if (!pending)
+				break;
+			// wait for a worker only while there is nothing to upload
+			const bool decoding = (texture == nullptr) ? s_uploads.empty() : !HasUpload(texture);
+			Collect(decoding);
+			s_frameUploadBytes += Upload(0, true);
+		}
+	}
+
+	bool TextureStreaming::IsPending(Texture2D const * texture)
+	{
+		return s_pending.find(texture) != s_pending.end();
+	}
+
+	std::size_t TextureStreaming::pendingCount()
+	{
+		return s_pending.size();
+	}
+
+	void TextureStreaming::Clean()
+	{
+		Queue().Resize(0);
+		Queue().Clear();
+		for (auto & job : s_uploads)
+			DeleteUnpublished(job);
+		s_uploads.clear();
+		for (auto & p : s_pending)
+		{
+			auto texture = const_cast<Texture2D*>(p.first);
+			texture->m_streaming = false;
+			texture->m_uploaded = true;
+		}
+		s_pending.clear();
+		for (auto & buffer : s_pixelBuffers)
+		{
+			if (buffer.fence != nullptr)
+				glDeleteSync(buffer.fence);
+			if (buffer.buffer != 0)
+				glDeleteBuffers(1, &buffer.buffer);
+			buffer = PixelBuffer();
+		}
+		s_nextPixelBuffer = 0;
+	}
+
+	int TextureStreaming::workerCount()
+	{
+		if (s_workerCount < 0)
+			return DefaultWorkerCount();
+		return s_workerCount;
+	}
+
+	void TextureStreaming::setWorkerCount(int count)
+	{
+		s_workerCount = std::max(count, 0);
+	}
+}
@@ -0,0 +1,145 @@
+#include <FishEngine/Render/UniformRingBuffer.hpp>
+
+#include <cassert>
+#include <cstring>
+
+#include <FishEngine/Debug.hpp>
+
+namespace FishEngine
+{
+	inline bool BufferStorageSupported()
+	{
+#if defined(GL_MAP_PERSISTENT_BIT)
+	#if defined(__glew_h__)
+		return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+	#else
+		return true;
+	#endif
+#else
+		return false;	// e.g. macOS, GL 4.1
+#endif
+	}
+
+	void UniformRingBuffer::Init(uint32_t segmentSize)
+	{
+		assert(m_buffer == 0);
+		GLint alignment = 0;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		if (alignment > 0)
+			m_alignment = static_cast<uint32_t>(alignment);
+		m_segmentSize = (segmentSize + m_alignment - 1) / m_alignment * m_alignment;
+		const GLsizeiptr totalSize = static_cast<GLsizeiptr>(m_segmentSize) * kSegmentCount;
+
+		glGenBuffers(1, &m_buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+#if defined(GL_MAP_PERSISTENT_BIT)
+		if (BufferStorageSupported())
+		{
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_UNIFORM_BUFFER, totalSize, nullptr, flags);
+			m_mapped = static_cast<uint8_t*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, totalSize, flags));
+			if (m_mapped == nullptr)
+			{
+				LogWarning("UniformRingBuffer: persistent mapping failed, fall back to glBufferSubData");
+				glDeleteBuffers(1, &m_buffer);
+				glGenBuffers(1, &m_buffer);
+				glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+			}
+		}
+#endif
+		if (m_mapped == nullptr)
+		{
+			glBufferData(GL_UNIFORM_BUFFER, totalSize, nullptr, GL_DYNAMIC_DRAW);
+		}
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glCheckError();
+	}
+
+	void UniformRingBuffer::Destroy()
+	{
+		for (auto & fence : m_fences)
+		{
+			if (fence != nullptr)
+			{
+				glDeleteSync(fence);
+				fence = nullptr;
+			}
+		}
+		if (m_buffer != 0)
+		{
+			if (m_mapped != nullptr)
+			{
+				glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+				glUnmapBuffer(GL_UNIFORM_BUFFER);
+				glBindBuffer(GL_UNIFORM_BUFFER, 0);
+				m_mapped = nullptr;
+			}
+			glDeleteBuffers(1, &m_buffer);
+			m_buffer = 0;
+		}
+	}
+
+	void UniformRingBuffer::Upload(GLuint bindingPoint, const void* data, uint32_t size, uint32_t bindSize)
+	{
+		assert(m_buffer != 0);
+		assert(size <= bindSize);
+		if (bindSize > m_segmentSize)
+		{
+			LogError("UniformRingBuffer: uniform block is larger than a segment");
+			return;
+		}
+
+		uint32_t offset = (m_head + m_alignment - 1) / m_alignment * m_alignment;
+		if (offset + bindSize > m_segmentSize)
+		{
+			AdvanceSegment();
+			offset = 0;
+		}
+		m_head = offset + bindSize;
+
+		const GLintptr globalOffset = static_cast<GLintptr>(m_segment) * m_segmentSize + offset;
+		if (m_mapped != nullptr)
+		{
+			std::memcpy(m_mapped + globalOffset, data, size);
+		}
+		else
+		{
+			glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+			glBufferSubData(GL_UNIFORM_BUFFER, globalOffset, size, data);
+		}
+		glBindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, m_buffer, globalOffset, bindSize);
+	}
+
+	void UniformRingBuffer::NextFrame()
+	{
+		if (m_head > 0)
+			AdvanceSegment();
+	}
+
+	void UniformRingBuffer::AdvanceSegment()
+	{
+		assert(m_fences[m_segment] == nullptr);
+		m_fences[m_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		m_segment = (m_segment + 1) % kSegmentCount;
+		m_head = 0;
+		m_generation++;
+
+		// wait until the GPU is done with the draws that read this segment last time
+		GLsync & fence = m_fences[m_segment];
+		if (fence != nullptr)
+		{
+			GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			while (result == GL_TIMEOUT_EXPIRED)
+			{
+				result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);	// 1ms
+			}
+			if (result == GL_WAIT_FAILED)
+			{
+				LogError("UniformRingBuffer: glClientWaitSync failed");
+			}
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+}
@@ -0,0 +1,213 @@
+#include <FishEngine/Render/VertexLayout.hpp>
+
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include <FishEngine/Mathf.hpp>
+#include <FishEngine/Matrix4x4.hpp>
+#include <FishEngine/Render/BonePalette.hpp>
+#include <FishEngine/ShaderVariables_gen.hpp>
+#include <FishEngine/Render/GraphicsDevice.hpp>
+
+namespace FishEngine
+{
+	namespace
+	{
+		struct GLFormat
+		{
+			GLenum      type;
+			GLboolean   normalized;
+			bool        integer;
+		};
+
+		GLFormat ToGLFormat(VertexAttributeFormat format)
+		{
+			switch (format)
+			{
+			case VertexAttributeFormat::Float32:            return { GL_FLOAT, GL_FALSE, false };
+			case VertexAttributeFormat::Float16:            return { GL_HALF_FLOAT, GL_FALSE, false };
+			case VertexAttributeFormat::SNorm2_10_10_10:    return { GL_INT_2_10_10_10_REV, GL_TRUE, false };
+			case VertexAttributeFormat::UNorm8:             return { GL_UNSIGNED_BYTE, GL_TRUE, false };
+			case VertexAttributeFormat::UInt8:              return { GL_UNSIGNED_BYTE, GL_FALSE, true };
+			case VertexAttributeFormat::UInt16:             return { GL_UNSIGNED_SHORT, GL_FALSE, true };
+			}
+			abort();
+		}
+
+		inline uint32_t PackSNorm10(float v)
+		{
+			const float c = Mathf::Clamp(v, -1.0f, 1.0f);
+			const int i = static_cast<int>(std::lround(c * 511.0f));
+			return static_cast<uint32_t>(i) & 0x3FFu;
+		}
+
+		inline uint8_t PackUNorm8(float v)
+		{
+			return static_cast<uint8_t>(std::lround(Mathf::Clamp01(v) * 255.0f));
+		}
+	}
+
+	uint32_t VertexLayout::SizeOf(VertexAttributeFormat format, int dimension)
+	{
+		switch (format)
+		{
+		case VertexAttributeFormat::Float32:            return 4 * dimension;
+		case VertexAttributeFormat::Float16:            return 2 * dimension;
+		case VertexAttributeFormat::SNorm2_10_10_10:    return 4;
+		case VertexAttributeFormat::UNorm8:             return dimension;
+		case VertexAttributeFormat::UInt8:              return dimension;
+		case VertexAttributeFormat::UInt16:             return 2 * dimension;
+		}
+		abort();
+	}
+
+	void VertexLayout::Add(GLuint location, VertexAttributeFormat format, int dimension)
+	{
+		assert(dimension >= 1 && dimension <= 4);
+		assert(Find(location) == nullptr);
+		m_attributes.push_back({location, format, dimension, m_stride});
+		m_stride += (SizeOf(format, dimension) + 3u) & ~3u;
+	}
+
+	VertexAttributeDescriptor const * VertexLayout::Find(GLuint location) const
+	{
+		for (auto const & a : m_attributes)
+		{
+			if (a.location == location)
+				return &a;
+		}
+		return nullptr;
+	}
+
+	void VertexLayout::Apply(GLintptr baseOffset) const
+	{
+		for (auto const & a : m_attributes)
+		{
+			const auto gl = ToGLFormat(a.format);
+			// GL_INT_2_10_10_10_REV needs size 4, the shader ignores the components it does not declare
+			const GLint size = a.format == VertexAttributeFormat::SNorm2_10_10_10 ? 4 : a.dimension;
+			const GLvoid* pointer = reinterpret_cast<const GLvoid*>(baseOffset + a.offset);
+			if (gl.integer)
+				glVertexAttribIPointer(a.location, size, gl.type, m_stride, pointer);
+			else
+				glVertexAttribPointer(a.location, size, gl.type, gl.normalized, m_stride, pointer);
+			glEnableVertexAttribArray(a.location);
+		}
+	}
+
+	void VertexLayout::ApplyInstanceMatrices(GLintptr offset)
+	{
+		// one attribute per matrix column, MATRIX_M at InstanceMatrixIndex and MATRIX_IT_M right after it
+		static_assert(InstanceMatrixITIndex == InstanceMatrixIndex + 4, "instance matrices must be adjacent");
+		constexpr GLsizei stride = 2 * sizeof(Matrix4x4);
+		for (int i = 0; i < 8; ++i)
+		{
+			const GLuint location = InstanceMatrixIndex + i;
+			glEnableVertexAttribArray(location);
+			glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const GLvoid*>(offset + i * sizeof(Vector4)));
+			glVertexAttribDivisor(location, 1);
+		}
+	}
+
+	void VertexLayout::ResetInstanceMatrices()
+	{
+		for (int i = 0; i < 8; ++i)
+		{
+			const GLuint location = InstanceMatrixIndex + i;
+			glVertexAttribDivisor(location, 0);
+			glDisableVertexAttribArray(location);
+		}
+	}
+
+	bool VertexLayout::operator==(VertexLayout const & rhs) const
+	{
+		if (m_stride != rhs.m_stride || m_attributes.size() != rhs.m_attributes.size())
+			return false;
+		for (std::size_t i = 0; i < m_attributes.size(); ++i)
+		{
+			auto const & a = m_attributes[i];
+			auto const & b = rhs.m_attributes[i];
+			if (a.location != b.location || a.format != b.format || a.dimension != b.dimension || a.offset != b.offset)
+				return false;
+		}
+		return true;
+	}
+
+	void VertexLayout::Write(void* vertices, GLuint location, const float* src, int srcDimension, std::size_t srcStride, uint32_t count) const
+	{
+		auto a = Find(location);
+		if (a == nullptr)
+			return;
+		auto dst = static_cast<uint8_t*>(vertices) + a->offset;
+		auto srcBytes = reinterpret_cast<const uint8_t*>(src);
+		for (uint32_t i = 0; i < count; ++i, dst += m_stride)
+		{
+			float v[4] = {0, 0, 0, 0};
+			if (src != nullptr)
+			{
+				auto s = reinterpret_cast<const float*>(srcBytes + i * srcStride);
+				for (int c = 0; c < srcDimension && c < 4; ++c)
+					v[c] = s[c];
+			}
+
+			switch (a->format)
+			{
+			case VertexAttributeFormat::Float32:
+				std::memcpy(dst, v, 4 * a->dimension);
+				break;
+			case VertexAttributeFormat::Float16:
+			{
+				uint16_t h[4];
+				for (int c = 0; c < a->dimension; ++c)
+					h[c] = Mathf::FloatToHalf(v[c]);
+				std::memcpy(dst, h, 2 * a->dimension);
+				break;
+			}
+			case VertexAttributeFormat::SNorm2_10_10_10:
+			{
+				// w only has 2 bits: -1, 0 or 1
+				const uint32_t w = static_cast<uint32_t>(static_cast<int>(Mathf::Clamp(std::round(v[3]), -1.0f, 1.0f))) & 0x3u;
+				const uint32_t packed = PackSNorm10(v[0]) | (PackSNorm10(v[1]) << 10) | (PackSNorm10(v[2]) << 20) | (w << 30);
+				std::memcpy(dst, &packed, 4);
+				break;
+			}
+			case VertexAttributeFormat::UNorm8:
+				for (int c = 0; c < a->dimension; ++c)
+					dst[c] = PackUNorm8(v[c]);
+				break;
+			case VertexAttributeFormat::UInt8:
+			case VertexAttributeFormat::UInt16:
+				assert(false && "use WriteInt for integer attributes");
+				break;
+			}
+		}
+	}
+
+	void VertexLayout::WriteInt(void* vertices, GLuint location, const int* src, std::size_t srcStride, uint32_t count) const
+	{
+		auto a = Find(location);
+		if (a == nullptr)
+			return;
+		assert(a->format == VertexAttributeFormat::UInt8 || a->format == VertexAttributeFormat::UInt16);
+		auto dst = static_cast<uint8_t*>(vertices) + a->offset;
+		auto srcBytes = reinterpret_cast<const uint8_t*>(src);
+		for (uint32_t i = 0; i < count; ++i, dst += m_stride)
+		{
+			auto s = reinterpret_cast<const int*>(srcBytes + i * srcStride);
+			for (int c = 0; c < a->dimension; ++c)
+			{
+				if (a->format == VertexAttributeFormat::UInt8)
+				{
+					dst[c] = static_cast<uint8_t>(s[c]);
+				}
+				else
+				{
+					const uint16_t value = static_cast<uint16_t>(s[c]);
+					std::memcpy(dst + 2 * c, &value, 2);
+				}
+			}
+		}
+	}
+}
@@ -20,6 +20,8 @@
 #include <FishEngine/AudioListener.hpp>
 #include <FishEngine/GLEnvironment.hpp>
 #include <FishEngine/Graphics.hpp>
+#include <FishEngine/Render/Culling.hpp>
+#include <FishEngine/Render/RendererRegistry.hpp>
 
 namespace FishEngine
 {
@@ -263,84 +265,71 @@ namespace FishEngine
 		//shader->BindUniformMat4("TestMat", Matrix4x4::identity);
 
 #if 1
-		auto gameObjects = m_gameObjects;
-		
-		while (!gameObjects.empty())
+		RendererRegistry::Update();
+		RendererRegistry::UpdateLOD(*camera);
+		const auto & casterBounds = RendererRegistry::s_worldBounds;
+		const std::size_t casterCount = RendererRegistry::size();
+
+		// cull casters against each cascade's light space ortho volume.
+		// The near plane is ignored: casters between the light and the split are pulled in by GL_DEPTH_CLAMP.
+		std::vector<uint8_t> cascadeMask(casterCount, 0);
+		std::vector<uint8_t> visible;
+		for (int i = 0; i < 4; ++i)
 		{
-			auto go = gameObjects.front();
-			gameObjects.pop_front();
-			
-			if (!go->activeInHierarchy())
-				continue;
-			
-			for (auto & child : go->transform()->children())
+			auto planes = FrustumPlanes::FromMatrix(light->m_projectMatrixForShadowMap[i] * light->m_viewMatrixForShadowMap[i]);
+			planes.planes[4] = Vector4(0, 0, 0, 1);	// always inside
+			Culling::CullBounds(planes, casterBounds, visible);
+			for (std::size_t k = 0; k < casterCount; ++k)
 			{
-				gameObjects.push_back(child->gameObject());
+				if (visible[k])
+					cascadeMask[k] |= (1 << i);
 			}
+		}
 
-			RendererPtr renderer = go->GetComponent<Renderer>();
-			if (renderer == nullptr || !renderer->enabled() || renderer->shadowCastingMode() == ShadowCastingMode::Off)
+		// group the casters by cascade mask: CascadeMask lives in the material's uniform block,
+		// so it is set (and the block uploaded) once per group instead of once per caster
+		constexpr uint8_t casterFlags = RendererRegistry::Active | RendererRegistry::CastShadows;
+		std::vector<uint32_t> casters[16];
+		for (std::size_t k = 0; k < casterCount; ++k)
+		{
+			// outside of all cascades, i.e. beyond the shadow distance
+			if (cascadeMask[k] == 0)
 				continue;
+			if ((RendererRegistry::s_flags[k] & casterFlags) != casterFlags)
+				continue;
+			// only the LOD that is fading out casts shadows, the one fading in would double them
+			if (RendererRegistry::s_lodFade[k] <= 0)
+				continue;
+			if (RendererRegistry::s_meshes[k] == nullptr)
+				continue;
+			casters[cascadeMask[k]].push_back(static_cast<uint32_t>(k));
+		}
 
-			MeshPtr mesh;
-			if (renderer->ClassID() == ClassID<SkinnedMeshRenderer>())
-			{
-				mesh = As<SkinnedMeshRenderer>(renderer)->sharedMesh();
-			}
-			else
-			{
-				auto meshFilter = go->GetComponent<MeshFilter>();
-				if (meshFilter != nullptr)
-					mesh = meshFilter->mesh();
-			}
-
-			if (mesh == nullptr)
+		for (int mask = 1; mask < 16; ++mask)
+		{
+			if (casters[mask].empty())
 				continue;
+			// the geometry shader only emits to the layers in CascadeMask
+			static const int cascadeMaskID = Shader::PropertyToID("CascadeMask");
+			shadow_map_material->SetFloat(cascadeMaskID, static_cast<float>(mask));
+			for (auto k : casters[mask])
+			{
+				auto & mesh = RendererRegistry::s_meshes[k];
 
-			//renderer->PreRender();
-			auto model = renderer->transform()->localToWorldMatrix();
-			Pipeline::UpdatePerDrawUniforms(model);
-			Graphics::DrawMesh(mesh, shadow_map_material);
-
-			//auto mesh_renderer = go->GetComponent<MeshRenderer>();
-			//if (mesh_renderer != nullptr)
-			//{
-			//	if (mesh_renderer->shadowCastingMode() != ShadowCastingMode::Off)
-			//	{
-			//		auto meshFilter = go->GetComponent<MeshFilter>();
-			//		if (meshFilter != nullptr)
-			//		{
-			//			mesh = meshFilter->mesh();
-			//		}
-			//	}
-			//}
-			//else
-			//{
-			//	auto renderer = go->GetComponent<SkinnedMeshRenderer>();
-			//	if (renderer != nullptr && renderer->shadowCastingMode() != ShadowCastingMode::Off)
-			//	{
-			//		mesh = renderer->sharedMesh();
-			//		if (renderer->m_avatar != nullptr)
-			//		{
-			//			shadow_map_material->EnableKeyword(ShaderKeyword::SkinnedAnimation);
-			//			is_skinned = true;
-			//			Pipeline::UpdateBonesUniforms(renderer->matrixPalette());
-			//		}
-			//	}
-			//}
-			//
-			//if (!is_skinned)
-			//{
-			//	shadow_map_material->DisableKeyword(ShaderKeyword::SkinnedAnimation);
-			//}
-
-			//if (mesh != nullptr)
-			//{
-			//	Pipeline::UpdatePerDrawUniforms(go->transform()->localToWorldMatrix());
-			//	//shader->BindUniformMat4("ObjectToWorld", go->transform()->localToWorldMatrix());
-			//	shader->CheckStatus();
-			//	mesh->Render();
-			//}
+				//renderer->PreRender();
+				auto & renderer = RendererRegistry::s_renderers[k];
+				auto model = renderer->transform()->localToWorldMatrix();
+				Pipeline::UpdatePerDrawUniforms(model);
+				if (RendererRegistry::s_flags[k] & RendererRegistry::Skinned)
+				{
+					// not skinned yet if the camera culled it
+					auto skinnedMeshRenderer = static_cast<SkinnedMeshRenderer*>(renderer.get());
+					skinnedMeshRenderer->MarkVisible();
+					skinnedMeshRenderer->UpdateAnimationIfCulled();
+					skinnedMeshRenderer->BindSkinnedVertices();
+				}
+				Graphics::DrawMesh(mesh, shadow_map_material);
+			}
 		}
 		
 #else
@@ -427,6 +416,7 @@ namespace FishEngine
 		t->m_gameObjectStrongRef = nullptr;
 		g->m_transform = nullptr;
 		m_gameObjects.remove(g);
+		RendererRegistry::OnGameObjectDestroyed(*g);
 	}
 
 	void Scene::DestroyImmediate(ComponentPtr c)
@@ -0,0 +1,162 @@
+#include <FishEngine/Serialization/LZ4Codec.hpp>
+
+#include <cstring>
+#include <vector>
+
+namespace FishEngine
+{
+	namespace
+	{
+		constexpr std::size_t kMinMatch = 4;
+		constexpr std::size_t kLastLiterals = 5;	// the block ends with at least 5 literals
+		constexpr std::size_t kMatchFindLimit = 12;	// the last match starts at least 12 bytes before the end
+		constexpr std::size_t kMaxOffset = 65535;
+		constexpr int kHashLog = 14;
+
+		inline uint32_t Read32(const uint8_t* p)
+		{
+			uint32_t v;
+			std::memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+		inline uint32_t Hash(uint32_t sequence)
+		{
+			return (sequence * 2654435761u) >> (32 - kHashLog);
+		}
+
+		inline uint8_t* WriteLength(uint8_t* op, std::size_t length)
+		{
+			for (; length >= 255; length -= 255)
+				*op++ = 255;
+			*op++ = static_cast<uint8_t>(length);
+			return op;
+		}
+
+		inline uint8_t* WriteSequence(uint8_t* op, const uint8_t* literals, std::size_t literalCount, std::size_t offset, std::size_t matchLength)
+		{
+			uint8_t* token = op++;
+			*token = static_cast<uint8_t>((literalCount < 15 ? literalCount : 15) << 4);
+			if (literalCount >= 15)
+				op = WriteLength(op, literalCount - 15);
+			if (literalCount > 0)
+				std::memcpy(op, literals, literalCount);
+			op += literalCount;
+			if (matchLength == 0)	// last literals
+				return op;
+
+			*op++ = static_cast<uint8_t>(offset & 0xFF);
+			*op++ = static_cast<uint8_t>(offset >> 8);
+			const std::size_t length = matchLength - kMinMatch;
+			*token |= static_cast<uint8_t>(length < 15 ? length : 15);
+			if (length >= 15)
+				op = WriteLength(op, length - 15);
+			return op;
+		}
+
+		// false if the length runs past end
+		inline bool ReadLength(const uint8_t* & ip, const uint8_t* end, std::size_t & length)
+		{
+			uint8_t b;
+			do
+			{
+				if (ip >= end)
+					return false;
+				b = *ip++;
+				length += b;
+			} while (b == 255);
+			return true;
+		}
+	}
+
+	std::size_t LZ4Codec::Compress(const uint8_t* src, std::size_t size, uint8_t* dst)
+	{
+		uint8_t* op = dst;
+		std::size_t anchor = 0;
+
+		if (size > kMatchFindLimit)
+		{
+			// position + 1 of the last occurrence of each hashed 4-byte sequence, 0 if none
+			std::vector<uint32_t> table(std::size_t(1) << kHashLog, 0);
+			const std::size_t matchStartLimit = size - kMatchFindLimit;
+			const std::size_t matchEndLimit = size - kLastLiterals;
+
+			std::size_t ip = 0;
+			while (ip < matchStartLimit)
+			{
+				const uint32_t sequence = Read32(src + ip);
+				const uint32_t h = Hash(sequence);
+				const std::size_t candidate = table[h];
+				table[h] = static_cast<uint32_t>(ip + 1);
+				if (candidate == 0 || ip - (candidate - 1) > kMaxOffset || Read32(src + candidate - 1) != sequence)
+				{
+					++ip;
+					continue;
+				}
+
+				const std::size_t ref = candidate - 1;
+				std::size_t length = kMinMatch;
+				while (ip + length < matchEndLimit && src[ref + length] == src[ip + length])
+					++length;
+
+				op = WriteSequence(op, src + anchor, ip - anchor, ip - ref, length);
+				ip += length;
+				anchor = ip;
+
+				// keep the table warm inside long matches
+				if (ip - 2 < matchStartLimit)
+					table[Hash(Read32(src + ip - 2))] = static_cast<uint32_t>(ip - 2 + 1);
+			}
+		}
+
+		op = WriteSequence(op, src + anchor, size - anchor, 0, 0);
+		return static_cast<std::size_t>(op - dst);
+	}
+
+	bool LZ4Codec::Decompress(const uint8_t* src, std::size_t srcSize, uint8_t* dst, std::size_t dstSize)
+	{
+		const uint8_t* ip = src;
+		const uint8_t* const iend = src + srcSize;
+		uint8_t* op = dst;
+		uint8_t* const oend = dst + dstSize;
+
+		while (ip < iend)
+		{
+			const uint8_t token = *ip++;
+
+			std::size_t literalCount = token >> 4;
+			if (literalCount == 15 && !ReadLength(ip, iend, literalCount))
+				return false;
+			if (literalCount > static_cast<std::size_t>(iend - ip) || literalCount > static_cast<std::size_t>(oend - op))
+				return false;
+			if (literalCount > 0)
+				std::memcpy(op, ip, literalCount);
+			ip += literalCount;
+			op += literalCount;
+
+			if (ip == iend)	// the last sequence has no match
+				break;
+
+			if (iend - ip < 2)
+				return false;
+			const std::size_t offset = ip[0] | (ip[1] << 8);
+			ip += 2;
+			if (offset == 0 || offset > static_cast<std::size_t>(op - dst))
+				return false;
+
+			std::size_t length = token & 15;
+			if (length == 15 && !ReadLength(ip, iend, length))
+				return false;
+			length += kMinMatch;
+			if (length > static_cast<std::size_t>(oend - op))
+				return false;
+
+			// the match may overlap the bytes it writes
+			const uint8_t* match = op - offset;
+			for (std::size_t i = 0; i < length; ++i)
+				op[i] = match[i];
+			op += length;
+		}
+		return op == oend;
+	}
+}
@@ -0,0 +1,107 @@
+#include <FishEngine/Serialization/MappedFile.hpp>
+
+#if FISHENGINE_PLATFORM_WINDOWS
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace FishEngine
+{
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+#if FISHENGINE_PLATFORM_WINDOWS
+
+	bool MappedFile::Open(Path const & path)
+	{
+		Close();
+		HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		// the mapping keeps the file open
+		HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (mapping == nullptr)
+			return false;
+
+		void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (data == nullptr)
+		{
+			CloseHandle(mapping);
+			return false;
+		}
+
+		m_mapping = mapping;
+		m_data = static_cast<const uint8_t*>(data);
+		m_size = static_cast<std::size_t>(size.QuadPart);
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (m_data != nullptr)
+		{
+			UnmapViewOfFile(m_data);
+			CloseHandle(m_mapping);
+		}
+		m_data = nullptr;
+		m_mapping = nullptr;
+		m_size = 0;
+	}
+
+#else
+
+	bool MappedFile::Open(Path const & path)
+	{
+		Close();
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0)
+		{
+			close(fd);
+			return false;
+		}
+
+		// the mapping keeps the file open
+		void* data = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED)
+			return false;
+
+		m_data = static_cast<const uint8_t*>(data);
+		m_size = static_cast<std::size_t>(st.st_size);
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (m_data != nullptr)
+		{
+			munmap(const_cast<uint8_t*>(m_data), m_size);
+		}
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+#endif
+}
@@ -0,0 +1,495 @@
+#include <FishEngine/Serialization/MeshFile.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <vector>
+
+#include <FishEngine/Mesh.hpp>
+#include <FishEngine/Debug.hpp>
+#include <FishEngine/Serialization/MappedFile.hpp>
+#include <FishEngine/Serialization/LZ4Codec.hpp>
+#include <FishEngine/Render/BonePalette.hpp>
+#include <FishEngine/ShaderVariables_gen.hpp>
+
+namespace FishEngine
+{
+	namespace
+	{
+		constexpr uint32_t FourCC(char a, char b, char c, char d)
+		{
+			return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+		}
+
+		constexpr uint32_t kMagic = FourCC('F', 'M', 'S', 'H');
+		constexpr uint64_t kAlignment = 16;
+
+		// smaller sections are not worth compressing
+		constexpr std::size_t kMinCompressedSize = 64;
+
+		enum SectionType : uint32_t
+		{
+			VertexLayoutSection		= FourCC('V', 'L', 'A', 'Y'),	// LayoutEntry[]
+			VertexBufferSection		= FourCC('V', 'B', 'U', 'F'),	// interleaved vertices, vertexStride bytes each
+			IndexBufferSection		= FourCC('I', 'B', 'U', 'F'),	// uint16 or uint32 indices
+			SubMeshSection			= FourCC('S', 'U', 'B', 'M'),	// uint32 index offset of each submesh
+			NameSection				= FourCC('N', 'A', 'M', 'E'),	// chars
+			BindposeSection			= FourCC('B', 'P', 'O', 'S'),	// Matrix4x4[]
+			BoneNameSection			= FourCC('B', 'N', 'A', 'M'),	// (uint32 length, chars)[]
+			PositionSection			= FourCC('P', 'O', 'S', '0'),	// Vector3[], readable meshes only
+			NormalSection			= FourCC('N', 'R', 'M', '0'),	// Vector3[]
+			TangentSection			= FourCC('T', 'A', 'N', '0'),	// Vector3[]
+			UVSection				= FourCC('U', 'V', '0', '0'),	// Vector2[]
+			BoneWeightSection		= FourCC('B', 'W', 'G', 'T'),	// BoneWeight[]
+		};
+
+		enum FileFlags : uint32_t
+		{
+			SkinnedFlag = 1 << 0,
+		};
+
+		struct FileHeader
+		{
+			uint32_t	magic;
+			uint32_t	version;
+			uint32_t	sectionCount;
+			uint32_t	flags;				// FileFlags
+			uint32_t	vertexCount;
+			uint32_t	indexCount;
+			uint32_t	subMeshCount;
+			uint32_t	indexSize;			// 2 or 4 bytes
+			uint32_t	vertexStride;
+			uint32_t	reserved;
+			float		boundsMin[3];
+			float		boundsMax[3];
+		};
+		static_assert(sizeof(FileHeader) == 64, "FileHeader is part of the file format");
+
+		struct SectionEntry
+		{
+			uint32_t	type;				// SectionType
+			uint32_t	compression;		// MeshFileCompression
+			uint64_t	offset;				// from the start of the file
+			uint64_t	size;				// size in the file
+			uint64_t	rawSize;			// size once decoded
+			uint32_t	elementSize;		// the bytes of each element are shuffled together before compression
+			uint32_t	reserved;
+		};
+		static_assert(sizeof(SectionEntry) == 40, "SectionEntry is part of the file format");
+
+		struct LayoutEntry
+		{
+			uint8_t		location;
+			uint8_t		format;				// VertexAttributeFormat
+			uint8_t		dimension;
+			uint8_t		reserved;
+			uint32_t	offset;
+		};
+		static_assert(sizeof(LayoutEntry) == 8, "LayoutEntry is part of the file format");
+
+		struct PendingSection
+		{
+			uint32_t				type;
+			uint32_t				elementSize;
+			std::vector<uint8_t>	data;
+		};
+
+		template<class T>
+		void AddSection(std::vector<PendingSection> & sections, uint32_t type, uint32_t elementSize, const T* data, std::size_t count)
+		{
+			PendingSection section{ type, elementSize, {} };
+			section.data.resize(count * sizeof(T));
+			if (count > 0)
+				std::memcpy(section.data.data(), data, section.data.size());
+			sections.push_back(std::move(section));
+		}
+
+		// group byte k of every element together, floats compress a lot better that way
+		void Shuffle(const uint8_t* src, std::size_t size, std::size_t elementSize, uint8_t* dst)
+		{
+			const std::size_t count = size / elementSize;
+			for (std::size_t i = 0; i < count; ++i)
+				for (std::size_t b = 0; b < elementSize; ++b)
+					dst[b * count + i] = src[i * elementSize + b];
+			std::memcpy(dst + count * elementSize, src + count * elementSize, size - count * elementSize);
+		}
+
+		void Unshuffle(const uint8_t* src, std::size_t size, std::size_t elementSize, uint8_t* dst)
+		{
+			const std::size_t count = size / elementSize;
+			for (std::size_t i = 0; i < count; ++i)
+				for (std::size_t b = 0; b < elementSize; ++b)
+					dst[i * elementSize + b] = src[b * count + i];
+			std::memcpy(dst + count * elementSize, src + count * elementSize, size - count * elementSize);
+		}
+
+		// the mapped file, plus the sections that had to be decoded
+		struct LoadedStorage
+		{
+			MappedFile							file;
+			std::vector<std::vector<uint8_t>>	decoded;
+		};
+
+		struct SectionView
+		{
+			const uint8_t*	data = nullptr;
+			std::size_t		size = 0;
+			bool			found = false;
+		};
+
+		// the section table, decoding compressed sections into storage
+		bool ReadSections(FileHeader const & header, LoadedStorage & storage, std::map<uint32_t, SectionView> & sections)
+		{
+			const uint8_t* base = storage.file.data();
+			const uint64_t fileSize = storage.file.size();
+			const uint64_t tableSize = uint64_t(header.sectionCount) * sizeof(SectionEntry);
+			if (tableSize > fileSize - sizeof(FileHeader))
+				return false;
+
+			for (uint32_t i = 0; i < header.sectionCount; ++i)
+			{
+				SectionEntry entry;
+				std::memcpy(&entry, base + sizeof(FileHeader) + i * sizeof(SectionEntry), sizeof(entry));
+				if (entry.offset > fileSize || entry.size > fileSize - entry.offset)
+					return false;
+
+				SectionView view;
+				view.found = true;
+				view.size = static_cast<std::size_t>(entry.rawSize);
+				const uint8_t* data = base + entry.offset;
+				if (entry.compression == static_cast<uint32_t>(MeshFileCompression::None))
+				{
+					if (entry.size != entry.rawSize)
+						return false;
+					view.data = data;
+				}
+				else if (entry.compression == static_cast<uint32_t>(MeshFileCompression::LZ4))
+				{
+					// a LZ4 block expands at most ~255 times, reject sizes a corrupted entry would allocate
+					if (entry.rawSize / 255 > entry.size)
+						return false;
+					std::vector<uint8_t> shuffled(view.size);
+					if (!LZ4Codec::Decompress(data, static_cast<std::size_t>(entry.size), shuffled.data(), view.size))
+						return false;
+					if (entry.elementSize > 1)
+					{
+						std::vector<uint8_t> decoded(view.size);
+						Unshuffle(shuffled.data(), view.size, entry.elementSize, decoded.data());
+						shuffled.swap(decoded);
+					}
+					storage.decoded.push_back(std::move(shuffled));
+					view.data = storage.decoded.back().data();
+				}
+				else
+				{
+					return false;
+				}
+				sections[entry.type] = view;
+			}
+			return true;
+		}
+
+		template<class T>
+		bool ReadArray(std::map<uint32_t, SectionView> const & sections, uint32_t type, std::size_t expectedCount, std::vector<T> & array)
+		{
+			auto it = sections.find(type);
+			if (it == sections.end())
+				return true;	// optional
+			if (it->second.size != expectedCount * sizeof(T))
+				return false;
+			array.resize(expectedCount);
+			if (expectedCount > 0)
+				std::memcpy(static_cast<void*>(array.data()), it->second.data, it->second.size);
+			return true;
+		}
+	}
+
+	constexpr uint32_t MeshFile::kVersion;
+
+	bool MeshFile::Save(Mesh const & mesh, Path const & path, MeshFileOptions const & options)
+	{
+		if (mesh.m_vertices.size() != mesh.m_vertexCount || mesh.m_triangles.size() != mesh.m_triangleCount * 3)
+		{
+			LogWarning(Format("MeshFile: mesh %1% is not readable, can not save it", mesh.name()));
+			return false;
+		}
+
+		const uint32_t vertexCount = mesh.m_vertexCount;
+		std::vector<PendingSection> sections;
+
+		// GPU buffers, encoded exactly as Mesh::UploadMeshData would
+		auto layout = mesh.ChooseVertexLayout();
+		std::vector<LayoutEntry> layoutEntries;
+		for (auto const & a : layout.attributes())
+		{
+			layoutEntries.push_back({ static_cast<uint8_t>(a.location), static_cast<uint8_t>(a.format), static_cast<uint8_t>(a.dimension), 0, a.offset });
+		}
+		AddSection(sections, VertexLayoutSection, 1, layoutEntries.data(), layoutEntries.size());
+
+		PendingSection vertexBuffer{ VertexBufferSection, layout.stride(), {} };
+		mesh.EncodeVertexBuffer(layout, vertexBuffer.data);
+		sections.push_back(std::move(vertexBuffer));
+
+		const GLenum indexType = mesh.ChooseIndexType();
+		const uint32_t indexSize = indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+		PendingSection indexBuffer{ IndexBufferSection, indexSize, {} };
+		mesh.EncodeIndexBuffer(indexType, indexBuffer.data);
+		sections.push_back(std::move(indexBuffer));
+
+		// a single submesh starts at 0, whatever m_subMeshIndexOffset says
+		std::vector<uint32_t> subMeshOffsets(mesh.m_subMeshCount, 0);
+		if (mesh.m_subMeshCount > 1 && mesh.m_subMeshIndexOffset.size() == static_cast<std::size_t>(mesh.m_subMeshCount))
+			subMeshOffsets = mesh.m_subMeshIndexOffset;
+		AddSection(sections, SubMeshSection, 4, subMeshOffsets.data(), subMeshOffsets.size());
+
+		auto name = mesh.name();
+		AddSection(sections, NameSection, 1, name.data(), name.size());
+
+		if (mesh.m_skinned)
+		{
+			AddSection(sections, BindposeSection, 4, mesh.m_bindposes.data(), mesh.m_bindposes.size());
+			std::vector<uint8_t> boneNames;
+			for (auto const & boneName : mesh.m_boneNames)
+			{
+				const uint32_t length = static_cast<uint32_t>(boneName.size());
+				boneNames.insert(boneNames.end(), reinterpret_cast<const uint8_t*>(&length), reinterpret_cast<const uint8_t*>(&length) + 4);
+				boneNames.insert(boneNames.end(), boneName.begin(), boneName.end());
+			}
+			AddSection(sections, BoneNameSection, 1, boneNames.data(), boneNames.size());
+		}
+
+		if (options.readable)
+		{
+			AddSection(sections, PositionSection, 4, mesh.m_vertices.data(), mesh.m_vertices.size());
+			if (mesh.m_normals.size() == vertexCount)
+				AddSection(sections, NormalSection, 4, mesh.m_normals.data(), mesh.m_normals.size());
+			if (mesh.m_tangents.size() == vertexCount)
+				AddSection(sections, TangentSection, 4, mesh.m_tangents.data(), mesh.m_tangents.size());
+			if (mesh.m_uv.size() == vertexCount)
+				AddSection(sections, UVSection, 4, mesh.m_uv.data(), mesh.m_uv.size());
+			if (mesh.m_boneWeights.size() == vertexCount)
+				AddSection(sections, BoneWeightSection, 4, mesh.m_boneWeights.data(), mesh.m_boneWeights.size());
+		}
+
+		FileHeader header = {};
+		header.magic = kMagic;
+		header.version = kVersion;
+		header.sectionCount = static_cast<uint32_t>(sections.size());
+		header.flags = mesh.m_skinned ? static_cast<uint32_t>(SkinnedFlag) : 0u;
+		header.vertexCount = vertexCount;
+		header.indexCount = static_cast<uint32_t>(mesh.m_triangles.size());
+		header.subMeshCount = static_cast<uint32_t>(mesh.m_subMeshCount);
+		header.indexSize = indexSize;
+		header.vertexStride = layout.stride();
+		auto bmin = mesh.m_bounds.min();
+		auto bmax = mesh.m_bounds.max();
+		std::memcpy(header.boundsMin, &bmin, sizeof(header.boundsMin));
+		std::memcpy(header.boundsMax, &bmax, sizeof(header.boundsMax));
+
+		// encode the sections and lay them out
+		std::vector<SectionEntry> entries(sections.size());
+		uint64_t offset = sizeof(FileHeader) + sections.size() * sizeof(SectionEntry);
+		for (std::size_t i = 0; i < sections.size(); ++i)
+		{
+			auto & section = sections[i];
+			auto & entry = entries[i];
+			offset = (offset + kAlignment - 1) / kAlignment * kAlignment;
+			entry = {};
+			entry.type = section.type;
+			entry.compression = static_cast<uint32_t>(MeshFileCompression::None);
+			entry.offset = offset;
+			entry.rawSize = section.data.size();
+			entry.elementSize = section.elementSize;
+
+			if (options.compression == MeshFileCompression::LZ4 && section.data.size() >= kMinCompressedSize)
+			{
+				std::vector<uint8_t> shuffled(section.data.size());
+				if (section.elementSize > 1)
+					Shuffle(section.data.data(), section.data.size(), section.elementSize, shuffled.data());
+				else
+					shuffled = section.data;
+				std::vector<uint8_t> compressed(LZ4Codec::CompressBound(shuffled.size()));
+				compressed.resize(LZ4Codec::Compress(shuffled.data(), shuffled.size(), compressed.data()));
+				// keep incompressible data as it is, it can be used in place
+				if (compressed.size() < section.data.size())
+				{
+					entry.compression = static_cast<uint32_t>(MeshFileCompression::LZ4);
+					section.data.swap(compressed);
+				}
+			}
+			entry.size = section.data.size();
+			offset += entry.size;
+		}
+
+		std::ofstream os(path.string(), std::ios::binary | std::ios::trunc);
+		if (!os)
+		{
+			LogWarning(Format("MeshFile: can not write %1%", path.string()));
+			return false;
+		}
+		os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		os.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(SectionEntry));
+		uint64_t position = sizeof(FileHeader) + entries.size() * sizeof(SectionEntry);
+		static const char padding[kAlignment] = {};
+		for (std::size_t i = 0; i < sections.size(); ++i)
+		{
+			os.write(padding, static_cast<std::streamsize>(entries[i].offset - position));
+			os.write(reinterpret_cast<const char*>(sections[i].data.data()), sections[i].data.size());
+			position = entries[i].offset + entries[i].size;
+		}
+		if (!os)
+		{
+			LogWarning(Format("MeshFile: can not write %1%", path.string()));
+			return false;
+		}
+		return true;
+	}
+
+	MeshPtr MeshFile::Load(Path const & path)
+	{
+		auto storage = std::make_shared<LoadedStorage>();
+		if (!storage->file.Open(path))
+		{
+			LogWarning(Format("MeshFile: can not open %1%", path.string()));
+			return nullptr;
+		}
+
+		auto invalid = [&path](const char* reason)
+		{
+			LogWarning(Format("MeshFile: %1% %2%", path.string(), reason));
+			return nullptr;
+		};
+
+		FileHeader header;
+		if (storage->file.size() < sizeof(FileHeader))
+			return invalid("is truncated");
+		std::memcpy(&header, storage->file.data(), sizeof(header));
+		if (header.magic != kMagic)
+			return invalid("is not a mesh file");
+		if (header.version != kVersion)
+			return invalid("has an unsupported version");
+
+		std::map<uint32_t, SectionView> sections;
+		if (!ReadSections(header, *storage, sections))
+			return invalid("is corrupted");
+
+		auto & layoutSection = sections[VertexLayoutSection];
+		auto & vertexSection = sections[VertexBufferSection];
+		auto & indexSection = sections[IndexBufferSection];
+		if (!layoutSection.found || !vertexSection.found || !indexSection.found)
+			return invalid("has no vertex or index buffer");
+
+		// rebuild the layout, Add() must come up with the same offsets
+		VertexLayout layout;
+		if (layoutSection.size % sizeof(LayoutEntry) != 0)
+			return invalid("has a corrupted vertex layout");
+		const std::size_t attributeCount = layoutSection.size / sizeof(LayoutEntry);
+		for (std::size_t i = 0; i < attributeCount; ++i)
+		{
+			LayoutEntry entry;
+			std::memcpy(&entry, layoutSection.data + i * sizeof(LayoutEntry), sizeof(entry));
+			// only the mesh streams are stored, the instance matrices come after them
+			if (entry.format > static_cast<uint8_t>(VertexAttributeFormat::UInt16) || entry.dimension < 1 || entry.dimension > 4
+				|| entry.location >= InstanceMatrixIndex || layout.Find(entry.location) != nullptr)
+				return invalid("has a corrupted vertex layout");
+			layout.Add(entry.location, static_cast<VertexAttributeFormat>(entry.format), entry.dimension);
+			if (layout.attributes().back().offset != entry.offset)
+				return invalid("has a corrupted vertex layout");
+		}
+		if (layout.stride() != header.vertexStride
+			|| vertexSection.size != uint64_t(header.vertexStride) * header.vertexCount
+			|| (header.indexSize != 2 && header.indexSize != 4)
+			|| indexSection.size != uint64_t(header.indexSize) * header.indexCount
+			|| header.indexCount % 3 != 0
+			|| header.subMeshCount == 0)
+			return invalid("is corrupted");
+
+		auto mesh = MakeShared<Mesh>();
+		mesh->m_vertexCount = header.vertexCount;
+		mesh->m_triangleCount = header.indexCount / 3;
+		mesh->m_subMeshCount = static_cast<int>(header.subMeshCount);
+		mesh->m_skinned = (header.flags & SkinnedFlag) != 0;
+		const Vector3 bmin(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+		const Vector3 bmax(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+		mesh->m_bounds.SetMinMax(bmin, bmax);
+
+		if (!sections[SubMeshSection].found || !ReadArray(sections, SubMeshSection, header.subMeshCount, mesh->m_subMeshIndexOffset))
+			return invalid("has corrupted submeshes");
+		for (auto offset : mesh->m_subMeshIndexOffset)
+		{
+			if (offset > header.indexCount)
+				return invalid("has corrupted submeshes");
+		}
+
+		// the index buffer is uploaded as it is, an index past the vertices would be read out of bounds by the GPU
+		std::vector<uint32_t> indices(header.indexCount);
+		for (uint32_t i = 0; i < header.indexCount; ++i)
+		{
+			if (header.indexSize == 2)
+			{
+				uint16_t index;
+				std::memcpy(&index, indexSection.data + i * 2, 2);
+				indices[i] = index;
+			}
+			else
+			{
+				std::memcpy(&indices[i], indexSection.data + i * 4, 4);
+			}
+			if (indices[i] >= header.vertexCount)
+				return invalid("has an index out of range");
+		}
+
+		auto & nameSection = sections[NameSection];
+		if (nameSection.found)
+			mesh->setName(std::string(reinterpret_cast<const char*>(nameSection.data), nameSection.size));
+
+		if (mesh->m_skinned)
+		{
+			auto & bindposeSection = sections[BindposeSection];
+			if (bindposeSection.size % sizeof(Matrix4x4) != 0
+				|| !ReadArray(sections, BindposeSection, bindposeSection.size / sizeof(Matrix4x4), mesh->m_bindposes))
+				return invalid("has corrupted bindposes");
+
+			auto & boneNameSection = sections[BoneNameSection];
+			const uint8_t* p = boneNameSection.data;
+			const uint8_t* end = p + boneNameSection.size;
+			while (p < end)
+			{
+				uint32_t length;
+				if (end - p < 4)
+					return invalid("has corrupted bone names");
+				std::memcpy(&length, p, 4);
+				p += 4;
+				if (static_cast<std::size_t>(end - p) < length)
+					return invalid("has corrupted bone names");
+				mesh->m_boneNames.emplace_back(reinterpret_cast<const char*>(p), length);
+				p += length;
+			}
+			if (mesh->m_boneNames.size() != mesh->m_bindposes.size())
+				return invalid("has corrupted bone names");
+		}
+
+		if (!ReadArray(sections, PositionSection, header.vertexCount, mesh->m_vertices)
+			|| !ReadArray(sections, NormalSection, header.vertexCount, mesh->m_normals)
+			|| !ReadArray(sections, TangentSection, header.vertexCount, mesh->m_tangents)
+			|| !ReadArray(sections, UVSection, header.vertexCount, mesh->m_uv)
+			|| !ReadArray(sections, BoneWeightSection, header.vertexCount, mesh->m_boneWeights))
+			return invalid("has corrupted vertex attributes");
+		if (!mesh->m_vertices.empty())
+		{
+			// the triangles are only kept for readable meshes
+			mesh->m_triangles.swap(indices);
+		}
+
+		mesh->m_vertexLayout = layout;
+		mesh->m_indexType = header.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		auto bufferData = std::make_shared<MeshBufferData>();
+		bufferData->vertices = vertexSection.data;
+		bufferData->verticesSize = vertexSection.size;
+		bufferData->indices = indexSection.data;
+		bufferData->indicesSize = indexSection.size;
+		bufferData->storage = storage;
+		mesh->m_bufferData = bufferData;
+		return mesh;
+	}
+}
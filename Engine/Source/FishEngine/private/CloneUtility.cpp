@@ -6,6 +6,7 @@
 #include <FishEngine/Avatar.hpp>
 #include <FishEngine/Mesh.hpp>
 #include <FishEngine/Prefab.hpp>
+#include <FishEngine/LODGroup.hpp>
 
 namespace FishEngine
 {
@@ -105,6 +106,13 @@ namespace FishEngine
 			dest = source;
 		}
 	}
+
+	void CloneUtility::Clone(FishEngine::LOD const & source, FishEngine::LOD & dest)
+	{
+		dest.screenRelativeTransitionHeight = source.screenRelativeTransitionHeight;
+		dest.fadeTransitionWidth = source.fadeTransitionWidth;
+		this->Clone(source.gameObjects, dest.gameObjects);
+	}
 	
 //	void CloneUtility::Clone(FishEngine::MaterialPtr const & source, FishEngine::MaterialPtr & dest)
 //	{
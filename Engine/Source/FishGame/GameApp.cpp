@@ -2,6 +2,7 @@
 
 #include <string>
 #include <chrono>
+#include <cstdlib>
 #include <FishEngine/GLEnvironment.hpp>
 #include <GLFW/glfw3.h>
 
@@ -20,6 +21,8 @@
 #include <FishEngine/Shader.hpp>
 #include <FishEngine/ShaderCompiler.hpp>
 #include <FishEngine/Mesh.hpp>
+#include <FishEngine/Render/GLStateCache.hpp>
+#include <FishEngine/Render/ShaderCache.hpp>
 
 using namespace std;
 using namespace FishEngine;
@@ -28,6 +31,7 @@ using namespace FishEngine;
 GLFWwindow* GameApp::m_window = nullptr;
 int GameApp::m_windowWidth = 640;
 int GameApp::m_windowHeight = 480;
+std::string GameApp::m_engineRoot;
 
 int GameApp::Run()
 {
@@ -45,7 +49,6 @@ int GameApp::Run()
 	// Create a GLFWwindow object that we can use for GLFW's functions
 	m_window = glfwCreateWindow(m_windowWidth, m_windowHeight, "FishEngine", nullptr, nullptr);
 	glfwMakeContextCurrent(m_window);
-	glCheckError();
 
 	glfwSetKeyCallback(m_window, GameApp::KeyCallBack);
 	//glfwSetCursorPosCallback(m_window, GameApp::MouseCallback);
@@ -72,6 +75,8 @@ int GameApp::Run()
 		LogInfo("GlEW initialized");
 	}
 #endif
+	GraphicsDevice::Init(GraphicsDeviceType::OpenGLCore);
+	glCheckError();
 	
 	int w, h;
 	glfwGetFramebufferSize(m_window, &w, &h);
@@ -79,34 +84,11 @@ int GameApp::Run()
 	Screen::m_height = h;
 	Screen::m_pixelsPerPoint = static_cast<float>(w) / m_windowWidth;
 
-#if FISHENGINE_PLATFORM_WINDOWS
-	auto shaderRoot = FishEngine::Path(R"(D:\program\github\FishEngine\Engine\Shaders)");
-#else
-	auto shaderRoot = FishEngine::Path("/Users/yushroom/program/FishEngine/Engine/Shaders");
-#endif
-	auto shaderIncludeDir = shaderRoot / "include";
-	ShaderCompiler::setShaderIncludeDir(shaderIncludeDir.string());
-	Shader::Init(shaderRoot.string());
-	
-#if FISHENGINE_PLATFORM_WINDOWS
-	Mesh::Init(R"(D:\program\github\FishEngine\assets\Models)");
-#else
-	Mesh::Init("/Users/yushroom/program/FishEngine/assets/Models");
-#endif
-	
-	//Resources::Init();
-	Input::Init();
-	RenderSystem::Init();
-	//WindowSizeCallback(m_window, m_windowWidth, m_windowHeight);
-
-	Init();
-	Scene::Init();
-	PhysicsSystem::Init();
-
-	Scene::Start();
-	//PhysicsSystem::Start();
-	
-	Init();
+	if (!InitEngine())
+	{
+		glfwTerminate();
+		return 1;
+	}
 
 	constexpr int report_frames = 1000;
 	int frames = 0;
@@ -131,6 +113,7 @@ int GameApp::Run()
 
 		glViewport(0, 0, Screen::width(), Screen::height());
 		RenderSystem::Render();
+		Pipeline::EndFrame();
 
 		frames++;
 		if (frames >= report_frames)
@@ -150,10 +133,113 @@ int GameApp::Run()
 		glfwSwapBuffers(m_window);
 	}
 
+	RenderSystem::Clean();
 	glfwTerminate();
 	return 0;
 }
 
+int GameApp::RunHeadless(int frameCount, int width /*= 1280*/, int height /*= 720*/)
+{
+	Debug::Init();
+	Debug::setColorMode(true);
+
+	// no window and no context, every GL call goes to the Null device
+	GraphicsDevice::Init(GraphicsDeviceType::Null);
+	m_windowWidth = width;
+	m_windowHeight = height;
+	Screen::m_width = width;
+	Screen::m_height = height;
+	Screen::m_pixelsPerPoint = 1.0f;
+
+	if (!InitEngine())
+		return 1;
+
+	typedef std::chrono::high_resolution_clock clock;
+	std::chrono::duration<double, std::milli> updateTime(0), renderTime(0);
+	uint64_t drawCalls = 0;
+	uint64_t stateChanges = 0;
+	uint64_t uploadBytes = 0;
+
+	for (int frame = 0; frame < frameCount; ++frame)
+	{
+		auto t0 = clock::now();
+		Input::Update();
+		Scene::Update();
+		PhysicsSystem::FixedUpdate();
+
+		auto t1 = clock::now();
+		glViewport(0, 0, Screen::width(), Screen::height());
+		RenderSystem::Render();
+		Pipeline::EndFrame();
+		auto t2 = clock::now();
+
+		updateTime += t1 - t0;
+		renderTime += t2 - t1;
+		drawCalls += GraphicsDevice::counters().drawCalls;
+		stateChanges += GLStateCache::counters().totalIssued();
+		uploadBytes += GraphicsDevice::counters().bufferUploadBytes;
+	}
+
+	if (frameCount > 0)
+	{
+		LogInfo(Format("headless: %1% frames, update %2% ms/frame, render %3% ms/frame", frameCount, updateTime.count() / frameCount, renderTime.count() / frameCount));
+		LogInfo(Format("headless: %1% draw calls/frame, %2% state changes/frame, %3% buffer bytes/frame", drawCalls / frameCount, stateChanges / frameCount, uploadBytes / frameCount));
+	}
+
+	RenderSystem::Clean();
+	return 0;
+}
+
+bool GameApp::InitEngine()
+{
+	std::string root = m_engineRoot;
+	if (root.empty())
+	{
+		const char* env = std::getenv("FISHENGINE_ROOT");
+		if (env != nullptr)
+			root = env;
+	}
+	if (root.empty())
+	{
+		LogError("FishEngine root not set: call GameApp::setEngineRoot or set FISHENGINE_ROOT to the directory with Engine/Shaders and assets/Models");
+		return false;
+	}
+	auto shaderRoot = FishEngine::Path(root) / "Engine" / "Shaders";
+	auto modelRoot = FishEngine::Path(root) / "assets" / "Models";
+	for (auto const & dir : { shaderRoot, modelRoot })
+	{
+		if (!boost::filesystem::is_directory(dir))
+		{
+			LogError("FishEngine root " + root + " has no " + dir.string());
+			return false;
+		}
+	}
+
+	auto shaderIncludeDir = shaderRoot / "include";
+	ShaderCompiler::setShaderIncludeDir(shaderIncludeDir.string());
+	ShaderCache::Init(ShaderCache::DefaultDirectory());
+	Shader::Init(shaderRoot.string());
+	
+	Mesh::Init(modelRoot.string());
+	
+	//Resources::Init();
+	Input::Init();
+	RenderSystem::Init();
+	// no first-use compile hitches in the first frames
+	Shader::WarmupAllShaders();
+	//WindowSizeCallback(m_window, m_windowWidth, m_windowHeight);
+
+	Init();
+	Scene::Init();
+	PhysicsSystem::Init();
+
+	Scene::Start();
+	//PhysicsSystem::Start();
+	
+	Init();
+	return true;
+}
+
 int KeyCodeFromGLFWKey(int key)
 {
 	if (key >= GLFW_KEY_A && key <= GLFW_KEY_Z)
@@ -1,6 +1,8 @@
 #include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <cstdlib>
+#include <cctype>
 
 #include <FishGame/GameApp.hpp>
 #include <FishEngine/Camera.hpp>
@@ -47,10 +49,30 @@ public:
 	}
 };
 
-int main()
+int main(int argc, char* argv[])
 {
 	TestApp app;
 	//app.Init();
-	app.Run();
-	return 0;
+	// Test [--root <dir>] [--headless [frames]]
+	// --root: the directory with Engine/Shaders and assets/Models, FISHENGINE_ROOT when omitted
+	// --headless: CPU cost of the render loop, no GPU needed
+	bool headless = false;
+	int frames = 1000;
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (arg == "--root" && i + 1 < argc)
+		{
+			GameApp::setEngineRoot(argv[++i]);
+		}
+		else if (arg == "--headless")
+		{
+			headless = true;
+			if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+				frames = std::atoi(argv[++i]);
+		}
+	}
+	if (headless)
+		return app.RunHeadless(frames);
+	return app.Run();
 }
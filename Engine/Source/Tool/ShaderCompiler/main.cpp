@@ -2,68 +2,542 @@
 #include <FishEngine/ShaderCompiler.hpp>
 #include <FishEngine/GLEnvironment.hpp>
 #include <FishEngine/Debug.hpp>
+#include <FishEngine/Render/GraphicsDevice.hpp>
+#include <FishEngine/Render/Shader/ShaderCompileError.hpp>
 #include <glfw/glfw3.h>
 
+#include <boost/algorithm/string.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
 using namespace FishEngine;
 
+// usage: ShaderCompiler [options] <shader file or directory>...
+//  -I <dir>            directory of the system includes (#include <...>)
+//                      default: the first Engine/Shaders/include above the executable
+//  -j <n>              preprocess with n threads, default: one per core
+//  --state <file>      results of the last run, shaders whose source and includes did not change are skipped
+//                      default: <temp>/FishEngine/ShaderCompiler.state
+//  --force             process every shader
+//  --report <file>     per-shader timing report, default: stdout
+//  --errors <file>     errors as a JSON array of {"file", "stage", "keywords", "line", "message"}, one per error line of
+//                      the GL info logs; keywords is the variant (ShaderKeywords), line is 0 if unknown
+//  --no-gl             preprocess only
+//
+// Every .shader/.surf file under the directories is processed: the dirty ones are preprocessed in parallel, then every
+// variant of them is compiled and linked on one GL context. The exit code is 1 if any shader failed.
+
+typedef std::chrono::high_resolution_clock Clock;
+
+namespace
+{
+	struct Options
+	{
+		std::vector<Path>   inputs;
+		Path                includeDir;
+		Path                stateFile;
+		Path                reportFile;
+		Path                errorFile;
+		int                 threads = 0;
+		bool                force = false;
+		bool                compile = true;
+	};
+
+	struct ShaderError
+	{
+		ShaderCompileStage  stage;
+		ShaderKeywords      keywords;
+		int                 line;
+		std::string         message;
+	};
+
+	struct Job
+	{
+		Path                                                path;
+		std::time_t                                         mtime = 0;
+		std::vector<std::pair<std::string, std::time_t>>    dependencies;
+
+		bool                                dirty = true;
+		bool                                ok = false;
+		std::unique_ptr<ShaderCompiler>     compiler;
+		std::string                         parsed;
+		std::vector<ShaderError>            errors;
+		int                                 variants = 0;
+		double                              preprocessTime = 0;	// ms
+		double                              compileTime = 0;	// ms
+	};
+
+	// what the last run saw of a shader
+	struct State
+	{
+		std::time_t                                         mtime = 0;
+		bool                                                ok = false;
+		std::vector<std::pair<std::string, std::time_t>>    dependencies;
+	};
+
+	std::time_t LastWriteTime(Path const & path)
+	{
+		boost::system::error_code error;
+		auto time = boost::filesystem::last_write_time(path, error);
+		return error ? static_cast<std::time_t>(-1) : time;
+	}
+
+	double Milliseconds(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	bool IsShaderFile(Path const & path)
+	{
+		auto ext = path.extension();
+		return ext == ".shader" || ext == ".surf";
+	}
+
+	std::vector<Path> CollectShaders(std::vector<Path> const & inputs)
+	{
+		std::vector<Path> files;
+		for (auto const & input : inputs)
+		{
+			if (boost::filesystem::is_directory(input))
+			{
+				boost::system::error_code error;
+				for (boost::filesystem::recursive_directory_iterator it(input, error), end; !error && it != end; it.increment(error))
+				{
+					if (IsShaderFile(it->path()))
+						files.push_back(boost::filesystem::absolute(it->path()));
+				}
+			}
+			else
+			{
+				files.push_back(boost::filesystem::absolute(input));
+			}
+		}
+		std::sort(files.begin(), files.end());
+		files.erase(std::unique(files.begin(), files.end()), files.end());
+		return files;
+	}
+
+	// one shader per line: path, mtime, ok, dependency count; then one line per dependency: path, mtime
+	constexpr const char* kStateHeader = "FishEngine ShaderCompiler state 1";
+
+	std::unordered_map<std::string, State> LoadState(Path const & path)
+	{
+		std::unordered_map<std::string, State> states;
+		std::ifstream file(path.string());
+		std::string line;
+		if (!std::getline(file, line) || line != kStateHeader)
+			return states;
+		while (std::getline(file, line))
+		{
+			std::vector<std::string> fields;
+			boost::split(fields, line, boost::is_any_of("\t"));
+			if (fields.size() != 4)
+				break;
+			State state;
+			state.mtime = std::stoll(fields[1]);
+			state.ok = fields[2] == "1";
+			const int count = std::stoi(fields[3]);
+			for (int i = 0; i < count && std::getline(file, line); ++i)
+			{
+				auto tab = line.find('\t');
+				if (tab == std::string::npos)
+					break;
+				state.dependencies.emplace_back(line.substr(0, tab), std::stoll(line.substr(tab + 1)));
+			}
+			states[fields[0]] = std::move(state);
+		}
+		return states;
+	}
+
+	// states: the state file as loaded, the shaders of other runs (other directories) are kept
+	void SaveState(Path const & path, std::unordered_map<std::string, State> states, std::vector<Job> const & jobs)
+	{
+		for (auto const & job : jobs)
+		{
+			auto & state = states[job.path.string()];
+			state.mtime = job.mtime;
+			state.ok = job.ok;
+			state.dependencies = job.dependencies;
+		}
+		std::vector<std::string> paths;
+		paths.reserve(states.size());
+		for (auto const & pair : states)
+			paths.push_back(pair.first);
+		std::sort(paths.begin(), paths.end());
+
+		boost::system::error_code error;
+		boost::filesystem::create_directories(path.parent_path(), error);
+		std::ofstream file(path.string(), std::ios::trunc);
+		file << kStateHeader << '\n';
+		for (auto const & p : paths)
+		{
+			auto const & state = states.at(p);
+			file << p << '\t' << static_cast<long long>(state.mtime) << '\t' << (state.ok ? 1 : 0) << '\t' << state.dependencies.size() << '\n';
+			for (auto const & d : state.dependencies)
+				file << d.first << '\t' << static_cast<long long>(d.second) << '\n';
+		}
+		if (!file)
+			LogWarning(Format("Can not write %1%", path.string()));
+	}
+
+	// a shader that compiled last time is skipped if neither it nor any of its includes changed
+	bool UpToDate(Job const & job, std::unordered_map<std::string, State> const & states)
+	{
+		auto it = states.find(job.path.string());
+		if (it == states.end())
+			return false;
+		auto const & state = it->second;
+		if (!state.ok || state.mtime != job.mtime)
+			return false;
+		for (auto const & d : state.dependencies)
+		{
+			if (LastWriteTime(d.first) != d.second)
+				return false;
+		}
+		return true;
+	}
+
+	void Preprocess(Job & job)
+	{
+		auto start = Clock::now();
+		try
+		{
+			job.compiler = std::make_unique<ShaderCompiler>(job.path);
+			job.parsed = job.compiler->Preprocess();
+			job.dependencies = job.compiler->m_dependencies;
+			std::sort(job.dependencies.begin(), job.dependencies.end());
+			job.dependencies.erase(std::unique(job.dependencies.begin(), job.dependencies.end()), job.dependencies.end());
+			job.ok = true;
+		}
+		catch (const ShaderCompileError& e)
+		{
+			job.errors.push_back({ShaderCompileStage::Preprocessor, 0, e.lineNumber(), e.what()});
+			job.ok = false;
+		}
+		catch (const std::exception& e)
+		{
+			job.errors.push_back({ShaderCompileStage::Preprocessor, 0, 0, e.what()});
+			job.ok = false;
+		}
+		job.preprocessTime = Milliseconds(start);
+	}
+
+	void PreprocessAll(std::vector<Job*> const & jobs, int threadCount)
+	{
+		std::atomic<size_t> next(0);
+		auto worker = [&]()
+		{
+			for (size_t i = next++; i < jobs.size(); i = next++)
+				Preprocess(*jobs[i]);
+		};
+		std::vector<std::thread> threads;
+		for (int i = 1; i < threadCount; ++i)
+			threads.emplace_back(worker);
+		worker();
+		for (auto & t : threads)
+			t.join();
+	}
+
+	// every variant of the shader
+	void Compile(Job & job)
+	{
+		auto start = Clock::now();
+		std::vector<ShaderDiagnostic> diagnostics;
+		auto shader = Shader::CreateFromPreprocessed(*job.compiler, job.parsed, &diagnostics);
+		if (shader != nullptr)
+		{
+			const ShaderKeywords mask = shader->variantKeywords();
+			for (ShaderKeywords keywords = mask; ; keywords = (keywords - 1) & mask)
+			{
+				shader->Warmup(keywords);
+				job.variants++;
+				if (keywords == 0)
+					break;
+			}
+			auto const & errors = shader->diagnostics();
+			diagnostics.insert(diagnostics.end(), errors.begin(), errors.end());
+		}
+		job.compileTime = Milliseconds(start);
+
+		for (auto const & d : diagnostics)
+			job.errors.push_back({d.stage, d.keywords, d.lineNumber, d.message});
+		job.ok = shader != nullptr && job.errors.empty();
+		job.compiler.reset();
+		job.parsed.clear();
+	}
+
+	const char* StageName(ShaderCompileStage stage)
+	{
+		switch (stage)
+		{
+		case ShaderCompileStage::Preprocessor:	return "Preprocessor";
+		case ShaderCompileStage::Compile:		return "Compile";
+		case ShaderCompileStage::Link:			return "Link";
+		}
+		return "Unknown";
+	}
+
+	std::string JsonString(std::string const & str)
+	{
+		std::ostringstream out;
+		out << '"';
+		for (unsigned char c : str)
+		{
+			switch (c)
+			{
+			case '"':  out << "\\\""; break;
+			case '\\': out << "\\\\"; break;
+			case '\n': out << "\\n"; break;
+			case '\r': out << "\\r"; break;
+			case '\t': out << "\\t"; break;
+			default:
+				if (c < 0x20)
+					out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+				else
+					out << c;
+			}
+		}
+		out << '"';
+		return out.str();
+	}
+
+	void WriteErrors(std::ostream & out, std::vector<Job> const & jobs)
+	{
+		out << "[";
+		bool first = true;
+		for (auto const & job : jobs)
+		{
+			for (auto const & e : job.errors)
+			{
+				out << (first ? "\n" : ",\n");
+				out << "\t{\"file\": " << JsonString(job.path.string())
+					<< ", \"stage\": " << JsonString(StageName(e.stage))
+					<< ", \"keywords\": " << e.keywords
+					<< ", \"line\": " << e.line
+					<< ", \"message\": " << JsonString(e.message) << "}";
+				first = false;
+			}
+		}
+		out << "\n]\n";
+	}
+
+	void WriteReport(std::ostream & out, std::vector<Job> const & jobs, double totalTime)
+	{
+		std::vector<Job const *> processed;
+		int failed = 0;
+		for (auto const & job : jobs)
+		{
+			if (!job.dirty)
+				continue;
+			processed.push_back(&job);
+			if (!job.ok)
+				failed++;
+		}
+		std::sort(processed.begin(), processed.end(), [](Job const * a, Job const * b)
+		{
+			return a->preprocessTime + a->compileTime > b->preprocessTime + b->compileTime;
+		});
+
+		out << std::fixed << std::setprecision(2);
+		out << "preprocess(ms)\tcompile(ms)\tvariants\tstatus\tshader\n";
+		for (auto job : processed)
+		{
+			out << job->preprocessTime << '\t' << job->compileTime << '\t' << job->variants << '\t'
+				<< (job->ok ? "ok" : "FAILED") << '\t' << job->path.string() << '\n';
+		}
+		out << jobs.size() << " shaders, " << jobs.size() - processed.size() << " up to date, "
+			<< processed.size() << " processed, " << failed << " failed, " << totalTime << " ms" << std::endl;
+	}
+
+	bool ParseOptions(int argc, char* argv[], Options & options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string arg = argv[i];
+			auto value = [&]() -> const char*
+			{
+				if (i + 1 >= argc)
+					throw std::invalid_argument(arg + " needs a value");
+				return argv[++i];
+			};
+			if (arg == "-I")
+				options.includeDir = value();
+			else if (arg == "-j")
+				options.threads = std::atoi(value());
+			else if (arg == "--state")
+				options.stateFile = value();
+			else if (arg == "--force")
+				options.force = true;
+			else if (arg == "--report")
+				options.reportFile = value();
+			else if (arg == "--errors")
+				options.errorFile = value();
+			else if (arg == "--no-gl")
+				options.compile = false;
+			else if (!arg.empty() && arg[0] == '-')
+				throw std::invalid_argument("unknown option " + arg);
+			else
+				options.inputs.push_back(arg);
+		}
+		return !options.inputs.empty();
+	}
+
+	// Engine/Shaders/include of the source tree the executable was built in, empty if there is none
+	Path FindIncludeDir(const char* argv0)
+	{
+		boost::system::error_code error;
+		Path exe = boost::filesystem::canonical(boost::filesystem::system_complete(argv0), error);
+		if (error)
+			return Path();
+		for (Path dir = exe.parent_path(); !dir.empty(); dir = dir.parent_path())
+		{
+			for (auto const & candidate : { dir / "Shaders" / "include", dir / "Engine" / "Shaders" / "include" })
+			{
+				if (boost::filesystem::is_directory(candidate, error))
+					return candidate;
+			}
+			if (dir == dir.root_path())
+				break;
+		}
+		return Path();
+	}
+
+	GLFWwindow* CreateContext()
+	{
+		glfwInit();
+		// Set all the required options for GLFW
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+		constexpr int WIDTH = 1;
+		constexpr int HEIGHT = 1;
+
+		// Create a GLFWwindow object that we can use for GLFW's functions
+		auto window = glfwCreateWindow(WIDTH, HEIGHT, "FishEngine", nullptr, nullptr);
+		if (window == nullptr)
+			return nullptr;
+		glfwMakeContextCurrent(window);
+
+#if FISHENGINE_PLATFORM_WINDOWS
+		// Set this to true so GLEW knows to use a modern approach to retrieving function pointers and extensions
+		glewExperimental = GL_TRUE;
+		// Initialize GLEW to setup the OpenGL Function pointers
+		glewInit();
+#endif
+		GraphicsDevice::Init(GraphicsDeviceType::OpenGLCore);
+		glCheckError();
+		return window;
+	}
+}
+
 int main(int argc, char* argv[])
 {
 	//Debug::Init();
 	//Debug::setColorMode(false);
-	LogInfo("Compiling...");
-	
-	glfwInit();
-	// Set all the required options for GLFW
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-	//glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
-	constexpr int WIDTH = 1;
-	constexpr int HEIGHT = 1;
-
-	// Create a GLFWwindow object that we can use for GLFW's functions
-	auto window = glfwCreateWindow(WIDTH, HEIGHT, "FishEngine", nullptr, nullptr);
-	glfwMakeContextCurrent(window);
-	glCheckError();
-	
-#if FISHENGINE_PLATFORM_WINDOWS
-	// Set this to true so GLEW knows to use a modern approach to retrieving function pointers and extensions
-	glewExperimental = GL_TRUE;
-	// Initialize GLEW to setup the OpenGL Function pointers
-	glewInit();
-	std::string path = R"(D:\program\github\FishEngine\Example\UnityChan-crs\Assets\UnityChanStage\Effects\Shaders\Light Beam.shader)";
-	ShaderCompiler::setShaderIncludeDir(R"(D:\program\github\FishEngine\Engine\Shaders\include)");
-#else
-	std::string path = "/Users/yushroom/program/FishEngine/Example/UnityChan-crs/Assets/UnityChan/CandyRockStar/Shader/Unitychan_chara_fuku_ds.shader";
-	ShaderCompiler::setShaderIncludeDir("/Users/yushroom/program/FishEngine/Engine/Shaders/include");
-#endif
 
-	
-	if (argc == 2)
-	{
-		path = argv[1];
-	}
-//#ifdef _DEBUG
-//    else
-//    {
-//        Debug::LogError("invalid command.");
-//        return 1;
-//    }
-//#endif
-	
-	auto shader = Shader::CreateFromFile(path);
-	if (shader == nullptr)
+	Options options;
+	options.stateFile = boost::filesystem::temp_directory_path() / "FishEngine" / "ShaderCompiler.state";
+	try
+	{
+		if (!ParseOptions(argc, argv, options))
+		{
+			LogError("usage: ShaderCompiler [-I include_dir] [-j threads] [--state file] [--force] [--report file] [--errors file] [--no-gl] <shader file or directory>...");
+			return 1;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		LogError(e.what());
 		return 1;
+	}
+	if (options.includeDir.empty())
+	{
+		options.includeDir = FindIncludeDir(argv[0]);
+		if (options.includeDir.empty())
+		{
+			LogError("Can not find Engine/Shaders/include next to the executable, pass it with -I");
+			return 1;
+		}
+	}
+	if (options.threads <= 0)
+		options.threads = std::max(1u, std::thread::hardware_concurrency());
+	ShaderCompiler::setShaderIncludeDir(options.includeDir.string());
+
+	auto start = Clock::now();
+
+	auto files = CollectShaders(options.inputs);
+	std::vector<Job> jobs(files.size());
+	auto states = LoadState(options.stateFile);
+	std::vector<Job*> dirty;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		auto & job = jobs[i];
+		job.path = files[i];
+		job.mtime = LastWriteTime(job.path);
+		if (options.compile && !options.force && UpToDate(job, states))
+		{
+			auto const & state = states.at(job.path.string());
+			job.dirty = false;
+			job.ok = true;
+			job.dependencies = state.dependencies;
+		}
+		else
+		{
+			dirty.push_back(&job);
+		}
+	}
+	LogInfo(Format("%1% shaders, %2% to process", jobs.size(), dirty.size()));
+
+	PreprocessAll(dirty, options.threads);
+	for (auto job : dirty)
+	{
+		for (auto const & e : job->errors)
+			LogError(Format("%1%: %2%", job->path.string(), e.message));
+	}
+
+	if (options.compile && !dirty.empty())
+	{
+		if (CreateContext() == nullptr)
+		{
+			LogError("Can not create a GL context, use --no-gl to preprocess only");
+			return 1;
+		}
+		for (auto job : dirty)
+		{
+			if (job->ok)
+				Compile(*job);
+		}
+	}
+
+	// a preprocess-only run does not validate a shader, do not record it as compiled
+	if (options.compile)
+		SaveState(options.stateFile, std::move(states), jobs);
 
-	shader->Use();
-	if (shader->IsValid())
+	if (options.reportFile.empty())
 	{
-		LogInfo("OK");
-		return 0;
+		WriteReport(std::cout, jobs, Milliseconds(start));
 	}
 	else
 	{
-		return 1;
+		std::ofstream report(options.reportFile.string());
+		WriteReport(report, jobs, Milliseconds(start));
 	}
+	if (!options.errorFile.empty())
+	{
+		std::ofstream errors(options.errorFile.string());
+		WriteErrors(errors, jobs);
+	}
+
+	bool ok = std::all_of(jobs.begin(), jobs.end(), [](Job const & job) { return job.ok; });
+	return ok ? 0 : 1;
 }
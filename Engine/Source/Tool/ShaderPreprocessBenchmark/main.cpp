@@ -0,0 +1,139 @@
+#include <FishEngine/ShaderCompiler.hpp>
+#include <FishEngine/Render/Shader/ShaderCompileError.hpp>
+#include <FishEngine/Debug.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using namespace FishEngine;
+
+// Times the shader preprocessor (no GL needed) on every .shader/.surf file under the given directories,
+// with a cold and a warm include cache.
+// With --dump, the preprocessed text of each shader is written to <dump dir>, one file per shader named after
+// its path, so that the output of two builds can be compared with a plain diff.
+// usage: ShaderPreprocessBenchmark <include dir> <shader dir>... [-n iterations] [--dump <dump dir>]
+// e.g. ShaderPreprocessBenchmark Engine/Shaders/include Engine/Shaders Example/UnityChan-crs/Assets Example/PBR
+
+typedef std::chrono::high_resolution_clock Clock;
+
+struct Result
+{
+	double      milliseconds = 0;
+	std::size_t bytes = 0;
+	int         failed = 0;
+};
+
+std::string PreprocessOne(Path const & file)
+{
+	ShaderCompiler compiler(file);
+	return compiler.Preprocess();
+}
+
+Result PreprocessAll(std::vector<Path> const & files, int iterations, bool coldIncludeCache)
+{
+	Result result;
+	for (int i = 0; i < iterations; ++i)
+	{
+		if (coldIncludeCache)
+			ShaderCompiler::ClearIncludeCache();
+		auto start = Clock::now();
+		for (auto const & file : files)
+		{
+			try
+			{
+				result.bytes += PreprocessOne(file).size();
+			}
+			catch (ShaderCompileError const &)
+			{
+				result.failed++;
+			}
+		}
+		result.milliseconds += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+	result.milliseconds /= iterations;
+	result.bytes /= iterations;
+	result.failed /= iterations;
+	return result;
+}
+
+void DumpOutputs(std::vector<Path> const & files, Path const & dumpDir)
+{
+	boost::filesystem::create_directories(dumpDir);
+	for (auto const & file : files)
+	{
+		std::string text;
+		try
+		{
+			text = PreprocessOne(file);
+		}
+		catch (ShaderCompileError const & e)
+		{
+			text = std::string("error: ") + e.what();
+		}
+		auto name = file.relative_path().string();
+		std::replace_if(name.begin(), name.end(), [](char c) { return c == '/' || c == '\\' || c == ':'; }, '_');
+		std::ofstream fout((dumpDir / (name + ".txt")).string());
+		fout << text;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		std::cout << "usage: ShaderPreprocessBenchmark <include dir> <shader dir>... [-n iterations] [--dump <dump dir>]" << std::endl;
+		return 1;
+	}
+
+	ShaderCompiler::setShaderIncludeDir(argv[1]);
+
+	int iterations = 20;
+	Path dumpDir;
+	std::vector<Path> files;
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "-n" && i + 1 < argc)
+		{
+			iterations = std::max(1, std::atoi(argv[++i]));
+			continue;
+		}
+		if (arg == "--dump" && i + 1 < argc)
+		{
+			dumpDir = argv[++i];
+			continue;
+		}
+		boost::system::error_code error;
+		for (boost::filesystem::recursive_directory_iterator it(arg, error), end; !error && it != end; it.increment(error))
+		{
+			auto ext = it->path().extension();
+			if (ext == ".shader" || ext == ".surf")
+				files.push_back(it->path());
+		}
+	}
+
+	if (files.empty())
+	{
+		LogError("No shader found.");
+		return 1;
+	}
+
+	// the first pass reads the files from disk, leave it out
+	PreprocessAll(files, 1, true);
+	if (!dumpDir.empty())
+		DumpOutputs(files, dumpDir);
+
+	auto cold = PreprocessAll(files, iterations, true);
+	auto warm = PreprocessAll(files, iterations, false);
+
+	std::cout << files.size() << " shaders, " << cold.failed << " failed, " << cold.bytes / 1024 << " KB of preprocessed text\n";
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "cold include cache: " << std::setw(8) << cold.milliseconds << " ms\n";
+	std::cout << "warm include cache: " << std::setw(8) << warm.milliseconds << " ms" << std::endl;
+	return 0;
+}
@@ -9,6 +9,7 @@
 @fragment
 {
 	#include <DeferredShadingCommon.inc>
+	#include <LODFade.inc>
 
 	struct VS_OUT
 	{
@@ -47,6 +48,7 @@
 
 	void main()
 	{
+		LODFadeClip();
 		FGBufferData GBuffer = CalcGBuffer(vs_out);
 		EncodeGBuffer(GBuffer, MRT0, MRT1, MRT2);
 	}
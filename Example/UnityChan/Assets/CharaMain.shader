@@ -47,6 +47,7 @@ struct VS_OUT
 {
 	#include <CGSupport.inc>
 	#include <ShaderVariables.inc>
+	#include <LODFade.inc>
 	// Material parameters
 	uniform float4 _Color;
 	uniform float4 _ShadowColor;
@@ -100,6 +101,7 @@ struct VS_OUT
 
 	void main()
 	{
+		LODFadeClip();
 		float4_t diffSamplerColor = tex2D( _MainTex, vs_out.uv.xy );
 		//color = diffSamplerColor;
 		//return;
@@ -40,6 +40,10 @@ namespace ${scope}
 	% if 'parent' in c and T != 'FishEditor::AssetImporter':
 		${c['parent']}::Deserialize(archive);
 	% endif
+	% if T in legacy_formats:
+		if (DeserializeLegacy(archive))
+			return;
+	% endif
 	% for member in c['members']:
 		archive >> FishEngine::make_nvp("${member['name']}", ${member['name']}); // ${member['type']}
 	% endfor
@@ -105,6 +109,9 @@ blacklist = ("FishEngine::Vector2",
 	"FishEngine::Matrix4x4",
 	"FishEngine::Quaternion");
 
+# classes whose older files are read by a hand-written bool DeserializeLegacy(FishEngine::InputArchive &)
+legacy_formats = ("FishEngine::Material",)
+
 
 def GenSerializationFunctions(classinfo, scope, root_dir):
 	def IsObject(name):
@@ -146,7 +153,7 @@ def GenSerializationFunctions(classinfo, scope, root_dir):
 		ClassInfo.append(c)
 
 	headers = set(headers)
-	return serialization_template.render(headers = headers, scope = scope, ClassInfo=ClassInfo)
+	return serialization_template.render(headers = headers, scope = scope, ClassInfo=ClassInfo, legacy_formats=legacy_formats)
 
 
 objectInheritance_template_str = '''